@@ -0,0 +1,394 @@
+// Extra Class for VoxelizedNuclearDNA
+//
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class holds the internal residue geometry of one chromatin fiber, in the fiber frame: the
+// sphere (centre & radius), shell radius, cut planes and copy number of every residue, and the centre of every
+// histone. It is used when fibers are replaced by homogeneous proxy cylinders for transport
+// (VoxelizedNuclearDNA parameter UseFiberProxy), and by the IRT chemistry of the scorer.
+//**************************************************************************************************
+
+#include "DNAFiberTemplate.hh"
+
+#include "G4SystemOfUnits.hh"
+#include "G4Types.hh"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+//--------------------------------------------------------------------------------------------------
+// Registry of templates, indexed by geometry component name. Templates are only added or refilled
+// during geometry construction, which happens on the master thread while no events are running.
+//--------------------------------------------------------------------------------------------------
+std::map<G4String, DNAFiberTemplate*>& DNAFiberTemplate::GetRegistry()
+{
+    static std::map<G4String, DNAFiberTemplate*> registry;
+    return registry;
+}
+
+DNAFiberTemplate* DNAFiberTemplate::GetInstance(const G4String& componentName)
+{
+    std::map<G4String, DNAFiberTemplate*>& registry = GetRegistry();
+    std::map<G4String, DNAFiberTemplate*>::iterator it = registry.find(componentName);
+    if (it != registry.end()) return it->second;
+
+    DNAFiberTemplate* fiberTemplate = new DNAFiberTemplate();
+    registry[componentName] = fiberTemplate;
+    return fiberTemplate;
+}
+
+const DNAFiberTemplate* DNAFiberTemplate::Find(const G4String& componentName)
+{
+    std::map<G4String, DNAFiberTemplate*>& registry = GetRegistry();
+    std::map<G4String, DNAFiberTemplate*>::iterator it = registry.find(componentName);
+    if (it == registry.end() || it->second->GetNumberOfResidues() == 0) return NULL;
+    return it->second;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Constructor
+//--------------------------------------------------------------------------------------------------
+DNAFiberTemplate::DNAFiberTemplate()
+    : fFiberRadius(0.), fFiberHalfLength(0.), fNumResidues(0), fResidueValues(NULL), fResidueCopyNumbers(NULL),
+      fMaxResidueRadius(0.), fMaxShellRadius(0.), fNumHistones(0), fHistoneValues(NULL),
+      fHistoneRadius(0.), fHistoneHalfHeight(0.), fFiberVolume(NULL)
+{}
+
+//--------------------------------------------------------------------------------------------------
+// Destructor
+//--------------------------------------------------------------------------------------------------
+DNAFiberTemplate::~DNAFiberTemplate()
+{}
+
+//--------------------------------------------------------------------------------------------------
+// Discard all residues & histones (or detach from external arrays) & set the fiber dimensions.
+//--------------------------------------------------------------------------------------------------
+void DNAFiberTemplate::Reset(G4double fiberRadius, G4double fiberHalfLength)
+{
+    fFiberRadius = fiberRadius;
+    fFiberHalfLength = fiberHalfLength;
+    fNumResidues = 0;
+    fOwnedResidueValues.clear();
+    fOwnedResidueCopyNumbers.clear();
+    fMaxResidueRadius = 0.;
+    fMaxShellRadius = 0.;
+    fCutPlanes.Clear();
+    fNumHistones = 0;
+    fOwnedHistoneValues.clear();
+    fHistoneRadius = 0.;
+    fHistoneHalfHeight = 0.;
+    UseOwnStorage();
+    fSpatialIndex.Build(fResidueValues, kResidueStride, 0, 1.*nm);
+    fHistoneIndex.Build(fHistoneValues, 3, 0, 1.*nm);
+    fFiberVolume = NULL;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Register a residue. Residues are only counted once Build() is called.
+//--------------------------------------------------------------------------------------------------
+void DNAFiberTemplate::AddResidue(const G4ThreeVector& position, G4double radius, G4double shellRadius,
+                                  G4int copyNumber, const std::vector<ResidueCutPlane>& cutPlanes)
+{
+    shellRadius = std::max(shellRadius, radius);
+    fOwnedResidueValues.push_back(position.x());
+    fOwnedResidueValues.push_back(position.y());
+    fOwnedResidueValues.push_back(position.z());
+    fOwnedResidueValues.push_back(radius);
+    fOwnedResidueValues.push_back(shellRadius);
+    fOwnedResidueCopyNumbers.push_back(copyNumber);
+    fMaxResidueRadius = std::max(fMaxResidueRadius, radius);
+    fMaxShellRadius = std::max(fMaxShellRadius, shellRadius);
+
+    fCutPlanes.AddResidue(cutPlanes);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Register a histone.
+//--------------------------------------------------------------------------------------------------
+void DNAFiberTemplate::AddHistone(const G4ThreeVector& position, G4double radius, G4double halfHeight)
+{
+    fOwnedHistoneValues.push_back(position.x());
+    fOwnedHistoneValues.push_back(position.y());
+    fOwnedHistoneValues.push_back(position.z());
+    fHistoneRadius = radius;
+    fHistoneHalfHeight = halfHeight;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Build the spatial indices. Cells are the size of the largest residue, so a point is only tested
+// against the residues of the cells around it. Histone cells enclose a histone.
+//--------------------------------------------------------------------------------------------------
+void DNAFiberTemplate::Build()
+{
+    UseOwnStorage();
+    fSpatialIndex.Build(fResidueValues, kResidueStride, fNumResidues, 2*fMaxResidueRadius);
+    fHistoneIndex.Build(fHistoneValues, 3, fNumHistones, 2*std::max(fHistoneRadius, fHistoneHalfHeight));
+}
+
+//--------------------------------------------------------------------------------------------------
+// Layout: ints are the numbers of residues, histones, cut planes, residue index cells & histone
+// index cells, then the copy numbers, the cut plane starts & the cell arrays of both indices.
+// Values are the six dimensions, then the residue, cut plane & histone arrays & both index grids.
+//--------------------------------------------------------------------------------------------------
+void DNAFiberTemplate::Serialize(std::vector<G4double>* values, std::vector<G4int>* ints) const
+{
+    G4int numCutPlanes = fCutPlanes.GetNumberOfPlanes();
+    G4int numResidueCells = fSpatialIndex.GetNumberOfCells();
+    G4int numHistoneCells = fHistoneIndex.GetNumberOfCells();
+
+    ints->push_back(fNumResidues);
+    ints->push_back(fNumHistones);
+    ints->push_back(numCutPlanes);
+    ints->push_back(numResidueCells);
+    ints->push_back(numHistoneCells);
+    ints->insert(ints->end(), fResidueCopyNumbers, fResidueCopyNumbers + fNumResidues);
+    ints->insert(ints->end(), fCutPlanes.GetStart(), fCutPlanes.GetStart() + fNumResidues + 1);
+    ints->insert(ints->end(), fSpatialIndex.GetCellStart(), fSpatialIndex.GetCellStart() + numResidueCells + 1);
+    ints->insert(ints->end(), fSpatialIndex.GetSortedIndices(), fSpatialIndex.GetSortedIndices() + fNumResidues);
+    ints->insert(ints->end(), fHistoneIndex.GetCellStart(), fHistoneIndex.GetCellStart() + numHistoneCells + 1);
+    ints->insert(ints->end(), fHistoneIndex.GetSortedIndices(), fHistoneIndex.GetSortedIndices() + fNumHistones);
+
+    values->push_back(fFiberRadius);
+    values->push_back(fFiberHalfLength);
+    values->push_back(fMaxResidueRadius);
+    values->push_back(fMaxShellRadius);
+    values->push_back(fHistoneRadius);
+    values->push_back(fHistoneHalfHeight);
+    values->insert(values->end(), fResidueValues, fResidueValues + kResidueStride*fNumResidues);
+    values->insert(values->end(), fCutPlanes.GetValues(), fCutPlanes.GetValues() + 4*numCutPlanes);
+    values->insert(values->end(), fHistoneValues, fHistoneValues + 3*fNumHistones);
+    G4double grid[ResidueSpatialIndex::kGridSize];
+    fSpatialIndex.GetGrid(grid);
+    values->insert(values->end(), grid, grid + ResidueSpatialIndex::kGridSize);
+    fHistoneIndex.GetGrid(grid);
+    values->insert(values->end(), grid, grid + ResidueSpatialIndex::kGridSize);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Point every array at the serialized layout.
+//--------------------------------------------------------------------------------------------------
+void DNAFiberTemplate::Attach(const G4double* values, const G4int* ints)
+{
+    std::vector<G4double>().swap(fOwnedResidueValues);
+    std::vector<G4int>().swap(fOwnedResidueCopyNumbers);
+    std::vector<G4double>().swap(fOwnedHistoneValues);
+
+    fNumResidues = ints[0];
+    fNumHistones = ints[1];
+    G4int numCutPlanes = ints[2];
+    G4int numResidueCells = ints[3];
+    G4int numHistoneCells = ints[4];
+    fResidueCopyNumbers = ints + 5;
+    const G4int* cutPlaneStart = fResidueCopyNumbers + fNumResidues;
+    const G4int* residueCellStart = cutPlaneStart + fNumResidues + 1;
+    const G4int* residueSortedIndices = residueCellStart + numResidueCells + 1;
+    const G4int* histoneCellStart = residueSortedIndices + fNumResidues;
+    const G4int* histoneSortedIndices = histoneCellStart + numHistoneCells + 1;
+
+    fFiberRadius = values[0];
+    fFiberHalfLength = values[1];
+    fMaxResidueRadius = values[2];
+    fMaxShellRadius = values[3];
+    fHistoneRadius = values[4];
+    fHistoneHalfHeight = values[5];
+    fResidueValues = values + 6;
+    const G4double* cutPlaneValues = fResidueValues + kResidueStride*fNumResidues;
+    fHistoneValues = cutPlaneValues + 4*numCutPlanes;
+    const G4double* residueGrid = fHistoneValues + 3*fNumHistones;
+    const G4double* histoneGrid = residueGrid + ResidueSpatialIndex::kGridSize;
+
+    fCutPlanes.Attach(fNumResidues, cutPlaneValues, cutPlaneStart);
+    fSpatialIndex.Attach(fResidueValues, kResidueStride, fNumResidues, residueGrid,
+                         residueCellStart, residueSortedIndices);
+    fHistoneIndex.Attach(fHistoneValues, 3, fNumHistones, histoneGrid, histoneCellStart, histoneSortedIndices);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Point the arrays at the template's own vectors.
+//--------------------------------------------------------------------------------------------------
+void DNAFiberTemplate::UseOwnStorage()
+{
+    fNumResidues = (G4int)fOwnedResidueCopyNumbers.size();
+    fResidueValues = fOwnedResidueValues.data();
+    fResidueCopyNumbers = fOwnedResidueCopyNumbers.data();
+    fNumHistones = (G4int)fOwnedHistoneValues.size()/3;
+    fHistoneValues = fOwnedHistoneValues.data();
+}
+
+//--------------------------------------------------------------------------------------------------
+// A point is inside a residue if it is inside its sphere & on the kept side of all its cut planes,
+// and inside its hydration shell if the same holds for the shell sphere. Shells of neighbouring
+// residues can overlap beyond their cut planes, hence the nearest surface.
+//--------------------------------------------------------------------------------------------------
+G4int DNAFiberTemplate::LocateResidue(const G4ThreeVector& localPoint, G4bool includeShells) const
+{
+    static G4ThreadLocal std::vector<G4int>* neighbours = 0;
+    if (!neighbours) neighbours = new std::vector<G4int>;
+
+    fSpatialIndex.FindNeighbours(localPoint, includeShells ? fMaxShellRadius : fMaxResidueRadius, *neighbours);
+
+    G4int shellResidue = -1;
+    G4double shellDepth = DBL_MAX; // distance outside the residue sphere
+    for (size_t n=0; n<neighbours->size(); ++n) {
+        G4int index = (*neighbours)[n];
+        const G4double* values = fResidueValues + kResidueStride*index;
+        G4ThreeVector relative(localPoint.x()-values[0], localPoint.y()-values[1], localPoint.z()-values[2]);
+        G4double distance2 = relative.mag2();
+        G4double radius = includeShells ? values[4] : values[3];
+        if (distance2 > radius*radius) continue;
+        if (!fCutPlanes.IsInside(index, relative)) continue;
+
+        if (distance2 <= values[3]*values[3]) return fResidueCopyNumbers[index];
+        G4double depth = std::sqrt(distance2) - values[3];
+        if (depth < shellDepth) {
+            shellDepth = depth;
+            shellResidue = fResidueCopyNumbers[index];
+        }
+    }
+    return shellResidue;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Histones are cylinders along the fiber axis.
+//--------------------------------------------------------------------------------------------------
+G4int DNAFiberTemplate::LocateHistone(const G4ThreeVector& localPoint) const
+{
+    static G4ThreadLocal std::vector<G4int>* neighbours = 0;
+    if (!neighbours) neighbours = new std::vector<G4int>;
+
+    fHistoneIndex.FindNeighbours(localPoint, std::sqrt(fHistoneRadius*fHistoneRadius + fHistoneHalfHeight*fHistoneHalfHeight),
+                                 *neighbours);
+
+    for (size_t n=0; n<neighbours->size(); ++n) {
+        G4int index = (*neighbours)[n];
+        G4ThreeVector relative = localPoint - GetHistonePosition(index);
+        if (std::abs(relative.z()) <= fHistoneHalfHeight && relative.perp2() <= fHistoneRadius*fHistoneRadius)
+            return index;
+    }
+    return -1;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Only the residues & histones near the segment are tested: those whose centre is within reach of
+// its midpoint. A residue is entered where the segment enters both its sphere & the kept side of all
+// its cut planes, so through its cut faces as well as its spherical surface (e.g. from a point of
+// the sphere cut off by a plane). A histone is entered where the segment enters both its slab along
+// the fiber axis & its infinite cylinder.
+//--------------------------------------------------------------------------------------------------
+G4bool DNAFiberTemplate::FindFirstCrossing(const G4ThreeVector& start, const G4ThreeVector& end,
+                                           SegmentCrossing& crossing, G4bool includeShells) const
+{
+    static G4ThreadLocal std::vector<G4int>* neighbours = 0;
+    if (!neighbours) neighbours = new std::vector<G4int>;
+
+    G4ThreeVector direction = end - start;
+    G4ThreeVector midpoint = 0.5*(start + end);
+    G4double halfLength = 0.5*direction.mag();
+    G4double a = direction.mag2();
+    if (a <= 0.) return false;
+
+    crossing.fraction = 2.;
+
+    //----------------------------------------------------------------------------------------------
+    // Residue spheres (or shell spheres)
+    //----------------------------------------------------------------------------------------------
+    fSpatialIndex.FindNeighbours(midpoint, halfLength + (includeShells ? fMaxShellRadius : fMaxResidueRadius),
+                                 *neighbours);
+    for (size_t n=0; n<neighbours->size(); ++n) {
+        G4int index = (*neighbours)[n];
+        G4double radius = includeShells ? GetResidueShellRadius(index) : GetResidueRadius(index);
+        G4ThreeVector offset = start - GetResiduePosition(index);
+
+        // Parameter interval inside the sphere
+        G4double b = 2.*offset.dot(direction);
+        G4double c = offset.mag2() - radius*radius;
+        G4double discriminant = b*b - 4.*a*c;
+        if (discriminant < 0.) continue;
+        G4double root = std::sqrt(discriminant);
+        G4double tMin = (-b - root)/(2.*a);
+        G4double tMax = std::min(1., (-b + root)/(2.*a));
+
+        // Parameter interval on the kept side of the cut planes
+        fCutPlanes.ClipSegment(index, offset, direction, tMin, tMax);
+
+        if (tMin > tMax || tMin <= 0. || tMin >= crossing.fraction) continue; // missed, or start inside
+
+        crossing.isHistone = false;
+        crossing.target = fResidueCopyNumbers[index];
+        crossing.fraction = tMin;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // Histone cylinders
+    //----------------------------------------------------------------------------------------------
+    G4double histoneReach = std::sqrt(fHistoneRadius*fHistoneRadius + fHistoneHalfHeight*fHistoneHalfHeight);
+    fHistoneIndex.FindNeighbours(midpoint, halfLength + histoneReach, *neighbours);
+    for (size_t n=0; n<neighbours->size(); ++n) {
+        G4int index = (*neighbours)[n];
+        G4ThreeVector offset = start - GetHistonePosition(index);
+
+        // Parameter interval inside the slab |z| <= half height
+        G4double tMin = 0.;
+        G4double tMax = 1.;
+        if (direction.z() != 0.) {
+            G4double t1 = (-fHistoneHalfHeight - offset.z())/direction.z();
+            G4double t2 = (fHistoneHalfHeight - offset.z())/direction.z();
+            tMin = std::max(tMin, std::min(t1, t2));
+            tMax = std::min(tMax, std::max(t1, t2));
+        }
+        else if (std::abs(offset.z()) > fHistoneHalfHeight) continue;
+
+        // Parameter interval inside the infinite cylinder
+        G4double aPerp = direction.perp2();
+        G4double cPerp = offset.perp2() - fHistoneRadius*fHistoneRadius;
+        if (aPerp > 0.) {
+            G4double bPerp = 2.*(offset.x()*direction.x() + offset.y()*direction.y());
+            G4double discriminant = bPerp*bPerp - 4.*aPerp*cPerp;
+            if (discriminant < 0.) continue;
+            G4double root = std::sqrt(discriminant);
+            tMin = std::max(tMin, (-bPerp - root)/(2.*aPerp));
+            tMax = std::min(tMax, (-bPerp + root)/(2.*aPerp));
+        }
+        else if (cPerp > 0.) continue;
+
+        if (tMin > tMax || tMin <= 0. || tMin >= crossing.fraction) continue; // missed, or start inside
+
+        crossing.isHistone = true;
+        crossing.target = index;
+        crossing.fraction = tMin;
+    }
+
+    return crossing.fraction <= 1.;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Estimate the fraction of the fiber volume occupied by residues. Grid points are at the centres of
+// cubic cells of side spacing; only those inside the fiber cylinder are counted.
+//--------------------------------------------------------------------------------------------------
+G4double DNAFiberTemplate::CalculateResidueVolumeFraction(G4double spacing) const
+{
+    if (spacing <= 0. || fFiberRadius <= 0. || fFiberHalfLength <= 0.) return 0.;
+
+    G4int numXY = (G4int)std::ceil(2*fFiberRadius/spacing);
+    G4int numZ = (G4int)std::ceil(2*fFiberHalfLength/spacing);
+    G4long numInFiber = 0;
+    G4long numInResidue = 0;
+
+    for (G4int iz=0; iz<numZ; ++iz) {
+        G4double z = -fFiberHalfLength + (iz+0.5)*spacing;
+        for (G4int iy=0; iy<numXY; ++iy) {
+            G4double y = -fFiberRadius + (iy+0.5)*spacing;
+            for (G4int ix=0; ix<numXY; ++ix) {
+                G4double x = -fFiberRadius + (ix+0.5)*spacing;
+                if (x*x + y*y > fFiberRadius*fFiberRadius) continue;
+                ++numInFiber;
+                if (LocateResidue(G4ThreeVector(x,y,z)) >= 0) ++numInResidue;
+            }
+        }
+    }
+
+    if (numInFiber == 0) return 0.;
+    return (G4double)numInResidue/numInFiber;
+}
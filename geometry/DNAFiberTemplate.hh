@@ -0,0 +1,202 @@
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class holds the internal residue geometry of one chromatin fiber, in the fiber frame: the
+// sphere (centre & radius), hydration shell radius, cut planes and copy number of every residue,
+// and the centre of every histone. It is used when fibers are replaced by homogeneous proxy cylinders for transport
+// (VoxelizedNuclearDNA parameter UseFiberProxy). Energy deposited in a proxy fiber is attributed by
+// the scorer to the residue that occupies the deposition point, found with LocateResidue(). The
+// template can also be built for full fibers (parameter BuildFiberTemplate), so the scorer can find
+// the residues & histones near a radiolytic species without navigating (IRT chemistry). With proxy
+// fibers, the diffusion steps of the species are tested against the residues & histones with
+// FindFirstCrossing().
+//
+// Hydration shells are not volumes: a residue's shell is its sphere inflated to the shell radius,
+// with the same cut planes. The Locate & crossing tests use the shell radius when asked to.
+//
+// One template is kept per geometry component, in a registry filled by VoxelizedNuclearDNA on the
+// master thread & read by the scorers on all threads. The template's arrays are either its own,
+// filled with AddResidue() & AddHistone(), or those of a mapped FiberTemplateFile (see Attach()),
+// so that processes sharing the file also share the template's memory.
+//**************************************************************************************************
+
+#ifndef DNAFIBERTEMPLATE_HH
+#define DNAFIBERTEMPLATE_HH
+
+#include "DNAOverlapChecker.hh"
+#include "ResidueSpatialIndex.hh"
+
+#include "G4ThreeVector.hh"
+#include "G4String.hh"
+
+#include <map>
+#include <vector>
+
+class G4LogicalVolume;
+
+class DNAFiberTemplate
+{
+public:
+    //----------------------------------------------------------------------------------------------
+    // Return the template of the given geometry component, creating an empty one if needed. The
+    // registry owns the templates, so the returned pointer remains valid for the whole session,
+    // including across geometry rebuilds.
+    //----------------------------------------------------------------------------------------------
+    static DNAFiberTemplate* GetInstance(const G4String& componentName);
+
+    //----------------------------------------------------------------------------------------------
+    // Return the template of the given geometry component, or NULL if none has been built.
+    //----------------------------------------------------------------------------------------------
+    static const DNAFiberTemplate* Find(const G4String& componentName);
+
+    //----------------------------------------------------------------------------------------------
+    // Discard all residues & set the fiber dimensions.
+    //----------------------------------------------------------------------------------------------
+    void Reset(G4double fiberRadius, G4double fiberHalfLength);
+
+    //----------------------------------------------------------------------------------------------
+    // Register a residue & the radius of its hydration shell. Position & cut plane normals are in
+    // the fiber frame.
+    //----------------------------------------------------------------------------------------------
+    void AddResidue(const G4ThreeVector& position, G4double radius, G4double shellRadius, G4int copyNumber,
+                    const std::vector<ResidueCutPlane>& cutPlanes);
+
+    //----------------------------------------------------------------------------------------------
+    // Register a histone: a cylinder along the fiber axis. Position is in the fiber frame.
+    //----------------------------------------------------------------------------------------------
+    void AddHistone(const G4ThreeVector& position, G4double radius, G4double halfHeight);
+
+    //----------------------------------------------------------------------------------------------
+    // Set the logical volume of the fiber, used to recognise the fiber in a touchable history.
+    //----------------------------------------------------------------------------------------------
+    void SetFiberVolume(G4LogicalVolume* fiberVolume) {fFiberVolume = fiberVolume;}
+
+    //----------------------------------------------------------------------------------------------
+    // Build the spatial indices. Must be called once all residues & histones are registered.
+    //----------------------------------------------------------------------------------------------
+    void Build();
+
+    //----------------------------------------------------------------------------------------------
+    // Append the template's arrays to values & ints, in the layout read by Attach(). The spatial
+    // indices are included, so an attached template needs no Build().
+    //----------------------------------------------------------------------------------------------
+    void Serialize(std::vector<G4double>* values, std::vector<G4int>* ints) const;
+
+    //----------------------------------------------------------------------------------------------
+    // Discard the template's own arrays & use external ones written by Serialize(), without
+    // copying them. They must remain valid until the next Reset() or Attach().
+    //----------------------------------------------------------------------------------------------
+    void Attach(const G4double* values, const G4int* ints);
+
+    //----------------------------------------------------------------------------------------------
+    // Return the copy number of the residue containing localPoint (fiber frame), or -1 if the point
+    // is not inside any residue. With includeShells, a point outside all residues but inside
+    // hydration shells is given to the residue whose surface is nearest.
+    //----------------------------------------------------------------------------------------------
+    G4int LocateResidue(const G4ThreeVector& localPoint, G4bool includeShells = false) const;
+
+    //----------------------------------------------------------------------------------------------
+    // Return the index of the histone containing localPoint (fiber frame), or -1 if the point is
+    // not inside any histone.
+    //----------------------------------------------------------------------------------------------
+    G4int LocateHistone(const G4ThreeVector& localPoint) const;
+
+    //----------------------------------------------------------------------------------------------
+    // First residue or histone entered along a straight segment (fiber frame): a residue copy number
+    // or a histone index, & the fraction of the segment travelled before entering it
+    //----------------------------------------------------------------------------------------------
+    struct SegmentCrossing
+    {
+        G4bool isHistone;
+        G4int target;
+        G4double fraction;
+    };
+
+    //----------------------------------------------------------------------------------------------
+    // Find the first residue or histone that the segment from start to end enters from outside,
+    // through its surface or one of its cut faces. Targets containing start are ignored (for a
+    // residue, only if start is on the kept side of its cut planes). Return false if no target is
+    // entered. With includeShells, a residue is entered at its hydration shell.
+    //----------------------------------------------------------------------------------------------
+    G4bool FindFirstCrossing(const G4ThreeVector& start, const G4ThreeVector& end, SegmentCrossing& crossing,
+                             G4bool includeShells = false) const;
+
+    //----------------------------------------------------------------------------------------------
+    // Estimate the fraction of the fiber volume occupied by residues, by locating the points of a
+    // regular grid with the given spacing.
+    //----------------------------------------------------------------------------------------------
+    G4double CalculateResidueVolumeFraction(G4double spacing) const;
+
+    //----------------------------------------------------------------------------------------------
+    // Fill residues (or histones) with the indices of all residues (histones) whose centre is within
+    // distance of localPoint (fiber frame). The vector is cleared first. Returns the number found.
+    //----------------------------------------------------------------------------------------------
+    G4int FindResidues(const G4ThreeVector& localPoint, G4double distance, std::vector<G4int>& residues) const
+    {return fSpatialIndex.FindNeighbours(localPoint, distance, residues);}
+    G4int FindHistones(const G4ThreeVector& localPoint, G4double distance, std::vector<G4int>& histones) const
+    {return fHistoneIndex.FindNeighbours(localPoint, distance, histones);}
+
+    //----------------------------------------------------------------------------------------------
+    // Getters
+    //----------------------------------------------------------------------------------------------
+    G4int GetNumberOfResidues() const {return fNumResidues;}
+    G4double GetFiberRadius() const {return fFiberRadius;}
+    G4double GetFiberHalfLength() const {return fFiberHalfLength;}
+    G4LogicalVolume* GetFiberVolume() const {return fFiberVolume;}
+    G4ThreeVector GetResiduePosition(G4int residue) const
+    {const G4double* values = fResidueValues + kResidueStride*residue; return G4ThreeVector(values[0], values[1], values[2]);}
+    G4double GetResidueRadius(G4int residue) const {return fResidueValues[kResidueStride*residue + 3];}
+    G4double GetResidueShellRadius(G4int residue) const {return fResidueValues[kResidueStride*residue + 4];}
+    G4int GetResidueCopyNumber(G4int residue) const {return fResidueCopyNumbers[residue];}
+    G4double GetMaxResidueRadius() const {return fMaxResidueRadius;}
+    G4double GetMaxShellRadius() const {return fMaxShellRadius;}
+    G4int GetNumberOfHistones() const {return fNumHistones;}
+    G4ThreeVector GetHistonePosition(G4int histone) const
+    {const G4double* values = fHistoneValues + 3*histone; return G4ThreeVector(values[0], values[1], values[2]);}
+    G4double GetHistoneRadius() const {return fHistoneRadius;}
+    G4double GetHistoneHalfHeight() const {return fHistoneHalfHeight;}
+
+private:
+    DNAFiberTemplate();
+
+    ~DNAFiberTemplate();
+
+    static std::map<G4String, DNAFiberTemplate*>& GetRegistry();
+
+    // Values stored per residue: centre x, y & z, radius, shell radius
+    static const G4int kResidueStride = 5;
+
+    //----------------------------------------------------------------------------------------------
+    // Point the arrays below at the template's own vectors.
+    //----------------------------------------------------------------------------------------------
+    void UseOwnStorage();
+
+    G4double fFiberRadius;
+    G4double fFiberHalfLength;
+
+    G4int fNumResidues;
+    const G4double* fResidueValues;
+    const G4int* fResidueCopyNumbers;
+    G4double fMaxResidueRadius;
+    G4double fMaxShellRadius;
+
+    ResidueCutPlaneTable fCutPlanes;
+
+    ResidueSpatialIndex fSpatialIndex;
+
+    // Histones (centre x, y & z), all with the same dimensions
+    G4int fNumHistones;
+    const G4double* fHistoneValues;
+    G4double fHistoneRadius;
+    G4double fHistoneHalfHeight;
+    ResidueSpatialIndex fHistoneIndex;
+
+    // The template's own arrays. Unused while attached to external ones.
+    std::vector<G4double> fOwnedResidueValues;
+    std::vector<G4int> fOwnedResidueCopyNumbers;
+    std::vector<G4double> fOwnedHistoneValues;
+
+    G4LogicalVolume* fFiberVolume;
+};
+
+#endif // DNAFIBERTEMPLATE_HH
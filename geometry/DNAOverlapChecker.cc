@@ -0,0 +1,379 @@
+// Extra Class for VoxelizedNuclearDNA
+//
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class performs a fast, analytic overlap verification of the contents of a single chromatin
+// fiber. It is an alternative to calling G4VPhysicalVolume::CheckOverlaps() on every residue and
+// histone placement, which samples random surface points against every sibling volume and takes
+// hours for a full fiber.
+//
+// Residues are described by their sphere (centre & radius) and the planes used to cut them in
+// VoxelizedNuclearDNA::CreateCutSolid(). Histones are z-aligned cylinders. Only near neighbours are
+// tested, using a ResidueSpatialIndex over the residue centres. The fiber boundary is also checked.
+//**************************************************************************************************
+
+#include "DNAOverlapChecker.hh"
+#include "ResidueSpatialIndex.hh"
+
+#include "G4SystemOfUnits.hh"
+#include "G4ios.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+//--------------------------------------------------------------------------------------------------
+// Helper used to order overlaps from deepest to shallowest
+//--------------------------------------------------------------------------------------------------
+static bool IsDeeperOverlap(const DNAOverlapRecord& a, const DNAOverlapRecord& b)
+{
+    return a.depth > b.depth;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Residue cut plane table. A copy of a table holding its own arrays holds copies of them; a copy of
+// an attached table views the same external arrays.
+//--------------------------------------------------------------------------------------------------
+ResidueCutPlaneTable::ResidueCutPlaneTable()
+{
+    Clear();
+}
+
+ResidueCutPlaneTable::ResidueCutPlaneTable(const ResidueCutPlaneTable& other)
+{
+    *this = other;
+}
+
+ResidueCutPlaneTable& ResidueCutPlaneTable::operator=(const ResidueCutPlaneTable& other)
+{
+    if (this == &other) return *this;
+    fNumResidues = other.fNumResidues;
+    fIsAttached = other.fIsAttached;
+    fOwnedValues = other.fOwnedValues;
+    fOwnedStart = other.fOwnedStart;
+    if (fIsAttached) {
+        fValues = other.fValues;
+        fStart = other.fStart;
+    }
+    else UseOwnStorage();
+    return *this;
+}
+
+void ResidueCutPlaneTable::Clear()
+{
+    fNumResidues = 0;
+    fIsAttached = false;
+    fOwnedValues.clear();
+    fOwnedStart.assign(1, 0);
+    UseOwnStorage();
+}
+
+void ResidueCutPlaneTable::AddResidue(const std::vector<ResidueCutPlane>& planes)
+{
+    if (fIsAttached) Clear();
+    for (size_t p=0; p<planes.size(); ++p) {
+        fOwnedValues.push_back(planes[p].normal.x());
+        fOwnedValues.push_back(planes[p].normal.y());
+        fOwnedValues.push_back(planes[p].normal.z());
+        fOwnedValues.push_back(planes[p].offset);
+    }
+    fOwnedStart.push_back((G4int)fOwnedValues.size()/4);
+    ++fNumResidues;
+    UseOwnStorage();
+}
+
+void ResidueCutPlaneTable::Attach(G4int numResidues, const G4double* values, const G4int* start)
+{
+    std::vector<G4double>().swap(fOwnedValues);
+    std::vector<G4int>().swap(fOwnedStart);
+    fNumResidues = numResidues;
+    fIsAttached = true;
+    fValues = values;
+    fStart = start;
+}
+
+std::vector<ResidueCutPlane> ResidueCutPlaneTable::GetPlanes(G4int residue, G4double rotationAngle) const
+{
+    std::vector<ResidueCutPlane> planes(fStart[residue+1] - fStart[residue]);
+    for (size_t p=0; p<planes.size(); ++p) {
+        const G4double* plane = fValues + 4*(fStart[residue]+p);
+        planes[p].normal.set(plane[0], plane[1], plane[2]);
+        if (rotationAngle != 0.) planes[p].normal.rotateZ(rotationAngle);
+        planes[p].offset = plane[3];
+    }
+    return planes;
+}
+
+void ResidueCutPlaneTable::UseOwnStorage()
+{
+    fValues = fOwnedValues.data();
+    fStart = fOwnedStart.data();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Constructor
+//--------------------------------------------------------------------------------------------------
+DNAOverlapChecker::DNAOverlapChecker(G4double fiberRadius, G4double fiberHalfLength)
+    : fFiberRadius(fiberRadius), fFiberHalfLength(fiberHalfLength), fMaxResidueRadius(0.),
+      fNumPairsTested(0)
+{}
+
+//--------------------------------------------------------------------------------------------------
+// Destructor
+//--------------------------------------------------------------------------------------------------
+DNAOverlapChecker::~DNAOverlapChecker()
+{}
+
+//--------------------------------------------------------------------------------------------------
+// Register a residue placed in the fiber.
+//--------------------------------------------------------------------------------------------------
+void DNAOverlapChecker::AddResidue(const G4ThreeVector& position, G4double radius, G4int copyNumber,
+                                   const std::vector<ResidueCutPlane>& cutPlanes)
+{
+    fResiduePositions.push_back(position);
+    fResidueRadii.push_back(radius);
+    fResidueCopyNumbers.push_back(copyNumber);
+    fResidueCutPlanes.push_back(cutPlanes);
+    fMaxResidueRadius = std::max(fMaxResidueRadius, radius);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Register a histone placed in the fiber.
+//--------------------------------------------------------------------------------------------------
+void DNAOverlapChecker::AddHistone(const G4ThreeVector& position, G4double radius, G4double halfHeight,
+                                   G4int copyNumber)
+{
+    fHistonePositions.push_back(position);
+    fHistoneRadii.push_back(radius);
+    fHistoneHalfHeights.push_back(halfHeight);
+    fHistoneCopyNumbers.push_back(copyNumber);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Test all registered volumes against their neighbours and against the fiber boundary. Residue
+// pairs are found with a spatial index, so the cost scales with the number of residues rather than
+// with its square.
+//--------------------------------------------------------------------------------------------------
+G4int DNAOverlapChecker::CheckOverlaps(G4int numToReport)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    fOverlaps.clear();
+    fNumPairsTested = 0;
+
+    G4int numResidues = fResiduePositions.size();
+    G4int numHistones = fHistonePositions.size();
+
+    //----------------------------------------------------------------------------------------------
+    // Index residue centres. A cell the size of the largest residue diameter means any overlapping
+    // pair lies in adjacent cells.
+    //----------------------------------------------------------------------------------------------
+    ResidueSpatialIndex index;
+    index.Build(fResiduePositions, 2*fMaxResidueRadius);
+    std::vector<G4int> neighbours;
+
+    //----------------------------------------------------------------------------------------------
+    // Residue-residue and residue-fiber
+    //----------------------------------------------------------------------------------------------
+    for (G4int a=0; a<numResidues; ++a) {
+        index.FindNeighbours(fResiduePositions[a], fResidueRadii[a]+fMaxResidueRadius, neighbours);
+        for (size_t k=0; k<neighbours.size(); ++k) {
+            // Test each pair once
+            if (neighbours[k] > a) CheckResiduePair(a, neighbours[k]);
+        }
+        CheckResidueInFiber(a);
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // Residue-histone, histone-histone and histone-fiber
+    //----------------------------------------------------------------------------------------------
+    for (G4int h=0; h<numHistones; ++h) {
+        G4double searchRadius = std::sqrt(std::pow(fHistoneRadii[h],2) + std::pow(fHistoneHalfHeights[h],2))
+                                + fMaxResidueRadius;
+        index.FindNeighbours(fHistonePositions[h], searchRadius, neighbours);
+        for (size_t k=0; k<neighbours.size(); ++k)
+            CheckResidueHistone(neighbours[k], h);
+
+        for (G4int other=h+1; other<numHistones; ++other)
+            CheckHistonePair(h, other);
+
+        CheckHistoneInFiber(h);
+    }
+
+    G4double elapsed = std::chrono::duration<G4double>(std::chrono::steady_clock::now() - start).count();
+
+    //----------------------------------------------------------------------------------------------
+    // Report
+    //----------------------------------------------------------------------------------------------
+    G4cout << "DNAOverlapChecker: tested " << numResidues << " residues and " << numHistones
+           << " histones (" << fNumPairsTested << " neighbouring pairs) in " << elapsed << " s." << G4endl;
+
+    if (fOverlaps.empty()) {
+        G4cout << "DNAOverlapChecker: no overlaps detected." << G4endl;
+        return 0;
+    }
+
+    G4int numReported = std::min((G4int)fOverlaps.size(), std::max(numToReport, 0));
+    std::partial_sort(fOverlaps.begin(), fOverlaps.begin()+numReported, fOverlaps.end(), IsDeeperOverlap);
+
+    G4cout << "DNAOverlapChecker: " << fOverlaps.size() << " overlaps detected. Deepest "
+           << numReported << ":" << G4endl;
+    for (G4int i=0; i<numReported; ++i) {
+        G4cout << "    " << fOverlaps[i].type << "  copy numbers " << fOverlaps[i].copyNumberA;
+        if (fOverlaps[i].copyNumberB >= 0) G4cout << " & " << fOverlaps[i].copyNumberB;
+        G4cout << "  depth = " << fOverlaps[i].depth/nm << " nm" << G4endl;
+    }
+
+    return fOverlaps.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Return the furthest extent of a cut residue along unit direction u, measured from its centre.
+// For a sphere of radius r cut by one plane {x.n <= h}, the extremal point is either r*u (if it
+// lies in the kept half-space) or on the rim of the cut face, which gives
+//      h*(u.n) + sqrt(r^2 - h^2) * |u - (u.n)n|
+//--------------------------------------------------------------------------------------------------
+G4double DNAOverlapChecker::GetResidueSupport(G4int index, const G4ThreeVector& u) const
+{
+    G4double radius = fResidueRadii[index];
+    G4double support = radius;
+
+    const std::vector<ResidueCutPlane>& planes = fResidueCutPlanes[index];
+    for (size_t p=0; p<planes.size(); ++p) {
+        G4double offset = planes[p].offset;
+        if (offset >= radius) continue; // plane does not intersect the sphere
+
+        G4double un = u.dot(planes[p].normal);
+        if (un*radius <= offset) continue; // extremal point of the sphere is kept
+
+        G4double perp = std::sqrt(std::max(0., 1.-un*un));
+        G4double rim = std::sqrt(std::max(0., radius*radius-offset*offset));
+        support = std::min(support, offset*un + rim*perp);
+    }
+    return support;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Separating-axis test along the line joining the two residue centres. Two residues cut against
+// each other by CreateCutSolid() are separated by the 0.001 nm safety margin on each side.
+//--------------------------------------------------------------------------------------------------
+void DNAOverlapChecker::CheckResiduePair(G4int a, G4int b)
+{
+    ++fNumPairsTested;
+
+    G4ThreeVector displacement = fResiduePositions[b] - fResiduePositions[a];
+    G4double distance = displacement.mag();
+
+    if (distance == 0) {
+        AddOverlap("residue-residue", fResidueCopyNumbers[a], fResidueCopyNumbers[b],
+                   fResidueRadii[a]+fResidueRadii[b]);
+        return;
+    }
+
+    G4ThreeVector u = displacement/distance;
+    G4double depth = GetResidueSupport(a, u) + GetResidueSupport(b, -u) - distance;
+    if (depth > 0)
+        AddOverlap("residue-residue", fResidueCopyNumbers[a], fResidueCopyNumbers[b], depth);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Test a residue against a z-aligned histone cylinder, using the axis from the residue centre to the
+// closest point of the cylinder.
+//--------------------------------------------------------------------------------------------------
+void DNAOverlapChecker::CheckResidueHistone(G4int residue, G4int histone)
+{
+    ++fNumPairsTested;
+
+    G4ThreeVector relative = fResiduePositions[residue] - fHistonePositions[histone];
+    G4double radius = fHistoneRadii[histone];
+    G4double halfHeight = fHistoneHalfHeights[histone];
+    G4double radial = relative.perp();
+
+    // Residue centre inside the histone
+    if (radial < radius && std::abs(relative.z()) < halfHeight) {
+        G4double depth = fResidueRadii[residue] + std::min(radius-radial, halfHeight-std::abs(relative.z()));
+        AddOverlap("residue-histone", fResidueCopyNumbers[residue], fHistoneCopyNumbers[histone], depth);
+        return;
+    }
+
+    // Closest point of the cylinder to the residue centre
+    G4double closestRadial = std::min(radial, radius);
+    G4ThreeVector closest(0., 0., std::max(-halfHeight, std::min(halfHeight, relative.z())));
+    if (radial > 0) {
+        closest.setX(relative.x()*closestRadial/radial);
+        closest.setY(relative.y()*closestRadial/radial);
+    }
+
+    G4ThreeVector towardsHistone = closest - relative;
+    G4double distance = towardsHistone.mag();
+    G4double depth = fResidueRadii[residue]; // residue centre on the histone surface
+    if (distance > 0)
+        depth = GetResidueSupport(residue, towardsHistone/distance) - distance;
+    if (depth > 0)
+        AddOverlap("residue-histone", fResidueCopyNumbers[residue], fHistoneCopyNumbers[histone], depth);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Two z-aligned cylinders overlap if they overlap both radially and along z.
+//--------------------------------------------------------------------------------------------------
+void DNAOverlapChecker::CheckHistonePair(G4int a, G4int b)
+{
+    ++fNumPairsTested;
+
+    G4ThreeVector relative = fHistonePositions[b] - fHistonePositions[a];
+    G4double radialDepth = fHistoneRadii[a] + fHistoneRadii[b] - relative.perp();
+    G4double axialDepth = fHistoneHalfHeights[a] + fHistoneHalfHeights[b] - std::abs(relative.z());
+
+    if (radialDepth > 0 && axialDepth > 0)
+        AddOverlap("histone-histone", fHistoneCopyNumbers[a], fHistoneCopyNumbers[b],
+                   std::min(radialDepth, axialDepth));
+}
+
+//--------------------------------------------------------------------------------------------------
+// Check that a residue does not protrude from the fiber cylinder (side or end caps).
+//--------------------------------------------------------------------------------------------------
+void DNAOverlapChecker::CheckResidueInFiber(G4int residue)
+{
+    const G4ThreeVector& position = fResiduePositions[residue];
+    G4double depth = -1.;
+
+    G4double radial = position.perp();
+    if (radial > 0) {
+        G4ThreeVector outwards(position.x()/radial, position.y()/radial, 0.);
+        depth = std::max(depth, radial + GetResidueSupport(residue, outwards) - fFiberRadius);
+    }
+    depth = std::max(depth, position.z() + GetResidueSupport(residue, G4ThreeVector(0.,0.,1.)) - fFiberHalfLength);
+    depth = std::max(depth, -position.z() + GetResidueSupport(residue, G4ThreeVector(0.,0.,-1.)) - fFiberHalfLength);
+
+    if (depth > 0)
+        AddOverlap("residue-fiber", fResidueCopyNumbers[residue], -1, depth);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Check that a histone does not protrude from the fiber cylinder (side or end caps).
+//--------------------------------------------------------------------------------------------------
+void DNAOverlapChecker::CheckHistoneInFiber(G4int histone)
+{
+    const G4ThreeVector& position = fHistonePositions[histone];
+    G4double radialDepth = position.perp() + fHistoneRadii[histone] - fFiberRadius;
+    G4double axialDepth = std::abs(position.z()) + fHistoneHalfHeights[histone] - fFiberHalfLength;
+    G4double depth = std::max(radialDepth, axialDepth);
+
+    if (depth > 0)
+        AddOverlap("histone-fiber", fHistoneCopyNumbers[histone], -1, depth);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Record an overlap.
+//--------------------------------------------------------------------------------------------------
+void DNAOverlapChecker::AddOverlap(const G4String& type, G4int copyNumberA, G4int copyNumberB,
+                                   G4double depth)
+{
+    DNAOverlapRecord record;
+    record.type = type;
+    record.copyNumberA = copyNumberA;
+    record.copyNumberB = copyNumberB;
+    record.depth = depth;
+    fOverlaps.push_back(record);
+}
@@ -0,0 +1,181 @@
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class performs a fast, analytic overlap verification of the contents of a single chromatin
+// fiber. It is an alternative to calling G4VPhysicalVolume::CheckOverlaps() on every residue and
+// histone placement, which samples random surface points against every sibling volume and takes
+// hours for a full fiber.
+//
+// Residues are described by their sphere (centre & radius) and the planes used to cut them in
+// VoxelizedNuclearDNA::CreateCutSolid(). Histones are z-aligned cylinders. Only near neighbours are
+// tested, using a ResidueSpatialIndex over the residue centres. The fiber boundary is also checked.
+//**************************************************************************************************
+
+#ifndef DNAOVERLAPCHECKER_HH
+#define DNAOVERLAPCHECKER_HH
+
+#include "G4ThreeVector.hh"
+#include "G4String.hh"
+
+#include <algorithm>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// A plane used to cut a residue sphere, expressed in the residue's own frame (origin at the sphere
+// centre). The part of the sphere kept after cutting is {x : x.dot(normal) <= offset}.
+//--------------------------------------------------------------------------------------------------
+struct ResidueCutPlane
+{
+    G4ThreeVector normal;
+    G4double offset;
+};
+
+//--------------------------------------------------------------------------------------------------
+// The cut planes of a set of residues, stored flat: residue i has planes GetStart()[i] to
+// GetStart()[i+1]-1, each given by 4 values (normal x, y & z, then offset). The table either holds
+// its own arrays, filled with AddResidue(), or views external ones (e.g. a mapped
+// FiberTemplateFile), which must then remain valid until the table is cleared or destroyed.
+//--------------------------------------------------------------------------------------------------
+class ResidueCutPlaneTable
+{
+public:
+    ResidueCutPlaneTable();
+    ResidueCutPlaneTable(const ResidueCutPlaneTable& other);
+    ResidueCutPlaneTable& operator=(const ResidueCutPlaneTable& other);
+
+    void Clear();
+    void AddResidue(const std::vector<ResidueCutPlane>& planes);
+    void Attach(G4int numResidues, const G4double* values, const G4int* start);
+
+    //----------------------------------------------------------------------------------------------
+    // Return the planes of a residue, with normals rotated about z by rotationAngle.
+    //----------------------------------------------------------------------------------------------
+    std::vector<ResidueCutPlane> GetPlanes(G4int residue, G4double rotationAngle = 0.) const;
+
+    //----------------------------------------------------------------------------------------------
+    // True if relative (a point relative to the residue centre) is on the kept side of all planes.
+    //----------------------------------------------------------------------------------------------
+    G4bool IsInside(G4int residue, const G4ThreeVector& relative) const
+    {
+        for (G4int p=fStart[residue]; p<fStart[residue+1]; ++p) {
+            const G4double* plane = fValues + 4*p;
+            if (relative.x()*plane[0] + relative.y()*plane[1] + relative.z()*plane[2] > plane[3])
+                return false;
+        }
+        return true;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // Restrict [tMin, tMax] to the parameters t for which relativeStart + t*direction (relative to
+    // the residue centre) is on the kept side of all planes of the residue. The interval is empty
+    // (tMin > tMax) if the line stays on the cut side of a plane.
+    //----------------------------------------------------------------------------------------------
+    void ClipSegment(G4int residue, const G4ThreeVector& relativeStart, const G4ThreeVector& direction,
+                     G4double& tMin, G4double& tMax) const
+    {
+        for (G4int p=fStart[residue]; p<fStart[residue+1] && tMin <= tMax; ++p) {
+            const G4double* plane = fValues + 4*p;
+            G4double distance = plane[3] - (relativeStart.x()*plane[0] + relativeStart.y()*plane[1]
+                                             + relativeStart.z()*plane[2]);
+            G4double rate = direction.x()*plane[0] + direction.y()*plane[1] + direction.z()*plane[2];
+            if (rate > 0.) tMax = std::min(tMax, distance/rate);
+            else if (rate < 0.) tMin = std::max(tMin, distance/rate);
+            else if (distance < 0.) tMax = tMin - 1.;
+        }
+    }
+
+    G4int GetNumberOfResidues() const {return fNumResidues;}
+    G4int GetNumberOfPlanes() const {return fStart[fNumResidues];}
+    const G4double* GetValues() const {return fValues;}
+    const G4int* GetStart() const {return fStart;}
+
+private:
+    void UseOwnStorage();
+
+    G4int fNumResidues;
+    const G4double* fValues;
+    const G4int* fStart;
+
+    G4bool fIsAttached;
+    std::vector<G4double> fOwnedValues;
+    std::vector<G4int> fOwnedStart;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Details of a detected overlap. Depth is the penetration along the axis used to test the pair.
+//--------------------------------------------------------------------------------------------------
+struct DNAOverlapRecord
+{
+    G4String type;
+    G4int copyNumberA;
+    G4int copyNumberB;
+    G4double depth;
+};
+
+class DNAOverlapChecker
+{
+public:
+    DNAOverlapChecker(G4double fiberRadius, G4double fiberHalfLength);
+
+    ~DNAOverlapChecker();
+
+    //----------------------------------------------------------------------------------------------
+    // Register volumes placed in the fiber. Positions, and the cut plane normals, must be given in
+    // the fiber frame (i.e. after applying any placement rotation).
+    //----------------------------------------------------------------------------------------------
+    void AddResidue(const G4ThreeVector& position, G4double radius, G4int copyNumber,
+                    const std::vector<ResidueCutPlane>& cutPlanes);
+    void AddHistone(const G4ThreeVector& position, G4double radius, G4double halfHeight,
+                    G4int copyNumber);
+
+    //----------------------------------------------------------------------------------------------
+    // Test all registered volumes against their neighbours and against the fiber boundary. Prints a
+    // summary and the numToReport deepest overlaps. Returns the total number of overlaps found.
+    //----------------------------------------------------------------------------------------------
+    G4int CheckOverlaps(G4int numToReport);
+
+    //----------------------------------------------------------------------------------------------
+    // Getters
+    //----------------------------------------------------------------------------------------------
+    const std::vector<DNAOverlapRecord>& GetOverlaps() const {return fOverlaps;}
+
+private:
+    //----------------------------------------------------------------------------------------------
+    // Return the furthest extent of residue index along unit direction u, measured from its centre.
+    // Each cut plane alone gives an exact bound; the minimum over all planes is returned, which is
+    // never smaller than the true extent of the cut solid (i.e. the test is conservative).
+    //----------------------------------------------------------------------------------------------
+    G4double GetResidueSupport(G4int index, const G4ThreeVector& u) const;
+
+    //----------------------------------------------------------------------------------------------
+    // Individual tests. Each appends to fOverlaps when an overlap is detected.
+    //----------------------------------------------------------------------------------------------
+    void CheckResiduePair(G4int a, G4int b);
+    void CheckResidueHistone(G4int residue, G4int histone);
+    void CheckHistonePair(G4int a, G4int b);
+    void CheckResidueInFiber(G4int residue);
+    void CheckHistoneInFiber(G4int histone);
+
+    void AddOverlap(const G4String& type, G4int copyNumberA, G4int copyNumberB, G4double depth);
+
+    G4double fFiberRadius;
+    G4double fFiberHalfLength;
+
+    // Residues
+    std::vector<G4ThreeVector> fResiduePositions;
+    std::vector<G4double> fResidueRadii;
+    std::vector<G4int> fResidueCopyNumbers;
+    std::vector<std::vector<ResidueCutPlane> > fResidueCutPlanes;
+    G4double fMaxResidueRadius;
+
+    // Histones
+    std::vector<G4ThreeVector> fHistonePositions;
+    std::vector<G4double> fHistoneRadii;
+    std::vector<G4double> fHistoneHalfHeights;
+    std::vector<G4int> fHistoneCopyNumbers;
+
+    std::vector<DNAOverlapRecord> fOverlaps;
+    G4long fNumPairsTested;
+};
+
+#endif // DNAOVERLAPCHECKER_HH
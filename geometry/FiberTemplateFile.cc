@@ -0,0 +1,245 @@
+// Extra Class for VoxelizedNuclearDNA
+//
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class reads & writes a binary file holding the template data of one chromatin fiber: the
+// positions of all residues & histones in the fiber frame, the planes used to cut the residues of
+// the template nucleosome & the fiber template. The file is generated by whichever process starts
+// first; all processes then map it read-only & use its arrays in place, sharing one copy per node.
+//**************************************************************************************************
+
+#include "FiberTemplateFile.hh"
+
+#include "G4ios.hh"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char kFileMagic[8] = {'D','N','A','F','I','B','E','R'};
+static const G4int kFileVersion = 2;
+
+//--------------------------------------------------------------------------------------------------
+// Constructor
+//--------------------------------------------------------------------------------------------------
+FiberTemplateFile::FiberTemplateFile()
+    : fData(NULL), fSize(0), fHeader(NULL), fValues(NULL), fCutPlaneStart(NULL)
+{}
+
+//--------------------------------------------------------------------------------------------------
+// Destructor
+//--------------------------------------------------------------------------------------------------
+FiberTemplateFile::~FiberTemplateFile()
+{
+    Close();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Number of doubles holding the residue & histone positions.
+//--------------------------------------------------------------------------------------------------
+size_t FiberTemplateFile::GetNumPositionValues(const Header& header)
+{
+    size_t numElements = (size_t)header.numNucleosomes*header.numBpPerNucleosome;
+    return 3*kNumDNAResidues*numElements + 3*(size_t)header.numNucleosomes;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Total size in bytes of a file with the given header.
+//--------------------------------------------------------------------------------------------------
+size_t FiberTemplateFile::GetFileSize(const Header& header)
+{
+    size_t numValues = GetNumPositionValues(header) + 4*(size_t)header.numCutPlanes + header.numTemplateValues;
+    size_t numInts = (size_t)header.numCutPlaneResidues + 1 + header.numTemplateInts;
+    return sizeof(Header) + GetPaddedKeyLength(header.keyLength) + numValues*sizeof(G4double)
+           + numInts*sizeof(G4int);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Map the file read-only & check that it matches the key.
+//--------------------------------------------------------------------------------------------------
+G4bool FiberTemplateFile::Open(const G4String& fileName, const G4String& key)
+{
+    Close();
+
+    G4int descriptor = open(fileName.c_str(), O_RDONLY);
+    if (descriptor < 0) return false;
+
+    struct stat fileStatus;
+    if (fstat(descriptor, &fileStatus) != 0 || (size_t)fileStatus.st_size < sizeof(Header)) {
+        close(descriptor);
+        return false;
+    }
+
+    void* data = mmap(NULL, fileStatus.st_size, PROT_READ, MAP_SHARED, descriptor, 0);
+    close(descriptor); // the mapping remains valid
+    if (data == MAP_FAILED) return false;
+
+    fData = (const char*)data;
+    fSize = fileStatus.st_size;
+    fHeader = (const Header*)fData;
+
+    const char* fileKey = fData + sizeof(Header);
+    if (std::memcmp(fHeader->magic, kFileMagic, sizeof(kFileMagic)) != 0
+        || fHeader->version != kFileVersion
+        || fHeader->keyLength != (G4int)key.size()
+        || fSize != GetFileSize(*fHeader)
+        || std::memcmp(fileKey, key.c_str(), key.size()) != 0) {
+        Close();
+        return false;
+    }
+
+    fValues = (const G4double*)(fileKey + GetPaddedKeyLength(fHeader->keyLength));
+    fCutPlaneStart = (const G4int*)(fValues + GetNumPositionValues(*fHeader) + 4*(size_t)fHeader->numCutPlanes
+                                    + fHeader->numTemplateValues);
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Unmap the file.
+//--------------------------------------------------------------------------------------------------
+void FiberTemplateFile::Close()
+{
+    if (fData) munmap((void*)fData, fSize);
+    fData = NULL;
+    fSize = 0;
+    fHeader = NULL;
+    fValues = NULL;
+    fCutPlaneStart = NULL;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Point the position buffer at the mapped arrays.
+//--------------------------------------------------------------------------------------------------
+void FiberTemplateFile::AttachPositions(DNAPositionBuffer* positions) const
+{
+    if (!fData) return;
+
+    positions->ReleaseOwnStorage();
+    positions->numNucleosomes = fHeader->numNucleosomes;
+    positions->numBpPerNucleosome = fHeader->numBpPerNucleosome;
+
+    size_t numElements = (size_t)fHeader->numNucleosomes*fHeader->numBpPerNucleosome;
+    const G4double* values = fValues;
+    for (G4int r=0; r<kNumDNAResidues; ++r) {
+        positions->xData[r] = values;
+        values += numElements;
+        positions->yData[r] = values;
+        values += numElements;
+        positions->zData[r] = values;
+        values += numElements;
+    }
+    positions->histoneXData = values;
+    values += fHeader->numNucleosomes;
+    positions->histoneYData = values;
+    values += fHeader->numNucleosomes;
+    positions->histoneZData = values;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Point the cut plane table at the mapped arrays.
+//--------------------------------------------------------------------------------------------------
+void FiberTemplateFile::AttachCutPlanes(ResidueCutPlaneTable* cutPlanes) const
+{
+    if (!fData) return;
+    cutPlanes->Attach(fHeader->numCutPlaneResidues, fValues + GetNumPositionValues(*fHeader), fCutPlaneStart);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Point the fiber template at the mapped arrays.
+//--------------------------------------------------------------------------------------------------
+G4bool FiberTemplateFile::AttachFiberTemplate(DNAFiberTemplate* fiberTemplate) const
+{
+    if (!HasFiberTemplate()) return false;
+    fiberTemplate->Attach(fValues + GetNumPositionValues(*fHeader) + 4*(size_t)fHeader->numCutPlanes,
+                          fCutPlaneStart + fHeader->numCutPlaneResidues + 1);
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Write a template file. The data is written to a temporary file in the same directory, which is
+// then renamed. Processes that have mapped an older version of the file keep a valid mapping.
+//--------------------------------------------------------------------------------------------------
+G4bool FiberTemplateFile::Write(const G4String& fileName, const G4String& key, const DNAPositionBuffer& positions,
+                                const ResidueCutPlaneTable& cutPlanes, const DNAFiberTemplate* fiberTemplate)
+{
+    std::vector<G4double> templateValues;
+    std::vector<G4int> templateInts;
+    if (fiberTemplate) fiberTemplate->Serialize(&templateValues, &templateInts);
+
+    Header header;
+    std::memcpy(header.magic, kFileMagic, sizeof(kFileMagic));
+    header.version = kFileVersion;
+    header.keyLength = (G4int)key.size();
+    header.numNucleosomes = positions.numNucleosomes;
+    header.numBpPerNucleosome = positions.numBpPerNucleosome;
+    header.numCutPlaneResidues = cutPlanes.GetNumberOfResidues();
+    header.numCutPlanes = cutPlanes.GetNumberOfPlanes();
+    header.numTemplateValues = (G4int)templateValues.size();
+    header.numTemplateInts = (G4int)templateInts.size();
+
+    //----------------------------------------------------------------------------------------------
+    // Write to a temporary file, then rename
+    //----------------------------------------------------------------------------------------------
+    std::ostringstream tempName;
+    tempName << fileName << ".tmp." << getpid();
+
+    std::ofstream file(tempName.str().c_str(), std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+
+    file.write((const char*)&header, sizeof(Header));
+    std::vector<char> paddedKey(GetPaddedKeyLength(header.keyLength), '\0');
+    std::memcpy(paddedKey.data(), key.c_str(), key.size());
+    file.write(paddedKey.data(), paddedKey.size());
+
+    size_t numElements = (size_t)positions.numNucleosomes*positions.numBpPerNucleosome;
+    for (G4int r=0; r<kNumDNAResidues; ++r) {
+        file.write((const char*)positions.xData[r], numElements*sizeof(G4double));
+        file.write((const char*)positions.yData[r], numElements*sizeof(G4double));
+        file.write((const char*)positions.zData[r], numElements*sizeof(G4double));
+    }
+    file.write((const char*)positions.histoneXData, positions.numNucleosomes*sizeof(G4double));
+    file.write((const char*)positions.histoneYData, positions.numNucleosomes*sizeof(G4double));
+    file.write((const char*)positions.histoneZData, positions.numNucleosomes*sizeof(G4double));
+    file.write((const char*)cutPlanes.GetValues(), 4*(size_t)header.numCutPlanes*sizeof(G4double));
+    file.write((const char*)templateValues.data(), templateValues.size()*sizeof(G4double));
+    file.write((const char*)cutPlanes.GetStart(), ((size_t)header.numCutPlaneResidues+1)*sizeof(G4int));
+    file.write((const char*)templateInts.data(), templateInts.size()*sizeof(G4int));
+    file.close();
+
+    if (!file || std::rename(tempName.str().c_str(), fileName.c_str()) != 0) {
+        std::remove(tempName.str().c_str());
+        return false;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Exclusive lock on <fileName>.lock. flock() locks are released automatically if the process dies.
+//--------------------------------------------------------------------------------------------------
+G4int FiberTemplateFile::Lock(const G4String& fileName)
+{
+    G4String lockName = fileName + ".lock";
+    G4int descriptor = open(lockName.c_str(), O_CREAT | O_RDWR, 0644);
+    if (descriptor < 0) return -1;
+
+    if (flock(descriptor, LOCK_EX) != 0) {
+        close(descriptor);
+        return -1;
+    }
+    return descriptor;
+}
+
+void FiberTemplateFile::Unlock(G4int lockDescriptor)
+{
+    if (lockDescriptor < 0) return;
+    flock(lockDescriptor, LOCK_UN);
+    close(lockDescriptor);
+}
@@ -0,0 +1,107 @@
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class reads & writes a binary file holding the template data of one chromatin fiber: the
+// positions of all residues & histones in the fiber frame, the planes used to cut the residues of
+// the template nucleosome and, if built, the DNAFiberTemplate of the whole fiber with its spatial
+// indices. The file is generated by whichever process starts first. Every process, including the
+// one that wrote it, then maps the file read-only & uses its arrays in place: the positions, cut
+// plane tables & fiber template point into the mapping, which the operating system shares between
+// all processes of a node (e.g. independent single-threaded shards of a simulation). Only one copy
+// of the fiber data is held per node; each process still builds its own Geant4 solids, logical &
+// physical volumes.
+//
+// Creation is serialized between processes with an exclusive lock on <file>.lock. The file is
+// written to a temporary name & renamed, so a reader never sees a partial file. The file records
+// the key of the fiber model it was built for, and is rebuilt if the key does not match.
+//**************************************************************************************************
+
+#ifndef FIBERTEMPLATEFILE_HH
+#define FIBERTEMPLATEFILE_HH
+
+#include "DNAFiberTemplate.hh"
+#include "DNAOverlapChecker.hh"
+#include "GeoCalculationV2.hh"
+
+#include "G4String.hh"
+
+#include <vector>
+
+class FiberTemplateFile
+{
+public:
+    FiberTemplateFile();
+
+    ~FiberTemplateFile();
+
+    //----------------------------------------------------------------------------------------------
+    // Map the file read-only. Return false (and leave nothing mapped) if the file does not exist,
+    // is not a valid template file, or was built for a different key.
+    //----------------------------------------------------------------------------------------------
+    G4bool Open(const G4String& fileName, const G4String& key);
+
+    //----------------------------------------------------------------------------------------------
+    // Unmap the file, if mapped. Anything attached to the file must be detached first.
+    //----------------------------------------------------------------------------------------------
+    void Close();
+
+    G4bool IsOpen() const {return fData != NULL;}
+    G4bool HasFiberTemplate() const {return fData && fHeader->numTemplateInts > 0;}
+
+    //----------------------------------------------------------------------------------------------
+    // Point positions, cutPlanes or fiberTemplate at the arrays of the mapped file, without copying
+    // them. They remain valid until the file is closed. Cut planes are indexed as in
+    // VoxelizedNuclearDNA: residue type, then bp. AttachFiberTemplate() returns false if the file
+    // holds no fiber template.
+    //----------------------------------------------------------------------------------------------
+    void AttachPositions(DNAPositionBuffer* positions) const;
+    void AttachCutPlanes(ResidueCutPlaneTable* cutPlanes) const;
+    G4bool AttachFiberTemplate(DNAFiberTemplate* fiberTemplate) const;
+
+    //----------------------------------------------------------------------------------------------
+    // Write a template file. fiberTemplate may be NULL. Return false if the file could not be
+    // written.
+    //----------------------------------------------------------------------------------------------
+    static G4bool Write(const G4String& fileName, const G4String& key, const DNAPositionBuffer& positions,
+                        const ResidueCutPlaneTable& cutPlanes, const DNAFiberTemplate* fiberTemplate);
+
+    //----------------------------------------------------------------------------------------------
+    // Take & release the exclusive lock used to serialize creation of the file between processes.
+    // Lock() blocks until the lock is acquired & returns a descriptor to pass to Unlock(), or -1 if
+    // the lock file could not be opened.
+    //----------------------------------------------------------------------------------------------
+    static G4int Lock(const G4String& fileName);
+    static void Unlock(G4int lockDescriptor);
+
+private:
+    //----------------------------------------------------------------------------------------------
+    // Layout of the file: this header, the key (padded to a multiple of 8 bytes), then arrays of
+    // doubles (residue x, y & z per residue type, histone x, y & z, nx, ny, nz & offset of all cut
+    // planes, then the fiber template values) and finally arrays of G4int (the index of the first
+    // cut plane of each residue, then the fiber template ints). See DNAFiberTemplate::Serialize().
+    //----------------------------------------------------------------------------------------------
+    struct Header
+    {
+        char magic[8];
+        G4int version;
+        G4int keyLength;
+        G4int numNucleosomes;
+        G4int numBpPerNucleosome;
+        G4int numCutPlaneResidues;
+        G4int numCutPlanes;
+        G4int numTemplateValues;
+        G4int numTemplateInts;
+    };
+
+    static size_t GetPaddedKeyLength(G4int keyLength) {return ((size_t)keyLength + 7)/8*8;}
+    static size_t GetNumPositionValues(const Header& header);
+    static size_t GetFileSize(const Header& header);
+
+    const char* fData;
+    size_t fSize;
+    const Header* fHeader;
+    const G4double* fValues;
+    const G4int* fCutPlaneStart;
+};
+
+#endif // FIBERTEMPLATEFILE_HH
@@ -9,39 +9,35 @@
 //
 // This class performs the calculations necessary for placing nucleotide base pairs and nucloesomes.
 // The size of the individual volumes comprising nucleotides and histones are defined using the
-// Initialize() function. CalculateNucleosomePosition() and CalculateDNAPosition() are used to
-// place three "basis" nucleosomes and their accompanying 200 bp each (incl linker DNA).
+// Initialize() function. The positions of all residues of one nucleosome (incl linker DNA) are
+// calculated once in the nucleosome's own frame. GeneratePositions() then places any number of
+// nucleosomes along the fiber helix by applying one rotation & translation per nucleosome to this
+// template, writing into a structure-of-arrays DNAPositionBuffer.
+// Two fiber models are supported: a one-start solenoid (consecutive nucleosomes are neighbours on
+// the helix, joined by a curved linker) and a two-start zig-zag (consecutive nucleosomes sit on
+// opposite sides of the fiber axis, joined by a straight linker). The fiber parameters can be set
+// before calling Initialize().
 //**************************************************************************************************
 
 #include "GeoCalculationV2.hh"
 
 #include "G4ios.hh"
 
-//--------------------------------------------------------------------------------------------------
-// Structure containting coordinates of volumes in a DNA base pair.
-//--------------------------------------------------------------------------------------------------
-struct DNAPlacementData
-{
-    //G4RotationMatrix *rotPosMat;
-    //G4RotationMatrix *rotSolidMat;
-
-    G4ThreeVector posCenterDNA;
-    G4ThreeVector posSugarTMP1;
-    G4ThreeVector posSugarTHF1;
-    G4ThreeVector posBase1;
-    G4ThreeVector posBase2;
-    G4ThreeVector posSugarTHF2;
-    G4ThreeVector posSugarTMP2;
-};
+#include <algorithm>
 
 //--------------------------------------------------------------------------------------------------
 // Constructor. Paramters used to set (i) verbosity of console output and (ii) a scaling factor on
 // the size of all geometry components (should be 1 for most purposes).
+// Default fiber parameters correspond to the solenoid model of Meylan et al. (2017).
 //--------------------------------------------------------------------------------------------------
 GeoCalculationV2::GeoCalculationV2(G4int verbose, G4double factor) :
-    fVerbose(verbose), fFactor(factor)
+    fVerbose(verbose), fFactor(factor), fPosAndRadiusMap(NULL)
 {
-
+    fFiberModel = "Solenoid";
+    fFiberPitch = 8.5*fFactor*nm; // pitch is height of 1 complete turn of helix
+    fFiberCentralRadius = 10.460*fFactor*nm; // radius of fiber
+    fFiberNbNuclPerTurn = 6;
+    bpNumForLinker = 46; //const G4int bpNumForLinker = 46;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -51,8 +47,6 @@ GeoCalculationV2::~GeoCalculationV2()
 {
     // Free the memory
     //
-    delete fPosNucleo;
-    delete fPosDNA;
     delete fPosAndRadiusMap;
 }
 
@@ -89,13 +83,37 @@ void GeoCalculationV2::Initialize()
     //----------------------------------------------------------------------------------------------
     // Fiber parameters. I.e. helical arrangment of nucleosomes in a fiber.
     //----------------------------------------------------------------------------------------------
-    fHistoneNum = 3; // should be 3 because the others are generated through rotations (see Construct() )
+    // Pitch, central radius & nucleosomes per turn are set in the constructor or by the setters.
     fHistoneRadius = 2.4*fFactor*nm; //2.860*fFactor*nm;
     fHistoneHeight = 2.860*fFactor*nm; //2.860*fFactor*nm;
-    fFiberPitch = 8.5*fFactor*nm; // pitch is height of 1 complete turn of helix
-    fFiberCentralRadius = 10.460*fFactor*nm; // radius of fiber
-    fFiberNbNuclPerTurn = 6;
-    fFiberDeltaAngle = 360./fFiberNbNuclPerTurn *deg;
+
+    if (fFiberNbNuclPerTurn <= 0 || fFiberPitch <= 0) {
+        G4cerr << "GeoCalculationV2::Initialize, Fatal Error. The number of nucleosomes per turn & the "
+               << "fiber pitch must be positive." << G4endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    if (fFiberModel == "Solenoid") {
+        // One-start helix: each nucleosome is the next one around the helix.
+        fIsZigZag = false;
+        fFiberDeltaAngle = 360./fFiberNbNuclPerTurn *deg;
+        fNucleosomeRise = fFiberPitch/fFiberNbNuclPerTurn;
+    }
+    else if (fFiberModel == "ZigZag") {
+        // Two-start helix: consecutive nucleosomes alternate between two stacks on opposite sides
+        // of the fiber axis. Each stack is a helix of fFiberNbNuclPerTurn nucleosomes per turn, so
+        // nucleosome n+2 is the next one along the stack of nucleosome n (rotated by
+        // 360/fFiberNbNuclPerTurn & raised by fFiberPitch/fFiberNbNuclPerTurn) and nucleosome n+1 is
+        // half way between them on the other stack (rotated by a further 180 deg).
+        fIsZigZag = true;
+        fFiberDeltaAngle = (180. + 180./fFiberNbNuclPerTurn) *deg;
+        fNucleosomeRise = fFiberPitch/fFiberNbNuclPerTurn/2.;
+    }
+    else {
+        G4cerr << "GeoCalculationV2::Initialize, Fatal Error. Unknown fiber model \"" << fFiberModel
+               << "\". Valid options are \"Solenoid\" and \"ZigZag\"." << G4endl;
+        std::exit(EXIT_FAILURE);
+    }
 
     //----------------------------------------------------------------------------------------------
     // Nucleosome parameters. I.e. helical arrangement of nucleotide base pairs around a histone.
@@ -110,31 +128,69 @@ void GeoCalculationV2::Initialize()
     //----------------------------------------------------------------------------------------------
     // Linker DNA parameters. Linker DNA connects one nucleosome to the next.
     //----------------------------------------------------------------------------------------------
-    // Schema:
-    //
-    //nucleosome ---(straight part)-----\(
-    //                                   \curved part
-    //                                    \)
-    //                                     \----(straight part)---- nucleosome
+    // The number of linker bp is set in the constructor or by SetLinkerNumBp(). The linker runs
+    // from the last bp wrapped around the histone to the first bp wrapped around the next one, with
+    // a fixed rise of 0.34 nm per bp along the DNA axis. For the solenoid, it follows an arc around
+    // the fiber axis, leaving the histone before descending to the next one. For the zig-zag, it is
+    // a straight segment across the fiber axis. A linker longer than this path bulges outwards
+    // (solenoid) or upwards (zig-zag) by linkerBulge; a shorter one cannot join the nucleosomes.
+    if (bpNumForLinker < 0) {
+        G4cerr << "GeoCalculationV2::Initialize, Fatal Error. Negative number of linker bp." << G4endl;
+        std::exit(EXIT_FAILURE);
+    }
+    linkerRisePerBp = 0.34*fFactor*nm;
+    linkerBulge = 0.;
 
-    bpNumForLinker = 46; //const G4int bpNumForLinker = 46;
-    linkerCentralRadius = 14.505*fFactor*nm;
-    // 2*0.01*15 is: 2 straight parts * 0.01 heigth per base in these parts * 15 bp in one straight part.
-    // 3.555 is the height per base in the curved part.
-    // The sum is the height per bp in the curve part of the linker.
-    linkerHeightPerBp = ( -(3.555)/15)*fFactor*nm; //( -(3.555+2*0.01*15)/15)*fFactor*nm;
-    nbBasePairPerTurnForLinker = 46; // do not change
-    deltaLinkerAngle = 60./nbBasePairPerTurnForLinker *deg;
+    fBpNum = bpNumAroundHistone + bpNumForLinker;
 
     //----------------------------------------------------------------------------------------------
     // Generate the positional information using the parameters defined above.
     //----------------------------------------------------------------------------------------------
+    CalculateNucleosomeTemplate();
 
-    fPosNucleo = CalculateNucleosomePosition(fHistoneNum);
+    //----------------------------------------------------------------------------------------------
+    // No two histones may be closer than the histone height. Only nucleosomes less than one histone
+    // height above nucleosome n can be closer, and the fiber is invariant along the helix, so it is
+    // enough to check them against nucleosome 0.
+    //----------------------------------------------------------------------------------------------
+    for (G4int k=1; k*fNucleosomeRise < 2*fHistoneHeight; ++k) {
+        G4double horizontal = 2*fFiberCentralRadius*std::sin(k*fFiberDeltaAngle/rad/2.);
+        G4double distance = std::sqrt(horizontal*horizontal + k*fNucleosomeRise*k*fNucleosomeRise);
+        if (distance < 2*fHistoneHeight) {
+            G4cerr << "GeoCalculationV2::Initialize, Fatal Error. The histones of nucleosomes n & n+" << k
+                   << " are " << distance/nm << " nm apart, closer than the histone height ("
+                   << 2*fHistoneHeight/nm << " nm). Increase the fiber pitch or central radius." << G4endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // Basis nucleosomes used to cut the residue solids (see VoxelizedNuclearDNA). The middle one is
+    // the template for all nucleosomes in the fiber. The basis holds every nucleosome less than one
+    // nucleosome height (histone or wrapped DNA, whichever is taller) above or below the template,
+    // and at least its two neighbours joined by linkers, so that the template is cut against every
+    // nucleosome it can touch.
+    //----------------------------------------------------------------------------------------------
+    G4double radii[kNumDNAResidues] = {0., fSugarTMPRadius, fSugarTHFRadius, fBaseRadius, fBaseRadius,
+                                       fSugarTHFRadius, fSugarTMPRadius};
+    G4double nucleosomeBottom = fTemplateHistonePosition[2] - fHistoneHeight;
+    G4double nucleosomeTop = fTemplateHistonePosition[2] + fHistoneHeight;
+    for (G4int i=0; i<bpNumAroundHistone; ++i) {
+        for (G4int r=kSugarTMP1; r<kNumDNAResidues; ++r) {
+            nucleosomeBottom = std::min(nucleosomeBottom, fTemplatePositions[r][i][2] - radii[r]);
+            nucleosomeTop = std::max(nucleosomeTop, fTemplatePositions[r][i][2] + radii[r]);
+        }
+    }
+    G4int numNeighbours = 1;
+    while ((numNeighbours+1)*fNucleosomeRise < nucleosomeTop - nucleosomeBottom) ++numNeighbours;
+    fHistoneNum = 2*numNeighbours + 1;
+    fNucleoNum = fHistoneNum;
 
-    fPosDNA = CalculateDNAPosition(fHistoneNum,fPosSugarTMP1,fPosSugarTHF1,fPosBase1,fPosBase2,fPosSugarTHF2,fPosSugarTMP2);
+    GeneratePositions(0, fHistoneNum, &fBasisPositions);
+    CheckNucleosomeOverlaps();
 
-    fPosAndRadiusMap = GenerateCoordAndRadiusMap(fPosDNA);
+    delete fPosAndRadiusMap;
+    fPosAndRadiusMap = GenerateCoordAndRadiusMap(fBasisPositions);
 
     //----------------------------------------------------------------------------------------------
     // Output information according to verbosity setting.
@@ -168,12 +224,14 @@ void GeoCalculationV2::Initialize()
         G4cout<<"********************************"<<G4endl;
         G4cout<<"Fiber parameters"<<G4endl;
         G4cout<<"********************************"<<G4endl;
+        G4cout<<"fFiberModel="<<fFiberModel<<G4endl;
         G4cout<<"fHistoneRadius="<<fHistoneRadius/nm<<" nm"<<G4endl;
         G4cout<<"fHistoneHeight="<<fHistoneHeight/nm<<" nm"<<G4endl;
         G4cout<<"fFiberPitch="<<fFiberPitch/nm<<" nm"<<G4endl;
         G4cout<<"fFiberCentralRadius="<<fFiberCentralRadius/nm<<" nm"<<G4endl;
         G4cout<<"fFiberNbNuclPerTurn="<<fFiberNbNuclPerTurn<<G4endl;
         G4cout<<"fFiberDeltaAngle="<<fFiberDeltaAngle/deg<<" deg"<<G4endl;
+        G4cout<<"fNucleosomeRise="<<fNucleosomeRise/nm<<" nm"<<G4endl;
 
         G4cout<<"********************************"<<G4endl;
         G4cout<<"DNA around histone parameters"<<G4endl;
@@ -189,503 +247,395 @@ void GeoCalculationV2::Initialize()
         G4cout<<"DNA linker parameters"<<G4endl;
         G4cout<<"********************************"<<G4endl;
         G4cout<<"bpNumForLinker="<<bpNumForLinker<<G4endl;
-        G4cout<<"linkerCentralRadius="<<linkerCentralRadius/nm<<" nm"<<G4endl;
-        G4cout<<"linkerHeightPerBp="<<linkerHeightPerBp/nm<<" nm"<<G4endl;
-        G4cout<<"nbBasePairPerTurnForLinker="<<nbBasePairPerTurnForLinker/nm<<" nm"<<G4endl;
-        G4cout<<"deltaLinkerAngle="<<deltaLinkerAngle/nm<<" nm"<<G4endl;
+        G4cout<<"linkerRisePerBp="<<linkerRisePerBp/nm<<" nm"<<G4endl;
+        G4cout<<"linkerBulge="<<linkerBulge/nm<<" nm"<<G4endl;
 
         G4cout<<"********************************"<<G4endl;
     }
 }
 
-
 //--------------------------------------------------------------------------------------------------
-// Calculate nucleosome positions for basis nucleosomes. Remaining nucleosome positions can be 
-// established by translating & rotating these three basis positions.
-// Note the number of basis nucleosomes (i.e. nucleoNum) is 3 for typical use.
-// Returns a pointer to a vector of size nucleoNum (3), with each element containing a G4ThreeVector
-// of the spatial coordinates for 1 of the basis nucleosomes.
+// Calculate the positions of the bp centre & 6 residues of every bp of one nucleosome, and of its
+// histone, in the frame of the nucleosome. Each residue is first placed on a small helix (the DNA
+// double helix, axis along y), which is then rotated to stay orthogonal to, and translated along,
+// a second helix: either the superhelix wrapped around the histone (154 bp) or the path of the
+// linker DNA (46 bp by default).
 //--------------------------------------------------------------------------------------------------
-std::vector<G4ThreeVector>* GeoCalculationV2::CalculateNucleosomePosition(G4int nucleoNum)
+void GeoCalculationV2::CalculateNucleosomeTemplate()
 {
-    // Vector to fill and to output (pointer to vector of G4 coordinates)
-    std::vector<G4ThreeVector>* posNucleoData = new std::vector<G4ThreeVector>(nucleoNum);
-
-    // Reserve vector sizes so reallocation not needed as add elements
-    fFiberHelixMatVect.reserve(nucleoNum);
-    fRotFiberMatVect.reserve(nucleoNum);
-
-    // Histone start coord (add something in z because of the super helix not zero centered)
-    G4double histoneMat[1][3] = {{0.,0.,2.370*fFactor*nm}};
-
-    // iterate over each nucleosome
-    for(int n=0;n<nucleoNum;++n)
-    {
-        // xyz spatial coordinates of nucleosome
-        G4double fiberHelixMat[3];
-        fiberHelixMat[0] = fFiberCentralRadius*cos(n*fFiberDeltaAngle/rad); // x
-        fiberHelixMat[1] = fFiberCentralRadius*sin(n*fFiberDeltaAngle/rad); // y
-        fiberHelixMat[2] = n*fFiberPitch/fFiberNbNuclPerTurn; // z
-
-        // Save the xyz matrix to fFiberHelixMatVect for use in CalculateDNAPosition()
-        fFiberHelixMatVect.push_back(std::vector<G4double>() );
-        fFiberHelixMatVect[n].push_back(fiberHelixMat[0]);
-        fFiberHelixMatVect[n].push_back(fiberHelixMat[1]);
-        fFiberHelixMatVect[n].push_back(fiberHelixMat[2]);
-
-        // Rotation matrix (Rz) for placement inside the fiber.
-        // We must rotate the objects first and then place them.
-        // Unsure of details here.
-        G4double rotFiberMat[3][3];
-        // x0, y0, z0
-        rotFiberMat[0][0] = cos(n*-fFiberDeltaAngle/rad);
-        rotFiberMat[0][1]=-sin(n*-fFiberDeltaAngle/rad);
-        rotFiberMat[0][2]=0;
-        // x1, y1, z1
-        rotFiberMat[1][0] = sin(n*-fFiberDeltaAngle/rad);
-        rotFiberMat[1][1]=cos(n*-fFiberDeltaAngle/rad);
-        rotFiberMat[1][2]=0; 
-        // x2, y2, z2
-        rotFiberMat[2][0] = 0;
-        rotFiberMat[2][1]=0;
-        rotFiberMat[2][2]=1; 
-
-        // Save the matrix to fRotFiberMatVect for use in CalculateDNAPosition()
-        fRotFiberMatVect.push_back(std::vector<std::vector<G4double> >() );
-        for(int line=0;line<3;++line)
-        {
-            fRotFiberMatVect[n].push_back(std::vector<G4double>() );
-
-            for(int column=0;column<3;++column)
-            {
-                fRotFiberMatVect[n][line].push_back(rotFiberMat[line][column]);
-            }
-        }
-
+    G4ThreeVector residuePositions[kNumDNAResidues] = {G4ThreeVector(), fPosSugarTMP1, fPosSugarTHF1,
+        fPosBase1, fPosBase2, fPosSugarTHF2, fPosSugarTMP2};
+
+    // Initial radius in xy plane, initial angle in xy plane & initial z of each residue
+    G4double residueRxy[kNumDNAResidues];
+    G4double residueIniAngle[kNumDNAResidues];
+    G4double residueZIni[kNumDNAResidues];
+    for (G4int r=0; r<kNumDNAResidues; ++r) {
+        residueRxy[r] = residuePositions[r].perp();
+        residueIniAngle[r] = (r==kCenterDNA) ? 0. : GetAngleToXAxis(residuePositions[r]);
+        residueZIni[r] = residuePositions[r].getZ();
+    }
 
-        // Fiber part
-        G4double histoneHelixFMat[1][3] = {};
-
-        // Matrix product to rotate
-        // iterate on each line of output matrix+
-        for(int line=0;line<1;line++)
-        {
-            // iterate on each column of output matrix
-            for(int column=0;column<3;column++)
-            {
-                // iterate to do the sum
-                for(int p=0;p<3;++p)
-                {
-                    histoneHelixFMat[line][column] += histoneMat[line][p]*rotFiberMat[p][column];
-                }
-            }
-        }
+    for (G4int r=0; r<kNumDNAResidues; ++r) {
+        fTemplatePositions[r].clear();
+        fTemplatePositions[r].reserve(fBpNum);
+    }
 
-        // Add the coord of the helix
-        for(int line=0;line<1;++line)
-        {
-            for(int column=0;column<3;++column)
-            {
-                histoneHelixFMat[line][column] += fiberHelixMat[column];
-            }
+    //----------------------------------------------------------------------------------------------
+    // Base pairs around the histone. For the zig-zag, the wrapped DNA is turned by 180 deg about the
+    // histone axis, so that it enters & leaves the nucleosome on the side of the fiber axis, across
+    // which the linker runs to the other stack.
+    //----------------------------------------------------------------------------------------------
+    G4double entryAngle = fIsZigZag ? 180*deg : 0.;
+    for (G4int i=0; i<bpNumAroundHistone; ++i) {
+        // Rotate first helix to be always ortho to the path of the second one
+        GeoMat3 rotMat = GeoRotationZ(i*deltaAngle + entryAngle);
+        // Second helix (big simple helix)
+        GeoVec3 secondHelix = {{centralRadius*std::cos((i*deltaAngle + entryAngle)/rad),
+                                centralRadius*std::sin((i*deltaAngle + entryAngle)/rad),
+                                i*secondHelixPitch/nbBasePairPerTurn}};
+
+        for (G4int r=0; r<kNumDNAResidues; ++r) {
+            // First DNA helix (small simple helix)
+            G4double angle = i*angleBpAroundHistone/rad + residueIniAngle[r]/rad;
+            GeoVec3 firstHelix = {{residueRxy[r]*std::cos(angle), residueZIni[r], residueRxy[r]*std::sin(angle)}};
+            fTemplatePositions[r].push_back(GeoTransform(rotMat, firstHelix, secondHelix));
         }
-
-        // fill the output vector
-        posNucleoData->at(n) = G4ThreeVector(histoneHelixFMat[0][0],histoneHelixFMat[0][1],histoneHelixFMat[0][2]);
     }
 
-    return posNucleoData;
+    //----------------------------------------------------------------------------------------------
+    // Linker bp. The linker starts from the last bp placed around the histone.
+    //----------------------------------------------------------------------------------------------
+    CalculateLinker(residueRxy, residueIniAngle, residueZIni);
+
+    //----------------------------------------------------------------------------------------------
+    // Histone (add something in z because of the super helix not zero centered)
+    //----------------------------------------------------------------------------------------------
+    fTemplateHistonePosition[0] = 0.;
+    fTemplateHistonePosition[1] = 0.;
+    fTemplateHistonePosition[2] = 2.370*fFactor*nm;
 }
 
 
 //--------------------------------------------------------------------------------------------------
-// Calculate positions of nucleotide volumes around the basis hisotone volumes (3).
-// Fills and returns pointer to DNAPosData object, which is a 2D vector of DNAPlacementData objects.
-//      outer index i : spans nucleosomes (1 to 3)
-//      inner index j : spans all bp in that nucleosome
-// DNAPlacementData is a structure containing 7 G4ThreeVectors containing the coordinates of 6
-// residues & central location of a given nucleotide base pair.
+// Exit if the DNA of the template nucleosome (the middle one of fBasisPositions, incl. its linker)
+// runs into a histone or into other DNA of the basis. A residue must not intersect any histone
+// cylinder, & the axis of each bp must be at least one DNA radius (the largest distance of a residue
+// surface from the DNA axis) from every bp more than one helical turn away along the DNA. Residues
+// of nearby DNA may still touch: these overlaps are removed by the cut planes.
 //--------------------------------------------------------------------------------------------------
-DNAPosData* GeoCalculationV2::CalculateDNAPosition(G4int histoneNum,
-                                                 G4ThreeVector& posSugarTMP1,
-                                                 G4ThreeVector& posSugarTHF1,
-                                                 G4ThreeVector& posBase1,
-                                                 G4ThreeVector& posBase2,
-                                                 G4ThreeVector& posSugarTHF2,
-                                                 G4ThreeVector& posSugarTMP2)
+void GeoCalculationV2::CheckNucleosomeOverlaps()
 {
-    DNAPosData* data = new DNAPosData;
-
-    G4ThreeVector posOfLastBp, posOfFirstBp, posOfSecondBp;
-
-    // Get the initial radius in xy plan
-    G4double sugarTMP1Rxy = sqrt(pow(posSugarTMP1.getX(),2)+pow(posSugarTMP1.getY(),2) );
-    G4double sugarTHF1Rxy = sqrt(pow(posSugarTHF1.getX(),2)+pow(posSugarTHF1.getY(),2) );
-    G4double base1Rxy = sqrt(pow(posBase1.getX(),2)+pow(posBase1.getY(),2) );
-    G4double base2Rxy = sqrt(pow(posBase2.getX(),2)+pow(posBase2.getY(),2) );
-    G4double sugarTHF2Rxy = sqrt(pow(posSugarTHF2.getX(),2)+pow(posSugarTHF2.getY(),2) );
-    G4double sugarTMP2Rxy = sqrt(pow(posSugarTMP2.getX(),2)+pow(posSugarTMP2.getY(),2) );
-
-    // Get the initial angle in xy plan
-    G4double sugarTMP1IniAngle = GetAngleToXAxis(posSugarTMP1);
-    G4double sugarTHF1IniAngle = GetAngleToXAxis(posSugarTHF1);
-    G4double base1IniAngle = GetAngleToXAxis(posBase1);
-    G4double base2IniAngle = GetAngleToXAxis(posBase2);
-    G4double sugarTHF2IniAngle = GetAngleToXAxis(posSugarTHF2);
-    G4double sugarTMP2IniAngle = GetAngleToXAxis(posSugarTMP2);
-
-    // Get the initial z pos
-    G4double sugarTMP1ZIni = posSugarTMP1.getZ();
-    G4double sugarTHF1ZIni = posSugarTHF1.getZ();
-    G4double base1ZIni = posBase1.getZ();
-    G4double base2ZIni = posBase2.getZ();
-    G4double sugarTHF2ZIni = posSugarTHF2.getZ();
-    G4double sugarTMP2ZIni = posSugarTMP2.getZ();
-
-
-    // iterate for each  nucleosome
-    for(int n=0;n<histoneNum;++n)
-    {
-        data->push_back(std::vector<DNAPlacementData>());
-
-        //****************************************
-        // Base pairs around the histone
-        //****************************************
-
-        // iterate on each bp around the histone
-        for(int i=0;i<bpNumAroundHistone;++i)
-        {
-            // First DNA helix (small simple helix)
-            //
-            //G4double dBetweenEl = 0.33*fFactor*nm;
-            G4double firstHelixMat[7][3] = {
-                {0.,0.,0}, // CenterDNA //i*dBetweenEl
-                {sugarTMP1Rxy*cos(i*angleBpAroundHistone/rad+sugarTMP1IniAngle/rad),sugarTMP1ZIni,sugarTMP1Rxy*sin(i*angleBpAroundHistone/rad+sugarTMP1IniAngle/rad)}, // SugarTMP1
-                {sugarTHF1Rxy*cos(i*angleBpAroundHistone/rad+sugarTHF1IniAngle/rad),sugarTHF1ZIni,sugarTHF1Rxy*sin(i*angleBpAroundHistone/rad+sugarTHF1IniAngle/rad)}, // SugarTHF1
-                {base1Rxy*cos(i*angleBpAroundHistone/rad+base1IniAngle/rad),base1ZIni,base1Rxy*sin(i*angleBpAroundHistone/rad+base1IniAngle/rad)}, // Base1
-                {base2Rxy*cos(i*angleBpAroundHistone/rad+base2IniAngle/rad),base2ZIni,base2Rxy*sin(i*angleBpAroundHistone/rad+base2IniAngle/rad)}, // Base2
-                {sugarTHF2Rxy*cos(i*angleBpAroundHistone/rad+sugarTHF2IniAngle/rad),sugarTHF2ZIni,sugarTHF2Rxy*sin(i*angleBpAroundHistone/rad+sugarTHF2IniAngle/rad)}, // SugarTHF2
-                {sugarTMP2Rxy*cos(i*angleBpAroundHistone/rad+sugarTMP2IniAngle/rad),sugarTMP2ZIni,sugarTMP2Rxy*sin(i*angleBpAroundHistone/rad+sugarTMP2IniAngle/rad)}
-            }; // SugarTMP2
-
-            // Second helix matrix
-            G4double secondHelixMat[3] = {centralRadius*cos(i*deltaAngle/rad), centralRadius*sin(i*deltaAngle/rad), i*secondHelixPitch/nbBasePairPerTurn};
-
-            // Rotate first helix to be always ortho to the path of the second one
-            G4double rotMat[3][3]={{cos(i*-deltaAngle/rad),-sin(i*-deltaAngle/rad),0},
-                                   {sin(i*-deltaAngle/rad),cos(i*-deltaAngle/rad),0},
-                                   {0,0,1}};
-
-            G4double firstHelixRotatedMat[7][3] = {};
-
-            // iterate to perform matrix product
-            //
-            // iterate on each line of output matrix
-            for(int line=0;line<7;line++)
-            {
-                // iterate on each column of output matrix
-                for(int column=0;column<3;column++)
-                {
-                    // iterate to do the sum
-                    for(int p=0;p<3;++p)
-                    {
-                        firstHelixRotatedMat[line][column] += firstHelixMat[line][p]*rotMat[p][column];
-                    }
+    const G4int templateIndex = fHistoneNum/2;
+    const G4int bpPerTurn = 10;
+
+    G4ThreeVector residuePositions[kNumDNAResidues] = {G4ThreeVector(), fPosSugarTMP1, fPosSugarTHF1,
+        fPosBase1, fPosBase2, fPosSugarTHF2, fPosSugarTMP2};
+    G4double radii[kNumDNAResidues] = {0., fSugarTMPRadius, fSugarTHFRadius, fBaseRadius, fBaseRadius,
+                                       fSugarTHFRadius, fSugarTMPRadius};
+    G4double dnaRadius = 0.;
+    for (G4int r=kSugarTMP1; r<kNumDNAResidues; ++r)
+        dnaRadius = std::max(dnaRadius, residuePositions[r].perp() + radii[r]);
+
+    for (G4int j=0; j<fBpNum; ++j) {
+        G4String part = (j < bpNumAroundHistone) ? "wrapped" : "linker";
+
+        // Residues against the histone cylinders
+        for (G4int r=kSugarTMP1; r<kNumDNAResidues; ++r) {
+            G4ThreeVector pos = fBasisPositions.GetPosition(r, templateIndex, j);
+            for (G4int n=0; n<fHistoneNum; ++n) {
+                G4ThreeVector relative = pos - fBasisPositions.GetHistonePosition(n);
+                G4double dxy = std::max(relative.perp() - fHistoneRadius, 0.);
+                G4double dz = std::max(std::abs(relative.getZ()) - fHistoneHeight, 0.);
+                if (std::sqrt(dxy*dxy + dz*dz) < radii[r]) {
+                    G4cerr << "GeoCalculationV2::Initialize, Fatal Error. A residue of " << part << " bp " << j
+                           << " of nucleosome n overlaps the histone of nucleosome n" << std::showpos
+                           << n-templateIndex << std::noshowpos << ". Change the fiber pitch, central radius "
+                           << "or number of linker bp." << G4endl;
+                    std::exit(EXIT_FAILURE);
                 }
             }
+        }
 
-            // Create super helix
-            //
-            G4double superHelixMat[7][3];
-
-            for(int line=0;line<7;++line)
-            {
-                for(int column=0;column<3;++column)
-                {
-                    superHelixMat[line][column] = firstHelixRotatedMat[line][column] + secondHelixMat[column];
+        // DNA axis against the other DNA
+        G4ThreeVector center = fBasisPositions.GetPosition(kCenterDNA, templateIndex, j);
+        for (G4int n=0; n<fHistoneNum; ++n) {
+            for (G4int k=0; k<fBpNum; ++k) {
+                if (std::abs((n-templateIndex)*fBpNum + k - j) <= bpPerTurn) continue;
+                G4double distance = (fBasisPositions.GetPosition(kCenterDNA, n, k) - center).mag();
+                if (distance < dnaRadius) {
+                    G4cerr << "GeoCalculationV2::Initialize, Fatal Error. The DNA of " << part << " bp " << j
+                           << " of nucleosome n runs into bp " << k << " of nucleosome n" << std::showpos
+                           << n-templateIndex << std::noshowpos << " (axes " << distance/nm << " nm apart, DNA "
+                           << "radius " << dnaRadius/nm << " nm). Change the fiber pitch, central radius or "
+                           << "number of linker bp." << G4endl;
+                    std::exit(EXIT_FAILURE);
                 }
             }
+        }
+    }
+}
 
-            // save info for linker pos (only for the first histone+DNA group)
-            //
-            if(i==bpNumAroundHistone-1 && n==0)
-            {
-                posOfLastBp = G4ThreeVector(superHelixMat[0][0],superHelixMat[0][1],superHelixMat[0][2]);
-            }
-            if(i==0 && n==0)
-            {
-                posOfFirstBp = G4ThreeVector(superHelixMat[0][0],superHelixMat[0][1],superHelixMat[0][2]);
-            }
-            if(i==1 && n==0)
-            {
-                posOfSecondBp = G4ThreeVector(superHelixMat[0][0],superHelixMat[0][1],superHelixMat[0][2]);
-            }
-
-            // Fiber part
-
-            G4double superHelixFMat[7][3] = {};
-
-            // iterate to perform matrix product
-
-            // iterate on each line of output matrix+
-            for(int line=0;line<7;line++)
-            {
-                // iterate on each column of output matrix
-                for(int column=0;column<3;column++)
-                {
-                    // iterate to do the sum
-                    for(int p=0;p<3;++p)
-                    {
-                        superHelixFMat[line][column] += superHelixMat[line][p]*fRotFiberMatVect[n][p][column];
-                    }
-                }
-            }
 
-            for(int line=0;line<7;++line)
-            {
-                for(int column=0;column<3;++column)
-                {
-                    superHelixFMat[line][column] += fFiberHelixMatVect[n][column];
-                }
-            }
+//--------------------------------------------------------------------------------------------------
+// Append the linker bp to the template. The bp are placed every linkerRisePerBp along the linker
+// path (see GetLinkerPathPoint()), whose bulge is first adjusted so that the path is exactly as long
+// as the linker: one rise from the last bp around this histone to the first linker bp, one between
+// consecutive linker bp & one from the last linker bp to the first bp around the next histone.
+// The twist of the DNA helix continues from the last bp around this histone & is spread evenly over
+// the linker, rounded to whole turns so that it also joins the first bp around the next histone.
+//--------------------------------------------------------------------------------------------------
+void GeoCalculationV2::CalculateLinker(const G4double* residueRxy, const G4double* residueIniAngle,
+                                       const G4double* residueZIni)
+{
+    if (bpNumForLinker == 0) return;
+
+    const G4double linkerLength = (bpNumForLinker+1)*linkerRisePerBp;
+    std::vector<GeoVec3> path;
+    std::vector<G4double> pathLength;
+
+    G4double shortestLength = SampleLinkerPath(0., &path, &pathLength);
+    if (linkerLength < shortestLength) {
+        G4cerr << "GeoCalculationV2::Initialize, Fatal Error. " << bpNumForLinker << " linker bp ("
+               << linkerLength/nm << " nm) cannot join consecutive nucleosomes, whose shortest linker path is "
+               << shortestLength/nm << " nm long. At least " << G4int(std::ceil(shortestLength/linkerRisePerBp))-1
+               << " linker bp are needed for this fiber." << G4endl;
+        std::exit(EXIT_FAILURE);
+    }
 
-            DNAPlacementData p;
-            data->at(n).push_back(p);
-
-            // Save the positions
-            //
-            data->at(n)[i].posCenterDNA = G4ThreeVector(superHelixFMat[0][0],superHelixFMat[0][1],superHelixFMat[0][2]);
-            data->at(n)[i].posSugarTMP1 = G4ThreeVector(superHelixFMat[1][0],superHelixFMat[1][1],superHelixFMat[1][2]);
-            data->at(n)[i].posSugarTHF1 = G4ThreeVector(superHelixFMat[2][0],superHelixFMat[2][1],superHelixFMat[2][2]);
-            data->at(n)[i].posBase1 = G4ThreeVector(superHelixFMat[3][0],superHelixFMat[3][1],superHelixFMat[3][2]);
-            data->at(n)[i].posBase2 = G4ThreeVector(superHelixFMat[4][0],superHelixFMat[4][1],superHelixFMat[4][2]);
-            data->at(n)[i].posSugarTHF2 = G4ThreeVector(superHelixFMat[5][0],superHelixFMat[5][1],superHelixFMat[5][2]);
-            data->at(n)[i].posSugarTMP2 = G4ThreeVector(superHelixFMat[6][0],superHelixFMat[6][1],superHelixFMat[6][2]);
+    // The path length increases with the bulge: bisect between no bulge & a bulge long enough
+    G4double lowBulge = 0.;
+    G4double highBulge = linkerRisePerBp;
+    while (SampleLinkerPath(highBulge, &path, &pathLength) < linkerLength) highBulge *= 2.;
+    for (G4int iteration=0; iteration<60; ++iteration) {
+        linkerBulge = (lowBulge + highBulge)/2.;
+        if (SampleLinkerPath(linkerBulge, &path, &pathLength) < linkerLength) lowBulge = linkerBulge;
+        else highBulge = linkerBulge;
+    }
+    linkerBulge = highBulge;
+    SampleLinkerPath(linkerBulge, &path, &pathLength);
+
+    // Twist of the last bp around the histone, & twist per linker bp giving a whole number of turns
+    // (as close as possible to angleBpAroundHistone per bp) up to the first bp around the next one
+    G4double pi = std::acos(-1.);
+    G4double lastTwist = (bpNumAroundHistone-1)*angleBpAroundHistone/rad;
+    G4int numTurns = G4int(std::floor((lastTwist + (bpNumForLinker+1)*angleBpAroundHistone/rad)/(2*pi) + 0.5));
+    G4double twistPerBp = (2*pi*numTurns - lastTwist)/(bpNumForLinker+1);
+
+    G4int segment = 0;
+    for (G4int i=0; i<bpNumForLinker; ++i) {
+        // Point of the path at the distance of this bp from the start
+        G4double distance = (i+1)*linkerRisePerBp;
+        while (segment+2 < (G4int)path.size() && pathLength[segment+1] < distance) ++segment;
+        G4double fraction = (distance - pathLength[segment])/(pathLength[segment+1] - pathLength[segment]);
+        GeoVec3 posCenter;
+        GeoVec3 direction;
+        for (G4int k=0; k<3; ++k) {
+            posCenter[k] = path[segment][k] + fraction*(path[segment+1][k] - path[segment][k]);
+            direction[k] = path[segment+1][k] - path[segment][k];
         }
 
-        //*********************************
-        // Linker bp
-        //*********************************
+        // Rotate first helix to be always ortho to the path
+        GeoMat3 rotMat = GetLinkerRotation(direction);
 
-        // iterate on each linker bp
-        for(int i=0;i<bpNumForLinker;++i)
-        {
+        for (G4int r=0; r<kNumDNAResidues; ++r) {
             // First DNA helix (small simple helix)
-            //
-            //G4double dBetweenEl = 0.33*fFactor*nm;
-            G4double firstHelixMat[7][3] = {
-                {0.,0.,0}, // CenterDNA //i*dBetweenEl
-                {sugarTMP1Rxy*cos(i*angleBpAroundHistone/rad+sugarTMP1IniAngle/rad),sugarTMP1ZIni,sugarTMP1Rxy*sin(i*angleBpAroundHistone/rad+sugarTMP1IniAngle/rad)}, // SugarTMP1
-                {sugarTHF1Rxy*cos(i*angleBpAroundHistone/rad+sugarTHF1IniAngle/rad),sugarTHF1ZIni,sugarTHF1Rxy*sin(i*angleBpAroundHistone/rad+sugarTHF1IniAngle/rad)}, // SugarTHF1
-                {base1Rxy*cos(i*angleBpAroundHistone/rad+base1IniAngle/rad),base1ZIni,base1Rxy*sin(i*angleBpAroundHistone/rad+base1IniAngle/rad)}, // Base1
-                {base2Rxy*cos(i*angleBpAroundHistone/rad+base2IniAngle/rad),base2ZIni,base2Rxy*sin(i*angleBpAroundHistone/rad+base2IniAngle/rad)}, // Base2
-                {sugarTHF2Rxy*cos(i*angleBpAroundHistone/rad+sugarTHF2IniAngle/rad),sugarTHF2ZIni,sugarTHF2Rxy*sin(i*angleBpAroundHistone/rad+sugarTHF2IniAngle/rad)}, // SugarTHF2
-                {sugarTMP2Rxy*cos(i*angleBpAroundHistone/rad+sugarTMP2IniAngle/rad),sugarTMP2ZIni,sugarTMP2Rxy*sin(i*angleBpAroundHistone/rad+sugarTMP2IniAngle/rad)}
-            }; // SugarTMP2
-
-            // Rotate first helix to be always ortho to the path of the second one
-            G4double rotMat[3][3]={{cos(i*-deltaLinkerAngle/rad),-sin(i*-deltaLinkerAngle/rad),0},
-                                   {sin(i*-deltaLinkerAngle/rad),cos(i*-deltaLinkerAngle/rad),0},
-                                   {0,0,1}};
-
-            // iterate to perform matrix product
-
-            G4double firstHelixRotatedMat[7][3] = {};
-
-            // iterate on each line of output matrix
-            for(int line=0;line<7;line++)
-            {
-                // iterate on each column of output matrix
-                for(int column=0;column<3;column++)
-                {
-                    // iterate to do the sum
-                    for(int p=0;p<3;++p)
-                    {
-                        firstHelixRotatedMat[line][column] += firstHelixMat[line][p]*rotMat[p][column];
-                    }
-                }
-            }
-
-            linkerArcCircleMat[0] = linkerCentralRadius*cos(i*deltaLinkerAngle/rad);
-            linkerArcCircleMat[1] = linkerCentralRadius*sin(i*deltaLinkerAngle/rad);
-
-            // Corrections to increase the space between the linker and the DNA around the histone
-            //
-            if(i>=0 && i<15)
-            {
-                // to quit the histone: increase the z coord
-                linkerArcCircleMat[2] = i*0.01*fFactor*nm;
-            }
-
-            else if(i>=15 && i<30)
-            {
-                // to do the link
-                linkerArcCircleMat[2] = (i-15)*linkerHeightPerBp;
-            }
-            else
-            {
-                // to join next histone: decrease the z coord
-                linkerArcCircleMat[2] = (i-30)*-0.01*fFactor*nm+15*linkerHeightPerBp;
-            }
-
-            // Create final arc equation
-            //
-            G4double arcFinalMat[7][3];
+            G4double angle = lastTwist + (i+1)*twistPerBp + residueIniAngle[r]/rad;
+            GeoVec3 firstHelix = {{residueRxy[r]*std::cos(angle), residueZIni[r], residueRxy[r]*std::sin(angle)}};
+            fTemplatePositions[r].push_back(GeoTransform(rotMat, firstHelix, posCenter));
+        }
+    }
+}
 
-            for(int line=0;line<7;++line)
-            {
-                for(int column=0;column<3;++column)
-                {
-                    arcFinalMat[line][column] = firstHelixRotatedMat[line][column] + linkerArcCircleMat[column];
-                }
-            }
 
-            // Create positions matrix
-            //
-            G4double posLinkerMat[7][3];
-            for(int line=0;line<7;++line)
-            {
-                for(int column=0;column<3;++column)
-                {
-                    posLinkerMat[line][column] = arcFinalMat[line][column];
-
-                    // x axis
-                    if(column==0)
-                    {
-                        // Remove r distance on the X axis to make the linker start at (0,0,0)
-                        posLinkerMat[line][column] -= linkerCentralRadius;
-                        // Add the x position of the last bp placed around the nucleosome
-                        posLinkerMat[line][column] += posOfLastBp.getX();
-                    }
-
-                    // y axis
-                    else if(column==1)
-                    {
-                        // Add a shift to avoid placing the first bp of the linker at the same position as the last of the nucleosome
-                        posLinkerMat[line][column] += (posOfSecondBp.getY() - posOfFirstBp.getY() );
-                    }
-
-                    // z axis
-                    else if(column==2)
-                    {
-                        // Add the z position of the last bp placed around the nucleosome
-                        posLinkerMat[line][column] += posOfLastBp.getZ();
-                    }
-                }
-            }
+//--------------------------------------------------------------------------------------------------
+// Point of the linker path at parameter t (0 = last bp wrapped around this histone, 1 = first bp
+// wrapped around the next one), in the frame of this nucleosome.
+// Solenoid: the radius about the fiber axis & the angle vary linearly between the two bp, the
+// radius being increased by bulge*sin(pi*t). The height varies as a cosine, so that the linker
+// leaves & joins the histones horizontally (see schema below).
+// Zig-zag: straight segment between the two bp, raised by bulge*sin(pi*t) perpendicularly to the
+// segment in its vertical plane.
+//--------------------------------------------------------------------------------------------------
+GeoVec3 GeoCalculationV2::GetLinkerPathPoint(G4double t, G4double bulge) const
+{
+    // Schema:
+    //
+    //nucleosome ---(straight part)-----\(
+    //                                   \curved part
+    //                                    \)
+    //                                     \----(straight part)---- nucleosome
+    const GeoVec3& posOfLastBp = fTemplatePositions[kCenterDNA][bpNumAroundHistone-1];
+    const GeoVec3& posOfFirstBp = fTemplatePositions[kCenterDNA][0];
+
+    // First bp of the next nucleosome, in the frame of this nucleosome. This is the same for every
+    // nucleosome of the fiber, since consecutive nucleosomes differ by the same rotation & rise.
+    GeoMat3 rotNext = GeoRotationZ(fFiberDeltaAngle);
+    GeoVec3 nextNucleosomeShift = {{fFiberCentralRadius*(std::cos(fFiberDeltaAngle/rad)-1.),
+                                    fFiberCentralRadius*std::sin(fFiberDeltaAngle/rad),
+                                    fNucleosomeRise}};
+    GeoVec3 posOfNextBp = GeoTransform(rotNext, posOfFirstBp, nextNucleosomeShift);
+
+    G4double pi = std::acos(-1.);
+    GeoVec3 point;
+    if (!fIsZigZag) {
+        // Cylindrical coordinates about the fiber axis, which is at x = -fFiberCentralRadius
+        G4double startRadius = std::hypot(posOfLastBp[0] + fFiberCentralRadius, posOfLastBp[1]);
+        G4double endRadius = std::hypot(posOfNextBp[0] + fFiberCentralRadius, posOfNextBp[1]);
+        G4double startAngle = std::atan2(posOfLastBp[1], posOfLastBp[0] + fFiberCentralRadius);
+        G4double endAngle = std::atan2(posOfNextBp[1], posOfNextBp[0] + fFiberCentralRadius);
+        while (endAngle <= startAngle) endAngle += 2*pi;
+
+        G4double radius = startRadius + t*(endRadius - startRadius) + bulge*std::sin(pi*t);
+        G4double angle = startAngle + t*(endAngle - startAngle);
+        point[0] = radius*std::cos(angle) - fFiberCentralRadius;
+        point[1] = radius*std::sin(angle);
+        point[2] = posOfLastBp[2] + (posOfNextBp[2] - posOfLastBp[2])*(1. - std::cos(pi*t))/2.;
+    }
+    else {
+        GeoVec3 chord;
+        for (G4int k=0; k<3; ++k) chord[k] = posOfNextBp[k] - posOfLastBp[k];
+        G4double chord2 = chord[0]*chord[0] + chord[1]*chord[1] + chord[2]*chord[2];
+        // Unit vector along z, orthogonal to the chord
+        GeoVec3 up = {{-chord[2]*chord[0]/chord2, -chord[2]*chord[1]/chord2, 1. - chord[2]*chord[2]/chord2}};
+        G4double upNorm = std::sqrt(up[0]*up[0] + up[1]*up[1] + up[2]*up[2]);
+        for (G4int k=0; k<3; ++k)
+            point[k] = posOfLastBp[k] + t*chord[k] + bulge*std::sin(pi*t)*up[k]/upNorm;
+    }
+    return point;
+}
 
-            // Fiber part
 
-            G4double posLinkerFMat[7][3] = {};
+//--------------------------------------------------------------------------------------------------
+// Sample the linker path with the given bulge at 1000 steps of t. Fill path with the points &
+// pathLength with the distance of each point from the start along the path. Return the length.
+//--------------------------------------------------------------------------------------------------
+G4double GeoCalculationV2::SampleLinkerPath(G4double bulge, std::vector<GeoVec3>* path,
+                                            std::vector<G4double>* pathLength) const
+{
+    const G4int numSteps = 1000;
+    path->resize(numSteps+1);
+    pathLength->resize(numSteps+1);
+
+    (*path)[0] = GetLinkerPathPoint(0., bulge);
+    (*pathLength)[0] = 0.;
+    for (G4int s=1; s<=numSteps; ++s) {
+        (*path)[s] = GetLinkerPathPoint(G4double(s)/numSteps, bulge);
+        G4double step2 = 0.;
+        for (G4int k=0; k<3; ++k) step2 += ((*path)[s][k]-(*path)[s-1][k])*((*path)[s][k]-(*path)[s-1][k]);
+        (*pathLength)[s] = (*pathLength)[s-1] + std::sqrt(step2);
+    }
+    return (*pathLength)[numSteps];
+}
 
-            // iterate to perform matrix product
 
-            // iterate on each line of output matrix
-            for(int line=0;line<7;line++)
-            {
-                // iterate on each column of output matrix
-                for(int column=0;column<3;column++)
-                {
-                    // iterate to do the sum
-                    for(int p=0;p<3;++p)
-                    {
-                        posLinkerFMat[line][column] += posLinkerMat[line][p]*fRotFiberMatVect[n][p][column];
-                    }
-                }
-            }
+//--------------------------------------------------------------------------------------------------
+// Rotation taking the DNA axis of a bp (local y) onto direction, keeping the local x axis
+// horizontal. Columns are the images of the local x, y & z axes.
+//--------------------------------------------------------------------------------------------------
+GeoMat3 GeoCalculationV2::GetLinkerRotation(GeoVec3 direction) const
+{
+    G4double length = std::sqrt(direction[0]*direction[0] + direction[1]*direction[1] + direction[2]*direction[2]);
+    for (G4int k=0; k<3; ++k) direction[k] /= length;
+
+    GeoVec3 xAxis = {{direction[1], -direction[0], 0.}}; // direction x z
+    G4double xNorm = std::sqrt(xAxis[0]*xAxis[0] + xAxis[1]*xAxis[1]);
+    if (xNorm > 0) {
+        xAxis[0] /= xNorm;
+        xAxis[1] /= xNorm;
+    }
+    else {
+        xAxis[0] = 1.;
+    }
+    GeoVec3 zAxis = {{xAxis[1]*direction[2] - xAxis[2]*direction[1],
+                      xAxis[2]*direction[0] - xAxis[0]*direction[2],
+                      xAxis[0]*direction[1] - xAxis[1]*direction[0]}};
+    GeoMat3 rotMat = {{ {{xAxis[0], direction[0], zAxis[0]}},
+                        {{xAxis[1], direction[1], zAxis[1]}},
+                        {{xAxis[2], direction[2], zAxis[2]}} }};
+    return rotMat;
+}
 
-            for(int line=0;line<7;++line)
-            {
-                for(int column=0;column<3;++column)
-                {
-                    posLinkerFMat[line][column] += fFiberHelixMatVect[n][column];
-                }
+//--------------------------------------------------------------------------------------------------
+// Place numNucleosomes nucleosomes along the fiber helix. For each nucleosome, the template is
+// rotated about the fiber axis and translated to its position on the helix in a single pass over
+// the contiguous coordinate arrays of each residue type.
+//--------------------------------------------------------------------------------------------------
+void GeoCalculationV2::GeneratePositions(G4int firstNucleosome, G4int numNucleosomes,
+                                         DNAPositionBuffer* buffer, G4double zOffset) const
+{
+    buffer->numNucleosomes = numNucleosomes;
+    buffer->numBpPerNucleosome = fBpNum;
+
+    G4int numElements = numNucleosomes*fBpNum;
+    for (G4int r=0; r<kNumDNAResidues; ++r) {
+        buffer->x[r].resize(numElements);
+        buffer->y[r].resize(numElements);
+        buffer->z[r].resize(numElements);
+    }
+    buffer->histoneX.resize(numNucleosomes);
+    buffer->histoneY.resize(numNucleosomes);
+    buffer->histoneZ.resize(numNucleosomes);
+
+    for (G4int n=0; n<numNucleosomes; ++n) {
+        G4int helixIndex = firstNucleosome + n;
+
+        // Rotation about, and position along, the fiber helix
+        GeoMat3 rotFiber = GeoRotationZ(helixIndex*fFiberDeltaAngle);
+        GeoVec3 fiberHelix = {{fFiberCentralRadius*std::cos(helixIndex*fFiberDeltaAngle/rad),
+                               fFiberCentralRadius*std::sin(helixIndex*fFiberDeltaAngle/rad),
+                               helixIndex*fNucleosomeRise + zOffset}};
+
+        G4int offset = n*fBpNum;
+        for (G4int r=0; r<kNumDNAResidues; ++r) {
+            const std::vector<GeoVec3>& local = fTemplatePositions[r];
+            G4double* outX = &buffer->x[r][offset];
+            G4double* outY = &buffer->y[r][offset];
+            G4double* outZ = &buffer->z[r][offset];
+            for (G4int j=0; j<fBpNum; ++j) {
+                outX[j] = rotFiber[0][0]*local[j][0] + rotFiber[0][1]*local[j][1] + fiberHelix[0];
+                outY[j] = rotFiber[1][0]*local[j][0] + rotFiber[1][1]*local[j][1] + fiberHelix[1];
+                outZ[j] = local[j][2] + fiberHelix[2];
             }
-
-            DNAPlacementData p;
-            data->at(n).push_back(p);
-
-            // Save the positions
-            data->at(n)[i+bpNumAroundHistone].posCenterDNA = G4ThreeVector(posLinkerFMat[0][0],posLinkerFMat[0][1],posLinkerFMat[0][2]);
-            data->at(n)[i+bpNumAroundHistone].posSugarTMP1 = G4ThreeVector(posLinkerFMat[1][0],posLinkerFMat[1][1],posLinkerFMat[1][2]);
-            data->at(n)[i+bpNumAroundHistone].posSugarTHF1 = G4ThreeVector(posLinkerFMat[2][0],posLinkerFMat[2][1],posLinkerFMat[2][2]);
-            data->at(n)[i+bpNumAroundHistone].posBase1 = G4ThreeVector(posLinkerFMat[3][0],posLinkerFMat[3][1],posLinkerFMat[3][2]);
-            data->at(n)[i+bpNumAroundHistone].posBase2 = G4ThreeVector(posLinkerFMat[4][0],posLinkerFMat[4][1],posLinkerFMat[4][2]);
-            data->at(n)[i+bpNumAroundHistone].posSugarTHF2 = G4ThreeVector(posLinkerFMat[5][0],posLinkerFMat[5][1],posLinkerFMat[5][2]);
-            data->at(n)[i+bpNumAroundHistone].posSugarTMP2 = G4ThreeVector(posLinkerFMat[6][0],posLinkerFMat[6][1],posLinkerFMat[6][2]);
         }
-    }
 
-    return data;
+        GeoVec3 histone = GeoTransform(rotFiber, fTemplateHistonePosition, fiberHelix);
+        buffer->histoneX[n] = histone[0];
+        buffer->histoneY[n] = histone[1];
+        buffer->histoneZ[n] = histone[2];
+    }
+    buffer->UseOwnStorage();
 }
 
 
 //--------------------------------------------------------------------------------------------------
-// Create a map of the 6 volumes comprising nucleotide base pairs, across all of the basis 
-// nucleosomes. Key = G4ThreeVector of coordinates, Value = radius of the volume (hydration shell).
-// Input parameter: pointer to a DNAPosData object created by CalculateDNAPosition().
-// Output: a map of coordinates:radius pairs that is used by 
+// Create a map of the 6 volumes comprising nucleotide base pairs, across all of the nucleosomes in
+// positions. Key = G4ThreeVector of coordinates, Value = radius of the volume.
+// Output: a map of coordinates:radius pairs that is used by
 //     VoxelizedNuclearDNA::CreateNucleosomeCuttedSolidsAndLogicals()
-// NOTE: it is the hydration shell radius that is used.
-// Map size = 3600 (3 nucleosomes x 200 bp/nucl x 6 volumes/bp)
+// Map size = 10800 for the default solenoid (9 nucleosomes x 200 bp/nucl x 6 volumes/bp)
 //--------------------------------------------------------------------------------------------------
-std::map<G4ThreeVector,G4double>* GeoCalculationV2::GenerateCoordAndRadiusMap(DNAPosData* dnaPosData)
+std::map<G4ThreeVector,G4double>* GeoCalculationV2::GenerateCoordAndRadiusMap(const DNAPositionBuffer& positions)
 {
     // To build the coord map used by the cut algorithm
-
     std::map<G4ThreeVector,G4double>* outMap = new std::map<G4ThreeVector,G4double>;
 
-    G4ThreeVector coord;
-    G4double radius;
+    G4double radii[kNumDNAResidues] = {0., fSugarTMPRadius, fSugarTHFRadius, fBaseRadius, fBaseRadius,
+                                       fSugarTHFRadius, fSugarTMPRadius};
 
-    // iterate on each histone (3)
-    for(int i=0, ei=dnaPosData->size();i<ei;++i)
-    {
-        // iterate on each bp (200)
-        for(int j=0, ej=dnaPosData->at(i).size();j<ej;++j)
-        {
-            // sugarTMP 1
-            coord = dnaPosData->at(i)[j].posSugarTMP1;
-            // radius = fSugarTMPRadiusWater;
-            radius = fSugarTMPRadius;
-            (*outMap)[coord] = radius;
-
-            // sugarTHF 1
-            coord = dnaPosData->at(i)[j].posSugarTHF1;
-            // radius = fSugarTHFRadiusWater;
-            radius = fSugarTHFRadius;
-            (*outMap)[coord] = radius;
-
-            // base 1
-            coord = dnaPosData->at(i)[j].posBase1;
-            // radius = fBaseRadiusWater;
-            radius = fBaseRadius;
-            (*outMap)[coord] = radius;
-
-            // base 2
-            coord = dnaPosData->at(i)[j].posBase2;
-            // radius = fBaseRadiusWater;
-            radius = fBaseRadius;
-            (*outMap)[coord] = radius;
-
-            // sugarTHF 2
-            coord = dnaPosData->at(i)[j].posSugarTHF2;
-            // radius = fSugarTHFRadiusWater;
-            radius = fSugarTHFRadius;
-            (*outMap)[coord] = radius;
-
-            // sugarTMP 2
-            coord = dnaPosData->at(i)[j].posSugarTMP2;
-            // radius = fSugarTMPRadiusWater;
-            radius = fSugarTMPRadius;
-            (*outMap)[coord] = radius;
+    // iterate on each basis histone (9 for the default solenoid)
+    for (G4int i=0; i<positions.numNucleosomes; ++i) {
+        // iterate on each bp (200 by default)
+        for (G4int j=0; j<positions.numBpPerNucleosome; ++j) {
+            // iterate on each residue (skip the bp centre)
+            for (G4int r=kSugarTMP1; r<kNumDNAResidues; ++r)
+                (*outMap)[positions.GetPosition(r,i,j)] = radii[r];
         }
     }
 
     return outMap;
 }
 
-
 //--------------------------------------------------------------------------------------------------
 // Helper function used by CalculateDNAPosition().
 //--------------------------------------------------------------------------------------------------
@@ -7,8 +7,14 @@
 //
 // This class performs the calculations necessary for placing nucleotide base pairs and nucloesomes.
 // The size of the individual volumes comprising nucleotides and histones are defined using the
-// Initialize() function. CalculateNucleosomePosition() and CalculateDNAPosition() are used to
-// place three "basis" nucleosomes and their accompanying 200 bp each (incl linker DNA).
+// Initialize() function. The positions of all residues of one nucleosome (incl linker DNA) are
+// calculated once in the nucleosome's own frame. GeneratePositions() then places any number of
+// nucleosomes along the fiber helix by applying one rotation & translation per nucleosome to this
+// template, writing into a structure-of-arrays DNAPositionBuffer.
+// Two fiber models are supported: a one-start solenoid (consecutive nucleosomes are neighbours on
+// the helix, joined by a curved linker) and a two-start zig-zag (consecutive nucleosomes sit on
+// opposite sides of the fiber axis, joined by a straight linker). The fiber parameters can be set
+// before calling Initialize().
 //**************************************************************************************************
 
 #ifndef GEOCALCULATIONV2_HH
@@ -16,31 +22,137 @@
 
 #include "G4UnitsTable.hh"
 #include "G4SystemOfUnits.hh"
+#include "G4ThreeVector.hh"
 
+#include <array>
+#include <cmath>
 #include <map>
+#include <vector>
 
 //--------------------------------------------------------------------------------------------------
-// Structure containting coordinates of volumes in a DNA base pair.
+// Fixed-size vector & matrix types used for the position calculations. Matrices are row-major and
+// act on column vectors (i.e. v' = M*v).
 //--------------------------------------------------------------------------------------------------
-struct DNAPlacementData;
+typedef std::array<G4double,3> GeoVec3;
+typedef std::array<GeoVec3,3> GeoMat3;
 
 //--------------------------------------------------------------------------------------------------
-// vector contains vector which contains DNA volume positions for one base pair
-// Schema:
+// Rotation about the z axis by angle.
 //--------------------------------------------------------------------------------------------------
-//     Vector                SubVector containing DNAPlacementData
-//     |
-//     |nucleosome 1 --------| Position informations about base pair 1 (4 volumes)
-//     |                     | Position informations about base pair 2 (4 volumes)
-//     |                     | Position informations about base pair 3 (4 volumes)
-//     |                     | etc.
-//     |
-//     |nucleosome 2 --------| Position informations about base pair 1 (4 volumes)
-//     |                     | Position informations about base pair 2 (4 volumes)
-//     |                     | Position informations about base pair 3 (4 volumes)
-//     |                     | etc.
-//
-typedef std::vector<std::vector<DNAPlacementData> > DNAPosData;
+inline GeoMat3 GeoRotationZ(G4double angle)
+{
+    G4double c = std::cos(angle/rad);
+    G4double s = std::sin(angle/rad);
+    GeoMat3 m = {{ {{c, -s, 0.}}, {{s, c, 0.}}, {{0., 0., 1.}} }};
+    return m;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Return M*v + t
+//--------------------------------------------------------------------------------------------------
+inline GeoVec3 GeoTransform(const GeoMat3& m, const GeoVec3& v, const GeoVec3& t)
+{
+    GeoVec3 out;
+    for (G4int row=0; row<3; ++row)
+        out[row] = m[row][0]*v[0] + m[row][1]*v[1] + m[row][2]*v[2] + t[row];
+    return out;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Index of each point recorded for a DNA base pair. The centre of the bp is followed by the 6
+// residues, in the order they are placed in the fiber.
+//--------------------------------------------------------------------------------------------------
+enum DNAResidueIndex
+{
+    kCenterDNA = 0,
+    kSugarTMP1,
+    kSugarTHF1,
+    kBase1,
+    kBase2,
+    kSugarTHF2,
+    kSugarTMP2,
+    kNumDNAResidues
+};
+
+//--------------------------------------------------------------------------------------------------
+// Structure-of-arrays container for the positions of DNA residues & histones of several nucleosomes.
+// Residue positions are stored per residue type, with element index = nucleosome*numBp + bp.
+// Histone positions are indexed by nucleosome. The positions are read through the data pointers,
+// which point either at the buffer's own vectors (filled by GeoCalculationV2::GeneratePositions())
+// or at external arrays, e.g. those of a mapped FiberTemplateFile.
+//--------------------------------------------------------------------------------------------------
+struct DNAPositionBuffer
+{
+    G4int numNucleosomes;
+    G4int numBpPerNucleosome;
+
+    std::vector<G4double> x[kNumDNAResidues];
+    std::vector<G4double> y[kNumDNAResidues];
+    std::vector<G4double> z[kNumDNAResidues];
+
+    std::vector<G4double> histoneX;
+    std::vector<G4double> histoneY;
+    std::vector<G4double> histoneZ;
+
+    const G4double* xData[kNumDNAResidues];
+    const G4double* yData[kNumDNAResidues];
+    const G4double* zData[kNumDNAResidues];
+
+    const G4double* histoneXData;
+    const G4double* histoneYData;
+    const G4double* histoneZData;
+
+    DNAPositionBuffer() : numNucleosomes(0), numBpPerNucleosome(0) {UseOwnStorage();}
+
+    //----------------------------------------------------------------------------------------------
+    // Point the data pointers at the vectors. Must be called once the vectors are filled.
+    //----------------------------------------------------------------------------------------------
+    void UseOwnStorage()
+    {
+        for (G4int r=0; r<kNumDNAResidues; ++r) {
+            xData[r] = x[r].data();
+            yData[r] = y[r].data();
+            zData[r] = z[r].data();
+        }
+        histoneXData = histoneX.data();
+        histoneYData = histoneY.data();
+        histoneZData = histoneZ.data();
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // Free the vectors, before pointing the data pointers at external arrays.
+    //----------------------------------------------------------------------------------------------
+    void ReleaseOwnStorage()
+    {
+        for (G4int r=0; r<kNumDNAResidues; ++r) {
+            std::vector<G4double>().swap(x[r]);
+            std::vector<G4double>().swap(y[r]);
+            std::vector<G4double>().swap(z[r]);
+        }
+        std::vector<G4double>().swap(histoneX);
+        std::vector<G4double>().swap(histoneY);
+        std::vector<G4double>().swap(histoneZ);
+        UseOwnStorage();
+    }
+
+    G4int GetIndex(G4int nucleosome, G4int bp) const {return nucleosome*numBpPerNucleosome + bp;}
+
+    G4ThreeVector GetPosition(G4int residue, G4int nucleosome, G4int bp) const
+    {
+        G4int index = GetIndex(nucleosome, bp);
+        return G4ThreeVector(xData[residue][index], yData[residue][index], zData[residue][index]);
+    }
+
+    G4ThreeVector GetHistonePosition(G4int nucleosome) const
+    {
+        return G4ThreeVector(histoneXData[nucleosome], histoneYData[nucleosome], histoneZData[nucleosome]);
+    }
+
+private:
+    // Not copyable: the data pointers may point at the buffer's own vectors
+    DNAPositionBuffer(const DNAPositionBuffer&);
+    DNAPositionBuffer& operator=(const DNAPositionBuffer&);
+};
 
 class GeoCalculationV2
 {
@@ -54,12 +166,24 @@ public:
     //----------------------------------------------------------------------------------------------
     void Initialize();
 
+    //----------------------------------------------------------------------------------------------
+    // Fill buffer with the positions of numNucleosomes consecutive nucleosomes along the fiber
+    // helix, starting from helix index firstNucleosome. Nucleosome n is the template rotated by
+    // n*fFiberDeltaAngle about the fiber axis and raised by n*fNucleosomeRise. An additional zOffset
+    // is applied to all positions (e.g. to start the helix at one end of the fiber). Any previous
+    // contents of buffer are replaced.
+    //----------------------------------------------------------------------------------------------
+    void GeneratePositions(G4int firstNucleosome, G4int numNucleosomes, DNAPositionBuffer* buffer,
+                           G4double zOffset=0.) const;
+
     //----------------------------------------------------------------------------------------------
     // Getters
     //----------------------------------------------------------------------------------------------
-    std::vector<G4ThreeVector>* GetNucleosomePosition(){return fPosNucleo;}
-    DNAPosData* GetAllDNAVolumePositions(){return fPosDNA;}
-    std::vector<DNAPlacementData>* GetDNAVolumePositionsForNucleosome(G4int nucl){return &fPosDNA->at(nucl);}
+    const DNAPositionBuffer* GetBasisPositions(){return &fBasisPositions;}
+    G4int GetBasisTemplateIndex(){return fHistoneNum/2;}
+    G4String GetFiberModel(){return fFiberModel;}
+    G4double GetFiberCentralRadius(){return fFiberCentralRadius;}
+    G4int GetLinkerNumBp(){return bpNumForLinker;}
     std::map<G4ThreeVector, G4double>* GetPosAndRadiusMap(){return fPosAndRadiusMap;}
     G4double GetSugarTHFRadiusWater(){return fSugarTHFRadiusWater;}
     G4double GetSugarTMPRadiusWater(){return fSugarTMPRadiusWater;}
@@ -84,6 +208,17 @@ public:
     void SetBaseRadiusWater(G4double radius){fBaseRadiusWater=radius;}
     void SetBaseRadius(G4double radius){fBaseRadius=radius;}
 
+    //----------------------------------------------------------------------------------------------
+    // Fiber model setters. Must be called before Initialize().
+    // model: "Solenoid" (default) or "ZigZag"
+    // number: nucleosomes per turn of the helix (of each of the two stacks for the zig-zag)
+    //----------------------------------------------------------------------------------------------
+    void SetFiberModel(G4String model){fFiberModel=model;}
+    void SetFiberNbNuclPerTurn(G4double number){fFiberNbNuclPerTurn=number;}
+    void SetFiberPitch(G4double pitch){fFiberPitch=pitch;}
+    void SetFiberCentralRadius(G4double radius){fFiberCentralRadius=radius;}
+    void SetLinkerNumBp(G4int number){bpNumForLinker=number;}
+
 private:
     G4int fVerbose;
     G4double fFactor;
@@ -109,15 +244,16 @@ private:
 
     // Calculation parameters
     // Fiber parameters
+    G4String fFiberModel;
+    G4bool fIsZigZag;
     G4int fHistoneNum;
     G4double fHistoneRadius;
     G4double fHistoneHeight;
     G4double fFiberPitch;
     G4double fFiberCentralRadius;
     G4double fFiberNbNuclPerTurn;
-    G4double fFiberDeltaAngle;
-    std::vector<std::vector<G4double> > fFiberHelixMatVect;
-    std::vector<std::vector<std::vector<G4double> > > fRotFiberMatVect;
+    G4double fFiberDeltaAngle; // rotation from one nucleosome to the next
+    G4double fNucleosomeRise; // rise from one nucleosome to the next
 
     // DNA around histone parameters
     // First helix parameters
@@ -132,15 +268,16 @@ private:
 
     // DNA linker parameters
     G4int bpNumForLinker;//const G4int bpNumForLinker = 46;
-    G4double linkerCentralRadius;
-    G4double linkerHeightPerBp;
-    G4double linkerArcCircleMat[3];
-    G4double nbBasePairPerTurnForLinker;
-    G4double deltaLinkerAngle;
+    G4double linkerRisePerBp; // distance between consecutive bp along the linker
+    G4double linkerBulge; // displacement of the middle of the linker from the shortest path
+
+    // Positions of all points of one nucleosome (incl linker) in the nucleosome frame. Indexed by
+    // DNAResidueIndex, then by bp.
+    std::vector<GeoVec3> fTemplatePositions[kNumDNAResidues];
+    GeoVec3 fTemplateHistonePosition;
 
     // Pos containers
-    std::vector<G4ThreeVector>* fPosNucleo;
-    DNAPosData* fPosDNA;
+    DNAPositionBuffer fBasisPositions;
     std::map<G4ThreeVector, G4double>* fPosAndRadiusMap;
 
     //**********************************************************************************************
@@ -148,40 +285,55 @@ private:
     //**********************************************************************************************
 
     //----------------------------------------------------------------------------------------------
-    // Calculate positions of nucleotide volumes around the basis hisotone volumes (3). Fills and 
-    // returns pointer to DNAPosData object, which is a 2D vector of DNAPlacementData objects.
-    //      outer index i : spans nucleosomes (1 to 3)
-    //      inner index j : spans all bp in that nucleosome
-    // DNAPlacementData is a structure containing 7 G4ThreeVectors containing the coordinates of 6
-    // residues & central location of a given nucleotide base pair.
+    // Calculate the positions of the bp centre & 6 residues of every bp of one nucleosome (154 bp
+    // wrapped around the histone followed by the linker bp), and the histone position, in the
+    // frame of the nucleosome. Fills fTemplatePositions & fTemplateHistonePosition.
+    //----------------------------------------------------------------------------------------------
+    void CalculateNucleosomeTemplate();
+
+    //----------------------------------------------------------------------------------------------
+    // Exit if the DNA of the template nucleosome of fBasisPositions (wrapped or linker) overlaps a
+    // histone, or if its axis comes closer than one DNA radius to DNA further along the chain.
+    //----------------------------------------------------------------------------------------------
+    void CheckNucleosomeOverlaps();
+
+    //----------------------------------------------------------------------------------------------
+    // Append the linker bp to the template, every linkerRisePerBp along the linker path. Input
+    // arrays are indexed by DNAResidueIndex and give the initial radius, angle & z of each residue
+    // on the small DNA helix.
+    //----------------------------------------------------------------------------------------------
+    void CalculateLinker(const G4double* residueRxy, const G4double* residueIniAngle,
+                         const G4double* residueZIni);
+
+    //----------------------------------------------------------------------------------------------
+    // Linker path from the last bp around the histone (t=0) to the first bp around the next one
+    // (t=1), in the frame of the nucleosome: an arc about the fiber axis (solenoid) or a straight
+    // segment (zig-zag), displaced by bulge*sin(pi*t).
+    //----------------------------------------------------------------------------------------------
+    GeoVec3 GetLinkerPathPoint(G4double t, G4double bulge) const;
+
+    //----------------------------------------------------------------------------------------------
+    // Sample the linker path with the given bulge. Fill path with the sampled points & pathLength
+    // with their distance from the start along the path. Return the length of the path.
     //----------------------------------------------------------------------------------------------
-    DNAPosData* CalculateDNAPosition(G4int histoneNum, G4ThreeVector& posSugarTMP1, 
-                                     G4ThreeVector &posSugarTHF1, G4ThreeVector &posBase1,
-                                     G4ThreeVector &posBase2, G4ThreeVector &posSugarTHF2, 
-                                     G4ThreeVector &posSugarTMP2);
+    G4double SampleLinkerPath(G4double bulge, std::vector<GeoVec3>* path, std::vector<G4double>* pathLength) const;
 
     //----------------------------------------------------------------------------------------------
-    // Calculate nucleosome positions for basis nucleosomes. Remaining nucleosome positions can be 
-    // established by translating & rotating these three basis positions. Note the number of basis
-    // nucleosomes (i.e. nucleoNum) is 3 for typical use. Returns a pointer to a vector of size
-    // nucleoNum (3), with each element containing a G4ThreeVector of the spatial coordinates for 1
-    // of the basis nucleosomes.
+    // Rotation taking the DNA axis of a bp (local y) onto direction.
     //----------------------------------------------------------------------------------------------
-    std::vector<G4ThreeVector>* CalculateNucleosomePosition(G4int nucleoNum);
+    GeoMat3 GetLinkerRotation(GeoVec3 direction) const;
 
     //----------------------------------------------------------------------------------------------
-    // Create a map of the 6 volumes comprising nucleotide base pairs, across all of the basis 
-    // nucleosomes. Key = G4ThreeVector of coordinates, Value = radius of the hydration shell.
-    // Input parameter: pointer to a DNAPosData object created by CalculateDNAPosition().
-    // Output: a map of coordinates:radius pairs that is used by 
+    // Create a map of the 6 volumes comprising nucleotide base pairs, across all of the nucleosomes
+    // in positions. Key = G4ThreeVector of coordinates, Value = radius of the volume.
+    // Output: a map of coordinates:radius pairs that is used by
     //     VoxelizedNuclearDNA::CreateNucleosomeCuttedSolidsAndLogicals()
-    // NOTE: it is the hydration shell radius that is used.
-    // Map size = 3600 (3 nucleosomes x 200 bp/nucl x 6 volumes/bp)
+    // Map size = 10800 for the default solenoid (9 nucleosomes x 200 bp/nucl x 6 volumes/bp)
     //----------------------------------------------------------------------------------------------
-    std::map<G4ThreeVector, G4double>* GenerateCoordAndRadiusMap(DNAPosData *dnaPosData);
+    std::map<G4ThreeVector, G4double>* GenerateCoordAndRadiusMap(const DNAPositionBuffer& positions);
 
     //----------------------------------------------------------------------------------------------
-    // Helper function used by CalculateDNAPosition().
+    // Helper function used by CalculateNucleosomeTemplate().
     //----------------------------------------------------------------------------------------------
     G4double GetAngleToXAxis(G4ThreeVector t);
 };
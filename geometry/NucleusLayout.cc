@@ -0,0 +1,168 @@
+// Extra Class for VoxelizedNuclearDNA
+//
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class holds the positions of the nuclei of a VoxelizedNuclearDNA component that builds a
+// population of cells, all placements of one logical nucleus volume.
+//**************************************************************************************************
+
+#include "NucleusLayout.hh"
+
+#include "TsParameterManager.hh"
+
+#include "G4LogicalVolume.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4VTouchable.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4ios.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+//--------------------------------------------------------------------------------------------------
+// Registry of layouts, indexed by geometry component name. Layouts are only added or refilled
+// during geometry construction, which happens on the master thread while no events are running.
+//--------------------------------------------------------------------------------------------------
+std::map<G4String, NucleusLayout*>& NucleusLayout::GetRegistry()
+{
+    static std::map<G4String, NucleusLayout*> registry;
+    return registry;
+}
+
+NucleusLayout* NucleusLayout::GetInstance(const G4String& componentName)
+{
+    std::map<G4String, NucleusLayout*>& registry = GetRegistry();
+    std::map<G4String, NucleusLayout*>::iterator it = registry.find(componentName);
+    if (it != registry.end()) return it->second;
+
+    NucleusLayout* layout = new NucleusLayout();
+    registry[componentName] = layout;
+    return layout;
+}
+
+const NucleusLayout* NucleusLayout::Find(const G4String& componentName)
+{
+    std::map<G4String, NucleusLayout*>& registry = GetRegistry();
+    std::map<G4String, NucleusLayout*>::iterator it = registry.find(componentName);
+    if (it == registry.end() || !it->second->fComponentVolume) return NULL;
+    return it->second;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Read the nucleus centres from the parameters of the component. A list of centres takes precedence
+// over the lattice.
+//--------------------------------------------------------------------------------------------------
+std::vector<G4ThreeVector> NucleusLayout::ReadCentres(TsParameterManager* pm, const G4String& componentName,
+                                                      G4double nucleusHalfLength)
+{
+    std::vector<G4ThreeVector> centres;
+    G4String prefix = "Ge/" + componentName + "/";
+
+    if (pm->ParameterExists(prefix + "NucleusCentres")) {
+        G4int length = pm->GetVectorLength(prefix + "NucleusCentres");
+        if (length == 0 || length % 3 != 0) {
+            G4cerr << "VoxelizedNuclearDNA, Fatal Error. " << prefix << "NucleusCentres must hold 3 "
+                   << "coordinates per nucleus (found " << length << " values)." << G4endl;
+            std::exit(EXIT_FAILURE);
+        }
+        G4double* values = pm->GetDoubleVector(prefix + "NucleusCentres", "Length");
+        for (G4int i=0; i<length; i+=3)
+            centres.push_back(G4ThreeVector(values[i], values[i+1], values[i+2]));
+    }
+    else {
+        G4int latticeSize[3] = {1, 1, 1};
+        if (pm->ParameterExists(prefix + "NucleusLattice")) {
+            G4int length = pm->GetVectorLength(prefix + "NucleusLattice");
+            G4int* values = pm->GetIntegerVector(prefix + "NucleusLattice");
+            if (length != 3 || values[0] < 1 || values[1] < 1 || values[2] < 1) {
+                G4cerr << "VoxelizedNuclearDNA, Fatal Error. " << prefix << "NucleusLattice must hold "
+                       << "3 positive numbers of nuclei (along x, y & z)." << G4endl;
+                std::exit(EXIT_FAILURE);
+            }
+            std::copy(values, values+3, latticeSize);
+        }
+
+        G4double pitch = 2*nucleusHalfLength;
+        if (pm->ParameterExists(prefix + "NucleusLatticePitch"))
+            pitch = pm->GetDoubleParameter(prefix + "NucleusLatticePitch", "Length");
+
+        for (G4int iz=0; iz<latticeSize[2]; ++iz)
+            for (G4int iy=0; iy<latticeSize[1]; ++iy)
+                for (G4int ix=0; ix<latticeSize[0]; ++ix)
+                    centres.push_back(G4ThreeVector((ix - 0.5*(latticeSize[0]-1))*pitch,
+                                                    (iy - 0.5*(latticeSize[1]-1))*pitch,
+                                                    (iz - 0.5*(latticeSize[2]-1))*pitch));
+    }
+
+    // Nuclei are cubes with the same orientation: they overlap if they do along all three axes. A
+    // tolerance allows nuclei that touch.
+    G4double minSeparation = 2*nucleusHalfLength - 1e-3*nm;
+    for (size_t i=0; i<centres.size(); ++i) {
+        for (size_t j=i+1; j<centres.size(); ++j) {
+            G4ThreeVector separation = centres[j] - centres[i];
+            if (std::abs(separation.x()) < minSeparation && std::abs(separation.y()) < minSeparation
+                && std::abs(separation.z()) < minSeparation) {
+                G4cerr << "VoxelizedNuclearDNA, Fatal Error. Nuclei " << i << " & " << j << " of component "
+                       << componentName << " overlap (centres " << centres[i]/um << " & " << centres[j]/um
+                       << " um, nucleus side length " << 2*nucleusHalfLength/um << " um)." << G4endl;
+                std::exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    return centres;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Constructor
+//--------------------------------------------------------------------------------------------------
+NucleusLayout::NucleusLayout()
+    : fNucleusHalfLength(0.), fNucleusVolume(NULL), fComponentVolume(NULL)
+{}
+
+//--------------------------------------------------------------------------------------------------
+// Destructor
+//--------------------------------------------------------------------------------------------------
+NucleusLayout::~NucleusLayout()
+{}
+
+//--------------------------------------------------------------------------------------------------
+// Set the centres & the logical volume of the nucleus.
+//--------------------------------------------------------------------------------------------------
+void NucleusLayout::Reset(const std::vector<G4ThreeVector>& centres, G4double nucleusHalfLength,
+                          G4LogicalVolume* nucleusVolume)
+{
+    fCentres = centres;
+    fNucleusHalfLength = nucleusHalfLength;
+    fNucleusVolume = nucleusVolume;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Walk up the touchable history to the placement of the nucleus volume. Nuclei are a few levels
+// above the DNA volumes, so only a few pointers are compared.
+//--------------------------------------------------------------------------------------------------
+G4int NucleusLayout::Locate(const G4VTouchable* touchable) const
+{
+    G4int depth = touchable->GetHistoryDepth();
+    for (G4int d=0; d<=depth; ++d) {
+        if (touchable->GetVolume(d)->GetLogicalVolume() == fNucleusVolume)
+            return touchable->GetCopyNumber(d);
+    }
+    return -1;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Half lengths of the box enclosing all nuclei, centred on the component origin
+//--------------------------------------------------------------------------------------------------
+G4ThreeVector NucleusLayout::GetEnclosingHalfLengths() const
+{
+    G4ThreeVector halfLengths(fNucleusHalfLength, fNucleusHalfLength, fNucleusHalfLength);
+    for (size_t i=0; i<fCentres.size(); ++i) {
+        halfLengths.setX(std::max(halfLengths.x(), std::abs(fCentres[i].x()) + fNucleusHalfLength));
+        halfLengths.setY(std::max(halfLengths.y(), std::abs(fCentres[i].y()) + fNucleusHalfLength));
+        halfLengths.setZ(std::max(halfLengths.z(), std::abs(fCentres[i].z()) + fNucleusHalfLength));
+    }
+    return halfLengths;
+}
@@ -0,0 +1,99 @@
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class holds the positions of the nuclei of a VoxelizedNuclearDNA component that builds a
+// population of cells. All nuclei are placements of one logical volume, so they share the voxel,
+// fiber & DNA volumes: each extra nucleus only costs one physical volume.
+//
+// The centres are read from the parameters of the component, either as a list (NucleusCentres) or
+// as a lattice (NucleusLattice & NucleusLatticePitch), so the scorer can count the nuclei from the
+// same parameters. One layout is kept per geometry component, in a registry filled by
+// VoxelizedNuclearDNA on the master thread & read by the scorers on all threads, which use it to
+// find the nucleus of a step. The layout also holds the logical volume of the whole component, which
+// a scorer can place in a navigator of its own to locate points in the component frame.
+//**************************************************************************************************
+
+#ifndef NUCLEUSLAYOUT_HH
+#define NUCLEUSLAYOUT_HH
+
+#include "G4ThreeVector.hh"
+#include "G4String.hh"
+
+#include <map>
+#include <vector>
+
+class TsParameterManager;
+class G4LogicalVolume;
+class G4VTouchable;
+
+class NucleusLayout
+{
+public:
+    //----------------------------------------------------------------------------------------------
+    // Return the centres of the nuclei of a component, in the component frame, from its parameters:
+    //   dv:Ge/<component>/NucleusCentres = 3N x1 y1 z1 ... xN yN zN <unit>
+    // or else a lattice centred on the component origin:
+    //   iv:Ge/<component>/NucleusLattice = 3 nX nY nZ (default 1 1 1)
+    //   d:Ge/<component>/NucleusLatticePitch (default: the nucleus side length)
+    // Exit if the list is malformed or if two nuclei (cubes of the given half length) overlap.
+    //----------------------------------------------------------------------------------------------
+    static std::vector<G4ThreeVector> ReadCentres(TsParameterManager* pm, const G4String& componentName,
+                                                  G4double nucleusHalfLength);
+
+    //----------------------------------------------------------------------------------------------
+    // Return the layout of the given geometry component, creating an empty one if needed. The
+    // registry owns the layouts, so the returned pointer remains valid for the whole session,
+    // including across geometry rebuilds.
+    //----------------------------------------------------------------------------------------------
+    static NucleusLayout* GetInstance(const G4String& componentName);
+
+    //----------------------------------------------------------------------------------------------
+    // Return the layout of the given geometry component, or NULL if the component has not been
+    // built.
+    //----------------------------------------------------------------------------------------------
+    static const NucleusLayout* Find(const G4String& componentName);
+
+    //----------------------------------------------------------------------------------------------
+    // Set the centres & the logical volume placed at each of them (copy number = nucleus index).
+    //----------------------------------------------------------------------------------------------
+    void Reset(const std::vector<G4ThreeVector>& centres, G4double nucleusHalfLength,
+               G4LogicalVolume* nucleusVolume);
+
+    //----------------------------------------------------------------------------------------------
+    // Set the logical volume of the component (the envelope enclosing all nuclei)
+    //----------------------------------------------------------------------------------------------
+    void SetComponentVolume(G4LogicalVolume* componentVolume) {fComponentVolume = componentVolume;}
+
+    //----------------------------------------------------------------------------------------------
+    // Return the index of the nucleus containing the volume of a touchable, or -1 if the volume is
+    // not inside a nucleus (e.g. the water between nuclei).
+    //----------------------------------------------------------------------------------------------
+    G4int Locate(const G4VTouchable* touchable) const;
+
+    //----------------------------------------------------------------------------------------------
+    // Half lengths of the box enclosing all nuclei, centred on the component origin
+    //----------------------------------------------------------------------------------------------
+    G4ThreeVector GetEnclosingHalfLengths() const;
+
+    //----------------------------------------------------------------------------------------------
+    // Getters
+    //----------------------------------------------------------------------------------------------
+    G4int GetNumberOfNuclei() const {return (G4int)fCentres.size();}
+    const G4ThreeVector& GetCentre(G4int nucleus) const {return fCentres[nucleus];}
+    G4double GetNucleusHalfLength() const {return fNucleusHalfLength;}
+    G4LogicalVolume* GetComponentVolume() const {return fComponentVolume;}
+
+private:
+    NucleusLayout();
+
+    ~NucleusLayout();
+
+    static std::map<G4String, NucleusLayout*>& GetRegistry();
+
+    std::vector<G4ThreeVector> fCentres;
+    G4double fNucleusHalfLength;
+    G4LogicalVolume* fNucleusVolume;
+    G4LogicalVolume* fComponentVolume;
+};
+
+#endif // NUCLEUSLAYOUT_HH
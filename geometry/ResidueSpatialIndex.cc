@@ -0,0 +1,219 @@
+// Extra Class for VoxelizedNuclearDNA
+//
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class is a uniform-grid spatial index over the centres of the DNA residue spheres in a single
+// chromatin fiber. Points are binned into cubic cells (stored contiguously, cell by cell) so that
+// all residues within a given distance of a point can be found by visiting only the few cells
+// surrounding it, rather than every residue in the fiber.
+//**************************************************************************************************
+
+#include "ResidueSpatialIndex.hh"
+
+#include "G4SystemOfUnits.hh"
+
+#include <algorithm>
+#include <cmath>
+
+//--------------------------------------------------------------------------------------------------
+// Constructor
+//--------------------------------------------------------------------------------------------------
+ResidueSpatialIndex::ResidueSpatialIndex()
+    : fCellSize(1.*nm), fCoordinates(NULL), fStride(3), fNumPoints(0), fCellStart(NULL), fSortedIndices(NULL)
+{
+    for (G4int k=0; k<3; ++k) {
+        fLowerEdge[k] = 0.;
+        fNumCells[k] = 1;
+    }
+    fOwnedCellStart.assign(2, 0);
+    fCellStart = fOwnedCellStart.data();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Destructor
+//--------------------------------------------------------------------------------------------------
+ResidueSpatialIndex::~ResidueSpatialIndex()
+{}
+
+//--------------------------------------------------------------------------------------------------
+// Copy the points, then bin them.
+//--------------------------------------------------------------------------------------------------
+void ResidueSpatialIndex::Build(const std::vector<G4ThreeVector>& points, G4double cellSize)
+{
+    fOwnedCoordinates.resize(3*points.size());
+    for (size_t i=0; i<points.size(); ++i) {
+        fOwnedCoordinates[3*i] = points[i].x();
+        fOwnedCoordinates[3*i+1] = points[i].y();
+        fOwnedCoordinates[3*i+2] = points[i].z();
+    }
+    fCoordinates = fOwnedCoordinates.data();
+    fStride = 3;
+    fNumPoints = (G4int)points.size();
+    BuildCells(cellSize);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Bin points stored elsewhere.
+//--------------------------------------------------------------------------------------------------
+void ResidueSpatialIndex::Build(const G4double* coordinates, G4int stride, G4int numPoints, G4double cellSize)
+{
+    std::vector<G4double>().swap(fOwnedCoordinates);
+    fCoordinates = coordinates;
+    fStride = stride;
+    fNumPoints = numPoints;
+    BuildCells(cellSize);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Point at an index built elsewhere. The grid is the cell size, the lower edge & the number of
+// cells along each axis.
+//--------------------------------------------------------------------------------------------------
+void ResidueSpatialIndex::Attach(const G4double* coordinates, G4int stride, G4int numPoints,
+                                 const G4double* grid, const G4int* cellStart, const G4int* sortedIndices)
+{
+    std::vector<G4double>().swap(fOwnedCoordinates);
+    std::vector<G4int>().swap(fOwnedCellStart);
+    std::vector<G4int>().swap(fOwnedSortedIndices);
+
+    fCoordinates = coordinates;
+    fStride = stride;
+    fNumPoints = numPoints;
+    fCellSize = grid[0];
+    for (G4int k=0; k<3; ++k) {
+        fLowerEdge[k] = grid[1+k];
+        fNumCells[k] = (G4int)grid[4+k];
+    }
+    fCellStart = cellStart;
+    fSortedIndices = sortedIndices;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Write the grid in the order read by Attach().
+//--------------------------------------------------------------------------------------------------
+void ResidueSpatialIndex::GetGrid(G4double* grid) const
+{
+    grid[0] = fCellSize;
+    for (G4int k=0; k<3; ++k) {
+        grid[1+k] = fLowerEdge[k];
+        grid[4+k] = fNumCells[k];
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Bin all points into cells of side cellSize. This is a counting sort: count the points in each
+// cell, convert counts into start offsets, then scatter point indices into their cell's range.
+//--------------------------------------------------------------------------------------------------
+void ResidueSpatialIndex::BuildCells(G4double cellSize)
+{
+    fCellSize = cellSize;
+    fOwnedCellStart.clear();
+    fOwnedSortedIndices.clear();
+
+    if (fNumPoints == 0 || fCellSize <= 0.) {
+        for (G4int k=0; k<3; ++k) {
+            fLowerEdge[k] = 0.;
+            fNumCells[k] = 1;
+        }
+        fNumPoints = 0;
+        fOwnedCellStart.assign(2, 0);
+        fCellStart = fOwnedCellStart.data();
+        fSortedIndices = fOwnedSortedIndices.data();
+        return;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // Determine the bounding box of all points and the number of cells along each axis
+    //----------------------------------------------------------------------------------------------
+    G4double lower[3] = {fCoordinates[0], fCoordinates[1], fCoordinates[2]};
+    G4double upper[3] = {fCoordinates[0], fCoordinates[1], fCoordinates[2]};
+    for (G4int i=1; i<fNumPoints; ++i) {
+        const G4double* point = fCoordinates + (size_t)i*fStride;
+        for (G4int k=0; k<3; ++k) {
+            lower[k] = std::min(lower[k], point[k]);
+            upper[k] = std::max(upper[k], point[k]);
+        }
+    }
+    for (G4int k=0; k<3; ++k) {
+        fLowerEdge[k] = lower[k];
+        fNumCells[k] = (G4int)std::floor((upper[k]-lower[k])/fCellSize) + 1;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // Counting sort of point indices by cell
+    //----------------------------------------------------------------------------------------------
+    G4int numCellsTotal = GetNumberOfCells();
+    fOwnedCellStart.assign(numCellsTotal+1, 0);
+
+    std::vector<G4int> cellOfPoint(fNumPoints);
+    for (G4int i=0; i<fNumPoints; ++i) {
+        const G4double* point = fCoordinates + (size_t)i*fStride;
+        G4int ix = GetCellIndex(point[0], fLowerEdge[0], fNumCells[0]);
+        G4int iy = GetCellIndex(point[1], fLowerEdge[1], fNumCells[1]);
+        G4int iz = GetCellIndex(point[2], fLowerEdge[2], fNumCells[2]);
+        cellOfPoint[i] = GetFlatIndex(ix, iy, iz);
+        fOwnedCellStart[cellOfPoint[i]+1]++;
+    }
+    for (G4int c=0; c<numCellsTotal; ++c)
+        fOwnedCellStart[c+1] += fOwnedCellStart[c];
+
+    fOwnedSortedIndices.resize(fNumPoints);
+    std::vector<G4int> fillPosition(fOwnedCellStart.begin(), fOwnedCellStart.end()-1);
+    for (G4int i=0; i<fNumPoints; ++i)
+        fOwnedSortedIndices[fillPosition[cellOfPoint[i]]++] = i;
+
+    fCellStart = fOwnedCellStart.data();
+    fSortedIndices = fOwnedSortedIndices.data();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Fill neighbours with the indices of all points within distance radius of position. Only the cells
+// overlapping the bounding cube of the search sphere are visited.
+//--------------------------------------------------------------------------------------------------
+G4int ResidueSpatialIndex::FindNeighbours(const G4ThreeVector& position, G4double radius,
+                                          std::vector<G4int>& neighbours) const
+{
+    neighbours.clear();
+    if (fNumPoints == 0) return 0;
+
+    G4double coords[3] = {position.x(), position.y(), position.z()};
+    G4int lowCell[3];
+    G4int highCell[3];
+    for (G4int k=0; k<3; ++k) {
+        // Skip entirely if the search sphere does not reach the indexed region along this axis
+        G4double upperEdge = fLowerEdge[k] + fNumCells[k]*fCellSize;
+        if (coords[k]+radius < fLowerEdge[k] || coords[k]-radius > upperEdge) return 0;
+        lowCell[k] = GetCellIndex(coords[k]-radius, fLowerEdge[k], fNumCells[k]);
+        highCell[k] = GetCellIndex(coords[k]+radius, fLowerEdge[k], fNumCells[k]);
+    }
+
+    G4double radius2 = radius*radius;
+    for (G4int iz=lowCell[2]; iz<=highCell[2]; ++iz) {
+        for (G4int iy=lowCell[1]; iy<=highCell[1]; ++iy) {
+            for (G4int ix=lowCell[0]; ix<=highCell[0]; ++ix) {
+                G4int cell = GetFlatIndex(ix, iy, iz);
+                for (G4int s=fCellStart[cell]; s<fCellStart[cell+1]; ++s) {
+                    G4int index = fSortedIndices[s];
+                    const G4double* point = fCoordinates + (size_t)index*fStride;
+                    G4double dx = point[0] - coords[0];
+                    G4double dy = point[1] - coords[1];
+                    G4double dz = point[2] - coords[2];
+                    if (dx*dx + dy*dy + dz*dz <= radius2)
+                        neighbours.push_back(index);
+                }
+            }
+        }
+    }
+    return (G4int)neighbours.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Convert a coordinate to a cell index along one axis, clamped to the valid range.
+//--------------------------------------------------------------------------------------------------
+G4int ResidueSpatialIndex::GetCellIndex(G4double coordinate, G4double lowerEdge, G4int numCells) const
+{
+    G4int index = (G4int)std::floor((coordinate-lowerEdge)/fCellSize);
+    if (index < 0) return 0;
+    if (index >= numCells) return numCells-1;
+    return index;
+}
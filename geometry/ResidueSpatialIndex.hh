@@ -0,0 +1,99 @@
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class is a uniform-grid spatial index over the centres of the DNA residue spheres in a single
+// chromatin fiber. Points are binned into cubic cells (stored contiguously, cell by cell) so that
+// all residues within a given distance of a point can be found by visiting only the few cells
+// surrounding it, rather than every residue in the fiber.
+//**************************************************************************************************
+
+#ifndef RESIDUESPATIALINDEX_HH
+#define RESIDUESPATIALINDEX_HH
+
+#include "G4ThreeVector.hh"
+
+#include <vector>
+
+class ResidueSpatialIndex
+{
+public:
+    // Number of values describing the grid, as written by GetGrid() & read by Attach()
+    static const G4int kGridSize = 7;
+
+    ResidueSpatialIndex();
+
+    ~ResidueSpatialIndex();
+
+    //----------------------------------------------------------------------------------------------
+    // Bin all points into cells of side cellSize. Any previously built index is discarded. The
+    // indices returned by FindNeighbours() refer to positions in the points vector, which is copied.
+    //----------------------------------------------------------------------------------------------
+    void Build(const std::vector<G4ThreeVector>& points, G4double cellSize);
+
+    //----------------------------------------------------------------------------------------------
+    // Same, for numPoints points whose x, y & z are at coordinates[i*stride]. The coordinates are
+    // not copied: they must remain valid until the index is rebuilt or destroyed.
+    //----------------------------------------------------------------------------------------------
+    void Build(const G4double* coordinates, G4int stride, G4int numPoints, G4double cellSize);
+
+    //----------------------------------------------------------------------------------------------
+    // Use an index built elsewhere, e.g. stored in a mapped FiberTemplateFile: the grid written by
+    // GetGrid() & the arrays returned by GetCellStart() & GetSortedIndices(). Nothing is copied.
+    //----------------------------------------------------------------------------------------------
+    void Attach(const G4double* coordinates, G4int stride, G4int numPoints, const G4double* grid,
+                const G4int* cellStart, const G4int* sortedIndices);
+
+    //----------------------------------------------------------------------------------------------
+    // Fill neighbours with the indices of all points within distance radius of position. The
+    // neighbours vector is cleared first. Returns the number of neighbours found.
+    //----------------------------------------------------------------------------------------------
+    G4int FindNeighbours(const G4ThreeVector& position, G4double radius,
+                         std::vector<G4int>& neighbours) const;
+
+    //----------------------------------------------------------------------------------------------
+    // Getters. The cell arrays hold GetNumberOfCells()+1 & GetNumberOfPoints() elements.
+    //----------------------------------------------------------------------------------------------
+    G4int GetNumberOfPoints() const {return fNumPoints;}
+    G4double GetCellSize() const {return fCellSize;}
+    G4int GetNumberOfCells() const {return fNumCells[0]*fNumCells[1]*fNumCells[2];}
+    void GetGrid(G4double* grid) const;
+    const G4int* GetCellStart() const {return fCellStart;}
+    const G4int* GetSortedIndices() const {return fSortedIndices;}
+
+private:
+    // Not copyable: the index may point at its own arrays
+    ResidueSpatialIndex(const ResidueSpatialIndex&);
+    ResidueSpatialIndex& operator=(const ResidueSpatialIndex&);
+
+    //----------------------------------------------------------------------------------------------
+    // Bin the points in fCoordinates into the owned cell arrays.
+    //----------------------------------------------------------------------------------------------
+    void BuildCells(G4double cellSize);
+
+    //----------------------------------------------------------------------------------------------
+    // Helper functions to convert a coordinate to a cell index along one axis, and a 3D cell index
+    // to the flattened index used for fCellStart.
+    //----------------------------------------------------------------------------------------------
+    G4int GetCellIndex(G4double coordinate, G4double lowerEdge, G4int numCells) const;
+    G4int GetFlatIndex(G4int ix, G4int iy, G4int iz) const {return ix + fNumCells[0]*(iy + fNumCells[1]*iz);}
+
+    G4double fCellSize;
+    G4double fLowerEdge[3];
+    G4int fNumCells[3];
+
+    // Point i is at fCoordinates[i*fStride] (x, y, z)
+    const G4double* fCoordinates;
+    G4int fStride;
+    G4int fNumPoints;
+
+    // Points sorted by cell. Cell c holds fSortedIndices[fCellStart[c]] to fSortedIndices[fCellStart[c+1]-1]
+    const G4int* fCellStart;
+    const G4int* fSortedIndices;
+
+    // Arrays owned by the index. Unused for what is attached or built on external coordinates.
+    std::vector<G4double> fOwnedCoordinates;
+    std::vector<G4int> fOwnedCellStart;
+    std::vector<G4int> fOwnedSortedIndices;
+};
+
+#endif // RESIDUESPATIALINDEX_HH
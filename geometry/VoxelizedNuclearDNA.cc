@@ -13,6 +13,9 @@
 
 #include "VoxelizedNuclearDNA.hh"
 #include "GeoCalculationV2.hh"
+#include "DNAFiberTemplate.hh"
+#include "FiberTemplateFile.hh"
+#include "NucleusLayout.hh"
 
 #include "TsParameterManager.hh"
 
@@ -26,6 +29,7 @@
 
 #include "G4Box.hh"
 #include "G4PVPlacement.hh"
+#include "G4PVReplica.hh"
 #include "G4RotationMatrix.hh"
 #include "G4SubtractionSolid.hh"
 #include "G4UnionSolid.hh"
@@ -35,23 +39,14 @@
 #include "G4VisAttributes.hh"
 #include "G4Colour.hh"
 #include "G4Exception.hh"
+#include <algorithm>
 #include <chrono>
+#include <iomanip>
+#include <sstream>
 
 
-//--------------------------------------------------------------------------------------------------
-// Structure containting coordinates of volumes in a DNA base pair.
-// Identical to the definition in GeoCalculation.
-//--------------------------------------------------------------------------------------------------
-struct DNAPlacementData
-{
-    G4ThreeVector posCenterDNA;
-    G4ThreeVector posSugarTMP1;
-    G4ThreeVector posSugarTHF1;
-    G4ThreeVector posBase1;
-    G4ThreeVector posBase2;
-    G4ThreeVector posSugarTHF2;
-    G4ThreeVector posSugarTMP2;
-};
+// Residue cut planes, per fiber model (see GetFiberModelKey())
+std::map<G4String, ResidueCutPlaneTable> VoxelizedNuclearDNA::fCutPlaneCache;
 
 
 //--------------------------------------------------------------------------------------------------
@@ -69,13 +64,26 @@ TsVGeometryComponent(pM, eM, mM, gM, parentComponent, parentVolume, name)
 
     //----------------------------------------------------------------------------------------------
     // A GeoCalculation object is used set various parameters for the configuration of DNA content
-    // in single chromatin fiber.
+    // in single chromatin fiber. The fiber model must be set before initialization.
     //----------------------------------------------------------------------------------------------
-    fFiberRadius = 17.*nm;
-    fFiberHalfLength = 68.*nm;
+    fGeoCalculation->SetFiberModel(fFiberModel);
+    fGeoCalculation->SetFiberNbNuclPerTurn(fFiberNbNuclPerTurn);
+    fGeoCalculation->SetFiberPitch(fFiberPitch);
+    fGeoCalculation->SetFiberCentralRadius(fFiberCentralRadius);
+    fGeoCalculation->SetLinkerNumBp(fLinkerNumBp);
 
     fGeoCalculation->Initialize();
 
+    // By default, use all bp of each nucleosome (i.e. incl. the full linker)
+    if (fNumBpPerNucleosome == -1)
+        fNumBpPerNucleosome = fGeoCalculation->GetBpNum();
+    else if (fNumBpPerNucleosome > fGeoCalculation->GetBpNum()) {
+        G4cerr << "VoxelizedNuclearDNA, Fatal Error. DnaNumBpPerNucleosome (" << fNumBpPerNucleosome
+               << ") exceeds the number of bp per nucleosome of the fiber model ("
+               << fGeoCalculation->GetBpNum() << ")." << G4endl;
+        std::exit(EXIT_FAILURE);
+    }
+
     fBaseRadius = fGeoCalculation->GetBaseRadius();
     fBaseRadiusWater = fGeoCalculation->GetBaseRadiusWater();
     fSugarTMPRadius = fGeoCalculation->GetSugarTMPRadius();
@@ -108,6 +116,10 @@ VoxelizedNuclearDNA::~VoxelizedNuclearDNA()
      delete fGeoCalculation;
 
      delete fpDnaMoleculePositions;
+
+     // The fiber template may point into the mapped template file
+     if (fTemplateFile.IsOpen())
+         DNAFiberTemplate::GetInstance(fName)->Reset(fFiberRadius, fFiberHalfLength);
 }
 
 
@@ -119,13 +131,82 @@ void VoxelizedNuclearDNA::ResolveParameters() {
     if (fPm->ParameterExists(GetFullParmName("DNANumBpPerNucleosome")))
         fNumBpPerNucleosome = fPm->GetIntegerParameter(GetFullParmName("DNANumBpPerNucleosome"));
     else
-        fNumBpPerNucleosome = 200;
+        fNumBpPerNucleosome = -1; // i.e. all bp of the fiber model, set once GeoCalculation is initialized
 
     if (fPm->ParameterExists(GetFullParmName("DnaNumNucleosomePerFiber")))
         fNumNucleosomePerFiber = fPm->GetIntegerParameter(GetFullParmName("DnaNumNucleosomePerFiber"));
     else
         fNumNucleosomePerFiber = 90;
 
+    //----------------------------------------------------------------------------------------------
+    // Chromatin fiber model. Defaults correspond to the solenoid of Meylan et al. (2017).
+    //----------------------------------------------------------------------------------------------
+    if (fPm->ParameterExists(GetFullParmName("FiberModel")))
+        fFiberModel = fPm->GetStringParameter(GetFullParmName("FiberModel"));
+    else
+        fFiberModel = "Solenoid";
+
+    if (fPm->ParameterExists(GetFullParmName("FiberNbNuclPerTurn")))
+        fFiberNbNuclPerTurn = fPm->GetUnitlessParameter(GetFullParmName("FiberNbNuclPerTurn"));
+    else
+        fFiberNbNuclPerTurn = 6;
+
+    if (fPm->ParameterExists(GetFullParmName("FiberPitch")))
+        fFiberPitch = fPm->GetDoubleParameter(GetFullParmName("FiberPitch"),"Length");
+    else
+        fFiberPitch = 8.5*nm;
+
+    if (fPm->ParameterExists(GetFullParmName("FiberCentralRadius")))
+        fFiberCentralRadius = fPm->GetDoubleParameter(GetFullParmName("FiberCentralRadius"),"Length");
+    else
+        fFiberCentralRadius = 10.46*nm;
+
+    if (fPm->ParameterExists(GetFullParmName("LinkerNumBp")))
+        fLinkerNumBp = fPm->GetIntegerParameter(GetFullParmName("LinkerNumBp"));
+    else
+        fLinkerNumBp = 46;
+
+    if (fPm->ParameterExists(GetFullParmName("FiberRadius")))
+        fFiberRadius = fPm->GetDoubleParameter(GetFullParmName("FiberRadius"),"Length");
+    else
+        fFiberRadius = 17.*nm;
+
+    if (fPm->ParameterExists(GetFullParmName("FiberHalfLength")))
+        fFiberHalfLength = fPm->GetDoubleParameter(GetFullParmName("FiberHalfLength"),"Length");
+    else
+        fFiberHalfLength = 68.*nm;
+
+    //----------------------------------------------------------------------------------------------
+    // Fiber proxy: fibers are homogeneous cylinders of DNA-equivalent material for transport, and
+    // the scorer attributes energy depositions to residues using a DNAFiberTemplate.
+    //----------------------------------------------------------------------------------------------
+    if (fPm->ParameterExists(GetFullParmName("UseFiberProxy")))
+        fUseFiberProxy = fPm->GetBooleanParameter(GetFullParmName("UseFiberProxy"));
+    else
+        fUseFiberProxy = false;
+
+    if (fPm->ParameterExists(GetFullParmName("FiberProxyMaterialName")))
+        fFiberProxyMaterialName = fPm->GetStringParameter(GetFullParmName("FiberProxyMaterialName"));
+    else
+        fFiberProxyMaterialName = "G4_WATER_FIBER_PROXY";
+
+    // The template is also built for full fibers if requested (e.g. for the IRT chemistry of the
+    // scorer). It is always built for proxy fibers.
+    if (fPm->ParameterExists(GetFullParmName("BuildFiberTemplate")))
+        fBuildFiberTemplate = fPm->GetBooleanParameter(GetFullParmName("BuildFiberTemplate"));
+    else
+        fBuildFiberTemplate = false;
+    fBuildFiberTemplate = fBuildFiberTemplate || fUseFiberProxy;
+
+    //----------------------------------------------------------------------------------------------
+    // Fiber template file: residue positions & cut planes are computed by the first process on this
+    // node & read from the file by the others. Empty (default) to compute them in every process.
+    //----------------------------------------------------------------------------------------------
+    if (fPm->ParameterExists(GetFullParmName("FiberTemplateFile")))
+        fFiberTemplateFileName = fPm->GetStringParameter(GetFullParmName("FiberTemplateFile"));
+    else
+        fFiberTemplateFileName = "";
+
     if (fPm->ParameterExists(GetFullParmName("CutVolumes")))
         fCutVolumes = fPm->GetBooleanParameter(GetFullParmName("CutVolumes"));
     else
@@ -156,6 +237,12 @@ void VoxelizedNuclearDNA::ResolveParameters() {
     else
         fVoxelSideLength = 250*nm;
 
+    // Nuclei of a cell population. A single nucleus is always built at the origin.
+    if (fBuildNucleus)
+        fNucleusCentres = NucleusLayout::ReadCentres(fPm, fName, fNumVoxelsPerSide*fVoxelSideLength);
+    if (fNucleusCentres.size() <= 1)
+        fNucleusCentres.assign(1, G4ThreeVector());
+
     if (fPm->ParameterExists(GetFullParmName("DNAMaterialName")))
         fDNAMaterialName = fPm->GetStringParameter(GetFullParmName("DNAMaterialName"));
     else
@@ -169,6 +256,18 @@ void VoxelizedNuclearDNA::ResolveParameters() {
     fCheckForOverlaps = fPm->GetBooleanParameter("Ge/CheckForOverlaps");
     fOverlapsResolution = fPm->GetIntegerParameter("Ge/CheckForOverlapsResolution");
     fQuitIfOverlap = fPm->GetBooleanParameter("Ge/QuitIfOverlapDetected");
+
+    // Analytic overlap verification of the fiber contents. Replaces the (very slow) Geant4 overlap
+    // check of each residue & histone placement when enabled.
+    if (fPm->ParameterExists(GetFullParmName("CheckForOverlapsAnalytically")))
+        fCheckForOverlapsAnalytically = fPm->GetBooleanParameter(GetFullParmName("CheckForOverlapsAnalytically"));
+    else
+        fCheckForOverlapsAnalytically = false;
+
+    if (fPm->ParameterExists(GetFullParmName("NumOverlapsToReport")))
+        fNumOverlapsToReport = fPm->GetIntegerParameter(GetFullParmName("NumOverlapsToReport"));
+    else
+        fNumOverlapsToReport = 10;
 }
 
 
@@ -181,26 +280,42 @@ G4VPhysicalVolume* VoxelizedNuclearDNA::Construct()
 	BeginConstruction();
 
     //----------------------------------------------------------------------------------------------
-    // Construct the envelope (wrapper) volume.
+    // Construct the envelope (wrapper) volume. With several nuclei, it encloses all of them.
     //----------------------------------------------------------------------------------------------
-    G4double envelopeSideLength = fNumVoxelsPerSide * fVoxelSideLength;
-    G4Box* sWrapper = new G4Box("solid_wrapper", envelopeSideLength, envelopeSideLength, envelopeSideLength);
+    G4double nucleusHalfLength = fNumVoxelsPerSide * fVoxelSideLength;
+    NucleusLayout* nucleusLayout = NucleusLayout::GetInstance(fName);
+    nucleusLayout->Reset(fNucleusCentres, nucleusHalfLength, NULL);
+    G4ThreeVector envelopeHalfLengths = nucleusLayout->GetEnclosingHalfLengths();
+    G4Box* sWrapper = new G4Box("solid_wrapper", envelopeHalfLengths.x(), envelopeHalfLengths.y(), envelopeHalfLengths.z());
     fEnvelopeLog = CreateLogicalVolume(sWrapper);
     fEnvelopePhys = CreatePhysicalVolume(fEnvelopeLog);
+    nucleusLayout->SetComponentVolume(fEnvelopeLog);
 
     //----------------------------------------------------------------------------------------------
     // Construct the logical volume for a single chromatin fiber.
     //----------------------------------------------------------------------------------------------
-    G4LogicalVolume* lFiber = BuildLogicFiber(fGeoCalculation->GetAllDNAVolumePositions(),
-        fGeoCalculation->GetNucleosomePosition(),
+    G4LogicalVolume* lFiber = BuildLogicFiber(fGeoCalculation->GetBasisPositions(),
         fGeoCalculation->GetPosAndRadiusMap());
 
     //----------------------------------------------------------------------------------------------
-    // Construct physical volume for the DNA. Either a voxelized nucleus containing many fibers or a
-    // single fiber. Place in the outermost physical volume for this custom component (i.e. in
-    // fEnvelopePhys).
+    // Construct physical volume for the DNA. Either a population of identical voxelized nuclei, a
+    // single voxelized nucleus containing many fibers or a single fiber. Place in the outermost
+    // physical volume for this custom component (i.e. in fEnvelopePhys).
     //----------------------------------------------------------------------------------------------
-    if (fBuildNucleus) {
+    if (fBuildNucleus && fNucleusCentres.size() > 1) {
+        //------------------------------------------------------------------------------------------
+        // Population of nuclei: place the same logical nucleus at each centre. The copy number of
+        // a placement is the index of the nucleus, used by the scorer (see NucleusLayout).
+        //------------------------------------------------------------------------------------------
+        G4LogicalVolume* nucleusLogical = ConstructLogicalNucleus(ConstructLogicalVoxel(lFiber));
+        for (size_t i=0; i<fNucleusCentres.size(); ++i) {
+            G4ThreeVector nucleusPlacement = fNucleusCentres[i];
+            CreatePhysicalVolume("Nucleus",i,true,nucleusLogical,new G4RotationMatrix(),&nucleusPlacement,fEnvelopeLog);
+        }
+        nucleusLayout->Reset(fNucleusCentres, nucleusHalfLength, nucleusLogical);
+        G4cout << "VoxelizedNuclearDNA: " << fNucleusCentres.size() << " nuclei share the DNA volumes of one nucleus." << G4endl;
+    }
+    else if (fBuildNucleus) {
         G4LogicalVolume* voxelLogical = ConstructLogicalVoxel(lFiber);
 
         //------------------------------------------------------------------------------------------
@@ -240,14 +355,13 @@ G4VPhysicalVolume* VoxelizedNuclearDNA::Construct()
 
 //--------------------------------------------------------------------------------------------------
 // Create and return a logical volume for a chromatin fiber.
-// Within this logical volume are the physical volumes for the histones, the resiudes and their
-// hydration shells. Solids and logicals are generated for the histones within this metohd directly,
+// Within this logical volume are the physical volumes for the histones and the resiudes. Solids
+// and logicals are generated for the histones within this metohd directly,
 // whereas those for the residues are generated using CreateNucleosomeCuttedSolidsAndLogicals().
 // A map, fpDnaMoleculePositions, containing the coordinates for all residues and histones is filled
 // and can be accessed using GetDNAMoleculesPositions().
 //--------------------------------------------------------------------------------------------------
-G4LogicalVolume* VoxelizedNuclearDNA::BuildLogicFiber(std::vector<std::vector<DNAPlacementData> >* dnaVolPos,
-                                            std::vector<G4ThreeVector>* posNucleo,
+G4LogicalVolume* VoxelizedNuclearDNA::BuildLogicFiber(const DNAPositionBuffer* basisPositions,
                                             std::map<G4ThreeVector, G4double>* posAndRadiusMap)
 {
     //----------------------------------------------------------------------------------------------
@@ -265,16 +379,50 @@ G4LogicalVolume* VoxelizedNuclearDNA::BuildLogicFiber(std::vector<std::vector<DN
     //----------------------------------------------------------------------------------------------
     G4Tubs* solidFiber = new G4Tubs("solid_fiber", 0., fFiberRadius, fFiberHalfLength, 0, 360);
 
+    // A proxy fiber is filled with a homogeneous DNA-equivalent material instead of DNA volumes
+    G4String fiberMaterialName = fUseFiberProxy ? fFiberProxyMaterialName : fWaterName;
+
     G4LogicalVolume* logicFiber;
     if (fUseG4Volumes) {
-        logicFiber = new G4LogicalVolume(solidFiber,fWater,"Fiber");
+        logicFiber = new G4LogicalVolume(solidFiber,GetMaterial(fiberMaterialName),"Fiber");
     }
     else {
-        logicFiber = CreateLogicalVolume("Fiber",fWaterName,solidFiber);
+        logicFiber = CreateLogicalVolume("Fiber",fiberMaterialName,solidFiber);
     }
 
     // If not building DNA in the fiber, return now with empty fiber (for visualization of large geometries)
-    if (!fFillFibersWithDNA) {
+    if (!fFillFibersWithDNA && !fUseFiberProxy) {
+        return logicFiber;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // Calculate the planes used to cut the residues of the template nucleosome.
+    //----------------------------------------------------------------------------------------------
+    // For the positions, only use the middle nucleosome of the basis (the template: index=4 for
+    // the default solenoid). Every nucleosome it can touch is present in the basis on both sides,
+    // so its residues will be cut to allow for proper linking of one nucleosome to the next & for
+    // nucleosomes stacked above & below it. Note basisPositions contains all nucleotide positions
+    // around the basis histone complexes (9 for the default solenoid), as generated by
+    // GeoCalculation. Note posAndRadiusMap is the output of GeoCalculation's
+    // GenerateCoordAndRadiusMap() method. I.e. a map of radii for 6 residue volumes in each bp of
+    // each basis nucleosome (10800 volumes for the default solenoid)
+    //
+    // Then generate the positions of all residue & histone volumes in the fiber. Nucleosome i of
+    // the fiber is nucleosome i of the fiber helix, shifted such that fiber helix construction
+    // begins at one end of the fiber. The template nucleosome of the basis (index=templateIndex) is
+    // identical to the nucleosome of the same index in the fiber, prior to the shift.
+    //----------------------------------------------------------------------------------------------
+    G4int templateIndex = fGeoCalculation->GetBasisTemplateIndex();
+    DNAPositionBuffer fiberPositions;
+    PrepareFiberData(basisPositions, templateIndex, posAndRadiusMap,
+                     -solidFiber->GetDz() + fHistoneHeight, &fiberPositions);
+    CheckFiberContents(fiberPositions);
+
+    // Save the residue geometry for the scorer. For a proxy fiber, no DNA volumes are placed.
+    if (fBuildFiberTemplate) {
+        BuildFiberTemplate(fiberPositions, templateIndex, logicFiber);
+    }
+    if (fUseFiberProxy) {
         return logicFiber;
     }
 
@@ -294,73 +442,24 @@ G4LogicalVolume* VoxelizedNuclearDNA::BuildLogicFiber(std::vector<std::vector<DN
     //----------------------------------------------------------------------------------------------
     // Generate logical volumes for the nucleotide base pairs.
     //----------------------------------------------------------------------------------------------
-    // For the positions, only use the nucleosome #2 (index=1). It is a "middle" nucleosome and
-    // thus, the two extremities will be cut to allow for  proper linking of one nucleosome to the
-    // next. Note dnaVolPos is essentially the output of GeoCalculation's CalculateDNAPosition()
-    // method.  I.e. all nucleotide positions around 3 basis histone complexes.
-    std::vector<DNAPlacementData>* nuclVolPos = &dnaVolPos->at(1);
-
-    // Create all the DNA volumes (solid & logical) around the histone based on nucleosome #2
-    // (index=1) positions. Place this nucleosome several times to build the fiber. This is done to
-    // save memory and improve speed. Logical volumes are saved a map (key = name of the volume
-    // [e.g. sugar1], value = vector of corresponding logical volumes). Note posAndRadiusMap is the
-    // output of GeoCalculation's GenerateCoordAndRadiusMap() method. I.e. a map of radii for 6
-    // residue volumes in each of 200 bp in each of 3 basis nucleosomes (3600 volumes)
-    std::map<G4String, std::vector<G4LogicalVolume*> >* volMap
-            = CreateNucleosomeCuttedSolidsAndLogicals(nuclVolPos, posAndRadiusMap);
-    // The resulting volMap is indexed by one of 12 entries (6 residues & 6 hydration shells). Each
-    // entry has 200 elements, each corresponding to a distinct logical volume
-
-    //----------------------------------------------------------------------------------------------
-    // Save the positions of all residue volumes in nucleosome #2 in vectors
-    //----------------------------------------------------------------------------------------------
-    G4ThreeVector posSugarTMP1;
-    G4ThreeVector posSugarTHF1;
-    G4ThreeVector posBase1;
-    G4ThreeVector posBase2;
-    G4ThreeVector posSugarTHF2;
-    G4ThreeVector posSugarTMP2;
-    std::vector<G4ThreeVector> posSugarTMP1Vect;
-    std::vector<G4ThreeVector> posSugarTHF1Vect;
-    std::vector<G4ThreeVector> posBase1Vect;
-    std::vector<G4ThreeVector> posBase2Vect;
-    std::vector<G4ThreeVector> posSugarTHF2Vect;
-    std::vector<G4ThreeVector> posSugarTMP2Vect;
-
-    // Get the bp volume positions of the middle basis nucleosome (which is used to generate cut
-    // solids) and save in a vector to be accessed & rotated in the following forloop
-    for(int j=0;j<fNumBpPerNucleosome;++j)
-    {
-        posSugarTMP1 = dnaVolPos->at(1)[j].posSugarTMP1;
-        posSugarTHF1 = dnaVolPos->at(1)[j].posSugarTHF1;
-        posBase1 = dnaVolPos->at(1)[j].posBase1;
-        posBase2 = dnaVolPos->at(1)[j].posBase2;
-        posSugarTHF2 = dnaVolPos->at(1)[j].posSugarTHF2;
-        posSugarTMP2 = dnaVolPos->at(1)[j].posSugarTMP2;
-
-        posSugarTMP1Vect.push_back(posSugarTMP1);
-        posSugarTHF1Vect.push_back(posSugarTHF1);
-        posBase1Vect.push_back(posBase1);
-        posBase2Vect.push_back(posBase2);
-        posSugarTHF2Vect.push_back(posSugarTHF2);
-        posSugarTMP2Vect.push_back(posSugarTMP2);
-    }
+    // Create all the DNA volumes (solid & logical) around the histone based on the template
+    // nucleosome. Place this nucleosome several times to build the fiber. This is done to save
+    // memory and improve speed. Logical volumes are saved a map (key = name of the volume [e.g.
+    // sugar1], value = vector of corresponding logical volumes).
+    std::map<G4String, std::vector<G4LogicalVolume*> >* volMap = CreateNucleosomeCuttedSolidsAndLogicals();
+    // The resulting volMap is indexed by one of 6 entries (one per residue). Each entry has
+    // fNumBpPerNucleosome elements, each corresponding to a distinct logical volume
 
-    //----------------------------------------------------------------------------------------------
-    // Save the first histone position
-    //----------------------------------------------------------------------------------------------
-    G4ThreeVector posHistone = posNucleo->at(0);
-
-    //----------------------------------------------------------------------------------------------
-    // Distance offset used to start placing volumes at one end of the fiber
-    //----------------------------------------------------------------------------------------------
-    G4ThreeVector minusForFiber = G4ThreeVector(0.,0.,-solidFiber->GetDz() + fHistoneHeight);
+    G4int count = 0;
 
     //----------------------------------------------------------------------------------------------
-    // z shift to be applied when positioning subsequent nucleosomes
+    // Analytic overlap checker. Residues & histones are registered as they are placed and checked
+    // all at once after the fiber is filled. Per-placement Geant4 overlap checks are skipped.
     //----------------------------------------------------------------------------------------------
-    G4double zShift = fFiberPitch/fFiberNbNuclPerTurn;
-    G4int count = 0;
+    DNAOverlapChecker* overlapChecker = NULL;
+    if (fCheckForOverlapsAnalytically)
+        overlapChecker = new DNAOverlapChecker(fFiberRadius, fFiberHalfLength);
+    G4bool checkEachPlacement = fCheckForOverlaps && !fCheckForOverlapsAnalytically;
 
     //----------------------------------------------------------------------------------------------
     // Fill the chromatin fiber with DNA by iterating over each nucleosome & each nucleotide base
@@ -372,12 +471,13 @@ G4LogicalVolume* VoxelizedNuclearDNA::BuildLogicFiber(std::vector<std::vector<DN
         // Rotate the nucleosome itself with respect to the z-axis, in order to align the cut
         // volumes appropriately to prevent overlaps. This is not the same as placing a nucleosome
         // at the next position around the fiber. That is done below. Our basis nucleosome is
-        // nucleosome #2 (index=1). The following rotation logic accounts for this.
+        // the template nucleosome (index=templateIndex). The following rotation logic accounts
+        // for this.
         // This rotation object will be applied to every physical volume placement below, in order
         // to align the cut bp volumes and prevent overlaps. This is a rotation about the
         // volume's own z-axis.
         G4RotationMatrix* rotCuts = new G4RotationMatrix();
-        rotCuts->rotateZ((i-1)*-fFiberDeltaAngle);
+        rotCuts->rotateZ((i-templateIndex)*-fFiberDeltaAngle);
 
         //------------------------------------------------------------------------------------------
         // Iterate over all bp in a nucleosome. At each iteration, generate physical volumes for all
@@ -386,48 +486,17 @@ G4LogicalVolume* VoxelizedNuclearDNA::BuildLogicFiber(std::vector<std::vector<DN
         for(int j=0;j<fNumBpPerNucleosome;++j)
         {
             //--------------------------------------------------------------------------------------
-            // The following positional rotations account for the fact that nucleosomes are
-            // assembled in a helical fashion around the fibre axis (z). Note this has nothing to
-            // do with rotations of the bp volumes themselves (which are handled by rotCuts obj).
+            // Positions of the residues of this bp in the fiber. The helical arrangement of
+            // nucleosomes around the fibre axis (z) has already been applied by GeoCalculation.
+            // Note this has nothing to do with rotations of the bp volumes themselves (which are
+            // handled by rotCuts obj).
             //--------------------------------------------------------------------------------------
-            if(i==0)
-            {
-                posSugarTMP1 = posSugarTMP1Vect[j].rotateZ(-fFiberDeltaAngle);
-                posSugarTHF1 = posSugarTHF1Vect[j].rotateZ(-fFiberDeltaAngle);
-                posBase1 = posBase1Vect[j].rotateZ(-fFiberDeltaAngle);
-                posBase2 = posBase2Vect[j].rotateZ(-fFiberDeltaAngle);
-                posSugarTHF2 = posSugarTHF2Vect[j].rotateZ(-fFiberDeltaAngle);
-                posSugarTMP2 = posSugarTMP2Vect[j].rotateZ(-fFiberDeltaAngle);
-            }
-            else
-            {
-                posSugarTMP1 = posSugarTMP1Vect[j].rotateZ(fFiberDeltaAngle);
-                posSugarTHF1 = posSugarTHF1Vect[j].rotateZ(fFiberDeltaAngle);
-                posBase1 = posBase1Vect[j].rotateZ(fFiberDeltaAngle);
-                posBase2 = posBase2Vect[j].rotateZ(fFiberDeltaAngle);
-                posSugarTHF2 = posSugarTHF2Vect[j].rotateZ(fFiberDeltaAngle);
-                posSugarTMP2 = posSugarTMP2Vect[j].rotateZ(fFiberDeltaAngle);
-            }
-
-            //--------------------------------------------------------------------------------------
-            // Apply a z shift, specific to each nucleosome, to span length of fiber
-            //--------------------------------------------------------------------------------------
-            posSugarTMP1 += G4ThreeVector(0.,0.,i*zShift-zShift);
-            posSugarTHF1 += G4ThreeVector(0.,0.,i*zShift-zShift);
-            posBase1 += G4ThreeVector(0.,0.,i*zShift-zShift);
-            posBase2 += G4ThreeVector(0.,0.,i*zShift-zShift);
-            posSugarTHF2 += G4ThreeVector(0.,0.,i*zShift-zShift);
-            posSugarTMP2 += G4ThreeVector(0.,0.,i*zShift-zShift);
-
-            //--------------------------------------------------------------------------------------
-            // Apply shift such that fiber helix construction begins at at one end.
-            //--------------------------------------------------------------------------------------
-            posSugarTMP1 += minusForFiber;
-            posSugarTHF1 += minusForFiber;
-            posBase1 += minusForFiber;
-            posBase2 += minusForFiber;
-            posSugarTHF2 += minusForFiber;
-            posSugarTMP2 += minusForFiber;
+            G4ThreeVector posSugarTMP1 = fiberPositions.GetPosition(kSugarTMP1,i,j);
+            G4ThreeVector posSugarTHF1 = fiberPositions.GetPosition(kSugarTHF1,i,j);
+            G4ThreeVector posBase1 = fiberPositions.GetPosition(kBase1,i,j);
+            G4ThreeVector posBase2 = fiberPositions.GetPosition(kBase2,i,j);
+            G4ThreeVector posSugarTHF2 = fiberPositions.GetPosition(kSugarTHF2,i,j);
+            G4ThreeVector posSugarTMP2 = fiberPositions.GetPosition(kSugarTMP2,i,j);
 
             //--------------------------------------------------------------------------------------
             // Place physical volumes for residues. 5 values for each physical volume
@@ -556,25 +625,26 @@ G4LogicalVolume* VoxelizedNuclearDNA::BuildLogicFiber(std::vector<std::vector<DN
             (*fpDnaMoleculePositions)["Phosphate"].back().push_back(2);
 
             //--------------------------------------------------------------------------------------
-            // Place water volumes (containing residue placements) inside fiber volume
+            // Register residues with the analytic overlap checker. Cut planes are rotated with the
+            // residue solids (i.e. by the inverse of rotCuts).
             //--------------------------------------------------------------------------------------
-            // G4PVPlacement* sTMP1W = new G4PVPlacement(0,posSugarTMP1,
-            //     volMap->at("sugarTMP1Water")[j],"sugarTMP1Hydra",logicFiber,false,count);
-            // G4PVPlacement* sTHF1W = new G4PVPlacement(0,posSugarTHF1,
-            //     volMap->at("sugarTHF1Water")[j],"sugarTHF1Hydra",logicFiber,false,count);
-            // G4PVPlacement* b1W = new G4PVPlacement(0,posBase1,
-            //     volMap->at("base1Water")[j],"base1Hydra",logicFiber,false,count);
-            // G4PVPlacement* b2W = new G4PVPlacement(0,posBase2,
-            //     volMap->at("base2Water")[j],"base2Hydra",logicFiber,false,count);
-            // G4PVPlacement* sTHF2W = new G4PVPlacement(0,posSugarTHF2,
-            //     volMap->at("sugarTHF2Water")[j],"sugarTHF2Hydra",logicFiber,false,count);
-            // G4PVPlacement* sTMP2W = new G4PVPlacement(0,posSugarTMP2,
-            //     volMap->at("sugarTMP2Water")[j],"sugarTMP2Hydra",logicFiber,false,count);
+            if (overlapChecker) {
+                const G4ThreeVector* residuePositions[6] = {&posSugarTMP1,&posSugarTHF1,&posBase1,
+                                                            &posBase2,&posSugarTHF2,&posSugarTMP2};
+                const G4double residueRadii[6] = {fSugarTMPRadius,fSugarTHFRadius,fBaseRadius,
+                                                  fBaseRadius,fSugarTHFRadius,fSugarTMPRadius};
+                const G4int copyNumbers[6] = {count,count+100000,count+200000,count+1200000,
+                                              count+1100000,count+1000000};
+                for (G4int r=0; r<6; ++r) {
+                    overlapChecker->AddResidue(*residuePositions[r],residueRadii[r],copyNumbers[r],
+                                               GetResidueCutPlanes(r,j,(i-templateIndex)*fFiberDeltaAngle));
+                }
+            }
 
             //--------------------------------------------------------------------------------------
             // Check overlaps if solids have been cut.
             //--------------------------------------------------------------------------------------
-            if (fCheckForOverlaps) {
+            if (checkEachPlacement) {
                 G4bool overlapDetected = false;
                 if(sTMP1->CheckOverlaps(fOverlapsResolution) && fQuitIfOverlap)
                     ThrowOverlapError();
@@ -588,12 +658,6 @@ G4LogicalVolume* VoxelizedNuclearDNA::BuildLogicFiber(std::vector<std::vector<DN
                     ThrowOverlapError();
                 if(sTMP2->CheckOverlaps(fOverlapsResolution) && fQuitIfOverlap)
                     ThrowOverlapError();
-                // sTMP1W->CheckOverlaps();
-                // sTHF1W->CheckOverlaps();
-                // b1W->CheckOverlaps();
-                // b2W->CheckOverlaps();
-                // sTHF2W->CheckOverlaps();
-                // sTMP2W->CheckOverlaps();
             }
             ++count;
         }
@@ -601,13 +665,7 @@ G4LogicalVolume* VoxelizedNuclearDNA::BuildLogicFiber(std::vector<std::vector<DN
         //------------------------------------------------------------------------------------------
         // Place the histone volume
         //------------------------------------------------------------------------------------------
-        G4ThreeVector posHistoneForNucleo = posHistone;
-        // Rotate. Not really necessary
-        posHistoneForNucleo.rotateZ(i*fFiberDeltaAngle);
-        // Apply a z shift, specific to each nucleosome, to span length of fiber
-        posHistoneForNucleo += G4ThreeVector(0.,0.,i*zShift);
-        // Apply shift such that fiber helix construction begins at at one end.
-        posHistoneForNucleo += minusForFiber;
+        G4ThreeVector posHistoneForNucleo = fiberPositions.GetHistonePosition(i);
 
         // Create volume
         G4String histName = "histone_" + std::to_string(i);
@@ -626,33 +684,223 @@ G4LogicalVolume* VoxelizedNuclearDNA::BuildLogicFiber(std::vector<std::vector<DN
         (*fpDnaMoleculePositions)["Histone"].back().push_back(0);
 
         // Check for overlaps
-        if (fCheckForOverlaps) {
+        if (overlapChecker) {
+            overlapChecker->AddHistone(posHistoneForNucleo,fHistoneRadius,fHistoneHeight,i+2000000);
+        }
+        else if (fCheckForOverlaps) {
             if(pHistone->CheckOverlaps(fOverlapsResolution) && fQuitIfOverlap)
                 ThrowOverlapError();
         }
     }
 
+    //----------------------------------------------------------------------------------------------
+    // Run the analytic overlap check over the whole fiber
+    //----------------------------------------------------------------------------------------------
+    if (overlapChecker) {
+        G4int numOverlaps = overlapChecker->CheckOverlaps(fNumOverlapsToReport);
+        delete overlapChecker;
+        if (numOverlaps > 0 && fQuitIfOverlap)
+            ThrowOverlapError();
+    }
+
     return logicFiber;
 }
 
 
 //--------------------------------------------------------------------------------------------------
-// Create the solid and logical volumes required to build DNA around one histone.
+// Set up the DNAFiberTemplate of this component. When the fiber template file holds the template,
+// the registry's template points into the mapping, shared by all processes of the node. Otherwise
+// it is filled here.
+//--------------------------------------------------------------------------------------------------
+void VoxelizedNuclearDNA::BuildFiberTemplate(const DNAPositionBuffer& fiberPositions, G4int templateIndex,
+                                             G4LogicalVolume* logicFiber)
+{
+    DNAFiberTemplate* fiberTemplate = DNAFiberTemplate::GetInstance(fName);
+    if (!fTemplateFile.AttachFiberTemplate(fiberTemplate))
+        FillFiberTemplate(fiberPositions, templateIndex);
+    fiberTemplate->SetFiberVolume(logicFiber);
+
+    //----------------------------------------------------------------------------------------------
+    // Report the fraction of the fiber occupied by residues, i.e. the density that the proxy
+    // material should have to be DNA-equivalent.
+    //----------------------------------------------------------------------------------------------
+    if (!fUseFiberProxy) {
+        G4cout << "VoxelizedNuclearDNA: fiber template with " << fiberTemplate->GetNumberOfResidues()
+               << " residues & " << fiberTemplate->GetNumberOfHistones() << " histones." << G4endl;
+        return;
+    }
+    G4double residueFraction = fiberTemplate->CalculateResidueVolumeFraction(0.5*nm);
+    G4double equivalentDensity = residueFraction*fDNAMaterial->GetDensity()
+                                 + (1.-residueFraction)*fWater->GetDensity();
+    G4cout << "VoxelizedNuclearDNA: fiber proxy with " << fiberTemplate->GetNumberOfResidues()
+           << " residues. Residue volume fraction = " << residueFraction
+           << ", DNA-equivalent density = " << equivalentDensity/(g/cm3) << " g/cm3 ("
+           << fFiberProxyMaterialName << " has " << GetMaterial(fFiberProxyMaterialName)->GetDensity()/(g/cm3)
+           << " g/cm3)" << G4endl;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Fill the DNAFiberTemplate of this component with all residues of the fiber (positions in the
+// fiber frame, copy numbers as used for the placed volumes & cut planes rotated like the placed
+// solids) & all histones. Each residue also carries the radius of its hydration shell, for the
+// scorer to test without placing shell volumes.
+//--------------------------------------------------------------------------------------------------
+void VoxelizedNuclearDNA::FillFiberTemplate(const DNAPositionBuffer& fiberPositions, G4int templateIndex)
+{
+    DNAFiberTemplate* fiberTemplate = DNAFiberTemplate::GetInstance(fName);
+    fiberTemplate->Reset(fFiberRadius, fFiberHalfLength);
+
+    const DNAResidueIndex residueIndices[6] = {kSugarTMP1,kSugarTHF1,kBase1,kBase2,kSugarTHF2,kSugarTMP2};
+    const G4double residueRadii[6] = {fSugarTMPRadius,fSugarTHFRadius,fBaseRadius,
+                                      fBaseRadius,fSugarTHFRadius,fSugarTMPRadius};
+    const G4double shellRadii[6] = {fSugarTMPRadiusWater,fSugarTHFRadiusWater,fBaseRadiusWater,
+                                    fBaseRadiusWater,fSugarTHFRadiusWater,fSugarTMPRadiusWater};
+    const G4int copyNumberOffsets[6] = {0,100000,200000,1200000,1100000,1000000};
+
+    G4int count = 0;
+    for(int i=0;i<fNumNucleosomePerFiber;++i)
+    {
+        for(int j=0;j<fNumBpPerNucleosome;++j)
+        {
+            for (G4int r=0; r<6; ++r) {
+                fiberTemplate->AddResidue(fiberPositions.GetPosition(residueIndices[r],i,j),
+                                          residueRadii[r],shellRadii[r],count+copyNumberOffsets[r],
+                                          GetResidueCutPlanes(r,j,(i-templateIndex)*fFiberDeltaAngle));
+            }
+            ++count;
+        }
+        fiberTemplate->AddHistone(fiberPositions.GetHistonePosition(i), fHistoneRadius, fHistoneHeight);
+    }
+    fiberTemplate->Build();
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Fill fResidueCutPlanes & fiberPositions. Without a FiberTemplateFile they are computed here. With
+// one, the first process to build this fiber model computes them (and the fiber template, if
+// built) & writes the file under an exclusive lock. Every process, including the writer, then maps
+// the file & points fiberPositions, fResidueCutPlanes & the fiber template at its arrays, so a
+// node holds one copy of them however many processes it runs. The mapping stays open until the
+// component is destroyed.
+//--------------------------------------------------------------------------------------------------
+void VoxelizedNuclearDNA::PrepareFiberData(const DNAPositionBuffer* basisPositions, G4int templateIndex,
+    std::map<G4ThreeVector, G4double>* posAndRadiusMap, G4double zOffset, DNAPositionBuffer* fiberPositions)
+{
+    // Detach the fiber template from a file mapped by a previous build before it is unmapped
+    if (fTemplateFile.IsOpen()) {
+        DNAFiberTemplate::GetInstance(fName)->Reset(fFiberRadius, fFiberHalfLength);
+        fTemplateFile.Close();
+    }
+
+    if (fFiberTemplateFileName == "") {
+        CalculateNucleosomeCutPlanes(basisPositions, templateIndex, posAndRadiusMap);
+        fGeoCalculation->GeneratePositions(0, fNumNucleosomePerFiber, fiberPositions, zOffset);
+        return;
+    }
+
+    // Everything the file contents depend on
+    std::ostringstream key;
+    key << std::setprecision(12) << GetFiberModelKey(templateIndex)
+        << "|" << fNumNucleosomePerFiber << "|" << zOffset/nm << "|" << (fCutVolumes || fBuildFiberTemplate)
+        << "|" << fBuildFiberTemplate << "|" << fFiberRadius/nm << "|" << fFiberHalfLength/nm
+        << "|" << fSugarTMPRadiusWater/nm << "|" << fSugarTHFRadiusWater/nm << "|" << fBaseRadiusWater/nm
+        << "|" << fHistoneRadius/nm << "|" << fHistoneHeight/nm;
+
+    G4bool isOpen = fTemplateFile.Open(fFiberTemplateFileName, key.str());
+    if (!isOpen) {
+        // Another process may be writing the file. Wait for it, then check again.
+        G4int lock = FiberTemplateFile::Lock(fFiberTemplateFileName);
+        isOpen = fTemplateFile.Open(fFiberTemplateFileName, key.str());
+        if (!isOpen) {
+            CalculateNucleosomeCutPlanes(basisPositions, templateIndex, posAndRadiusMap);
+            fGeoCalculation->GeneratePositions(0, fNumNucleosomePerFiber, fiberPositions, zOffset);
+            const DNAFiberTemplate* fiberTemplate = NULL;
+            if (fBuildFiberTemplate) {
+                FillFiberTemplate(*fiberPositions, templateIndex);
+                fiberTemplate = DNAFiberTemplate::GetInstance(fName);
+            }
+            if (FiberTemplateFile::Write(fFiberTemplateFileName, key.str(), *fiberPositions, fResidueCutPlanes,
+                                         fiberTemplate)) {
+                G4cout << "VoxelizedNuclearDNA: wrote fiber template file " << fFiberTemplateFileName << G4endl;
+                // Use the shared copy from now on, so the data computed here can be freed
+                isOpen = fTemplateFile.Open(fFiberTemplateFileName, key.str());
+            }
+            else
+                G4cerr << "Warning: VoxelizedNuclearDNA could not write fiber template file "
+                       << fFiberTemplateFileName << ". Continuing without it." << G4endl;
+        }
+        FiberTemplateFile::Unlock(lock);
+        if (!isOpen) return;
+    }
+
+    G4cout << "VoxelizedNuclearDNA: mapped fiber template file " << fFiberTemplateFileName << G4endl;
+    fTemplateFile.AttachPositions(fiberPositions);
+    fTemplateFile.AttachCutPlanes(&fResidueCutPlanes);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Calculate the planes used to cut each residue of the template nucleosome (index nucleosome of
+// basisPositions) & save them in fResidueCutPlanes. Planes are only calculated if the residues are
+// cut, or if a fiber template is built (the planes are then used to locate energy depositions).
+//--------------------------------------------------------------------------------------------------
+void VoxelizedNuclearDNA::CalculateNucleosomeCutPlanes(const DNAPositionBuffer* basisPositions,
+    G4int nucleosome, std::map<G4ThreeVector, G4double>* posAndRadiusMap)
+{
+    // The planes only depend on the fiber model, so they are computed once per model & reused when
+    // the geometry is rebuilt, or when another component uses the same model. Solids & logical
+    // volumes are always recreated, since Geant4 deletes them on a geometry rebuild.
+    fResidueCutPlanes.Clear();
+
+    if(fCutVolumes || fBuildFiberTemplate)
+    {
+        G4String modelKey = GetFiberModelKey(nucleosome);
+        std::map<G4String, ResidueCutPlaneTable>::iterator cached = fCutPlaneCache.find(modelKey);
+
+        if (cached != fCutPlaneCache.end()) {
+            fResidueCutPlanes = cached->second;
+        }
+        else {
+            const DNAResidueIndex residueIndices[6] = {kSugarTMP1,kSugarTHF1,kBase1,kBase2,kSugarTHF2,kSugarTMP2};
+            const G4double residueRadii[6] = {fSugarTMPRadius,fSugarTHFRadius,fBaseRadius,
+                                              fBaseRadius,fSugarTHFRadius,fSugarTMPRadius};
+            std::vector<ResidueCutPlane> planes;
+            for (G4int r=0; r<6; ++r) {
+                for(int j=0;j<fNumBpPerNucleosome;++j)
+                {
+                    planes.clear();
+                    CalculateCutPlanes(basisPositions->GetPosition(residueIndices[r],nucleosome,j),
+                                       residueRadii[r], posAndRadiusMap, &planes);
+                    fResidueCutPlanes.AddResidue(planes);
+                }
+            }
+            fCutPlaneCache[modelKey] = fResidueCutPlanes;
+        }
+    }
+    else
+    {
+        // Uncut, so no cut planes.
+        for (G4int r=0; r<6*fNumBpPerNucleosome; ++r)
+            fResidueCutPlanes.AddResidue(std::vector<ResidueCutPlane>());
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Create the solid and logical volumes required to build DNA around one histone, using the cut
+// planes in fResidueCutPlanes.
 // Return a map as:
-// Key: name of the volume (base1, base2, base1Water, ...). Size = 12.
-// Content: vector of corresponding logical volumes (each vector size = 200)
-// Note: there is code to implement hydration shells around the residue volumes, but this is not
-// currently implemented/tested.
+// Key: name of the volume (sugarTMP1, base1, ...). Size = 6.
+// Content: vector of corresponding logical volumes (each vector size = fNumBpPerNucleosome)
+// Hydration shells are not volumes: their radii are registered with the residues in the fiber
+// template (see BuildFiberTemplate()).
 //--------------------------------------------------------------------------------------------------
-std::map<G4String, std::vector<G4LogicalVolume*> >* VoxelizedNuclearDNA::CreateNucleosomeCuttedSolidsAndLogicals(
-    std::vector<DNAPlacementData>* nucleosomeVolumePositions, std::map<G4ThreeVector,
-    G4double>* posAndRadiusMap)
+std::map<G4String, std::vector<G4LogicalVolume*> >* VoxelizedNuclearDNA::CreateNucleosomeCuttedSolidsAndLogicals()
 {
     // This is the map to be returned
     std::map<G4String, std::vector<G4LogicalVolume*> >* logicSolidsMap = new std::map<G4String, std::vector<G4LogicalVolume*> >;
 
-    G4int basePairNum = nucleosomeVolumePositions->size(); // 200
-
     //----------------------------------------------------------------------------------------------
     // Create elementary solids
     //----------------------------------------------------------------------------------------------
@@ -673,21 +921,6 @@ std::map<G4String, std::vector<G4LogicalVolume*> >* VoxelizedNuclearDNA::CreateN
     G4Orb* solidSugarTMP = new G4Orb("solid_sugar_TMP", fSugarTMPRadius);
     G4Orb* solidBase = new G4Orb("solid_base", fBaseRadius);
 
-    // hydration shells
-    // G4Orb* solidSugarTHFWater = new G4Orb("solid_sugar_THF_Water", fSugarTHFRadiusWater);
-    // G4Orb* solidSugarTMPWater = new G4Orb("solid_sugar_TMP_Water", fSugarTMPRadiusWater);
-    // G4Orb* solidBaseWater = new G4Orb("solid_base_Water", fBaseRadiusWater);
-
-    //----------------------------------------------------------------------------------------------
-    // Position variables for residues
-    //----------------------------------------------------------------------------------------------
-    G4ThreeVector posSugarTMP1;
-    G4ThreeVector posSugarTHF1;
-    G4ThreeVector posBase1;
-    G4ThreeVector posBase2;
-    G4ThreeVector posSugarTHF2;
-    G4ThreeVector posSugarTMP2;
-
     //----------------------------------------------------------------------------------------------
     // Iterate over each base pair to generate cut solids and logical volumes.
     //----------------------------------------------------------------------------------------------
@@ -696,14 +929,6 @@ std::map<G4String, std::vector<G4LogicalVolume*> >* VoxelizedNuclearDNA::CreateN
         //------------------------------------------------------------------------------------------
         // First: cut the solids (if requested)
         //------------------------------------------------------------------------------------------
-        // Get the position
-        posSugarTMP1 = nucleosomeVolumePositions->at(j).posSugarTMP1;
-        posSugarTHF1 = nucleosomeVolumePositions->at(j).posSugarTHF1;
-        posBase1 = nucleosomeVolumePositions->at(j).posBase1;
-        posBase2 = nucleosomeVolumePositions->at(j).posBase2;
-        posSugarTHF2 = nucleosomeVolumePositions->at(j).posSugarTHF2;
-        posSugarTMP2 = nucleosomeVolumePositions->at(j).posSugarTMP2;
-
         // Variables for the cut solid volumes
         // residues
         G4VSolid* sugarTMP1;
@@ -713,33 +938,16 @@ std::map<G4String, std::vector<G4LogicalVolume*> >* VoxelizedNuclearDNA::CreateN
         G4VSolid* sugarTHF2;
         G4VSolid* sugarTMP2;
 
-        // hydration shells
-        // G4VSolid* sugarTMP1Water;
-        // G4VSolid* sugarTHF1Water;
-        // G4VSolid* base1Water;
-        // G4VSolid* base2Water;
-        // G4VSolid* sugarTHF2Water;
-        // G4VSolid* sugarTMP2Water;
-
-
         // if fCutVolumes is true (i.e. need to run simulations), cut the volumes
         if(fCutVolumes)
         {
             // residues
-            sugarTMP1 = CreateCutSolid(solidSugarTMP,posSugarTMP1,posAndRadiusMap, "sugarTMP");
-            sugarTHF1 = CreateCutSolid(solidSugarTHF,posSugarTHF1,posAndRadiusMap, "sugarTHF");
-            base1 = CreateCutSolid(solidBase,posBase1,posAndRadiusMap, "base");
-            base2 = CreateCutSolid(solidBase,posBase2,posAndRadiusMap, "base");
-            sugarTHF2 = CreateCutSolid(solidSugarTHF,posSugarTHF2,posAndRadiusMap, "sugarTHF");
-            sugarTMP2 = CreateCutSolid(solidSugarTMP,posSugarTMP2,posAndRadiusMap, "sugarTMP");
-
-            // hydration shells
-            // sugarTMP1Water = CreateCutSolid(solidSugarTMPWater,posSugarTMP1,posAndRadiusMap);
-            // sugarTHF1Water = CreateCutSolid(solidSugarTHFWater,posSugarTHF1,posAndRadiusMap);
-            // base1Water = CreateCutSolid(solidBaseWater,posBase1,posAndRadiusMap);
-            // base2Water = CreateCutSolid(solidBaseWater,posBase2,posAndRadiusMap);
-            // sugarTHF2Water = CreateCutSolid(solidSugarTHFWater,posSugarTHF2,posAndRadiusMap);
-            // sugarTMP2Water = CreateCutSolid(solidSugarTMPWater,posSugarTMP2,posAndRadiusMap);
+            sugarTMP1 = CreateCutSolid(solidSugarTMP,GetResidueCutPlanes(0,j));
+            sugarTHF1 = CreateCutSolid(solidSugarTHF,GetResidueCutPlanes(1,j));
+            base1 = CreateCutSolid(solidBase,GetResidueCutPlanes(2,j));
+            base2 = CreateCutSolid(solidBase,GetResidueCutPlanes(3,j));
+            sugarTHF2 = CreateCutSolid(solidSugarTHF,GetResidueCutPlanes(4,j));
+            sugarTMP2 = CreateCutSolid(solidSugarTMP,GetResidueCutPlanes(5,j));
         }
         // if fCutVolumes is false it means we just want to visualize the geometry so we do not need
         // the cutted volumes. Just use the uncut solids.
@@ -752,14 +960,6 @@ std::map<G4String, std::vector<G4LogicalVolume*> >* VoxelizedNuclearDNA::CreateN
             base2 = solidBase;
             sugarTHF2 = solidSugarTHF;
             sugarTMP2 = solidSugarTMP;
-
-            // hydration shells
-            // sugarTMP1Water = solidSugarTMPWater;
-            // sugarTHF1Water = solidSugarTHFWater;
-            // base1Water = solidBaseWater;
-            // base2Water = solidBaseWater;
-            // sugarTHF2Water = solidSugarTHFWater;
-            // sugarTMP2Water = solidSugarTMPWater;
         }
 
         //------------------------------------------------------------------------------------------
@@ -772,13 +972,6 @@ std::map<G4String, std::vector<G4LogicalVolume*> >* VoxelizedNuclearDNA::CreateN
         G4LogicalVolume* logicBase2;
         G4LogicalVolume* logicSugarTHF2;
         G4LogicalVolume* logicSugarTMP2;
-        // hydration shells
-        // G4LogicalVolume* logicSugarTMP1Water;
-        // G4LogicalVolume* logicSugarTHF1Water;
-        // G4LogicalVolume* logicBase1Water;
-        // G4LogicalVolume* logicBase2Water;
-        // G4LogicalVolume* logicSugarTHF2Water;
-        // G4LogicalVolume* logicSugarTMP2Water;
 
         // Handle G4 vs Ts approach to generating logical volumes
         if (fUseG4Volumes) {
@@ -799,14 +992,6 @@ std::map<G4String, std::vector<G4LogicalVolume*> >* VoxelizedNuclearDNA::CreateN
             logicSugarTMP2 = CreateLogicalVolume("Phosphate2",fDNAMaterialName,sugarTMP2);
         }
 
-        // Creation of hydration shells
-        // logicSugarTMP1Water = new G4LogicalVolume(sugarTMP1Water,fDNAMaterial,"logic_sugarTMP_1_hydra");
-        // logicSugarTHF1Water = new G4LogicalVolume(sugarTHF1Water,fDNAMaterial,"logic_sugarTHF_1_hydra");
-        // logicBase1Water = new G4LogicalVolume(base1Water, fDNAMaterial,"Base1_hydra");
-        // logicBase2Water = new G4LogicalVolume(base2Water, fDNAMaterial,"Base2_hydra");
-        // logicSugarTHF2Water = new G4LogicalVolume(sugarTHF2Water,fDNAMaterial,"logic_sugarTHF_2_hydra");
-        // logicSugarTMP2Water = new G4LogicalVolume(sugarTMP2Water,fDNAMaterial,"logic_sugarTMP_2_hydra");
-
         //------------------------------------------------------------------------------------------
         // Save the logical volumes in the output map
         //------------------------------------------------------------------------------------------
@@ -816,16 +1001,9 @@ std::map<G4String, std::vector<G4LogicalVolume*> >* VoxelizedNuclearDNA::CreateN
         (*logicSolidsMap)["base2"].push_back(logicBase2);
         (*logicSolidsMap)["sugarTHF2"].push_back(logicSugarTHF2);
         (*logicSolidsMap)["sugarTMP2"].push_back(logicSugarTMP2);
-
-        // (*logicSolidsMap)["sugarTMP1Water"].push_back(logicSugarTMP1Water);
-        // (*logicSolidsMap)["sugarTHF1Water"].push_back(logicSugarTHF1Water);
-        // (*logicSolidsMap)["base1Water"].push_back(logicBase1Water);
-        // (*logicSolidsMap)["base2Water"].push_back(logicBase2Water);
-        // (*logicSolidsMap)["sugarTHF2Water"].push_back(logicSugarTHF2Water);
-        // (*logicSolidsMap)["sugarTMP2Water"].push_back(logicSugarTMP2Water);
     } // complete iterating over all bp in single nucleotide
 
-    // Note: each vector of the logicSolidsMap has 200 elements
+    // Note: each vector of the logicSolidsMap has fNumBpPerNucleosome elements
     return logicSolidsMap;
 }
 
@@ -833,39 +1011,24 @@ std::map<G4String, std::vector<G4LogicalVolume*> >* VoxelizedNuclearDNA::CreateN
 //--------------------------------------------------------------------------------------------------
 // Algorithm for cutting DNA residue solids to avoid overlaps.
 // Idea: we must have a reference and a target. The reference is the solid we are considering
-// (described by parameters solidOrbRef & posRef) and that could be cut if an overlap is
-// detected with the target solid. In a geometry, it implies we have to go through all the target
-// solids for a given reference solid. Target solid info (position and radius) is included in tarMap
-// This method will return the cut spherical reference solid.
+// (described by parameters posRef & radiusRef) and that could be cut if an overlap is detected with
+// the target solid. In a geometry, it implies we have to go through all the target solids for a
+// given reference solid. Target solid info (position and radius) is included in tarMap.
+// Each cut is recorded as a plane (normal & offset from the reference centre) in cutPlanes. The
+// planes are used both to create the cut solid (CreateCutSolid) & by DNAOverlapChecker.
 //--------------------------------------------------------------------------------------------------
-G4VSolid* VoxelizedNuclearDNA::CreateCutSolid(G4Orb *solidOrbRef,
-                                       G4ThreeVector& posRef,
-                                       std::map<G4ThreeVector,G4double>* tarMap,
-                                       G4String volName)
+void VoxelizedNuclearDNA::CalculateCutPlanes(const G4ThreeVector& posRef,
+                                             G4double radiusRef,
+                                             std::map<G4ThreeVector,G4double>* tarMap,
+                                             std::vector<ResidueCutPlane>* cutPlanes)
 {
-    G4SubtractionSolid* solidCut(NULL); // container for the cut solid
-
-    bool isCutted = false; // flag to indicate if volume has been cut yet
     bool isOurVol = false; // flag to indicate if target volume is our reference volume
 
     //----------------------------------------------------------------------------------------------
-    // Define radius of the reference solid we are focusing on
-    //----------------------------------------------------------------------------------------------
-    G4double radiusRef (0);
-
-    if(volName=="base") radiusRef = fBaseRadius;
-    else if(volName=="sugarTHF") radiusRef = fSugarTHFRadius;
-    else if(volName=="sugarTMP") radiusRef = fSugarTMPRadius;
-
-    // Hydration shell is handled if no volName provided
-    else radiusRef = solidOrbRef->GetRadius();
-
-    //----------------------------------------------------------------------------------------------
-    // iterate on all the residue volumes in the map (3600 elements), i.e. "targets"
+    // iterate on all the residue volumes in the map (10800 elements by default), i.e. "targets"
     //----------------------------------------------------------------------------------------------
     std::map<G4ThreeVector,G4double>::iterator it;
     std::map<G4ThreeVector,G4double>::iterator ite;
-    G4int count = 0;
 
     for(it=tarMap->begin(), ite=tarMap->end();it!=ite;++it)
     {
@@ -897,49 +1060,69 @@ G4VSolid* VoxelizedNuclearDNA::CreateCutSolid(G4Orb *solidOrbRef,
         //------------------------------------------------------------------------------------------
         else if(distance <= radiusRef+radiusTar)
         {
-            // Solid volume used to cut. Make size "equal" to that of larger between the reference
-            // and current target.
-            G4double sliceBoxSize = std::max(radiusRef,radiusTar);
-            G4Box* sliceBox = new G4Box("solid box for cut", sliceBoxSize, sliceBoxSize, sliceBoxSize);
-
-            //--------------------------------------------------------------------------------------
-            // To calculate the position of the intersection center
-            //--------------------------------------------------------------------------------------
             // Displacement vector between target and reference
             G4ThreeVector displacement_vector = posTar - posRef;
-            // Find the middle overlap point between the target and reference
-            G4double intersection = (pow(radiusRef,2)-pow(radiusTar,2)+pow(distance,2) ) / (2*distance) + sliceBox->GetZHalfLength();
-            // Add small safety buffer
-            intersection -= 0.001*nm;
-            // Create a vector to the intersection position, where one edge of the slicing volume
-            // will be placed
-            G4ThreeVector posSlice = intersection *( displacement_vector/displacement_vector.getR() );
 
-            //--------------------------------------------------------------------------------------
-            // Calculate the necessary rotations.
-            //--------------------------------------------------------------------------------------
-            G4double phi = std::acos(posSlice.getZ()/posSlice.getR());
-            G4double theta = std::acos( posSlice.getX() / ( posSlice.getR()*std::cos(M_PI/2.-phi) ) );
+            ResidueCutPlane plane;
+            plane.normal = displacement_vector/displacement_vector.getR();
+            // Find the middle overlap point between the target and reference & add small safety
+            // buffer
+            plane.offset = (pow(radiusRef,2)-pow(radiusTar,2)+pow(distance,2) ) / (2*distance);
+            plane.offset -= 0.001*nm;
+            cutPlanes->push_back(plane);
+        }
+    }
+}
 
-            if(posSlice.getY()<0) theta = -theta;
 
-            G4ThreeVector rotAxisForPhi(1*nm,0.,0.);
-            rotAxisForPhi.rotateZ(theta+M_PI/2);
-            G4RotationMatrix *rotMat = new G4RotationMatrix;
-            rotMat->rotate(-phi, rotAxisForPhi);
+//--------------------------------------------------------------------------------------------------
+// Cut a spherical residue solid with the planes calculated by CalculateCutPlanes(). For each plane,
+// a box is subtracted from the sphere with one face on the plane. The box is as large as the
+// sphere, so it removes the whole cap beyond the plane. Return the uncut solid if there are no
+// planes.
+//--------------------------------------------------------------------------------------------------
+G4VSolid* VoxelizedNuclearDNA::CreateCutSolid(G4Orb *solidOrbRef,
+                                       const std::vector<ResidueCutPlane>& cutPlanes)
+{
+    G4SubtractionSolid* solidCut(NULL); // container for the cut solid
 
-            G4ThreeVector rotZAxis(0.,0.,1*nm);
-            rotMat->rotate(theta, rotZAxis);
+    bool isCutted = false; // flag to indicate if volume has been cut yet
 
-            //--------------------------------------------------------------------------------------
-            // Create the G4SubtractionSolid.
-            //--------------------------------------------------------------------------------------
-            if(!isCutted) solidCut = new G4SubtractionSolid("solidCut", solidOrbRef, sliceBox, rotMat, posSlice);
-            else solidCut = new G4SubtractionSolid("solidCut", solidCut, sliceBox, rotMat, posSlice);
+    G4double sliceBoxSize = solidOrbRef->GetRadius();
 
-            isCutted = true;
-        }
-        count++;
+    for (size_t p=0; p<cutPlanes.size(); ++p)
+    {
+        // Solid volume used to cut
+        G4Box* sliceBox = new G4Box("solid box for cut", sliceBoxSize, sliceBoxSize, sliceBoxSize);
+
+        // Create a vector to the intersection position, where one edge of the slicing volume
+        // will be placed
+        G4double intersection = cutPlanes[p].offset + sliceBox->GetZHalfLength();
+        G4ThreeVector posSlice = intersection*cutPlanes[p].normal;
+
+        //------------------------------------------------------------------------------------------
+        // Calculate the necessary rotations.
+        //------------------------------------------------------------------------------------------
+        G4double phi = std::acos(posSlice.getZ()/posSlice.getR());
+        G4double theta = std::acos( posSlice.getX() / ( posSlice.getR()*std::cos(M_PI/2.-phi) ) );
+
+        if(posSlice.getY()<0) theta = -theta;
+
+        G4ThreeVector rotAxisForPhi(1*nm,0.,0.);
+        rotAxisForPhi.rotateZ(theta+M_PI/2);
+        G4RotationMatrix *rotMat = new G4RotationMatrix;
+        rotMat->rotate(-phi, rotAxisForPhi);
+
+        G4ThreeVector rotZAxis(0.,0.,1*nm);
+        rotMat->rotate(theta, rotZAxis);
+
+        //------------------------------------------------------------------------------------------
+        // Create the G4SubtractionSolid.
+        //------------------------------------------------------------------------------------------
+        if(!isCutted) solidCut = new G4SubtractionSolid("solidCut", solidOrbRef, sliceBox, rotMat, posSlice);
+        else solidCut = new G4SubtractionSolid("solidCut", solidCut, sliceBox, rotMat, posSlice);
+
+        isCutted = true;
     }
 
     if(isCutted) return solidCut;
@@ -947,6 +1130,104 @@ G4VSolid* VoxelizedNuclearDNA::CreateCutSolid(G4Orb *solidOrbRef,
 }
 
 
+//--------------------------------------------------------------------------------------------------
+// Exit if a residue or histone of the fiber sticks out of the fiber volume. The volumes would
+// otherwise overlap the voxel & neighbouring fibers.
+//--------------------------------------------------------------------------------------------------
+void VoxelizedNuclearDNA::CheckFiberContents(const DNAPositionBuffer& fiberPositions)
+{
+    const DNAResidueIndex residueIndices[6] = {kSugarTMP1,kSugarTHF1,kBase1,kBase2,kSugarTHF2,kSugarTMP2};
+    const G4double residueRadii[6] = {fSugarTMPRadius,fSugarTHFRadius,fBaseRadius,
+                                      fBaseRadius,fSugarTHFRadius,fSugarTMPRadius};
+
+    for (G4int i=0; i<fNumNucleosomePerFiber; ++i) {
+        G4ThreeVector posHistone = fiberPositions.GetHistonePosition(i);
+        G4bool isOutside = posHistone.perp() + fHistoneRadius > fFiberRadius
+            || std::abs(posHistone.z()) + fHistoneHeight > fFiberHalfLength;
+
+        for (G4int j=0; j<fNumBpPerNucleosome && !isOutside; ++j) {
+            for (G4int r=0; r<6 && !isOutside; ++r) {
+                G4ThreeVector pos = fiberPositions.GetPosition(residueIndices[r], i, j);
+                isOutside = pos.perp() + residueRadii[r] > fFiberRadius
+                    || std::abs(pos.z()) + residueRadii[r] > fFiberHalfLength;
+            }
+        }
+
+        if (isOutside) {
+            G4cerr << "VoxelizedNuclearDNA, Fatal Error. Nucleosome " << i << " of the fiber sticks out of "
+                   << "the fiber volume (radius " << fFiberRadius/nm << " nm, half length " << fFiberHalfLength/nm
+                   << " nm). Reduce DnaNumNucleosomePerFiber or change the fiber parameters." << G4endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Exit if a fiber placed in voxelLogical leaves the voxel or overlaps another fiber. The bounding
+// boxes of the fibers are compared: the default fibers fill their boxes, which tile the voxel.
+//--------------------------------------------------------------------------------------------------
+void VoxelizedNuclearDNA::CheckFiberPlacements(G4LogicalVolume* voxelLogical)
+{
+    const G4double tolerance = 1e-3*nm;
+    G4int numFibers = (G4int)voxelLogical->GetNoDaughters();
+    std::vector<G4ThreeVector> boxMin(numFibers);
+    std::vector<G4ThreeVector> boxMax(numFibers);
+
+    for (G4int i=0; i<numFibers; ++i) {
+        G4VPhysicalVolume* fiber = voxelLogical->GetDaughter(i);
+        G4ThreeVector axis = fiber->GetObjectRotationValue()*G4ThreeVector(0.,0.,1.);
+        G4ThreeVector centre = fiber->GetObjectTranslation();
+        for (G4int k=0; k<3; ++k) {
+            G4double halfExtent = fFiberHalfLength*std::abs(axis[k])
+                + fFiberRadius*std::sqrt(std::max(0., 1. - axis[k]*axis[k]));
+            boxMin[i][k] = centre[k] - halfExtent;
+            boxMax[i][k] = centre[k] + halfExtent;
+            if (boxMin[i][k] < -fVoxelSideLength - tolerance || boxMax[i][k] > fVoxelSideLength + tolerance) {
+                G4cerr << "VoxelizedNuclearDNA, Fatal Error. Fiber " << i << " leaves the voxel with FiberRadius = "
+                       << fFiberRadius/nm << " nm & FiberHalfLength = " << fFiberHalfLength/nm
+                       << " nm. The fibers are placed for the default 17 nm & 68 nm." << G4endl;
+                std::exit(EXIT_FAILURE);
+            }
+        }
+
+        for (G4int other=0; other<i; ++other) {
+            G4bool overlaps = true;
+            for (G4int k=0; k<3; ++k)
+                overlaps = overlaps && std::min(boxMax[i][k], boxMax[other][k])
+                                       - std::max(boxMin[i][k], boxMin[other][k]) > tolerance;
+            if (overlaps) {
+                G4cerr << "VoxelizedNuclearDNA, Fatal Error. Fibers " << other << " & " << i
+                       << " overlap with FiberRadius = " << fFiberRadius/nm << " nm & FiberHalfLength = "
+                       << fFiberHalfLength/nm << " nm. The fibers are placed for the default 17 nm & 68 nm."
+                       << G4endl;
+                std::exit(EXIT_FAILURE);
+            }
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Return a string identifying everything the residue cut planes depend on: the fiber model, the
+// residue radii, the number of bp used per nucleosome & the basis nucleosome used as the template.
+//--------------------------------------------------------------------------------------------------
+G4String VoxelizedNuclearDNA::GetFiberModelKey(G4int nucleosome)
+{
+    std::ostringstream key;
+    key << std::setprecision(12)
+        << fGeoCalculation->GetFiberModel()
+        << "|" << fGeoCalculation->GetFiberNbNuclPerTurn()
+        << "|" << fGeoCalculation->GetFiberPitch()/nm
+        << "|" << fGeoCalculation->GetFiberCentralRadius()/nm
+        << "|" << fGeoCalculation->GetLinkerNumBp()
+        << "|" << fSugarTMPRadius/nm << "|" << fSugarTHFRadius/nm << "|" << fBaseRadius/nm
+        << "|" << fNumBpPerNucleosome
+        << "|" << nucleosome;
+    return key.str();
+}
+
+
 //--------------------------------------------------------------------------------------------------
 // This method arranges identical DNA fibers in a cubic voxel, and returns the logical volume of
 // that voxel. Current implementation places 20 fibers in fractal pattern, similar to that
@@ -1094,10 +1375,42 @@ G4LogicalVolume* VoxelizedNuclearDNA::ConstructLogicalVoxel(G4LogicalVolume* lFi
         fibreRotation->rotateX(CLHEP::pi);
         CreatePhysicalVolume("Fiber",19,true,lFiber,fibreRotation,&fibrePlacement,voxelLogical);
 
+        // The positions above are fixed for the default fibre envelope, so check that the fibres
+        // still fit for the given FiberRadius & FiberHalfLength
+        CheckFiberPlacements(voxelLogical);
+
         return voxelLogical;
 }
 
 
+//--------------------------------------------------------------------------------------------------
+// Arrange identical voxels in a cubic nucleus & return the logical volume of that nucleus. Same
+// arrangement of nested replicas as the single nucleus built in Construct(), but with logical
+// mothers, since the nucleus is placed several times.
+//--------------------------------------------------------------------------------------------------
+G4LogicalVolume* VoxelizedNuclearDNA::ConstructLogicalNucleus(G4LogicalVolume* voxelLogical) {
+    G4double nucleusSideLength = fVoxelSideLength * fNumVoxelsPerSide;
+
+    G4Box* solidNucleus = new G4Box("solid_nucleus", nucleusSideLength, nucleusSideLength, nucleusSideLength);
+    G4LogicalVolume* nucleusLogical = CreateLogicalVolume("Nucleus",fWaterName,solidNucleus);
+
+    // Outermost dimension is Y. Reserve 3D space for replicated 2D arrays of voxels.
+    G4Box* solidEmptyVoxelArea = new G4Box("solid_voxel_area", nucleusSideLength, fVoxelSideLength, nucleusSideLength);
+    G4LogicalVolume* logEmptyVoxelArea = CreateLogicalVolume("Voxel",fWaterName,solidEmptyVoxelArea);
+    new G4PVReplica("ReplicaVoxels3D",logEmptyVoxelArea,nucleusLogical,kYAxis,fNumVoxelsPerSide,2*fVoxelSideLength);
+
+    // Middle dimension is X. Reserve 2D space for replicated 1D arrays of voxels in xz-plane.
+    G4Box* solidEmptyVoxelLength = new G4Box("solid_voxel_length", fVoxelSideLength, fVoxelSideLength, nucleusSideLength);
+    G4LogicalVolume* logEmptyVoxelLength = CreateLogicalVolume("Voxel",fWaterName,solidEmptyVoxelLength);
+    new G4PVReplica("ReplicaVoxels2D",logEmptyVoxelLength,logEmptyVoxelArea,kXAxis,fNumVoxelsPerSide,2*fVoxelSideLength);
+
+    // Innermost dimension is Z. Fill 1D array of voxels in z-dimension.
+    new G4PVReplica("ReplicaVoxels1D",voxelLogical,logEmptyVoxelLength,kZAxis,fNumVoxelsPerSide,2*fVoxelSideLength);
+
+    return nucleusLogical;
+}
+
+
 //--------------------------------------------------------------------------------------------------
 // Helper function used if a geometrical overlap is detected. Return the standard Topas message
 // about geometry overlaps and exit gracefully.
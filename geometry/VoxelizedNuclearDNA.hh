@@ -15,15 +15,15 @@
 #include "TsVGeometryComponent.hh"
 
 #include <map>
+#include <vector>
 #include "G4VSolid.hh"
 #include "G4LogicalVolume.hh"
 #include "G4Orb.hh"
 #include "GeoCalculationV2.hh"
+#include "DNAOverlapChecker.hh"
+#include "FiberTemplateFile.hh"
 
 
-
-struct DNAPlacementData;
-
 class VoxelizedNuclearDNA : public TsVGeometryComponent
 {
 public:
@@ -52,33 +52,91 @@ private:
     //----------------------------------------------------------------------------------------------
     // Create and return a logical volume for a chromatin fiber.
     //----------------------------------------------------------------------------------------------
-    G4LogicalVolume *BuildLogicFiber(std::vector<std::vector<DNAPlacementData> > *dnaVolPos,
-                                     std::vector<G4ThreeVector> *posNucleo,
+    G4LogicalVolume *BuildLogicFiber(const DNAPositionBuffer *basisPositions,
                                      std::map<G4ThreeVector, G4double> *posAndRadiusMap);
 
     //----------------------------------------------------------------------------------------------
-    // Create the solid and logical volumes required to build DNA around one histone.
-    // Return a map as:
+    // Set up the DNAFiberTemplate of this component with the residues & histones of the whole
+    // fiber: attached to fTemplateFile if it holds one, otherwise filled by FillFiberTemplate().
+    // Used instead of placing the DNA volumes when the fiber is a proxy.
+    //----------------------------------------------------------------------------------------------
+    void BuildFiberTemplate(const DNAPositionBuffer& fiberPositions, G4int templateIndex,
+                            G4LogicalVolume* logicFiber);
+    void FillFiberTemplate(const DNAPositionBuffer& fiberPositions, G4int templateIndex);
+
+    //----------------------------------------------------------------------------------------------
+    // Fill fResidueCutPlanes & fiberPositions for this fiber model. If a FiberTemplateFile is set,
+    // both point into that file, which is written by the first process to need it.
+    //----------------------------------------------------------------------------------------------
+    void PrepareFiberData(const DNAPositionBuffer *basisPositions, G4int templateIndex,
+                          std::map<G4ThreeVector, G4double> *posAndRadiusMap, G4double zOffset,
+                          DNAPositionBuffer *fiberPositions);
+
+    //----------------------------------------------------------------------------------------------
+    // Calculate the planes used to cut each residue of the template nucleosome (the given
+    // nucleosome of basisPositions) & save them in fResidueCutPlanes.
+    //----------------------------------------------------------------------------------------------
+    void CalculateNucleosomeCutPlanes(const DNAPositionBuffer *basisPositions, G4int nucleosome,
+                                      std::map<G4ThreeVector, G4double> *posAndRadiusMap);
+
+    //----------------------------------------------------------------------------------------------
+    // Create the solid and logical volumes required to build DNA around one histone, using the
+    // planes in fResidueCutPlanes. Return a map as:
     // Key: name of the volume (base1, base2, base1Water, ...). Size = 12.
-    // Content: vector of corresponding logical volumes (each vector size = 200)
+    // Content: vector of corresponding logical volumes (each vector size = fNumBpPerNucleosome)
+    //----------------------------------------------------------------------------------------------
+    std::map<G4String, std::vector<G4LogicalVolume *> >* CreateNucleosomeCuttedSolidsAndLogicals();
+
+    //----------------------------------------------------------------------------------------------
+    // Algorithm for cutting DNA residue solids to avoid overlaps. Fill cutPlanes with the planes
+    // that cut the reference residue (in the residue frame) against all overlapping targets.
     //----------------------------------------------------------------------------------------------
-    std::map<G4String, std::vector<G4LogicalVolume *> >* CreateNucleosomeCuttedSolidsAndLogicals(
-        std::vector<DNAPlacementData> *nucleosomeVolumePositions,
-        std::map<G4ThreeVector, G4double> *posAndRadiusMap);
+    void CalculateCutPlanes(const G4ThreeVector& posRef,
+                            G4double radiusRef,
+                            std::map<G4ThreeVector, G4double> *tarMap,
+                            std::vector<ResidueCutPlane> *cutPlanes);
 
     //----------------------------------------------------------------------------------------------
-    // Algorithm for cutting DNA residue solids to avoid overlaps. Return the cut spherical solid.
+    // Return the spherical solid cut by the given planes (or the solid itself if there are none).
     //----------------------------------------------------------------------------------------------
     G4VSolid *CreateCutSolid(G4Orb *solidOrbRef,
-                             G4ThreeVector& posRef,
-                             std::map<G4ThreeVector, G4double> *tarMap,
-                             G4String volName = "");
+                             const std::vector<ResidueCutPlane>& cutPlanes);
+
+    //----------------------------------------------------------------------------------------------
+    // Return a string identifying the fiber model & all other inputs of the residue cut planes.
+    // Used as the key of fCutPlaneCache.
+    //----------------------------------------------------------------------------------------------
+    G4String GetFiberModelKey(G4int nucleosome);
+
+    //----------------------------------------------------------------------------------------------
+    // Return the cut planes of residue (index in the order sugarTMP1, sugarTHF1, base1, base2,
+    // sugarTHF2, sugarTMP2) of bp j, rotated about the fiber axis by rotationAngle.
+    //----------------------------------------------------------------------------------------------
+    std::vector<ResidueCutPlane> GetResidueCutPlanes(G4int residue, G4int j, G4double rotationAngle = 0.) const
+    {return fResidueCutPlanes.GetPlanes(residue*fNumBpPerNucleosome + j, rotationAngle);}
+
+    //----------------------------------------------------------------------------------------------
+    // Exit if a residue or histone of the fiber is not entirely inside the fiber volume.
+    //----------------------------------------------------------------------------------------------
+    void CheckFiberContents(const DNAPositionBuffer& fiberPositions);
 
     //----------------------------------------------------------------------------------------------
     // Arrange identical DNA fibers in a cubic voxel. Return the logical volume of that voxel.
     //----------------------------------------------------------------------------------------------
     G4LogicalVolume *ConstructLogicalVoxel(G4LogicalVolume* logicalFiber);
 
+    //----------------------------------------------------------------------------------------------
+    // Exit if a fiber placed in the voxel leaves it or overlaps another fiber, i.e. if the fiber
+    // envelope does not fit the fixed fiber positions of ConstructLogicalVoxel().
+    //----------------------------------------------------------------------------------------------
+    void CheckFiberPlacements(G4LogicalVolume* voxelLogical);
+
+    //----------------------------------------------------------------------------------------------
+    // Arrange identical voxels in a cubic nucleus. Return the logical volume of that nucleus, which
+    // is placed once per nucleus of a cell population.
+    //----------------------------------------------------------------------------------------------
+    G4LogicalVolume *ConstructLogicalNucleus(G4LogicalVolume* voxelLogical);
+
     //----------------------------------------------------------------------------------------------
     // Helper function to detect if geometrical overlap & throw error if so.
     //----------------------------------------------------------------------------------------------
@@ -94,13 +152,24 @@ private:
     G4bool fCheckForOverlaps;
     G4int fOverlapsResolution;
     G4bool fQuitIfOverlap;
+    G4bool fCheckForOverlapsAnalytically;
+    G4int fNumOverlapsToReport;
 
     G4bool fFillFibersWithDNA;
 
+    G4bool fUseFiberProxy;
+    G4String fFiberProxyMaterialName;
+    G4bool fBuildFiberTemplate;
+
+    G4String fFiberTemplateFileName;
+
     G4bool fBuildNucleus;
     G4int fNumVoxelsPerSide;
     G4double fVoxelSideLength;
 
+    // Centres of the nuclei (component frame). Several nuclei share one logical nucleus volume.
+    std::vector<G4ThreeVector> fNucleusCentres;
+
     G4VPhysicalVolume* pFiber;
 
     G4bool fUseG4Volumes;
@@ -113,9 +182,12 @@ private:
     G4double fFiberRadius;
     G4double fFiberHalfLength;
 
+    G4String fFiberModel;
     G4double fFiberPitch;
     G4double fFiberNbNuclPerTurn;
     G4double fFiberDeltaAngle;
+    G4double fFiberCentralRadius;
+    G4int fLinkerNumBp;
 
     G4double fHistoneHeight;
     G4double fHistoneRadius;
@@ -134,6 +206,18 @@ private:
 		G4String fHistoneMaterialName;
     G4Material* fHistoneMaterial;
 
+    // Planes used to cut each residue of the basis nucleosome. Residue r (in the order of
+    // GetResidueCutPlanes()) of bp j is entry r*fNumBpPerNucleosome + j.
+    ResidueCutPlaneTable fResidueCutPlanes;
+
+    // fResidueCutPlanes of every fiber model computed so far in this session, keyed by
+    // GetFiberModelKey(). Shared by all instances of this component.
+    static std::map<G4String, ResidueCutPlaneTable> fCutPlaneCache;
+
+    // The mapped FiberTemplateFile, if any. Kept open for the whole session, since the fiber
+    // template of this component points into it.
+    FiberTemplateFile fTemplateFile;
+
     // This map is indexed as moleculeName: <x, y, z, copyNumber, strand>
     std::map<G4String, std::vector<std::vector<double> > >* fpDnaMoleculePositions;
 };
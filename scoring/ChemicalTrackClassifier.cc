@@ -0,0 +1,128 @@
+// Extra Class for ClusteredDNADamage
+//
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class classifies each chemical track (molecule) once, when the chemistry scheduler starts
+// tracking it, using the material at its vertex. Molecules created inside DNA or histone volumes
+// are killed immediately, so they are never diffused & never take part in reactions. Optionally,
+// all other molecules are collected for the IRT chemistry of the scorer & killed too.
+//**************************************************************************************************
+
+#include "ChemicalTrackClassifier.hh"
+
+#include "G4Scheduler.hh"
+#include "G4Navigator.hh"
+#include "G4TransportationManager.hh"
+#include "G4LogicalVolume.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4Track.hh"
+#include "G4Step.hh"
+#include "G4Molecule.hh"
+
+//--------------------------------------------------------------------------------------------------
+// Constructor
+//--------------------------------------------------------------------------------------------------
+ChemicalTrackClassifier::ChemicalTrackClassifier(G4Material* dnaMaterial, G4Material* histoneMaterial)
+    : fDNAMaterial(dnaMaterial), fHistoneMaterial(histoneMaterial), fWrappedInteractivity(NULL),
+      fIsInstalled(false), fNavigator(NULL), fNumKilledAtBirth(0), fCollectMolecules(false)
+{}
+
+//--------------------------------------------------------------------------------------------------
+// Destructor. Restore the wrapped interactivity if this classifier is still installed.
+//--------------------------------------------------------------------------------------------------
+ChemicalTrackClassifier::~ChemicalTrackClassifier()
+{
+    G4Scheduler* scheduler = G4Scheduler::Instance();
+    if (fIsInstalled && scheduler->GetInteractivity() == this)
+        scheduler->SetInteractivity(fWrappedInteractivity);
+    delete fNavigator;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Install in the chemistry scheduler of the current thread.
+//--------------------------------------------------------------------------------------------------
+void ChemicalTrackClassifier::Install()
+{
+    G4Scheduler* scheduler = G4Scheduler::Instance();
+    if (scheduler->GetInteractivity() == this) return;
+
+    fWrappedInteractivity = scheduler->GetInteractivity();
+    scheduler->SetInteractivity(this);
+    fIsInstalled = true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Kill the track if it was created in a DNA or histone volume. The track has not moved yet, so its
+// position is its vertex. Other tracks are collected & killed if collecting.
+//--------------------------------------------------------------------------------------------------
+void ChemicalTrackClassifier::StartTracking(G4Track* track)
+{
+    G4Material* vertexMaterial = LocateMaterial(track);
+    if (vertexMaterial && (vertexMaterial == fDNAMaterial || vertexMaterial == fHistoneMaterial)) {
+        track->SetTrackStatus(fStopAndKill);
+        fNumKilledAtBirth++;
+    }
+    else if (fCollectMolecules) {
+        CollectedMolecule molecule = {GetMolecule(track)->GetMolecularConfiguration(), track->GetPosition(),
+                                      track->GetGlobalTime()};
+        fCollectedMolecules.push_back(molecule);
+        track->SetTrackStatus(fStopAndKill);
+    }
+
+    if (fWrappedInteractivity)
+        fWrappedInteractivity->StartTracking(track);
+    else
+        G4ITTrackingInteractivity::StartTracking(track);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Locate the track with a dedicated navigator. Created on first use, once the world exists.
+//--------------------------------------------------------------------------------------------------
+G4Material* ChemicalTrackClassifier::LocateMaterial(const G4Track* track)
+{
+    if (!fNavigator) {
+        G4VPhysicalVolume* world = G4TransportationManager::GetTransportationManager()
+                                       ->GetNavigatorForTracking()->GetWorldVolume();
+        if (!world) return NULL;
+        fNavigator = new G4Navigator();
+        fNavigator->SetWorldVolume(world);
+    }
+
+    G4VPhysicalVolume* volume = fNavigator->LocateGlobalPointAndSetup(track->GetPosition(), NULL, false, true);
+    if (!volume) return NULL;
+    return volume->GetLogicalVolume()->GetMaterial();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Calls forwarded to the wrapped interactivity
+//--------------------------------------------------------------------------------------------------
+void ChemicalTrackClassifier::Initialize()
+{
+    if (fWrappedInteractivity) fWrappedInteractivity->Initialize();
+    else G4ITTrackingInteractivity::Initialize();
+}
+
+void ChemicalTrackClassifier::AppendStep(G4Track* track, G4Step* step)
+{
+    if (fWrappedInteractivity) fWrappedInteractivity->AppendStep(track, step);
+    else G4ITTrackingInteractivity::AppendStep(track, step);
+}
+
+void ChemicalTrackClassifier::EndTracking(G4Track* track)
+{
+    if (fWrappedInteractivity) fWrappedInteractivity->EndTracking(track);
+    else G4ITTrackingInteractivity::EndTracking(track);
+}
+
+void ChemicalTrackClassifier::Finalize()
+{
+    if (fWrappedInteractivity) fWrappedInteractivity->Finalize();
+    else G4ITTrackingInteractivity::Finalize();
+}
+
+void ChemicalTrackClassifier::TrackBanned(G4Track* track)
+{
+    if (fWrappedInteractivity) fWrappedInteractivity->TrackBanned(track);
+    else G4ITTrackingInteractivity::TrackBanned(track);
+}
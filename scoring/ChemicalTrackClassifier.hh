@@ -0,0 +1,101 @@
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class classifies each chemical track (molecule) once, when the chemistry scheduler starts
+// tracking it, using the material at its vertex. Molecules created inside DNA or histone volumes
+// are killed immediately, so they are never diffused & never take part in reactions. Without it,
+// ScoreClusteredDNADamage kills these molecules when they first reach a volume boundary, which
+// requires looking up the vertex material at every chemical step.
+//
+// The classifier is installed as the tracking interactivity of the chemistry scheduler of the
+// current thread. Any interactivity installed before it is kept & receives all calls.
+//
+// For the IRT chemistry of the scorer, the classifier can also collect the species, position & time
+// of every other molecule & kill it, so the scheduler diffuses nothing (see IRTChemistry).
+//**************************************************************************************************
+
+#ifndef ChemicalTrackClassifier_hh
+#define ChemicalTrackClassifier_hh
+
+#include "G4ITTrackingInteractivity.hh"
+#include "G4ThreeVector.hh"
+
+#include <vector>
+
+class G4Material;
+class G4MolecularConfiguration;
+class G4Navigator;
+class G4Track;
+class G4Step;
+
+class ChemicalTrackClassifier : public G4ITTrackingInteractivity
+{
+public:
+    //----------------------------------------------------------------------------------------------
+    // Molecule collected at its creation
+    //----------------------------------------------------------------------------------------------
+    struct CollectedMolecule
+    {
+        const G4MolecularConfiguration* configuration;
+        G4ThreeVector position;
+        G4double time;
+    };
+
+    //----------------------------------------------------------------------------------------------
+    // Constructor. Molecules whose vertex is in dnaMaterial or histoneMaterial are killed.
+    //----------------------------------------------------------------------------------------------
+    ChemicalTrackClassifier(G4Material* dnaMaterial, G4Material* histoneMaterial);
+
+    virtual ~ChemicalTrackClassifier();
+
+    //----------------------------------------------------------------------------------------------
+    // Install this classifier in the chemistry scheduler of the current thread, wrapping the
+    // interactivity already installed (if any). Has no effect if already installed.
+    //----------------------------------------------------------------------------------------------
+    void Install();
+
+    //----------------------------------------------------------------------------------------------
+    // G4ITTrackingInteractivity interface. StartTracking() classifies the track; all calls are
+    // forwarded to the wrapped interactivity.
+    //----------------------------------------------------------------------------------------------
+    virtual void Initialize();
+    virtual void StartTracking(G4Track* track);
+    virtual void AppendStep(G4Track* track, G4Step* step);
+    virtual void EndTracking(G4Track* track);
+    virtual void Finalize();
+    virtual void TrackBanned(G4Track* track);
+
+    //----------------------------------------------------------------------------------------------
+    // Number of molecules killed at creation since the classifier was constructed
+    //----------------------------------------------------------------------------------------------
+    G4long GetNumKilledAtBirth() const {return fNumKilledAtBirth;}
+
+    //----------------------------------------------------------------------------------------------
+    // Collection of the molecules not killed at birth. While enabled, they are killed once collected.
+    //----------------------------------------------------------------------------------------------
+    void SetCollectMolecules(G4bool collect) {fCollectMolecules = collect;}
+    const std::vector<CollectedMolecule>& GetCollectedMolecules() const {return fCollectedMolecules;}
+    void ClearCollectedMolecules() {fCollectedMolecules.clear();}
+
+private:
+    //----------------------------------------------------------------------------------------------
+    // Return the material at the position of the track, using a navigator separate from the one
+    // used for tracking so its state is not disturbed.
+    //----------------------------------------------------------------------------------------------
+    G4Material* LocateMaterial(const G4Track* track);
+
+    G4Material* fDNAMaterial;
+    G4Material* fHistoneMaterial;
+
+    G4ITTrackingInteractivity* fWrappedInteractivity;
+    G4bool fIsInstalled;
+
+    G4Navigator* fNavigator;
+
+    G4long fNumKilledAtBirth;
+
+    G4bool fCollectMolecules;
+    std::vector<CollectedMolecule> fCollectedMolecules;
+};
+
+#endif
@@ -0,0 +1,74 @@
+// Extra Class for ClusteredDNADamage
+//
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class tallies the populations & outcomes (damage, scavenging) of radiolytic species at a set
+// of time points of the chemical stage.
+//**************************************************************************************************
+
+#include "ChemistryYieldTally.hh"
+
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------------------
+// Constructor
+//--------------------------------------------------------------------------------------------------
+ChemistryYieldTally::ChemistryYieldTally(G4int numSpecies, const std::vector<G4double>& times)
+    : fNumSpecies(numSpecies), fTimes(times), fPopulations(numSpecies*times.size(), 0),
+      fOutcomes(numSpecies*kNumOutcomes*times.size(), 0)
+{}
+
+//--------------------------------------------------------------------------------------------------
+// Destructor
+//--------------------------------------------------------------------------------------------------
+ChemistryYieldTally::~ChemistryYieldTally()
+{}
+
+//--------------------------------------------------------------------------------------------------
+// Steps are short compared to the spacing of the time points, so a step usually covers none of them
+//--------------------------------------------------------------------------------------------------
+void ChemistryYieldTally::AddStep(G4int species, G4double startTime, G4double endTime)
+{
+    std::vector<G4double>::const_iterator time = std::lower_bound(fTimes.begin(), fTimes.end(), startTime);
+    std::int64_t* populations = &fPopulations[species*fTimes.size()];
+    for (; time != fTimes.end() && *time < endTime; ++time)
+        populations[time - fTimes.begin()]++;
+}
+
+void ChemistryYieldTally::AddOutcome(G4int species, G4int outcome, G4double time)
+{
+    size_t i = std::lower_bound(fTimes.begin(), fTimes.end(), time) - fTimes.begin();
+    if (i == fTimes.size()) i--;
+    fOutcomes[(species*kNumOutcomes + outcome)*fTimes.size() + i]++;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Outcomes counted up to a time point
+//--------------------------------------------------------------------------------------------------
+std::int64_t ChemistryYieldTally::GetCumulativeOutcomes(G4int species, G4int outcome, G4int i) const
+{
+    const std::int64_t* outcomes = &fOutcomes[(species*kNumOutcomes + outcome)*fTimes.size()];
+    std::int64_t total = 0;
+    for (G4int j=0; j<=i; ++j)
+        total += outcomes[j];
+    return total;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Merge the tally of a worker thread
+//--------------------------------------------------------------------------------------------------
+void ChemistryYieldTally::Absorb(ChemistryYieldTally& other)
+{
+    for (size_t i=0; i<fPopulations.size(); ++i)
+        fPopulations[i] += other.fPopulations[i];
+    for (size_t i=0; i<fOutcomes.size(); ++i)
+        fOutcomes[i] += other.fOutcomes[i];
+    other.Clear();
+}
+
+void ChemistryYieldTally::Clear()
+{
+    std::fill(fPopulations.begin(), fPopulations.end(), 0);
+    std::fill(fOutcomes.begin(), fOutcomes.end(), 0);
+}
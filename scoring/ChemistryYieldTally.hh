@@ -0,0 +1,74 @@
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class tallies the radiolytic yields of the chemical stage over time, for a few species: the
+// number of molecules present at each of a set of time points, and the number of molecules that
+// have damaged a residue, been scavenged by a residue or a histone, or been scavenged by the
+// cellular environment up to each time point. ScoreClusteredDNADamage fills one tally per thread
+// from the diffusion steps & encounters it sees, merges them at the end of the run & writes them as
+// G-values, to find the shortest chemical stage & coarsest time step that keep the yields stable.
+//
+// A molecule is present at time t if one of its steps starts at or before t & ends after it. An
+// outcome at time t is counted at the first time point at or after t (at the last time point if t
+// is later).
+//**************************************************************************************************
+
+#ifndef ChemistryYieldTally_hh
+#define ChemistryYieldTally_hh
+
+#include "G4Types.hh"
+
+#include <cstdint>
+#include <vector>
+
+class ChemistryYieldTally
+{
+public:
+    // Outcomes of a molecule
+    static const G4int kOutcomeDamage = 0;
+    static const G4int kOutcomeKilledByDNA = 1;
+    static const G4int kOutcomeKilledByHistone = 2;
+    static const G4int kOutcomeScavenged = 3; // by the cellular environment
+    static const G4int kNumOutcomes = 4;
+
+    //----------------------------------------------------------------------------------------------
+    // Tally of numSpecies species at the given time points (in increasing order)
+    //----------------------------------------------------------------------------------------------
+    ChemistryYieldTally(G4int numSpecies, const std::vector<G4double>& times);
+
+    ~ChemistryYieldTally();
+
+    //----------------------------------------------------------------------------------------------
+    // Count a molecule as present at the time points in [startTime, endTime) (one diffusion step)
+    //----------------------------------------------------------------------------------------------
+    void AddStep(G4int species, G4double startTime, G4double endTime);
+
+    //----------------------------------------------------------------------------------------------
+    // Count an outcome of a molecule at the given time
+    //----------------------------------------------------------------------------------------------
+    void AddOutcome(G4int species, G4int outcome, G4double time);
+
+    //----------------------------------------------------------------------------------------------
+    // Add the counts of another tally with the same species & time points, & clear them from it
+    //----------------------------------------------------------------------------------------------
+    void Absorb(ChemistryYieldTally& other);
+
+    void Clear();
+
+    //----------------------------------------------------------------------------------------------
+    // Getters. Outcomes are cumulative: counted from the start of the chemical stage up to the time
+    // point.
+    //----------------------------------------------------------------------------------------------
+    G4int GetNumberOfTimes() const {return (G4int)fTimes.size();}
+    G4double GetTime(G4int i) const {return fTimes[i];}
+    std::int64_t GetPopulation(G4int species, G4int i) const {return fPopulations[species*fTimes.size() + i];}
+    std::int64_t GetCumulativeOutcomes(G4int species, G4int outcome, G4int i) const;
+
+private:
+    G4int fNumSpecies;
+    std::vector<G4double> fTimes;
+    std::vector<std::int64_t> fPopulations; // [species][time point]
+    std::vector<std::int64_t> fOutcomes; // [species][outcome][time point], not cumulative
+};
+
+#endif
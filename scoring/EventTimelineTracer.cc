@@ -0,0 +1,261 @@
+// Extra Class for ClusteredDNADamage
+//
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class records the wall time spent in the stages of the events of one thread, and writes the
+// spans of all threads in the Chrome trace-event format.
+//**************************************************************************************************
+
+#include "EventTimelineTracer.hh"
+
+#include "G4EventManager.hh"
+#include "G4Event.hh"
+#include "G4Scheduler.hh"
+#include "G4Threading.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <set>
+
+//--------------------------------------------------------------------------------------------------
+// Constructor
+//--------------------------------------------------------------------------------------------------
+EventTimelineTracer::EventTimelineTracer(G4int bufferSize, G4int sampleInterval)
+    : fWrappedAction(NULL), fChemistryProbe(NULL), fIsInstalled(false), fSampleInterval(sampleInterval),
+      fIsSampling(true), fThreadID(G4Threading::G4GetThreadId()), fEventID(-1), fStage(kStageNone),
+      fStageStart(0), fEventStart(0), fBufferSize(bufferSize), fNextRecord(0)
+{
+    fRecords.reserve(fBufferSize);
+    Now(); // start the clock
+}
+
+//--------------------------------------------------------------------------------------------------
+// Destructor. Restore the wrapped event action & interactivity if this tracer is still installed.
+//--------------------------------------------------------------------------------------------------
+EventTimelineTracer::~EventTimelineTracer()
+{
+    if (fIsInstalled) {
+        G4EventManager* eventManager = G4EventManager::GetEventManager();
+        if (eventManager && eventManager->GetUserEventAction() == this)
+            eventManager->SetUserAction(fWrappedAction);
+
+        G4Scheduler* scheduler = G4Scheduler::Instance();
+        if (scheduler->GetInteractivity() == fChemistryProbe)
+            scheduler->SetInteractivity(fChemistryProbe->fWrappedInteractivity);
+    }
+    delete fChemistryProbe;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Install in the event manager & chemistry scheduler of the current thread. The master of a
+// multithreaded run has no event manager; it only records its own spans.
+//--------------------------------------------------------------------------------------------------
+void EventTimelineTracer::Install()
+{
+    G4EventManager* eventManager = G4EventManager::GetEventManager();
+    if (fIsInstalled || !eventManager) return;
+
+    fWrappedAction = eventManager->GetUserEventAction();
+    eventManager->SetUserAction(this);
+
+    G4Scheduler* scheduler = G4Scheduler::Instance();
+    fChemistryProbe = new ChemistryProbe(this);
+    fChemistryProbe->fWrappedInteractivity = scheduler->GetInteractivity();
+    scheduler->SetInteractivity(fChemistryProbe);
+
+    fIsInstalled = true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Start of an event: decide whether it is traced & start its physical stage
+//--------------------------------------------------------------------------------------------------
+void EventTimelineTracer::BeginOfEventAction(const G4Event* event)
+{
+    fEventID = event->GetEventID();
+    fIsSampling = fEventID % fSampleInterval == 0;
+    if (fIsSampling) {
+        fEventStart = Now();
+        fStage = kStagePhysical;
+        fStageStart = fEventStart;
+    }
+
+    if (fWrappedAction) fWrappedAction->BeginOfEventAction(event);
+}
+
+//--------------------------------------------------------------------------------------------------
+// End of an event: end its current stage (if the scorer did not), then record the whole event
+//--------------------------------------------------------------------------------------------------
+void EventTimelineTracer::EndOfEventAction(const G4Event* event)
+{
+    if (fWrappedAction) fWrappedAction->EndOfEventAction(event);
+
+    if (fIsSampling) {
+        std::int64_t now = Now();
+        EndStage(now);
+        AddRecord("Event", fEventStart, now);
+    }
+
+    // Spans recorded between events (e.g. at the end of the run) are always kept
+    fEventID = -1;
+    fIsSampling = true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Stages of an event
+//--------------------------------------------------------------------------------------------------
+void EventTimelineTracer::StartChemicalStage()
+{
+    if (!fIsSampling || fStage != kStagePhysical) return;
+    std::int64_t now = Now();
+    AddRecord("Physical transport", fStageStart, now);
+    fStage = kStageChemical;
+    fStageStart = now;
+}
+
+void EventTimelineTracer::EndStage(std::int64_t time)
+{
+    if (fStage == kStagePhysical)
+        AddRecord("Physical transport", fStageStart, time);
+    else if (fStage == kStageChemical)
+        AddRecord("Chemical stage", fStageStart, time);
+    fStage = kStageNone;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Scoped span
+//--------------------------------------------------------------------------------------------------
+EventTimelineTracer::Span::Span(EventTimelineTracer* tracer, const char* name)
+    : fTracer(tracer && tracer->fIsSampling ? tracer : NULL), fName(name), fStart(0)
+{
+    if (!fTracer) return;
+    fStart = Now();
+    fTracer->EndStage(fStart);
+}
+
+EventTimelineTracer::Span::~Span()
+{
+    if (fTracer) fTracer->AddRecord(fName, fStart, Now());
+}
+
+//--------------------------------------------------------------------------------------------------
+// Add a span to the ring buffer, overwriting the oldest once it is full
+//--------------------------------------------------------------------------------------------------
+void EventTimelineTracer::AddRecord(const char* name, std::int64_t start, std::int64_t end)
+{
+    Record record = {name, start, end, fThreadID, fEventID};
+    if (fRecords.size() < fBufferSize) {
+        fRecords.push_back(record);
+    }
+    else {
+        fRecords[fNextRecord] = record;
+        fNextRecord = (fNextRecord+1) % fBufferSize;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Gather the spans of a worker. Called by the master, after the worker's run has ended.
+//--------------------------------------------------------------------------------------------------
+void EventTimelineTracer::AbsorbSpans(EventTimelineTracer* workerTracer)
+{
+    fAbsorbedRecords.insert(fAbsorbedRecords.end(), workerTracer->fRecords.begin(), workerTracer->fRecords.end());
+    workerTracer->fRecords.clear();
+    workerTracer->fNextRecord = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Write the Chrome trace-event file: one complete ("X") event per span, with times in microseconds,
+// and the name of each thread ("M" events). Thread IDs are shifted by one so the master is 0.
+//--------------------------------------------------------------------------------------------------
+G4bool EventTimelineTracer::WriteChromeTrace(const G4String& fileName) const
+{
+    std::vector<Record> records(fAbsorbedRecords);
+    records.insert(records.end(), fRecords.begin(), fRecords.end());
+    std::sort(records.begin(), records.end(),
+              [](const Record& a, const Record& b) {return a.start < b.start;});
+
+    std::ofstream file(fileName.c_str(), std::ofstream::trunc);
+    if (!file) return false;
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    std::set<G4int> threadIDs;
+    for (size_t i=0; i<records.size(); ++i)
+        threadIDs.insert(records[i].threadID);
+    G4bool isFirst = true;
+    for (std::set<G4int>::const_iterator it=threadIDs.begin(); it!=threadIDs.end(); ++it) {
+        file << (isFirst ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << *it+1
+             << ",\"args\":{\"name\":\"";
+        if (*it < 0) file << "Master";
+        else file << "Worker " << *it;
+        file << "\"}}";
+        isFirst = false;
+    }
+
+    file.setf(std::ios::fixed);
+    file.precision(3);
+    for (size_t i=0; i<records.size(); ++i) {
+        const Record& record = records[i];
+        file << (isFirst ? "" : ",\n") << "{\"name\":\"" << record.name << "\",\"cat\":\""
+             << (record.eventID >= 0 ? "event" : "run") << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << record.threadID+1
+             << ",\"ts\":" << record.start*1e-3 << ",\"dur\":" << (record.end-record.start)*1e-3;
+        if (record.eventID >= 0) file << ",\"args\":{\"event\":" << record.eventID << "}";
+        file << "}";
+        isFirst = false;
+    }
+    file << "\n]}\n";
+    file.close();
+    return (G4bool)file;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Nanoseconds since the first call in this process, on a monotonic clock shared by all threads
+//--------------------------------------------------------------------------------------------------
+std::int64_t EventTimelineTracer::Now()
+{
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Chemistry probe. The first chemical track of an event starts the chemical stage; all calls are
+// forwarded to the wrapped interactivity.
+//--------------------------------------------------------------------------------------------------
+void EventTimelineTracer::ChemistryProbe::StartTracking(G4Track* track)
+{
+    fTracer->StartChemicalStage();
+
+    if (fWrappedInteractivity) fWrappedInteractivity->StartTracking(track);
+    else G4ITTrackingInteractivity::StartTracking(track);
+}
+
+void EventTimelineTracer::ChemistryProbe::Initialize()
+{
+    if (fWrappedInteractivity) fWrappedInteractivity->Initialize();
+    else G4ITTrackingInteractivity::Initialize();
+}
+
+void EventTimelineTracer::ChemistryProbe::AppendStep(G4Track* track, G4Step* step)
+{
+    if (fWrappedInteractivity) fWrappedInteractivity->AppendStep(track, step);
+    else G4ITTrackingInteractivity::AppendStep(track, step);
+}
+
+void EventTimelineTracer::ChemistryProbe::EndTracking(G4Track* track)
+{
+    if (fWrappedInteractivity) fWrappedInteractivity->EndTracking(track);
+    else G4ITTrackingInteractivity::EndTracking(track);
+}
+
+void EventTimelineTracer::ChemistryProbe::Finalize()
+{
+    if (fWrappedInteractivity) fWrappedInteractivity->Finalize();
+    else G4ITTrackingInteractivity::Finalize();
+}
+
+void EventTimelineTracer::ChemistryProbe::TrackBanned(G4Track* track)
+{
+    if (fWrappedInteractivity) fWrappedInteractivity->TrackBanned(track);
+    else G4ITTrackingInteractivity::TrackBanned(track);
+}
@@ -0,0 +1,151 @@
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class records where wall time goes within the events of one thread: physical transport, the
+// chemical stage, and the damage analysis & output done by ScoreClusteredDNADamage at the end of
+// the event. On the master thread it records the absorption of the worker scorers and the analysis
+// & output done at the end of the run. The master gathers the spans of all threads & writes them in
+// the Chrome trace-event format (JSON), which any trace viewer (chrome://tracing, Perfetto) shows as
+// one timeline per thread, so the overlap of workers can be seen too.
+//
+// The physical stage of an event lasts from the start of the event to the first chemical track (or
+// to the end-of-event analysis if there is no chemistry). The chemical stage lasts until the
+// analysis starts. Only one event in K is traced (eventID % K == 0), to keep the overhead low.
+//
+// Spans are kept in a fixed-size ring buffer per thread (one tracer per scorer instance), so a long
+// run keeps its most recent spans.
+//
+// The tracer is installed as the user event action of the event manager of the current thread,
+// and as the tracking interactivity of its chemistry scheduler. The action & interactivity
+// installed before it are kept & receive all calls.
+//**************************************************************************************************
+
+#ifndef EventTimelineTracer_hh
+#define EventTimelineTracer_hh
+
+#include "G4UserEventAction.hh"
+#include "G4ITTrackingInteractivity.hh"
+#include "G4String.hh"
+
+#include <cstdint>
+#include <vector>
+
+class G4Event;
+class G4Track;
+class G4Step;
+
+class EventTimelineTracer : public G4UserEventAction
+{
+public:
+    //----------------------------------------------------------------------------------------------
+    // Constructor. Keep at most bufferSize spans; trace one event in sampleInterval.
+    //----------------------------------------------------------------------------------------------
+    EventTimelineTracer(G4int bufferSize, G4int sampleInterval);
+    virtual ~EventTimelineTracer();
+
+    //----------------------------------------------------------------------------------------------
+    // Install this tracer in the event manager & chemistry scheduler of the current thread. Has no
+    // effect if already installed.
+    //----------------------------------------------------------------------------------------------
+    void Install();
+
+    //----------------------------------------------------------------------------------------------
+    // G4UserEventAction interface. Calls are forwarded to the wrapped event action, inside the span
+    // of the event.
+    //----------------------------------------------------------------------------------------------
+    virtual void BeginOfEventAction(const G4Event* event);
+    virtual void EndOfEventAction(const G4Event* event);
+
+    //----------------------------------------------------------------------------------------------
+    // Whether the current event is traced (always true outside events, e.g. on the master)
+    //----------------------------------------------------------------------------------------------
+    G4bool IsSampling() const {return fIsSampling;}
+
+    //----------------------------------------------------------------------------------------------
+    // Records a span from its construction to its destruction, if the tracer is not null & is
+    // sampling. Opening a span ends the physical or chemical stage of the current event.
+    //----------------------------------------------------------------------------------------------
+    class Span
+    {
+    public:
+        Span(EventTimelineTracer* tracer, const char* name);
+        ~Span();
+
+    private:
+        EventTimelineTracer* fTracer;
+        const char* fName;
+        std::int64_t fStart;
+    };
+
+    //----------------------------------------------------------------------------------------------
+    // Add the spans of a worker's tracer to this one & clear them from the worker's
+    //----------------------------------------------------------------------------------------------
+    void AbsorbSpans(EventTimelineTracer* workerTracer);
+
+    //----------------------------------------------------------------------------------------------
+    // Write all spans to a JSON file in the Chrome trace-event format. Return false if the file
+    // could not be written.
+    //----------------------------------------------------------------------------------------------
+    G4bool WriteChromeTrace(const G4String& fileName) const;
+
+private:
+    struct Record
+    {
+        const char* name; // string literal
+        std::int64_t start; // ns since the first use of the tracer in this process
+        std::int64_t end;
+        G4int threadID;
+        G4int eventID; // -1 outside events
+    };
+
+    //----------------------------------------------------------------------------------------------
+    // Forwards the chemistry scheduler's calls to the tracer & the wrapped interactivity
+    //----------------------------------------------------------------------------------------------
+    class ChemistryProbe : public G4ITTrackingInteractivity
+    {
+    public:
+        ChemistryProbe(EventTimelineTracer* tracer) : fTracer(tracer), fWrappedInteractivity(NULL) {}
+
+        virtual void Initialize();
+        virtual void StartTracking(G4Track* track);
+        virtual void AppendStep(G4Track* track, G4Step* step);
+        virtual void EndTracking(G4Track* track);
+        virtual void Finalize();
+        virtual void TrackBanned(G4Track* track);
+
+        EventTimelineTracer* fTracer;
+        G4ITTrackingInteractivity* fWrappedInteractivity;
+    };
+
+    // Stage of the current event
+    static const G4int kStageNone = 0;
+    static const G4int kStagePhysical = 1;
+    static const G4int kStageChemical = 2;
+
+    static std::int64_t Now();
+
+    void AddRecord(const char* name, std::int64_t start, std::int64_t end);
+    void StartChemicalStage();
+    void EndStage(std::int64_t time);
+
+    G4UserEventAction* fWrappedAction;
+    ChemistryProbe* fChemistryProbe;
+    G4bool fIsInstalled;
+
+    G4int fSampleInterval;
+    G4bool fIsSampling;
+    G4int fThreadID;
+    G4int fEventID;
+    G4int fStage;
+    std::int64_t fStageStart;
+    std::int64_t fEventStart;
+
+    // Ring buffer of spans: fRecords[fNextRecord] is the oldest once the buffer is full
+    std::vector<Record> fRecords;
+    size_t fBufferSize;
+    size_t fNextRecord;
+
+    std::vector<Record> fAbsorbedRecords; // spans of the worker tracers, on the master
+};
+
+#endif
@@ -0,0 +1,422 @@
+// Extra Class for ClusteredDNADamage
+//
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class runs the chemical stage of one event with the independent reaction times (IRT) method:
+// radical-radical reactions & encounters of species with static DNA targets (residues & histones).
+//**************************************************************************************************
+
+#include "IRTChemistry.hh"
+#include "DNAFiberTemplate.hh"
+
+#include "G4DNAMolecularReactionTable.hh"
+#include "G4MolecularConfiguration.hh"
+#include "G4SystemOfUnits.hh"
+#include "Randomize.hh"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+//--------------------------------------------------------------------------------------------------
+// Inverse of the complementary error function, for 0 < y < 2. Initial guess from the single
+// precision approximation of M. Giles (2010), written for x = 1-y so small y loses no precision,
+// then refined by Newton iterations on erfc.
+//--------------------------------------------------------------------------------------------------
+static G4double InverseErfc(G4double y)
+{
+    G4double w = -std::log(y*(2.-y));
+    G4double p;
+    if (w < 5.) {
+        w -= 2.5;
+        p = 2.81022636e-08;
+        p = 3.43273939e-07 + p*w;
+        p = -3.5233877e-06 + p*w;
+        p = -4.39150654e-06 + p*w;
+        p = 0.00021858087 + p*w;
+        p = -0.00125372503 + p*w;
+        p = -0.00417768164 + p*w;
+        p = 0.246640727 + p*w;
+        p = 1.50140941 + p*w;
+    }
+    else {
+        w = std::sqrt(w) - 3.;
+        p = -0.000200214257;
+        p = 0.000100950558 + p*w;
+        p = 0.00134934322 + p*w;
+        p = -0.00367342844 + p*w;
+        p = 0.00573950773 + p*w;
+        p = -0.0076224613 + p*w;
+        p = 0.00943887047 + p*w;
+        p = 1.00167406 + p*w;
+        p = 2.83297682 + p*w;
+    }
+    G4double x = p*(1.-y);
+
+    for (G4int i=0; i<2; ++i)
+        x += (std::erfc(x) - y)/(2./std::sqrt(CLHEP::pi)*std::exp(-x*x));
+    return x;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Constructor
+//--------------------------------------------------------------------------------------------------
+IRTChemistry::IRTChemistry()
+    : fFiberTemplate(NULL), fReactionTable(G4DNAMolecularReactionTable::Instance()), fEndTime(1.*ns),
+      fUseHydrationShells(false), fHistoneSphereRadius(0.), fNumInitialSpecies(0), fNumReactions(0), fNumScavenged(0), fMaxReactionRadius(0.),
+      fMaxDiffusionCoefficient(0.), fCellSize(0.)
+{}
+
+//--------------------------------------------------------------------------------------------------
+// Destructor
+//--------------------------------------------------------------------------------------------------
+IRTChemistry::~IRTChemistry()
+{}
+
+//--------------------------------------------------------------------------------------------------
+// Set the species that react with residues & with histones, indexed by molecule ID
+//--------------------------------------------------------------------------------------------------
+void IRTChemistry::SetTargetSpecies(const std::vector<G4int>& residueSpecies, const std::vector<G4int>& histoneSpecies)
+{
+    fIsResidueTarget.clear();
+    fIsHistoneTarget.clear();
+    for (size_t i=0; i<residueSpecies.size(); ++i) {
+        if (residueSpecies[i] >= (G4int)fIsResidueTarget.size()) fIsResidueTarget.resize(residueSpecies[i]+1, false);
+        fIsResidueTarget[residueSpecies[i]] = true;
+    }
+    for (size_t i=0; i<histoneSpecies.size(); ++i) {
+        if (histoneSpecies[i] >= (G4int)fIsHistoneTarget.size()) fIsHistoneTarget.resize(histoneSpecies[i]+1, false);
+        fIsHistoneTarget[histoneSpecies[i]] = true;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Set the scavenging rates, indexed by molecule ID
+//--------------------------------------------------------------------------------------------------
+void IRTChemistry::SetScavengingRates(const std::map<G4int, G4double>& scavengingRates)
+{
+    fScavengingRates.clear();
+    for (std::map<G4int, G4double>::const_iterator it=scavengingRates.begin(); it!=scavengingRates.end(); ++it) {
+        if (it->first >= (G4int)fScavengingRates.size()) fScavengingRates.resize(it->first+1, 0.);
+        fScavengingRates[it->first] = it->second;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Discard the species & reactions of the previous event. Configurations are kept, since the same
+// species are created by every event.
+//--------------------------------------------------------------------------------------------------
+void IRTChemistry::Clear()
+{
+    fSpecies.clear();
+    fFiberFrames.clear();
+    fNumInitialSpecies = 0;
+    fNumReactions = 0;
+    fNumScavenged = 0;
+    fCells.clear();
+    fReactions = std::priority_queue<Reaction, std::vector<Reaction>, std::greater<Reaction> >();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Add a species created by the event
+//--------------------------------------------------------------------------------------------------
+void IRTChemistry::AddSpecies(const G4MolecularConfiguration* configuration, const G4ThreeVector& position,
+                              G4double time, const G4AffineTransform* globalToFiber, G4int voxelID, G4int fiberID)
+{
+    G4int fiberFrame = -1;
+    if (globalToFiber) {
+        FiberFrame frame = {*globalToFiber, voxelID, fiberID};
+        fFiberFrames.push_back(frame);
+        fiberFrame = (G4int)fFiberFrames.size() - 1;
+    }
+    CreateSpecies(configuration, position, time, fiberFrame);
+}
+
+G4int IRTChemistry::CreateSpecies(const G4MolecularConfiguration* configuration, const G4ThreeVector& position,
+                                  G4double time, G4int fiberFrame)
+{
+    RegisterConfiguration(configuration);
+    Species species = {configuration, configuration->GetMoleculeID(), configuration->GetDiffusionCoefficient(),
+                       position, time, true, fiberFrame};
+    fSpecies.push_back(species);
+    return (G4int)fSpecies.size() - 1;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Update the largest reaction radius & diffusion coefficient with a configuration not seen before
+//--------------------------------------------------------------------------------------------------
+void IRTChemistry::RegisterConfiguration(const G4MolecularConfiguration* configuration)
+{
+    if (std::find(fConfigurations.begin(), fConfigurations.end(), configuration) != fConfigurations.end()) return;
+    fConfigurations.push_back(configuration);
+
+    fMaxDiffusionCoefficient = std::max(fMaxDiffusionCoefficient, configuration->GetDiffusionCoefficient());
+    for (size_t i=0; i<fConfigurations.size(); ++i) {
+        const G4DNAMolecularReactionData* data = fReactionTable->GetReactionData(
+            const_cast<G4MolecularConfiguration*>(configuration), const_cast<G4MolecularConfiguration*>(fConfigurations[i]));
+        if (data) fMaxReactionRadius = std::max(fMaxReactionRadius, data->GetEffectiveReactionRadius());
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Three diffusion lengths over the remaining time: the probability of reacting from further away is
+// below erfc(3) = 2e-5.
+//--------------------------------------------------------------------------------------------------
+G4double IRTChemistry::GetReactionCutoff(G4double diffusionCoefficient, G4double time) const
+{
+    return 3.*std::sqrt(4.*diffusionCoefficient*std::max(fEndTime - time, 0.));
+}
+
+//--------------------------------------------------------------------------------------------------
+// A particle diffusing from distance r0 reaches a sphere of radius R before time t with probability
+// (R/r0)*erfc((r0-R)/sqrt(4Dt)), so it reaches it at all with probability R/r0. The time is sampled
+// by inverting this distribution.
+//--------------------------------------------------------------------------------------------------
+G4double IRTChemistry::SampleReactionTime(G4double r0, G4double R, G4double diffusionCoefficient,
+                                          G4double startTime) const
+{
+    if (r0 <= R) return startTime;
+    if (diffusionCoefficient <= 0.) return DBL_MAX;
+
+    G4double u = G4UniformRand()*r0/R;
+    if (u >= 1. || u <= 0.) return DBL_MAX;
+
+    G4double x = InverseErfc(u);
+    return startTime + (r0-R)*(r0-R)/(4.*diffusionCoefficient*x*x);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Key of the cell of a position, shifted by the given number of cells along each axis. Cell indices
+// are packed on 21 bits each, so neighbouring cells always have distinct keys; distant cells may
+// share a key, which only adds candidates that are rejected by their distance.
+//--------------------------------------------------------------------------------------------------
+std::int64_t IRTChemistry::GetCellKey(const G4ThreeVector& position, G4int offsetX, G4int offsetY, G4int offsetZ) const
+{
+    std::int64_t ix = (std::int64_t)std::floor(position.x()/fCellSize) + offsetX;
+    std::int64_t iy = (std::int64_t)std::floor(position.y()/fCellSize) + offsetY;
+    std::int64_t iz = (std::int64_t)std::floor(position.z()/fCellSize) + offsetZ;
+    return (ix & 0x1FFFFF) | ((iy & 0x1FFFFF) << 21) | ((iz & 0x1FFFFF) << 42);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Sample the reactions of all pairs of species within reach of each other, and of each species with
+// its DNA targets. The initial species are binned in a grid whose cells are the largest reach of a
+// pair, so only the neighbouring cells are searched.
+//--------------------------------------------------------------------------------------------------
+void IRTChemistry::Start()
+{
+    fNumInitialSpecies = (G4int)fSpecies.size();
+    if (fFiberTemplate) {
+        G4double histoneRadius = fFiberTemplate->GetHistoneRadius();
+        fHistoneSphereRadius = std::cbrt(1.5*histoneRadius*histoneRadius*fFiberTemplate->GetHistoneHalfHeight());
+    }
+
+    G4double startTime = fEndTime;
+    for (G4int i=0; i<fNumInitialSpecies; ++i)
+        startTime = std::min(startTime, fSpecies[i].time);
+    fCellSize = fMaxReactionRadius + GetReactionCutoff(2.*fMaxDiffusionCoefficient, startTime);
+
+    if (fCellSize > 0.) {
+        for (G4int i=0; i<fNumInitialSpecies; ++i)
+            fCells[GetCellKey(fSpecies[i].position, 0, 0, 0)].push_back(i);
+
+        for (G4int i=0; i<fNumInitialSpecies; ++i) {
+            for (G4int dz=-1; dz<=1; ++dz) {
+                for (G4int dy=-1; dy<=1; ++dy) {
+                    for (G4int dx=-1; dx<=1; ++dx) {
+                        std::unordered_map<std::int64_t, std::vector<G4int> >::const_iterator cell
+                            = fCells.find(GetCellKey(fSpecies[i].position, dx, dy, dz));
+                        if (cell == fCells.end()) continue;
+                        for (size_t n=0; n<cell->second.size(); ++n)
+                            if (cell->second[n] > i) SamplePairReaction(i, cell->second[n]);
+                    }
+                }
+            }
+        }
+    }
+
+    for (G4int i=0; i<fNumInitialSpecies; ++i) {
+        SampleTargetReactions(i);
+        SampleScavenging(i);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Sample the reaction of two species, if the reaction table has one. The pair is skipped if its
+// separation exceeds the reaction radius by more than the cutoff.
+//--------------------------------------------------------------------------------------------------
+void IRTChemistry::SamplePairReaction(G4int species1, G4int species2)
+{
+    const Species& first = fSpecies[species1];
+    const Species& second = fSpecies[species2];
+
+    const G4DNAMolecularReactionData* data = fReactionTable->GetReactionData(
+        const_cast<G4MolecularConfiguration*>(first.configuration), const_cast<G4MolecularConfiguration*>(second.configuration));
+    if (!data) return;
+
+    G4double reactionRadius = data->GetEffectiveReactionRadius();
+    G4double diffusionCoefficient = first.diffusionCoefficient + second.diffusionCoefficient;
+    G4double startTime = std::max(first.time, second.time);
+    G4double separation = (first.position - second.position).mag();
+    if (separation - reactionRadius > GetReactionCutoff(diffusionCoefficient, startTime)) return;
+
+    G4double time = SampleReactionTime(separation, reactionRadius, diffusionCoefficient, startTime);
+    if (time < fEndTime) {
+        Reaction reaction = {time, species1, species2, -1, false};
+        fReactions.push(reaction);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Sample the encounters of a species with the residues & histones of its fiber, in the fiber frame.
+// With hydration shells, a residue is encountered at its shell radius.
+//--------------------------------------------------------------------------------------------------
+void IRTChemistry::SampleTargetReactions(G4int species)
+{
+    const Species& state = fSpecies[species];
+    if (!fFiberTemplate || state.fiberFrame < 0) return;
+
+    G4bool isResidueTarget = state.moleculeID < (G4int)fIsResidueTarget.size() && fIsResidueTarget[state.moleculeID];
+    G4bool isHistoneTarget = state.moleculeID < (G4int)fIsHistoneTarget.size() && fIsHistoneTarget[state.moleculeID];
+    if (!isResidueTarget && !isHistoneTarget) return;
+
+    G4ThreeVector localPosition = fFiberFrames[state.fiberFrame].globalToFiber.TransformPoint(state.position);
+    G4double cutoff = GetReactionCutoff(state.diffusionCoefficient, state.time);
+
+    if (isResidueTarget) {
+        G4double maxRadius = fUseHydrationShells ? fFiberTemplate->GetMaxShellRadius() : fFiberTemplate->GetMaxResidueRadius();
+        fFiberTemplate->FindResidues(localPosition, maxRadius + cutoff, fNeighbours);
+        for (size_t n=0; n<fNeighbours.size(); ++n) {
+            G4int residue = fNeighbours[n];
+            G4double radius = fUseHydrationShells ? fFiberTemplate->GetResidueShellRadius(residue)
+                                                  : fFiberTemplate->GetResidueRadius(residue);
+            G4double distance = (localPosition - fFiberTemplate->GetResiduePosition(residue)).mag();
+            if (distance - radius > cutoff) continue;
+
+            G4double time = SampleReactionTime(distance, radius, state.diffusionCoefficient, state.time);
+            if (time < fEndTime) {
+                Reaction reaction = {time, species, -1, fFiberTemplate->GetResidueCopyNumber(residue), false};
+                fReactions.push(reaction);
+            }
+        }
+    }
+
+    if (isHistoneTarget) {
+        fFiberTemplate->FindHistones(localPosition, fHistoneSphereRadius + cutoff, fNeighbours);
+        for (size_t n=0; n<fNeighbours.size(); ++n) {
+            G4int histone = fNeighbours[n];
+            G4double distance = (localPosition - fFiberTemplate->GetHistonePosition(histone)).mag();
+            G4double time = SampleReactionTime(distance, fHistoneSphereRadius, state.diffusionCoefficient, state.time);
+            if (time < fEndTime) {
+                Reaction reaction = {time, species, -1, histone, true};
+                fReactions.push(reaction);
+            }
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Sample the reactions of a product with the living species, from their initial positions, & with
+// its DNA targets
+//--------------------------------------------------------------------------------------------------
+void IRTChemistry::SampleProductReactions(G4int product)
+{
+    const G4ThreeVector& position = fSpecies[product].position;
+    if (fCellSize > 0.) {
+        for (G4int dz=-1; dz<=1; ++dz) {
+            for (G4int dy=-1; dy<=1; ++dy) {
+                for (G4int dx=-1; dx<=1; ++dx) {
+                    std::unordered_map<std::int64_t, std::vector<G4int> >::const_iterator cell
+                        = fCells.find(GetCellKey(position, dx, dy, dz));
+                    if (cell == fCells.end()) continue;
+                    for (size_t n=0; n<cell->second.size(); ++n)
+                        if (fSpecies[cell->second[n]].isAlive) SamplePairReaction(cell->second[n], product);
+                }
+            }
+        }
+    }
+    for (G4int i=fNumInitialSpecies; i<product; ++i)
+        if (fSpecies[i].isAlive) SamplePairReaction(i, product);
+
+    SampleTargetReactions(product);
+    SampleScavenging(product);
+}
+
+//--------------------------------------------------------------------------------------------------
+// The species survives scavenging for a time t with probability exp(-k*t)
+//--------------------------------------------------------------------------------------------------
+void IRTChemistry::SampleScavenging(G4int species)
+{
+    const Species& state = fSpecies[species];
+    if (state.moleculeID >= (G4int)fScavengingRates.size() || fScavengingRates[state.moleculeID] <= 0.) return;
+
+    G4double time = state.time - std::log(1. - G4UniformRand())/fScavengingRates[state.moleculeID];
+    if (time < fEndTime) {
+        Reaction reaction = {time, species, -1, -1, false};
+        fReactions.push(reaction);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Carry out a radical-radical reaction. The products are created at the encounter point, weighted
+// by the diffusion coefficients of the reactants, in the fiber frame of either reactant.
+//--------------------------------------------------------------------------------------------------
+void IRTChemistry::React(const Reaction& reaction)
+{
+    Species& first = fSpecies[reaction.species1];
+    Species& second = fSpecies[reaction.species2];
+    first.isAlive = false;
+    second.isAlive = false;
+    fNumReactions++;
+
+    const G4DNAMolecularReactionData* data = fReactionTable->GetReactionData(
+        const_cast<G4MolecularConfiguration*>(first.configuration), const_cast<G4MolecularConfiguration*>(second.configuration));
+    G4double diffusionCoefficient = first.diffusionCoefficient + second.diffusionCoefficient;
+    G4ThreeVector position = 0.5*(first.position + second.position);
+    if (diffusionCoefficient > 0.)
+        position = (second.diffusionCoefficient*first.position + first.diffusionCoefficient*second.position)
+                   /diffusionCoefficient;
+    G4int fiberFrame = (first.fiberFrame >= 0) ? first.fiberFrame : second.fiberFrame;
+
+    for (G4int p=0; p<data->GetNbProducts(); ++p) {
+        G4int product = CreateSpecies(data->GetProduct(p), position, reaction.time, fiberFrame);
+        SampleProductReactions(product);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Pop the reactions in time order. Reactions of species that have already reacted are discarded.
+//--------------------------------------------------------------------------------------------------
+G4bool IRTChemistry::NextEncounter(Encounter& encounter)
+{
+    while (!fReactions.empty()) {
+        Reaction reaction = fReactions.top();
+        fReactions.pop();
+        if (!fSpecies[reaction.species1].isAlive) continue;
+
+        if (reaction.species2 >= 0) {
+            if (fSpecies[reaction.species2].isAlive) React(reaction);
+            continue;
+        }
+        Species& state = fSpecies[reaction.species1];
+        encounter.species = reaction.species1;
+        encounter.moleculeID = state.moleculeID;
+        encounter.isHistone = reaction.isHistone;
+        encounter.target = reaction.target;
+        encounter.time = reaction.time;
+        if (reaction.target < 0) {
+            state.isAlive = false;
+            fNumScavenged++;
+            encounter.voxelID = -1;
+            encounter.fiberID = -1;
+            return true;
+        }
+
+        const FiberFrame& frame = fFiberFrames[state.fiberFrame];
+        encounter.voxelID = frame.voxelID;
+        encounter.fiberID = frame.fiberID;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,201 @@
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class runs the chemical stage of one event with the independent reaction times (IRT) method,
+// instead of diffusing every molecule step by step. The species created by the event are collected
+// at their creation (see ChemicalTrackClassifier). The time of every possible reaction is then
+// sampled once, from the initial separation of the reactants, and the reactions are carried out in
+// time order up to the end of the chemical stage. A species that has already reacted takes no part
+// in its later reactions.
+//
+// Radical-radical reactions use the reaction radius & products of the Geant4-DNA reaction table. The
+// DNA residues & histones of the fiber containing a species are static targets: the species reaches
+// a target (a sphere) at a time sampled from the same first-passage distribution, with its own
+// diffusion coefficient. Each encounter is returned to the scorer, which applies its damage
+// probabilities & kill lists, and removes the species if it is scavenged. Histones are treated as
+// spheres of the volume of their cylinder.
+//
+// Species may also be scavenged by the cellular environment (scorer parameters ScavengingLifetime):
+// a first-order reaction whose time is sampled from an exponential distribution.
+//
+// As usual for IRT, the reactants of each pair are assumed independent of the other species, and
+// the products start from the point of their reaction at its time.
+//**************************************************************************************************
+
+#ifndef IRTChemistry_hh
+#define IRTChemistry_hh
+
+#include "G4AffineTransform.hh"
+#include "G4ThreeVector.hh"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+class DNAFiberTemplate;
+class G4DNAMolecularReactionTable;
+class G4MolecularConfiguration;
+
+class IRTChemistry
+{
+public:
+    //----------------------------------------------------------------------------------------------
+    // Encounter of a species with a DNA target: a residue (copy number) or a histone (index in the
+    // fiber template), in the fiber of the given voxel & fiber IDs. A target of -1 means the species
+    // was scavenged by the cellular environment (it is already removed).
+    //----------------------------------------------------------------------------------------------
+    struct Encounter
+    {
+        G4int species;
+        G4int moleculeID;
+        G4bool isHistone;
+        G4int target;
+        G4int voxelID;
+        G4int fiberID;
+        G4double time;
+    };
+
+    IRTChemistry();
+
+    ~IRTChemistry();
+
+    //----------------------------------------------------------------------------------------------
+    // Configuration: the fiber template giving the DNA targets, the end of the chemical stage & the
+    // molecule IDs of the species that react with residues & with histones. Other species only react
+    // with each other.
+    //----------------------------------------------------------------------------------------------
+    void SetFiberTemplate(const DNAFiberTemplate* fiberTemplate) {fFiberTemplate = fiberTemplate;}
+    void SetEndTime(G4double endTime) {fEndTime = endTime;}
+    void SetUseHydrationShells(G4bool useHydrationShells) {fUseHydrationShells = useHydrationShells;}
+    void SetTargetSpecies(const std::vector<G4int>& residueSpecies, const std::vector<G4int>& histoneSpecies);
+
+    //----------------------------------------------------------------------------------------------
+    // Rates of scavenging by the cellular environment, by molecule ID (species absent from the map
+    // are not scavenged)
+    //----------------------------------------------------------------------------------------------
+    void SetScavengingRates(const std::map<G4int, G4double>& scavengingRates);
+
+    //----------------------------------------------------------------------------------------------
+    // Discard the species & reactions of the previous event
+    //----------------------------------------------------------------------------------------------
+    void Clear();
+
+    //----------------------------------------------------------------------------------------------
+    // Add a species created at the given position (global frame) & time. globalToFiber is the
+    // transform to the frame of the fiber containing it, or NULL if it is not in a fiber.
+    //----------------------------------------------------------------------------------------------
+    void AddSpecies(const G4MolecularConfiguration* configuration, const G4ThreeVector& position,
+                    G4double time, const G4AffineTransform* globalToFiber, G4int voxelID, G4int fiberID);
+
+    //----------------------------------------------------------------------------------------------
+    // Sample the times of the reactions between the species & with their DNA targets. Must be
+    // called once all species of the event are added.
+    //----------------------------------------------------------------------------------------------
+    void Start();
+
+    //----------------------------------------------------------------------------------------------
+    // Carry out the radical-radical reactions in time order up to the next encounter with a DNA
+    // target or scavenging by the environment & return it. Return false once no other encounter
+    // happens before the end time.
+    //----------------------------------------------------------------------------------------------
+    G4bool NextEncounter(Encounter& encounter);
+
+    //----------------------------------------------------------------------------------------------
+    // Remove a species scavenged by a DNA target. Its later reactions are discarded.
+    //----------------------------------------------------------------------------------------------
+    void RemoveSpecies(G4int species) {fSpecies[species].isAlive = false;}
+
+    //----------------------------------------------------------------------------------------------
+    // Getters
+    //----------------------------------------------------------------------------------------------
+    G4int GetNumberOfSpecies() const {return (G4int)fSpecies.size();}
+    G4int GetNumberOfReactions() const {return fNumReactions;}
+    G4int GetNumberOfScavengedSpecies() const {return fNumScavenged;}
+
+private:
+    struct Species
+    {
+        const G4MolecularConfiguration* configuration;
+        G4int moleculeID;
+        G4double diffusionCoefficient;
+        G4ThreeVector position;
+        G4double time;
+        G4bool isAlive;
+        G4int fiberFrame; // index in fFiberFrames, -1 if not in a fiber
+    };
+
+    struct FiberFrame
+    {
+        G4AffineTransform globalToFiber;
+        G4int voxelID;
+        G4int fiberID;
+    };
+
+    // Sampled reaction of a pair (species2 >= 0), of a species with a target (species2 = -1) or of
+    // a species with the scavengers of the environment (species2 = -1, target = -1)
+    struct Reaction
+    {
+        G4double time;
+        G4int species1;
+        G4int species2;
+        G4int target;
+        G4bool isHistone;
+        G4bool operator>(const Reaction& other) const {return time > other.time;}
+    };
+
+    G4int CreateSpecies(const G4MolecularConfiguration* configuration, const G4ThreeVector& position,
+                        G4double time, G4int fiberFrame);
+    void RegisterConfiguration(const G4MolecularConfiguration* configuration);
+
+    //----------------------------------------------------------------------------------------------
+    // Distance beyond which a species created at the given time is unlikely to react before the end
+    // time, for the given diffusion coefficient
+    //----------------------------------------------------------------------------------------------
+    G4double GetReactionCutoff(G4double diffusionCoefficient, G4double time) const;
+
+    //----------------------------------------------------------------------------------------------
+    // Sample a first-passage time to a sphere of radius R from distance r0. Return a time past the
+    // end time if the sphere is never reached.
+    //----------------------------------------------------------------------------------------------
+    G4double SampleReactionTime(G4double r0, G4double R, G4double diffusionCoefficient, G4double startTime) const;
+
+    void SampleProductReactions(G4int product);
+    void SamplePairReaction(G4int species1, G4int species2);
+    void SampleTargetReactions(G4int species);
+    void SampleScavenging(G4int species);
+    void React(const Reaction& reaction);
+
+    // Hashed grid over the initial positions (sparse, since a track may span a whole nucleus)
+    std::int64_t GetCellKey(const G4ThreeVector& position, G4int offsetX, G4int offsetY, G4int offsetZ) const;
+
+    const DNAFiberTemplate* fFiberTemplate;
+    const G4DNAMolecularReactionTable* fReactionTable;
+    G4double fEndTime;
+    G4bool fUseHydrationShells; // residue reaction radius is the hydration shell radius
+    std::vector<G4bool> fIsResidueTarget; // by molecule ID
+    std::vector<G4bool> fIsHistoneTarget;
+    std::vector<G4double> fScavengingRates; // by molecule ID, 0 if not scavenged
+    G4double fHistoneSphereRadius;
+
+    std::vector<Species> fSpecies;
+    std::vector<FiberFrame> fFiberFrames;
+    G4int fNumInitialSpecies;
+    G4int fNumReactions;
+    G4int fNumScavenged;
+
+    // Configurations seen so far, with the largest reaction radius & diffusion coefficient
+    std::vector<const G4MolecularConfiguration*> fConfigurations;
+    G4double fMaxReactionRadius;
+    G4double fMaxDiffusionCoefficient;
+
+    G4double fCellSize;
+    std::unordered_map<std::int64_t, std::vector<G4int> > fCells;
+
+    std::priority_queue<Reaction, std::vector<Reaction>, std::greater<Reaction> > fReactions;
+    std::vector<G4int> fNeighbours;
+};
+
+#endif
@@ -0,0 +1,361 @@
+// Extra Class for ClusteredDNADamage
+//
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class keeps the output files of completed simulations in a local cache directory, indexed by
+// a hash of the parameters that affect their contents.
+//**************************************************************************************************
+
+#include "ResultCache.hh"
+
+#include "TsParameterManager.hh"
+
+#include "G4ios.hh"
+#include "G4Version.hh"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Bump when the canonical text or the layout of an entry changes, to invalidate older entries
+static const G4int kCacheFormatVersion = 2;
+
+// Identifier of the sources, e.g. -DCLUSTERED_DNA_DAMAGE_BUILD_ID=\"$(git rev-parse HEAD)\" when
+// building. Without it, the compile time of this file is used.
+#ifndef CLUSTERED_DNA_DAMAGE_BUILD_ID
+#define CLUSTERED_DNA_DAMAGE_BUILD_ID __DATE__ " " __TIME__
+#endif
+
+static const std::uint64_t kFNVOffsetBasis = 14695981039346656037ULL;
+static const std::uint64_t kFNVPrime = 1099511628211ULL;
+
+std::vector<ResultCache*> ResultCache::fScheduledStores;
+std::vector<ResultCache*> ResultCache::fScheduledRestores;
+
+//--------------------------------------------------------------------------------------------------
+// Lower-case copy of a string
+//--------------------------------------------------------------------------------------------------
+static G4String ToLower(const G4String& value)
+{
+    std::string lower(value);
+    for (size_t i=0; i<lower.size(); ++i)
+        lower[i] = (char)std::tolower((unsigned char)lower[i]);
+    return lower;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Identifier of the compiled code: the build identifier, the Geant4 version, and the size &
+// modification time of the binary holding this code (the Topas executable or the extension
+// library), which change whenever it is rebuilt, even if this file is not recompiled.
+//--------------------------------------------------------------------------------------------------
+static G4String GetBuildIdentifier()
+{
+    std::ostringstream identifier;
+    identifier << CLUSTERED_DNA_DAMAGE_BUILD_ID << " geant4 " << G4VERSION_NUMBER;
+
+    Dl_info info;
+    struct stat status;
+    if (dladdr((void*)&GetBuildIdentifier, &info) != 0 && info.dli_fname && stat(info.dli_fname, &status) == 0)
+        identifier << " binary " << status.st_size << " " << status.st_mtime;
+    return identifier.str();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Constructor
+//--------------------------------------------------------------------------------------------------
+ResultCache::ResultCache(const G4String& directory)
+    : fDirectory(directory), fCreationTime(std::time(NULL))
+{}
+
+//--------------------------------------------------------------------------------------------------
+// Add parameters to the key. The canonical line of a parameter holds its type, value(s) & unit as
+// reported by the parameter manager. A string parameter naming a readable file also contributes a
+// hash of the file contents (e.g. spectra or chemistry files).
+//--------------------------------------------------------------------------------------------------
+void ResultCache::AddParameters(TsParameterManager* pm, const G4String& prefix,
+                                const std::vector<G4String>& excludedNames,
+                                const std::vector<G4String>& excludedPrefixes)
+{
+    std::vector<G4String> names;
+    pm->GetParameterNamesStartingWith(prefix, &names);
+
+    for (size_t n=0; n<names.size(); ++n) {
+        const G4String& name = names[n];
+        G4String lowerName = ToLower(name);
+        G4String lastComponent = lowerName.substr(lowerName.find_last_of('/')+1);
+
+        G4bool isExcluded = false;
+        for (size_t i=0; i<excludedNames.size() && !isExcluded; ++i)
+            isExcluded = lastComponent == ToLower(excludedNames[i]);
+        for (size_t i=0; i<excludedPrefixes.size() && !isExcluded; ++i)
+            isExcluded = lastComponent.compare(0, excludedPrefixes[i].size(), ToLower(excludedPrefixes[i])) == 0;
+        if (isExcluded) continue;
+
+        G4String type = pm->GetTypeOfParameter(name);
+        std::ostringstream line;
+        line << lowerName << " " << type << " =";
+
+        std::vector<G4String> values;
+        if (!type.empty() && type[type.size()-1] == 'v') {
+            G4int length = pm->GetVectorLength(name);
+            G4String* vector = pm->GetStringVector(name);
+            values.assign(vector, vector+length);
+        }
+        else {
+            values.push_back(pm->GetStringParameter(name));
+        }
+        for (size_t i=0; i<values.size(); ++i)
+            line << " " << values[i];
+
+        if (!type.empty() && type[0] == 'd')
+            line << " " << pm->GetUnitOfParameter(name);
+
+        if (!type.empty() && type[0] == 's') {
+            for (size_t i=0; i<values.size(); ++i) {
+                std::ifstream file(values[i].c_str(), std::ios::binary);
+                if (!file) continue;
+                std::ostringstream contents;
+                contents << file.rdbuf();
+                const std::string& bytes = contents.str();
+                line << " [" << values[i] << ": " << std::hex
+                     << HashBytes(bytes.data(), bytes.size(), kFNVOffsetBasis) << std::dec << "]";
+            }
+        }
+
+        fCanonicalParameters[lowerName] = line.str();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Register an output file
+//--------------------------------------------------------------------------------------------------
+void ResultCache::AddOutputFile(const G4String& role, const G4String& fileName)
+{
+    fOutputFiles.push_back(std::make_pair(role, fileName));
+}
+
+//--------------------------------------------------------------------------------------------------
+// Key of the configuration: FNV-1a hash of the canonical text
+//--------------------------------------------------------------------------------------------------
+G4String ResultCache::GetKey() const
+{
+    G4String text = GetCanonicalText();
+
+    std::ostringstream key;
+    key << std::hex;
+    key.width(16);
+    key.fill('0');
+    key << HashBytes(text.data(), text.size(), kFNVOffsetBasis);
+    return key.str();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Canonical text of the configuration: format version & build of the code, then one line per
+// parameter sorted by name
+//--------------------------------------------------------------------------------------------------
+G4String ResultCache::GetCanonicalText() const
+{
+    std::ostringstream text;
+    text << "version " << kCacheFormatVersion << "\n";
+    text << "build " << GetBuildIdentifier() << "\n";
+    for (std::map<G4String, G4String>::const_iterator it=fCanonicalParameters.begin(); it!=fCanonicalParameters.end(); ++it)
+        text << it->second << "\n";
+    return text.str();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Files of the matching entry & the names to restore them to. Return false if there is no complete
+// entry for this configuration.
+//--------------------------------------------------------------------------------------------------
+G4bool ResultCache::FindEntryFiles(std::vector<std::pair<G4String, G4String> >& copies) const
+{
+    G4String entry = fDirectory + "/" + GetKey();
+    copies.clear();
+
+    // Configuration must match exactly
+    std::ifstream configuration((entry + "/configuration.txt").c_str());
+    if (!configuration) return false;
+    std::ostringstream storedText;
+    storedText << configuration.rdbuf();
+
+    if (storedText.str() != GetCanonicalText()) return false;
+
+    // Every stored role must have a registered file name
+    std::ifstream manifest((entry + "/manifest.txt").c_str());
+    if (!manifest) return false;
+
+    std::string role;
+    while (std::getline(manifest, role)) {
+        if (role.empty()) continue;
+        size_t i = 0;
+        while (i < fOutputFiles.size() && fOutputFiles[i].first != role) ++i;
+        if (i == fOutputFiles.size()) return false;
+        copies.push_back(std::make_pair(entry + "/" + role, fOutputFiles[i].second));
+    }
+    return true;
+}
+
+G4bool ResultCache::HasEntry() const
+{
+    std::vector<std::pair<G4String, G4String> > copies;
+    return FindEntryFiles(copies);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Restore the outputs of a matching entry. The whole entry is checked before any file is copied.
+//--------------------------------------------------------------------------------------------------
+G4bool ResultCache::Restore() const
+{
+    std::vector<std::pair<G4String, G4String> > copies; // source, destination
+    if (!FindEntryFiles(copies)) return false;
+
+    for (size_t i=0; i<copies.size(); ++i) {
+        if (!CopyFile(copies[i].first, copies[i].second)) {
+            G4cerr << "Error: could not restore " << copies[i].second << " from the result cache." << G4endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Schedule a store at exit. The handler is registered once per process. Each scorer with a result
+// cache schedules its own entry; a later store of the same entry (e.g. at the end of the next run)
+// replaces the earlier one.
+//--------------------------------------------------------------------------------------------------
+void ResultCache::ScheduleStore() const
+{
+    if (fScheduledStores.empty())
+        std::atexit(StoreScheduledEntries);
+    for (size_t i=0; i<fScheduledStores.size(); ++i) {
+        if (fScheduledStores[i]->fDirectory == fDirectory && fScheduledStores[i]->GetKey() == GetKey()) {
+            delete fScheduledStores[i];
+            fScheduledStores[i] = new ResultCache(*this);
+            return;
+        }
+    }
+    fScheduledStores.push_back(new ResultCache(*this));
+}
+
+void ResultCache::StoreScheduledEntries()
+{
+    for (size_t i=0; i<fScheduledStores.size(); ++i) {
+        if (!fScheduledStores[i]->Store())
+            std::cerr << "Warning: results could not be stored in the result cache "
+                      << fScheduledStores[i]->fDirectory << std::endl;
+        delete fScheduledStores[i];
+    }
+    fScheduledStores.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Schedule a restore at exit, once Topas has closed the output files it writes for the scorer (which
+// are replaced). The handler is registered once per process.
+//--------------------------------------------------------------------------------------------------
+void ResultCache::ScheduleRestore() const
+{
+    if (fScheduledRestores.empty())
+        std::atexit(RestoreScheduledEntries);
+    fScheduledRestores.push_back(new ResultCache(*this));
+}
+
+void ResultCache::RestoreScheduledEntries()
+{
+    for (size_t i=0; i<fScheduledRestores.size(); ++i) {
+        if (!fScheduledRestores[i]->Restore())
+            std::cerr << "Warning: results could not be restored from the result cache "
+                      << fScheduledRestores[i]->fDirectory << std::endl;
+        delete fScheduledRestores[i];
+    }
+    fScheduledRestores.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Write the entry to a temporary directory, then rename it. Files not written since this object was
+// constructed are left out (e.g. a header file of an earlier simulation with the same name).
+//--------------------------------------------------------------------------------------------------
+G4bool ResultCache::Store() const
+{
+    G4String entry = fDirectory + "/" + GetKey();
+    struct stat info;
+    if (stat(entry.c_str(), &info) == 0) return true; // stored by an earlier or concurrent simulation
+
+    mkdir(fDirectory.c_str(), 0755);
+
+    std::ostringstream tempName;
+    tempName << entry << ".tmp." << getpid();
+    G4String tempEntry = tempName.str();
+    if (mkdir(tempEntry.c_str(), 0755) != 0) return false;
+
+    std::vector<G4String> written;
+    G4bool isComplete = true;
+
+    // Output files
+    std::ofstream manifest((tempEntry + "/manifest.txt").c_str());
+    std::set<G4String> roles;
+    for (size_t i=0; i<fOutputFiles.size() && isComplete; ++i) {
+        const G4String& role = fOutputFiles[i].first;
+        const G4String& fileName = fOutputFiles[i].second;
+        if (roles.count(role) || stat(fileName.c_str(), &info) != 0 || info.st_mtime < fCreationTime) continue;
+
+        isComplete = CopyFile(fileName, tempEntry + "/" + role);
+        written.push_back(tempEntry + "/" + role);
+        manifest << role << "\n";
+        roles.insert(role);
+    }
+    manifest.close();
+    written.push_back(tempEntry + "/manifest.txt");
+    isComplete = isComplete && manifest;
+
+    // Configuration, written last: its presence marks a complete entry
+    std::ofstream configuration((tempEntry + "/configuration.txt").c_str());
+    configuration << GetCanonicalText();
+    configuration.close();
+    written.push_back(tempEntry + "/configuration.txt");
+    isComplete = isComplete && configuration;
+
+    if (!isComplete || std::rename(tempEntry.c_str(), entry.c_str()) != 0) {
+        for (size_t i=0; i<written.size(); ++i)
+            std::remove(written[i].c_str());
+        rmdir(tempEntry.c_str());
+        return stat(entry.c_str(), &info) == 0;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Copy a file. Return false if either file could not be opened or the copy failed.
+//--------------------------------------------------------------------------------------------------
+G4bool ResultCache::CopyFile(const G4String& source, const G4String& destination)
+{
+    std::ifstream in(source.c_str(), std::ios::binary);
+    if (!in) return false;
+    std::ofstream out(destination.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+
+    if (in.peek() != std::ifstream::traits_type::eof())
+        out << in.rdbuf();
+    out.close();
+    return (G4bool)out;
+}
+
+//--------------------------------------------------------------------------------------------------
+// 64-bit FNV-1a hash, continued from hash
+//--------------------------------------------------------------------------------------------------
+std::uint64_t ResultCache::HashBytes(const char* data, size_t length, std::uint64_t hash)
+{
+    for (size_t i=0; i<length; ++i) {
+        hash ^= (unsigned char)data[i];
+        hash *= kFNVPrime;
+    }
+    return hash;
+}
@@ -0,0 +1,109 @@
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class keeps the output files of completed simulations in a local cache directory, indexed by
+// a hash of everything that affects their contents. Sweeps often resubmit simulations that differ
+// from earlier ones only in the names of their output files; with the cache, such a simulation
+// restores the outputs of the earlier one under its own file names instead of running again.
+//
+// The key is built from the canonical text of the build of the code (build identifier, Geant4
+// version & binary) and of the parameters that affect the results (one line per parameter, sorted by
+// name, with the contents of any file named by a string parameter), hashed with 64-bit FNV-1a. Parameters that only name outputs are excluded by the caller. Each entry holds the
+// canonical text, which is compared on restore so a hash collision is never mistaken for a hit.
+//
+// Layout of an entry: <directory>/<key>/configuration.txt, manifest.txt (one role per line) and one
+// file per role (e.g. "run_summary.csv"). Entries are written to a temporary directory & renamed, so
+// concurrent simulations never see a partial entry.
+//
+// Outputs are only complete once Topas has closed its files, after the scorers are deleted, so they
+// are stored from a handler registered with std::atexit(). For the same reason, a simulation that
+// reuses an entry restores it from such a handler, replacing the files Topas wrote for the scorer.
+//**************************************************************************************************
+
+#ifndef ResultCache_hh
+#define ResultCache_hh
+
+#include "G4String.hh"
+
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <vector>
+
+class TsParameterManager;
+
+class ResultCache
+{
+public:
+    //----------------------------------------------------------------------------------------------
+    // Constructor. The directory is created when the first entry is stored.
+    //----------------------------------------------------------------------------------------------
+    explicit ResultCache(const G4String& directory);
+
+    //----------------------------------------------------------------------------------------------
+    // Add all parameters whose names start with prefix to the key, except those whose last name
+    // component (after the last '/') is in excludedNames or starts with one of excludedPrefixes
+    // (case-insensitive).
+    //----------------------------------------------------------------------------------------------
+    void AddParameters(TsParameterManager* pm, const G4String& prefix,
+                       const std::vector<G4String>& excludedNames = std::vector<G4String>(),
+                       const std::vector<G4String>& excludedPrefixes = std::vector<G4String>());
+
+    //----------------------------------------------------------------------------------------------
+    // Register an output file under a role that does not depend on its name (e.g. "run_summary.csv")
+    //----------------------------------------------------------------------------------------------
+    void AddOutputFile(const G4String& role, const G4String& fileName);
+
+    //----------------------------------------------------------------------------------------------
+    // Hexadecimal hash of the canonical text of the parameters added so far
+    //----------------------------------------------------------------------------------------------
+    G4String GetKey() const;
+
+    //----------------------------------------------------------------------------------------------
+    // Return true if there is a complete entry for this configuration
+    //----------------------------------------------------------------------------------------------
+    G4bool HasEntry() const;
+
+    //----------------------------------------------------------------------------------------------
+    // Copy the files of the entry for this key to the names registered for their roles. Return false
+    // (and copy nothing) if there is no complete entry for this configuration.
+    //----------------------------------------------------------------------------------------------
+    G4bool Restore() const;
+
+    //----------------------------------------------------------------------------------------------
+    // Restore the entry when the process exits, after the output files have been closed
+    //----------------------------------------------------------------------------------------------
+    void ScheduleRestore() const;
+
+    //----------------------------------------------------------------------------------------------
+    // Store the registered output files written since this object was constructed in a new entry
+    // when the process exits. Replaces a store of the same entry scheduled before.
+    //----------------------------------------------------------------------------------------------
+    void ScheduleStore() const;
+
+private:
+    //----------------------------------------------------------------------------------------------
+    // Write the entry now. Return false if it could not be written (an existing entry for the same
+    // key is kept).
+    //----------------------------------------------------------------------------------------------
+    G4bool Store() const;
+
+    G4String GetCanonicalText() const;
+    G4bool FindEntryFiles(std::vector<std::pair<G4String, G4String> >& copies) const;
+
+    static void StoreScheduledEntries(); // registered with std::atexit()
+    static void RestoreScheduledEntries(); // registered with std::atexit()
+
+    static G4bool CopyFile(const G4String& source, const G4String& destination);
+    static std::uint64_t HashBytes(const char* data, size_t length, std::uint64_t hash);
+
+    G4String fDirectory;
+    std::map<G4String, G4String> fCanonicalParameters; // lower-case name -> canonical line
+    std::vector<std::pair<G4String, G4String> > fOutputFiles; // role, file name
+    std::time_t fCreationTime;
+
+    static std::vector<ResultCache*> fScheduledStores;
+    static std::vector<ResultCache*> fScheduledRestores;
+};
+
+#endif
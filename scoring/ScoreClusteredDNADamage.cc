@@ -13,19 +13,105 @@
 //**************************************************************************************************
 
 #include "ScoreClusteredDNADamage.hh"
+#include "DNAFiberTemplate.hh"
+#include "NucleusLayout.hh"
+#include "ChemicalTrackClassifier.hh"
+#include "TrackTagger.hh"
+#include "ResultCache.hh"
+#include "EventTimelineTracer.hh"
+#include "TrackLibrary.hh"
+#include "IRTChemistry.hh"
+#include "ChemistryYieldTally.hh"
+#include "StatusStreamPublisher.hh"
 #include "TsTrackInformation.hh"
 #include "G4TouchableHistory.hh"
 #include "G4SystemOfUnits.hh"
 #include "Randomize.hh"
 #include <algorithm>
+#include <chrono>
+#include <random>
+#include <sys/resource.h>
 
 #include <map>
+#include <set>
 #include "G4RunManager.hh"
+#include "G4AutoLock.hh"
+#include "G4EventManager.hh"
+#include "G4Event.hh"
+#include "G4PrimaryVertex.hh"
+#include "G4PrimaryParticle.hh"
+#include "G4Navigator.hh"
+#include "G4PVPlacement.hh"
+#include "G4PhysicalVolumeStore.hh"
+#include "G4LogicalVolume.hh"
+#include "G4VSolid.hh"
+#include "G4RandomDirection.hh"
+#include "G4TransportationManager.hh"
+#include "G4Scheduler.hh"
 
 #include "G4Molecule.hh"
 #include "G4MoleculeTable.hh"
 #include "G4MolecularConfiguration.hh"
 
+// Damage channel of each (strand, residue) pair. Phosphate & deoxyribose are backbone residues.
+constexpr G4int ScoreClusteredDNADamage::fChannelLookup[2][3];
+
+//--------------------------------------------------------------------------------------------------
+// Return the entry of a fiber in a damage map indexed by voxel then fiber, or an empty entry if the
+// fiber has no damage. Unlike operator[], the map is not modified.
+//--------------------------------------------------------------------------------------------------
+template<typename T>
+static const T& FindFiberEntry(const std::map<G4int, std::map<G4int, T>>& map, G4int iVoxel, G4int iFiber)
+{
+	static const T empty;
+	typename std::map<G4int, std::map<G4int, T>>::const_iterator voxel = map.find(iVoxel);
+	if (voxel == map.end()) return empty;
+	typename std::map<G4int, T>::const_iterator fiber = voxel->second.find(iFiber);
+	if (fiber == voxel->second.end()) return empty;
+	return fiber->second;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Wall-clock time (s) on a monotonic clock shared by all threads, for the run metrics
+//--------------------------------------------------------------------------------------------------
+static G4double GetWallTime()
+{
+	return std::chrono::duration<G4double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Energy deposited during the current run by the scorers of all threads, by scorer name. It is
+// compared with the dose threshold after every event, so the threshold applies to the run as a
+// whole, whatever the number of threads & however events are spread over them (e.g. by a tasking
+// run manager).
+//--------------------------------------------------------------------------------------------------
+static G4Mutex runEdepMutex = G4MUTEX_INITIALIZER;
+static std::map<G4String, G4double> runEdepByScorer;
+
+//--------------------------------------------------------------------------------------------------
+// Physical volumes are registered in a store shared by all threads, so the copies of the component
+// used to replay library tracks are created & deleted one at a time.
+//--------------------------------------------------------------------------------------------------
+static G4Mutex replayWorldMutex = G4MUTEX_INITIALIZER;
+
+//--------------------------------------------------------------------------------------------------
+// Scorers whose outputs are restored from the result cache, by name. The master decides when it is
+// constructed, before the scorers of the worker threads.
+//--------------------------------------------------------------------------------------------------
+static G4Mutex restoredScorersMutex = G4MUTEX_INITIALIZER;
+static std::set<G4String> restoredScorers;
+
+//--------------------------------------------------------------------------------------------------
+// Adds the wall time from its construction to its destruction to a total, if the total is not null
+//--------------------------------------------------------------------------------------------------
+struct ScopedWallTimer {
+	ScopedWallTimer(G4double* total) : fTotal(total), fStart(total ? GetWallTime() : 0.) {}
+	~ScopedWallTimer() { if (fTotal) *fTotal += GetWallTime() - fStart; }
+
+	G4double* fTotal;
+	G4double fStart;
+};
+
 //--------------------------------------------------------------------------------------------------
 // Struct used to hold parameters of interest for a single cluster of DNA damage.
 // Used in RecordClusteredDNADamage().
@@ -103,15 +189,46 @@ ScoreClusteredDNADamage::ScoreClusteredDNADamage(TsParameterManager* pM, TsMater
 	fTotalEdep = 0.;
 	fFiberID = 0;
 	fVoxelID = 0;
+	fNucleusID = 0;
+	fNucleusDose = 0.;
+	fNucleusEdep.assign(fNumNuclei > 1 ? fNumNuclei : 0, 0.);
 
 	// Variables used when generating output files
 	fDelimiter = ",";
 	fOutFileExtension = ".csv";
 	fOutHeaderExtension = ".header";
 
+	// Restore the outputs of an identical earlier simulation, if any, instead of scoring. The rest of
+	// the simulation (other scorers & outputs) runs as usual; the outputs of this scorer are restored
+	// at exit, once Topas has closed its files, & this scorer does nothing in the meantime.
+	fResultCache = NULL;
+	if (fUseResultCache && G4Threading::IsMasterThread()) {
+		fResultCache = CreateResultCache(outFileName);
+		if (fReuseCachedResults) {
+			if (fResultCache->HasEntry()) {
+				fResultCache->ScheduleRestore();
+				G4AutoLock lock(&restoredScorersMutex);
+				restoredScorers.insert(GetName());
+				G4cout << "Outputs of " << GetName() << " will be restored from result cache entry "
+					   << fResultCacheDirectory << "/" << fResultCache->GetKey() << ". Skipping this scorer." << G4endl;
+			}
+			else
+				G4cout << "No result cache entry for " << GetName() << ". Running the scorer." << G4endl;
+		}
+	}
+	{
+		G4AutoLock lock(&restoredScorersMutex);
+		fRestoredFromCache = restoredScorers.count(GetName()) > 0;
+	}
+	if (fRestoredFromCache) {
+		delete fResultCache;
+		fResultCache = NULL;
+	}
+
 	// Erase contents of existing output files. Must be done here, at start of run, in case doing
 	// event-by-event scoring (i.e. need to write to same file many times).
-	ClearOutputFiles();
+	if (!fRestoredFromCache)
+		ClearOutputFiles();
 
 	// Total cubic volume of the DNA component
 	fComponentVolume = CalculateComponentVolume();
@@ -124,6 +241,128 @@ ScoreClusteredDNADamage::ScoreClusteredDNADamage(TsParameterManager* pM, TsMater
 		fNumFibers = 1;
 	}
 
+	// Classify molecules once at creation (on the chemistry scheduler of this thread)
+	fTrackClassifier = NULL;
+	if (fKillSpeciesAtBirth) {
+		fTrackClassifier = new ChemicalTrackClassifier(fDNAMaterial, fHistoneMaterial);
+		fTrackClassifier->SetCollectMolecules(fChemistryMode == fChemistryIRT);
+		fTrackClassifier->Install();
+	}
+
+	// IRT chemistry. Species that can damage or be scavenged by residues react with them, and the
+	// species scavenged by histones with histones. The navigator used to locate the molecules is
+	// created at the first event of the thread.
+	fIRTChemistry = NULL;
+	fIRTNavigator = NULL;
+	fIRTTouchable = NULL;
+	if (fChemistryMode == fChemistryIRT) {
+		std::vector<G4int> residueSpecies = fSpeciesToKillByDNAVolumes;
+		for (std::map<G4int, G4float>::iterator it = fMoleculeDamageProb_SSB.begin(); it != fMoleculeDamageProb_SSB.end(); ++it)
+			if (it->second > 0.) residueSpecies.push_back(it->first);
+		for (std::map<G4int, G4float>::iterator it = fMoleculeDamageProb_BD.begin(); it != fMoleculeDamageProb_BD.end(); ++it)
+			if (it->second > 0.) residueSpecies.push_back(it->first);
+		std::vector<G4int> histoneSpecies;
+		if (fHistonesAsScavenger)
+			histoneSpecies = fspeciesToKillByHistones;
+
+		G4int maxMoleculeID = -1;
+		for (size_t i = 0; i < residueSpecies.size(); i++)
+			maxMoleculeID = std::max(maxMoleculeID, residueSpecies[i]);
+		fIRTResidueReactivity.assign(maxMoleculeID+1, IRTResidueReactivity());
+		for (std::map<G4int, G4float>::iterator it = fMoleculeDamageProb_SSB.begin(); it != fMoleculeDamageProb_SSB.end(); ++it)
+			if (it->first <= maxMoleculeID) fIRTResidueReactivity[it->first].probDamageBackbone = it->second;
+		for (std::map<G4int, G4float>::iterator it = fMoleculeDamageProb_BD.begin(); it != fMoleculeDamageProb_BD.end(); ++it)
+			if (it->first <= maxMoleculeID) fIRTResidueReactivity[it->first].probDamageBase = it->second;
+		for (size_t i = 0; i < fSpeciesToKillByDNAVolumes.size(); i++)
+			fIRTResidueReactivity[fSpeciesToKillByDNAVolumes[i]].isKilledByResidues = true;
+
+		fIRTChemistry = new IRTChemistry();
+		fIRTChemistry->SetTargetSpecies(residueSpecies, histoneSpecies);
+		fIRTChemistry->SetUseHydrationShells(fUseHydrationShells);
+		if (fIncludeScavenging)
+			fIRTChemistry->SetScavengingRates(fScavengingRates);
+	}
+
+	// Time-resolved yields of the chemical stage, tallied by each thread & merged on the master
+	fChemistryYieldTally = NULL;
+	if (!fChemistryYieldSpecies.empty())
+		fChemistryYieldTally = new ChemistryYieldTally(fChemistryYieldSpecies.size(), fChemistryYieldTimes);
+
+	// Tag physical tracks (on the event manager of this thread) to attribute direct damage
+	fTrackTagger = NULL;
+	if (fRecordDamageAttribution) {
+		fTrackTagger = new TrackTagger();
+		fTrackTagger->Install();
+	}
+	fAttributionTallies.assign(TrackTagger::kNumTags, AttributionTally());
+
+	// Run metrics. The scorer of a thread is constructed once the thread is initialised.
+	fThreadMetrics = ThreadMetrics();
+	fThreadMetrics.readyTime = GetWallTime();
+	fEndOfRunStartTime = -1.;
+	fAbsorbTime = 0.;
+	fEndOfRunAnalysisTime = 0.;
+	fEndOfRunOutputTime = 0.;
+
+	// Live status stream, shared by all threads & published by the master
+	fStatusPublisher = NULL;
+	fEdepPublished = 0.;
+	if (fPublishStatusStream && !fRestoredFromCache) {
+		fStatusPublisher = StatusStreamPublisher::GetInstance(GetName());
+		if (G4Threading::IsMasterThread()
+			&& !fStatusPublisher->Open(fStatusStreamSocket, fStatusStreamInterval/s,
+									   1./(GetMaterial("G4_WATER")->GetDensity()*fComponentVolume),
+									   fUseDoseThreshold ? fDoseThreshold : 0., fNumNuclei)) {
+			G4cerr << "Error: the status stream socket " << fStatusStreamSocket << " cannot be created." << G4endl;
+			exit(0);
+		}
+	}
+
+	// Track library. The navigator used to replay tracks is created at the first event of the thread.
+	fRecordedTrackLibrary = NULL;
+	if (fTrackLibraryMode == fTrackLibraryRecord)
+		fRecordedTrackLibrary = new TrackLibrary();
+	fReplayPrimaryEnergy = 0.;
+	fReplayWorld = NULL;
+	fReplayNavigator = NULL;
+	fReplayTouchable = NULL;
+
+	// Trace the stages of the events of this thread (event action & chemistry scheduler)
+	fTimelineTracer = NULL;
+	if (fRecordEventTimeline) {
+		fTimelineTracer = new EventTimelineTracer(fEventTimelineBufferSize, fEventTimelineSampleInterval);
+		fTimelineTracer->Install();
+	}
+
+	// Damage maps of each channel, indexed by GetDamageChannel()
+	fMapEdepByChannel[fChannelStrand1Backbone] = &fMapEdepStrand1Backbone;
+	fMapEdepByChannel[fChannelStrand1Base] = &fMapEdepStrand1Base;
+	fMapEdepByChannel[fChannelStrand2Backbone] = &fMapEdepStrand2Backbone;
+	fMapEdepByChannel[fChannelStrand2Base] = &fMapEdepStrand2Base;
+
+	fFiberMapEdepByChannel[fChannelStrand1Backbone] = &fFiberMapEdepStrand1Backbone;
+	fFiberMapEdepByChannel[fChannelStrand1Base] = &fFiberMapEdepStrand1Base;
+	fFiberMapEdepByChannel[fChannelStrand2Backbone] = &fFiberMapEdepStrand2Backbone;
+	fFiberMapEdepByChannel[fChannelStrand2Base] = &fFiberMapEdepStrand2Base;
+
+	fMapIndDamageByChannel[fChannelStrand1Backbone] = &fMapIndDamageStrand1Backbone;
+	fMapIndDamageByChannel[fChannelStrand1Base] = &fMapIndDamageStrand1Base;
+	fMapIndDamageByChannel[fChannelStrand2Backbone] = &fMapIndDamageStrand2Backbone;
+	fMapIndDamageByChannel[fChannelStrand2Base] = &fMapIndDamageStrand2Base;
+
+	// Select the step handler once, now that the configuration is known. Histones only act as
+	// scavengers of chemical species when indirect damage is scored. The features acting on every
+	// step are only tested by ProcessHitsWithStepFeatures(), used if one of them is enabled.
+	fConfigurationHandler = SelectStepHandler<>(fIncludeDirectDamage, fIncludeIndirectDamage, fBuildNucleus,
+												fNumFibers > 1, fIncludeIndirectDamage && fHistonesAsScavenger);
+	if (fRestoredFromCache)
+		fStepHandler = &ScoreClusteredDNADamage::IgnoreStep;
+	else if (fTrackLibraryMode != fTrackLibraryOff || fIncludeScavenging || fNumNuclei > 1 || fChemistryYieldTally
+			 || fUseFiberProxy)
+		fStepHandler = &ScoreClusteredDNADamage::ProcessHitsWithStepFeatures;
+	else
+		fStepHandler = fConfigurationHandler;
+
 	// If using a dose threshold to end simulation, convert to an energy threshold, which is
 	// compared against after every event
 	if (fUseDoseThreshold) {
@@ -132,6 +371,7 @@ ScoreClusteredDNADamage::ScoreClusteredDNADamage(TsParameterManager* pM, TsMater
 	else {
 		fEnergyThreshold = -1.;
 	}
+	fEdepAddedToRun = 0.;
 
 	// Determine order of magnitude of number of base pairs.
 	// Set fParser parameters accordingly for use in ProcessHits()
@@ -142,12 +382,42 @@ ScoreClusteredDNADamage::ScoreClusteredDNADamage(TsParameterManager* pM, TsMater
 	fThreadID = 0;
 	fEventID = 0;
 
+	// Batches
+	fNumEventsInBatch = 0;
+	fBatchID = 0;
+	fEdepBeforeBatch = 0.;
+	fBatchDose = 0.;
+
+	// In-run yield estimates. The sample is drawn with a separate engine so the simulation's random
+	// numbers are unaffected.
+	fIsEstimatingYields = false;
+	fYieldEstimateEngine.seed(12345);
+
+	// Energy groups
+	fEnergyGroupTallies.assign(fEnergyGroupEdges.empty() ? 0 : fEnergyGroupEdges.size()-1, EnergyGroupTally());
+	fNumEventsOutsideEnergyGroups = 0;
+	fPrimaryEnergy = 0.;
+	fEnergyGroup = -1;
+	fEdepBeforeEvent = 0.;
+
 	//----------------------------------------------------------------------------------------------
 	// Assign member variables to columns in the main output file. Contains DNA damage yields.
 	//----------------------------------------------------------------------------------------------
 	fNtuple->RegisterColumnI(&fThreadID, "Thread ID"); // Unique thread ID
 	fNtuple->RegisterColumnI(&fEventID, "Event ID"); // Unique ID of primary particle / event / history
 	fNtuple->RegisterColumnI(&fFiberID, "Fiber ID"); // Unique fiber ID
+	if (fNumNuclei > 1) {
+		fNtuple->RegisterColumnI(&fNucleusID, "Nucleus ID"); // Index of the nucleus in the population
+		fNtuple->RegisterColumnD(&fNucleusDose, "Nucleus dose", "Gy"); // Dose to this nucleus in the event, batch or run
+	}
+	if (fRecordDamagePerBatch > 0) {
+		fNtuple->RegisterColumnI(&fNumEventsInBatch, "Events in batch"); // Event ID is then the batch ID
+		fNtuple->RegisterColumnD(&fBatchDose, "Batch dose", "Gy"); // Dose to the component in the batch
+	}
+	if (!fEnergyGroupEdges.empty()) {
+		fNtuple->RegisterColumnD(&fPrimaryEnergy, "Primary energy", "MeV"); // Kinetic energy of primary particle
+		fNtuple->RegisterColumnI(&fEnergyGroup, "Energy group"); // Index of energy group of primary (-1 if outside)
+	}
 	fNtuple->RegisterColumnI(&fTotalSSB, "Total single strand breaks"); // Number of SSB caused by this primary particle
 	if (fIncludeDirectDamage)
 		fNtuple->RegisterColumnI(&fTotalSSB_direct, "SSBs direct");
@@ -199,6 +469,23 @@ ScoreClusteredDNADamage::ScoreClusteredDNADamage(TsParameterManager* pM, TsMater
 // Destructor
 //--------------------------------------------------------------------------------------------------
 ScoreClusteredDNADamage::~ScoreClusteredDNADamage() {
+	delete fTrackClassifier;
+	delete fTrackTagger;
+	delete fResultCache;
+	delete fTimelineTracer;
+	delete fRecordedTrackLibrary;
+	delete fIRTChemistry;
+	delete fChemistryYieldTally;
+	if (fStatusPublisher && G4Threading::IsMasterThread())
+		fStatusPublisher->Close();
+	delete fIRTTouchable;
+	delete fIRTNavigator;
+	delete fReplayTouchable;
+	delete fReplayNavigator;
+	if (fReplayWorld) {
+		G4AutoLock lock(&replayWorldMutex);
+		delete fReplayWorld;
+	}
 }
 
 
@@ -246,6 +533,48 @@ void ScoreClusteredDNADamage::ResolveParams() {
 	else
 		fRecordDamagePerEvent = false;
 
+	//----------------------------------------------------------------------------------------------
+	// Optionally record damage every N events (per worker thread) instead of every event or once per
+	// run. Each batch gives one row of the output ntuple, so batches provide samples for variance
+	// estimates at a fraction of the cost of per-event analysis. Events left over at the end of the
+	// run are combined over all threads & recorded in a final row (event ID = -1).
+	//----------------------------------------------------------------------------------------------
+	if ( fPm->ParameterExists(GetFullParmName("RecordDamagePerBatch")))
+		fRecordDamagePerBatch = fPm->GetIntegerParameter(GetFullParmName("RecordDamagePerBatch"));
+	else
+		fRecordDamagePerBatch = 0;
+	if (fRecordDamagePerBatch < 0) {
+		G4cerr << "Error: RecordDamagePerBatch must not be negative." << G4endl;
+		exit(0);
+	}
+	if (fRecordDamagePerBatch > 0 && fRecordDamagePerEvent) {
+		G4cerr << "Error: RecordDamagePerBatch cannot be used with RecordDamagePerEvent." << G4endl;
+		exit(0);
+	}
+
+	//----------------------------------------------------------------------------------------------
+	// Optional in-run yield estimates when recording damage over the whole run. Every
+	// YieldEstimateInterval events, the first worker thread analyses a random sample of the fibers
+	// it has hit so far & prints provisional yields per Gy with 95% confidence intervals.
+	//----------------------------------------------------------------------------------------------
+	if ( fPm->ParameterExists(GetFullParmName("YieldEstimateInterval")))
+		fYieldEstimateInterval = fPm->GetIntegerParameter(GetFullParmName("YieldEstimateInterval"));
+	else
+		fYieldEstimateInterval = 0;
+	if (fYieldEstimateInterval > 0 && (fRecordDamagePerEvent || fRecordDamagePerBatch > 0)) {
+		G4cerr << "Error: YieldEstimateInterval can only be used when recording damage over the whole run." << G4endl;
+		exit(0);
+	}
+
+	if ( fPm->ParameterExists(GetFullParmName("YieldEstimateNumFibers")))
+		fYieldEstimateNumFibers = fPm->GetIntegerParameter(GetFullParmName("YieldEstimateNumFibers"));
+	else
+		fYieldEstimateNumFibers = 50;
+	if (fYieldEstimateNumFibers < 2) {
+		G4cerr << "Error: YieldEstimateNumFibers must be at least 2." << G4endl;
+		exit(0);
+	}
+
 	//----------------------------------------------------------------------------------------------
 	// Specify whether to report damage on a per-fibre basis (vs. grouping together). Note that
 	// damage in separate fibers are never considered together when clustering damage.
@@ -273,6 +602,144 @@ void ScoreClusteredDNADamage::ResolveParams() {
 	else
 		fFileNonDSBCluster = "output_non_dsb_cluster_specs";
 
+	if ( fPm->ParameterExists(GetFullParmName("FileEnergyGroups")))
+		fFileEnergyGroups = fPm->GetStringParameter(GetFullParmName("FileEnergyGroups"));
+	else
+		fFileEnergyGroups = "output_energy_groups";
+
+	//----------------------------------------------------------------------------------------------
+	// Optional per-event tallies: primary energy, energy deposited & damage yields of every event,
+	// written at the end of the run. Used to reweight a run to other primary spectra (see
+	// tools/reweight_spectrum.py). Requires RecordDamagePerEvent.
+	//----------------------------------------------------------------------------------------------
+	if ( fPm->ParameterExists(GetFullParmName("RecordEventTallies")))
+		fRecordEventTallies = fPm->GetBooleanParameter(GetFullParmName("RecordEventTallies"));
+	else
+		fRecordEventTallies = false;
+	if (fRecordEventTallies && !fRecordDamagePerEvent) {
+		G4cerr << "Error: RecordEventTallies requires RecordDamagePerEvent to be True." << G4endl;
+		exit(0);
+	}
+
+	if ( fPm->ParameterExists(GetFullParmName("FileEventTallies")))
+		fFileEventTallies = fPm->GetStringParameter(GetFullParmName("FileEventTallies"));
+	else
+		fFileEventTallies = "output_event_tallies";
+
+	//----------------------------------------------------------------------------------------------
+	// Optional primary energy groups. Yields, dose & cluster sizes are additionally tallied per
+	// group of primary energy, so a single run with a broad spectrum gives an energy-resolved
+	// response. Groups are defined by their edges (e.g. every few bins of the spectrum grid). The
+	// damage of each event must be analysed separately, so RecordDamagePerEvent must be enabled.
+	//----------------------------------------------------------------------------------------------
+	fEnergyGroupEdges.clear();
+	if ( fPm->ParameterExists(GetFullParmName("EnergyGroupEdges"))) {
+		G4int numEdges = fPm->GetVectorLength(GetFullParmName("EnergyGroupEdges"));
+		G4double* edges = fPm->GetDoubleVector(GetFullParmName("EnergyGroupEdges"), "Energy");
+		fEnergyGroupEdges.assign(edges, edges+numEdges);
+
+		if (numEdges < 2 || !std::is_sorted(fEnergyGroupEdges.begin(), fEnergyGroupEdges.end())) {
+			G4cerr << "Error: EnergyGroupEdges must contain at least 2 values in increasing order." << G4endl;
+			exit(0);
+		}
+		if (!fRecordDamagePerEvent) {
+			G4cerr << "Error: EnergyGroupEdges requires RecordDamagePerEvent to be True." << G4endl;
+			exit(0);
+		}
+	}
+
+	//----------------------------------------------------------------------------------------------
+	// Optional run metrics (thread count, event rate, init & end-of-run times, peak memory), one
+	// row per run, used by tools/scaling_harness.py to find where the scorer stops scaling
+	//----------------------------------------------------------------------------------------------
+	if ( fPm->ParameterExists(GetFullParmName("RecordRunMetrics")))
+		fRecordRunMetrics = fPm->GetBooleanParameter(GetFullParmName("RecordRunMetrics"));
+	else
+		fRecordRunMetrics = false;
+
+	if ( fPm->ParameterExists(GetFullParmName("FileRunMetrics")))
+		fFileRunMetrics = fPm->GetStringParameter(GetFullParmName("FileRunMetrics"));
+	else
+		fFileRunMetrics = "output_run_metrics";
+
+	//----------------------------------------------------------------------------------------------
+	// Optional live status stream (see StatusStreamPublisher): the events, dose, event rate &
+	// provisional yields of the run, published as JSON lines every StatusStreamInterval on the
+	// Unix-domain socket StatusStreamSocket, e.g. for a dashboard (tools/status_client.py prints it)
+	//----------------------------------------------------------------------------------------------
+	if ( fPm->ParameterExists(GetFullParmName("PublishStatusStream")))
+		fPublishStatusStream = fPm->GetBooleanParameter(GetFullParmName("PublishStatusStream"));
+	else
+		fPublishStatusStream = false;
+
+	if ( fPm->ParameterExists(GetFullParmName("StatusStreamSocket")))
+		fStatusStreamSocket = fPm->GetStringParameter(GetFullParmName("StatusStreamSocket"));
+	else
+		fStatusStreamSocket = "dna_damage_status.sock";
+
+	if ( fPm->ParameterExists(GetFullParmName("StatusStreamInterval")))
+		fStatusStreamInterval = fPm->GetDoubleParameter(GetFullParmName("StatusStreamInterval"), "Time");
+	else
+		fStatusStreamInterval = 1.*s;
+	if (fStatusStreamInterval <= 0.) {
+		G4cerr << "Error: StatusStreamInterval must be positive." << G4endl;
+		exit(0);
+	}
+
+	//----------------------------------------------------------------------------------------------
+	// Optional timeline of the stages of each event (physical, chemical, analysis & output) and of
+	// the master's end-of-run work, written in the Chrome trace-event format. One event in
+	// EventTimelineSampleInterval is traced; each thread keeps its last EventTimelineBufferSize spans.
+	//----------------------------------------------------------------------------------------------
+	if ( fPm->ParameterExists(GetFullParmName("RecordEventTimeline")))
+		fRecordEventTimeline = fPm->GetBooleanParameter(GetFullParmName("RecordEventTimeline"));
+	else
+		fRecordEventTimeline = false;
+
+	if ( fPm->ParameterExists(GetFullParmName("EventTimelineSampleInterval")))
+		fEventTimelineSampleInterval = fPm->GetIntegerParameter(GetFullParmName("EventTimelineSampleInterval"));
+	else
+		fEventTimelineSampleInterval = 1;
+	if (fEventTimelineSampleInterval < 1) {
+		G4cerr << "Error: EventTimelineSampleInterval must be at least 1." << G4endl;
+		exit(0);
+	}
+
+	if ( fPm->ParameterExists(GetFullParmName("EventTimelineBufferSize")))
+		fEventTimelineBufferSize = fPm->GetIntegerParameter(GetFullParmName("EventTimelineBufferSize"));
+	else
+		fEventTimelineBufferSize = 100000;
+	if (fEventTimelineBufferSize < 1) {
+		G4cerr << "Error: EventTimelineBufferSize must be at least 1." << G4endl;
+		exit(0);
+	}
+
+	if ( fPm->ParameterExists(GetFullParmName("FileEventTimeline")))
+		fFileEventTimeline = fPm->GetStringParameter(GetFullParmName("FileEventTimeline"));
+	else
+		fFileEventTimeline = "output_event_timeline";
+
+	//----------------------------------------------------------------------------------------------
+	// Optional result cache. The outputs of each completed simulation are stored under a hash of
+	// all parameters that affect them (see ResultCache). With ReuseCachedResults, a simulation
+	// whose configuration matches a stored one (output file names aside) restores the outputs of
+	// this scorer instead of scoring.
+	//----------------------------------------------------------------------------------------------
+	if ( fPm->ParameterExists(GetFullParmName("ReuseCachedResults")))
+		fReuseCachedResults = fPm->GetBooleanParameter(GetFullParmName("ReuseCachedResults"));
+	else
+		fReuseCachedResults = false;
+
+	if ( fPm->ParameterExists(GetFullParmName("UseResultCache")))
+		fUseResultCache = fPm->GetBooleanParameter(GetFullParmName("UseResultCache")) || fReuseCachedResults;
+	else
+		fUseResultCache = fReuseCachedResults;
+
+	if ( fPm->ParameterExists(GetFullParmName("ResultCacheDirectory")))
+		fResultCacheDirectory = fPm->GetStringParameter(GetFullParmName("ResultCacheDirectory"));
+	else
+		fResultCacheDirectory = "result_cache";
+
 	//----------------------------------------------------------------------------------------------
 	// Specify whether to output headers for data files or not
 	//----------------------------------------------------------------------------------------------
@@ -368,6 +835,19 @@ void ScoreClusteredDNADamage::ResolveParams() {
 				fMoleculeDamageProb_BD.emplace(mol_ID, fPm->GetUnitlessParameter(GetFullParmName(paramNameBD)));
 			else
 				fMoleculeDamageProb_BD.emplace(mol_ID, 0.0);
+
+			// Mean lifetime of the species against the scavengers of the cellular environment. Its
+			// inverse is the scavenging capacity (rate constant times scavenger concentration).
+			G4String paramNameScavenging = "ScavengingLifetime/" + mol_name;
+			if (fPm->ParameterExists(GetFullParmName(paramNameScavenging))) {
+				G4double lifetime = fPm->GetDoubleParameter(GetFullParmName(paramNameScavenging), "Time");
+				if (lifetime <= 0.) {
+					G4cerr << "Error: ScavengingLifetime/" << mol_name << " must be positive." << G4endl;
+					exit(0);
+				}
+				fScavengingRates.emplace(mol_ID, 1./lifetime);
+				G4cout << " Scavenged by the environment: " << mol_name << ", lifetime = " << lifetime/ns << " ns" << G4endl;
+			}
 		}
 		// Species killed by DNA volumes
 		if (fPm->ParameterExists(GetFullParmName("SpeciesToKillByDNAVolumes"))) {
@@ -421,6 +901,249 @@ void ScoreClusteredDNADamage::ResolveParams() {
 		exit(0);
 	}
 
+	// Kill molecules created in DNA & histone volumes when the chemistry scheduler starts tracking
+	// them (see ChemicalTrackClassifier), instead of when they first reach a volume boundary
+	if ( fPm->ParameterExists(GetFullParmName("KillSpeciesAtBirth")))
+		fKillSpeciesAtBirth = fPm->GetBooleanParameter(GetFullParmName("KillSpeciesAtBirth"));
+	else
+		fKillSpeciesAtBirth = true;
+	fKillSpeciesAtBirth = fKillSpeciesAtBirth && fIncludeIndirectDamage;
+
+	// Scavenging by the cellular environment, which allows a chemical stage shorter than the usual
+	// 1 ns cut-off (see ScavengeMolecule())
+	fIncludeScavenging = fIncludeIndirectDamage && !fScavengingRates.empty();
+
+	// Chemistry mode: step-by-step diffusion by the Geant4-DNA chemistry scheduler (StepByStep), or
+	// independent reaction times with the residues & histones as static targets (IRT, see
+	// IRTChemistry). IRT needs the residue geometry of the fibers (geometry parameter
+	// BuildFiberTemplate); the molecules are collected when they are created, so species created in
+	// DNA & histone volumes are always killed at birth.
+	G4String chemistryMode = "StepByStep";
+	if ( fPm->ParameterExists(GetFullParmName("ChemistryMode")))
+		chemistryMode = fPm->GetStringParameter(GetFullParmName("ChemistryMode"));
+	chemistryMode.toLower();
+	if (chemistryMode == "stepbystep")
+		fChemistryMode = fChemistryStepByStep;
+	else if (chemistryMode == "irt")
+		fChemistryMode = fChemistryIRT;
+	else {
+		G4cerr << "Error: ChemistryMode must be StepByStep or IRT." << G4endl;
+		exit(0);
+	}
+	if (fChemistryMode == fChemistryIRT) {
+		if (!fIncludeIndirectDamage) {
+			G4cerr << "Error: ChemistryMode IRT requires IncludeIndirectDamage to be True." << G4endl;
+			exit(0);
+		}
+		fKillSpeciesAtBirth = true;
+	}
+
+	//----------------------------------------------------------------------------------------------
+	// Optional time-resolved yields of the chemical stage (see ChemistryYieldTally): populations &
+	// outcomes of a few species at ChemistryYieldNumTimes time points, spaced logarithmically from
+	// ChemistryYieldTimeStart to ChemistryYieldTimeEnd
+	//----------------------------------------------------------------------------------------------
+	G4bool recordChemistryYields = false;
+	if ( fPm->ParameterExists(GetFullParmName("RecordChemistryYields")))
+		recordChemistryYields = fPm->GetBooleanParameter(GetFullParmName("RecordChemistryYields"));
+	if (recordChemistryYields && !fIncludeIndirectDamage) {
+		G4cerr << "Error: RecordChemistryYields requires IncludeIndirectDamage to be True." << G4endl;
+		exit(0);
+	}
+
+	if ( fPm->ParameterExists(GetFullParmName("FileChemistryYields")))
+		fFileChemistryYields = fPm->GetStringParameter(GetFullParmName("FileChemistryYields"));
+	else
+		fFileChemistryYields = "output_chemistry_yields";
+
+	fChemistryYieldSpecies.clear();
+	fChemistryYieldTimes.clear();
+	fChemistryYieldIndices.clear();
+	if (recordChemistryYields) {
+		if ( fPm->ParameterExists(GetFullParmName("ChemistryYieldSpecies"))) {
+			G4String* names = fPm->GetStringVector(GetFullParmName("ChemistryYieldSpecies"));
+			fChemistryYieldSpecies.assign(names, names + fPm->GetVectorLength(GetFullParmName("ChemistryYieldSpecies")));
+		}
+		else
+			fChemistryYieldSpecies = {"OH", "e_aq", "H"};
+
+		for (size_t i = 0; i < fChemistryYieldSpecies.size(); i++) {
+			G4MolecularConfiguration* configuration = G4MoleculeTable::Instance()->GetConfiguration(fChemistryYieldSpecies[i], false);
+			if (!configuration) {
+				G4cerr << "Error: Unknown species in ChemistryYieldSpecies: " << fChemistryYieldSpecies[i] << G4endl;
+				exit(0);
+			}
+			G4int moleculeID = configuration->GetMoleculeID();
+			if (moleculeID >= (G4int)fChemistryYieldIndices.size())
+				fChemistryYieldIndices.resize(moleculeID+1, -1);
+			fChemistryYieldIndices[moleculeID] = i;
+		}
+
+		G4double timeStart = 1.*ps;
+		if ( fPm->ParameterExists(GetFullParmName("ChemistryYieldTimeStart")))
+			timeStart = fPm->GetDoubleParameter(GetFullParmName("ChemistryYieldTimeStart"), "Time");
+		G4double timeEnd = 1.*ns;
+		if ( fPm->ParameterExists(GetFullParmName("ChemistryYieldTimeEnd")))
+			timeEnd = fPm->GetDoubleParameter(GetFullParmName("ChemistryYieldTimeEnd"), "Time");
+		G4int numTimes = 31;
+		if ( fPm->ParameterExists(GetFullParmName("ChemistryYieldNumTimes")))
+			numTimes = fPm->GetIntegerParameter(GetFullParmName("ChemistryYieldNumTimes"));
+		if (timeStart <= 0. || timeEnd <= timeStart || numTimes < 2) {
+			G4cerr << "Error: ChemistryYieldTimeStart must be positive & less than ChemistryYieldTimeEnd, "
+				   << "and ChemistryYieldNumTimes at least 2." << G4endl;
+			exit(0);
+		}
+		for (G4int i = 0; i < numTimes; i++)
+			fChemistryYieldTimes.push_back(timeStart*std::pow(timeEnd/timeStart, (G4double)i/(numTimes-1)));
+	}
+
+	//----------------------------------------------------------------------------------------------
+	// Optional attribution of direct damage to the particle type, creator process & generation of
+	// the track that deposited the most energy in each damaged residue (see TrackTagger)
+	//----------------------------------------------------------------------------------------------
+	if ( fPm->ParameterExists(GetFullParmName("RecordDamageAttribution")))
+		fRecordDamageAttribution = fPm->GetBooleanParameter(GetFullParmName("RecordDamageAttribution"));
+	else
+		fRecordDamageAttribution = false;
+	if (fRecordDamageAttribution && !fIncludeDirectDamage) {
+		G4cerr << "Error: RecordDamageAttribution requires IncludeDirectDamage to be True." << G4endl;
+		exit(0);
+	}
+
+	if ( fPm->ParameterExists(GetFullParmName("FileDamageAttribution")))
+		fFileDamageAttribution = fPm->GetStringParameter(GetFullParmName("FileDamageAttribution"));
+	else
+		fFileDamageAttribution = "output_damage_attribution";
+
+	//----------------------------------------------------------------------------------------------
+	// Fiber proxy. Must match the geometry component. Molecules diffuse through proxy fibers as
+	// through water, and their steps are tested against the residues & histones of the fiber
+	// template (see ProcessChemicalStepInFiberProxy()).
+	//----------------------------------------------------------------------------------------------
+	if ( fPm->ParameterExists(GetFullParmName("UseFiberProxy")))
+		fUseFiberProxy = fPm->GetBooleanParameter(GetFullParmName("UseFiberProxy"));
+	else
+		fUseFiberProxy = false;
+
+	fComponentName = fPm->GetStringParameter(GetFullParmName("Component"));
+	fFiberTemplate = NULL;
+	fFiberProxyMaterial = NULL;
+	if (fUseFiberProxy) {
+		G4String fiberProxyMaterialName = "G4_WATER_FIBER_PROXY";
+		if ( fPm->ParameterExists(GetFullParmName("FiberProxyMaterialName")))
+			fiberProxyMaterialName = fPm->GetStringParameter(GetFullParmName("FiberProxyMaterialName"));
+		fFiberProxyMaterial = GetMaterial(fiberProxyMaterialName);
+	}
+
+	//----------------------------------------------------------------------------------------------
+	// Hydration shells. They are not volumes, but radii carried by the residues of the fiber
+	// template, so they only apply where the template is used: a molecule reaches a residue when it
+	// enters the residue's shell (proxy fibers & IRT chemistry). They only affect indirect damage:
+	// direct damage is scored in the residues themselves in every mode.
+	//----------------------------------------------------------------------------------------------
+	if ( fPm->ParameterExists(GetFullParmName("UseHydrationShells")))
+		fUseHydrationShells = fPm->GetBooleanParameter(GetFullParmName("UseHydrationShells"));
+	else
+		fUseHydrationShells = false;
+	if (fUseHydrationShells && !fUseFiberProxy && fChemistryMode != fChemistryIRT) {
+		G4cerr << "Error: UseHydrationShells requires UseFiberProxy to be True or ChemistryMode to be IRT." << G4endl;
+		exit(0);
+	}
+
+	//----------------------------------------------------------------------------------------------
+	// Population of nuclei, counted from the parameters of the geometry component (see
+	// NucleusLayout). The layout itself is found once the geometry has been built.
+	//----------------------------------------------------------------------------------------------
+	fNumVoxelsPerNucleus = pow(fNumVoxelsPerSide,3);
+	fNumNuclei = 1;
+	if (fBuildNucleus)
+		fNumNuclei = NucleusLayout::ReadCentres(fPm, fComponentName, fNumVoxelsPerSide*fVoxelSideLength).size();
+	fNucleusLayout = NULL;
+
+	//----------------------------------------------------------------------------------------------
+	// Track library (see TrackLibrary). In Record mode, the energy deposits of each event are kept
+	// relative to the primary vertex & written at the end of the run, instead of scoring damage. In
+	// Replay mode, the transported particles are ignored: each event scores a track drawn from the
+	// libraries (e.g. one per energy bin of a spectrum, drawn with the given weights), randomly
+	// rotated & translated into a nucleus. Replay only scores direct damage.
+	//----------------------------------------------------------------------------------------------
+	G4String trackLibraryMode = "None";
+	if ( fPm->ParameterExists(GetFullParmName("TrackLibraryMode")))
+		trackLibraryMode = fPm->GetStringParameter(GetFullParmName("TrackLibraryMode"));
+	trackLibraryMode.toLower();
+	if (trackLibraryMode == "none")
+		fTrackLibraryMode = fTrackLibraryOff;
+	else if (trackLibraryMode == "record")
+		fTrackLibraryMode = fTrackLibraryRecord;
+	else if (trackLibraryMode == "replay")
+		fTrackLibraryMode = fTrackLibraryReplay;
+	else {
+		G4cerr << "Error: TrackLibraryMode must be None, Record or Replay." << G4endl;
+		exit(0);
+	}
+
+	if ( fPm->ParameterExists(GetFullParmName("TrackLibraryFile")))
+		fTrackLibraryFile = fPm->GetStringParameter(GetFullParmName("TrackLibraryFile"));
+	else
+		fTrackLibraryFile = "track_library.bin";
+
+	if ( fPm->ParameterExists(GetFullParmName("TrackLibraryRecordSpecies")))
+		fTrackLibraryRecordSpecies = fPm->GetBooleanParameter(GetFullParmName("TrackLibraryRecordSpecies"));
+	else
+		fTrackLibraryRecordSpecies = false;
+
+	if ( fPm->ParameterExists(GetFullParmName("TrackLibraryTranslationMargin")))
+		fTrackLibraryTranslationMargin = fPm->GetDoubleParameter(GetFullParmName("TrackLibraryTranslationMargin"), "Length");
+	else
+		fTrackLibraryTranslationMargin = 0.;
+
+	if (fTrackLibraryMode == fTrackLibraryRecord && fChemistryMode == fChemistryIRT) {
+		G4cerr << "Error: TrackLibraryMode Record cannot be used with ChemistryMode IRT." << G4endl;
+		exit(0);
+	}
+	if (fTrackLibraryMode == fTrackLibraryReplay) {
+		if (fIncludeIndirectDamage || fRecordDamageAttribution) {
+			G4cerr << "Error: TrackLibraryMode Replay cannot be used with IncludeIndirectDamage or RecordDamageAttribution." << G4endl;
+			exit(0);
+		}
+		if (!fPm->ParameterExists(GetFullParmName("TrackLibraryFiles"))) {
+			G4cerr << "Error: TrackLibraryMode Replay requires TrackLibraryFiles." << G4endl;
+			exit(0);
+		}
+		G4String* libraryFiles = fPm->GetStringVector(GetFullParmName("TrackLibraryFiles"));
+		G4int numLibraries = fPm->GetVectorLength(GetFullParmName("TrackLibraryFiles"));
+
+		std::vector<G4double> weights(numLibraries, 1.);
+		if (fPm->ParameterExists(GetFullParmName("TrackLibraryWeights"))) {
+			if (fPm->GetVectorLength(GetFullParmName("TrackLibraryWeights")) != numLibraries) {
+				G4cerr << "Error: TrackLibraryWeights must have one weight per file of TrackLibraryFiles." << G4endl;
+				exit(0);
+			}
+			G4double* values = fPm->GetUnitlessVector(GetFullParmName("TrackLibraryWeights"));
+			weights.assign(values, values + numLibraries);
+		}
+
+		G4double totalWeight = 0.;
+		for (G4int i = 0; i < numLibraries; i++) {
+			const TrackLibrary* library = TrackLibrary::Load(libraryFiles[i]);
+			if (!library || library->GetNumberOfTracks() == 0) {
+				G4cerr << "Error: Track library " << libraryFiles[i] << " cannot be read or holds no tracks." << G4endl;
+				exit(0);
+			}
+			if (weights[i] < 0.) {
+				G4cerr << "Error: TrackLibraryWeights cannot be negative." << G4endl;
+				exit(0);
+			}
+			totalWeight += weights[i];
+			fReplayLibraries.push_back(library);
+			fReplayCumulativeWeights.push_back(totalWeight);
+		}
+		if (totalWeight <= 0.) {
+			G4cerr << "Error: TrackLibraryWeights must include a positive weight." << G4endl;
+			exit(0);
+		}
+	}
+
 	//----------------------------------------------------------------------------------------------
 	// Material of DNA residue and histone volumes in which to score
 	//----------------------------------------------------------------------------------------------
@@ -434,10 +1157,6 @@ void ScoreClusteredDNADamage::ResolveParams() {
 		HistoneMaterialName = fPm->GetStringParameter(GetFullParmName("HistoneMaterialName"));
 	fHistoneMaterial = GetMaterial(HistoneMaterialName);
 
-	//----------------------------------------------------------------------------------------------
-	// Parameters not specific to this extension. Can't/don't need to use GetFullParmName()
-	//----------------------------------------------------------------------------------------------
-	fNumberOfThreads = fPm->GetIntegerParameter("Ts/NumberOfThreads");
 }
 
 
@@ -459,6 +1178,38 @@ void ScoreClusteredDNADamage::ClearOutputFiles() {
 	fileToClear.open(fFileNonDSBCluster+fOutFileExtension, std::ofstream::trunc);
 	fileToClear.close();
 
+	// Event tallies
+	if (fRecordEventTallies) {
+		fileToClear.open(fFileEventTallies+fOutFileExtension, std::ofstream::trunc);
+		fileToClear.close();
+	}
+
+	// Damage attribution
+	if (fRecordDamageAttribution) {
+		fileToClear.open(fFileDamageAttribution+fOutFileExtension, std::ofstream::trunc);
+		fileToClear.close();
+	}
+
+	// Run metrics
+	if (fRecordRunMetrics) {
+		fileToClear.open(fFileRunMetrics+fOutFileExtension, std::ofstream::trunc);
+		fileToClear.close();
+	}
+
+	// Chemistry yields
+	if (!fChemistryYieldSpecies.empty()) {
+		fileToClear.open(fFileChemistryYields+fOutFileExtension, std::ofstream::trunc);
+		fileToClear.close();
+	}
+
+	// Energy groups
+	if (!fEnergyGroupEdges.empty()) {
+		fileToClear.open(fFileEnergyGroups+fOutFileExtension, std::ofstream::trunc);
+		fileToClear.close();
+		fileToClear.open(fFileEnergyGroups+"_cluster_sizes"+fOutFileExtension, std::ofstream::trunc);
+		fileToClear.close();
+	}
+
 	// Headers
 	if (fOutputHeaders) {
 		fileToClear.open(fFileRunSummary+fOutHeaderExtension, std::ofstream::trunc);
@@ -471,21 +1222,72 @@ void ScoreClusteredDNADamage::ClearOutputFiles() {
 }
 
 
+//--------------------------------------------------------------------------------------------------
+// Create the result cache of this scorer. The key covers the parameters of this scorer, all geometry
+// components, materials, physics & chemistry, sources (spectra, # histories), time features,
+// variance reduction, the seed & the number of threads. Parameters that only name outputs, control
+// console output or the cache itself are left out, as is the fiber template file (a cache too).
+//--------------------------------------------------------------------------------------------------
+ResultCache* ScoreClusteredDNADamage::CreateResultCache(const G4String& outFileName) {
+	ResultCache* cache = new ResultCache(fResultCacheDirectory);
+
+	std::vector<G4String> scorerExclusions = {"OutputFile", "IfOutputFileAlreadyExists", "OutputToConsole",
+											  "UseResultCache", "ReuseCachedResults", "ResultCacheDirectory",
+											  "YieldEstimateInterval", "YieldEstimateNumFibers", "RecordEventTimeline",
+											  "EventTimelineSampleInterval", "EventTimelineBufferSize", "RecordRunMetrics",
+											  "TrackLibraryFile", "PublishStatusStream", "StatusStreamSocket",
+											  "StatusStreamInterval"};
+	cache->AddParameters(fPm, "Sc/" + GetName() + "/", scorerExclusions, {"File"});
+	cache->AddParameters(fPm, "Ge/", {"FiberTemplateFile"});
+	cache->AddParameters(fPm, "Ma/");
+	cache->AddParameters(fPm, "El/");
+	cache->AddParameters(fPm, "Ph/");
+	cache->AddParameters(fPm, "Ch/");
+	cache->AddParameters(fPm, "So/");
+	cache->AddParameters(fPm, "Tf/");
+	cache->AddParameters(fPm, "Vr/");
+	cache->AddParameters(fPm, "Ts/Seed");
+	cache->AddParameters(fPm, "Ts/NumberOfThreads");
+
+	// Main output file (extensions of the Topas output types), then the files of this scorer
+	cache->AddOutputFile("ntuple.phsp", outFileName + ".phsp");
+	cache->AddOutputFile("ntuple.header", outFileName + ".header");
+	cache->AddOutputFile("ntuple.root", outFileName + ".root");
+	cache->AddOutputFile("ntuple.xml", outFileName + ".xml");
+
+	std::vector<std::pair<G4String, G4String> > files = {
+		{"run_summary", fFileRunSummary}, {"complex_dsb", fFileComplexDSB},
+		{"non_dsb_cluster", fFileNonDSBCluster}, {"event_tallies", fFileEventTallies},
+		{"damage_attribution", fFileDamageAttribution}, {"energy_groups", fFileEnergyGroups},
+		{"energy_groups_cluster_sizes", fFileEnergyGroups+"_cluster_sizes"}, {"chemistry_yields", fFileChemistryYields}};
+	for (size_t i=0; i<files.size(); ++i) {
+		cache->AddOutputFile(files[i].first + fOutFileExtension, files[i].second + fOutFileExtension);
+		if (fOutputHeaders)
+			cache->AddOutputFile(files[i].first + fOutHeaderExtension, files[i].second + fOutHeaderExtension);
+	}
+	if (fTrackLibraryMode == fTrackLibraryRecord)
+		cache->AddOutputFile("track_library.bin", fTrackLibraryFile);
+
+	return cache;
+}
+
+
 //--------------------------------------------------------------------------------------------------
 // Calculate cubic volume of component attached to the scorer. Use parameter values to perform
-// calculation according to the shape of the volume
+// calculation according to the shape of the volume. With several nuclei, only the nuclei are
+// counted (energy deposited between them is not scored), so doses are averaged over the nuclei.
 //--------------------------------------------------------------------------------------------------
 G4double ScoreClusteredDNADamage::CalculateComponentVolume() {
-	G4double componentVolume = pow(2*fVoxelSideLength*fNumVoxelsPerSide,3);
+	G4double componentVolume = fNumNuclei*pow(2*fVoxelSideLength*fNumVoxelsPerSide,3);
 
 	return componentVolume;
 }
 
 //--------------------------------------------------------------------------------------------------
 // Handle conversion of dose threshold to energy threshold using the cubic volume and density of
-// the geometry component. The resulting energy threshold is divided evenly amongst the worker
-// threads. E.g. If total energy threshold is 1 MeV and there are 4 worker threads. The returned
-// value is 0.25 MeV.
+// the geometry component. The returned threshold is the total for the run: each thread adds the
+// energy of its events to the run-wide total of this scorer (runEdepByScorer, see AddToRunEdep()) &
+// the run is aborted once that total exceeds the threshold, e.g. 1 MeV whatever the number of threads.
 //--------------------------------------------------------------------------------------------------
 G4double ScoreClusteredDNADamage::ConvertDoseThresholdToEnergy() {
 	G4double energyThreshold;
@@ -501,10 +1303,8 @@ G4double ScoreClusteredDNADamage::ConvertDoseThresholdToEnergy() {
 	energyThreshold = GetMaterial("G4_WATER")->GetDensity() * fComponentVolume * fDoseThreshold;
 	// energyThreshold = fDNAMaterial->GetDensity() * volume * fDoseThreshold;
 
-	// Divide by number of threads
-	if (fNumberOfThreads > 1){
-		energyThreshold /= fNumberOfThreads;
-	}
+	// The threshold applies to the energy deposited by all threads together (see AddToRunEdep()),
+	// so it is not divided by the number of threads
 
 	// Output information
 	// G4cout << "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^" << G4endl;
@@ -528,155 +1328,193 @@ G4double ScoreClusteredDNADamage::ConvertDoseThresholdToEnergy() {
 // deposition took place. This is faster than using string comparisons. This method is only called
 // for energy depositions in the sensitive volumes (i.e. residues) by using material filtering, as
 // defined in the parameter file with "OnlyIncludeIfInMaterial" parameter.
+//
+// The step handler is selected at construction: IgnoreStep() if the outputs are restored from the
+// result cache, ProcessHitsWithStepFeatures() if a feature acting on every step is enabled, or else
+// directly the variant of ProcessHitsForConfiguration() for this configuration.
 //--------------------------------------------------------------------------------------------------
 G4bool ScoreClusteredDNADamage::ProcessHits(G4Step* aStep,G4TouchableHistory*)
 {
 	fNumProcessHitsCalls++; // for debugging purposes
+	return (this->*fStepHandler)(aStep);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Step handler applying the features that act on every step (track library, scavenging by the
+// cellular environment, nucleus of the step, time-resolved yields & proxy fibers) before the
+// variant of ProcessHitsForConfiguration() for this configuration.
+//--------------------------------------------------------------------------------------------------
+G4bool ScoreClusteredDNADamage::ProcessHitsWithStepFeatures(G4Step* aStep)
+{
 	G4double edep = aStep->GetTotalEnergyDeposit(); // In eV;
-	fTotalEdep += edep; // running sum of energy deposition in entire volume
 
-	// Material filtering of pre-step and post-step (only proceed if a sensitive volume is involved)
-	G4Material* materialPreStep = aStep->GetPreStepPoint()->GetMaterial();
-	G4bool isPreStepDNAMaterial = (materialPreStep == fDNAMaterial);
-	G4bool isPreStepHistoneMaterial = (materialPreStep == fHistoneMaterial);
-	G4Material* materialPostStep = aStep->GetPostStepPoint()->GetMaterial();
-	G4bool isPostStepDNAMaterial = (materialPostStep == fDNAMaterial);
-	if (!isPreStepDNAMaterial && !isPostStepDNAMaterial && !isPreStepHistoneMaterial) {
+	// Track library: record the deposits of this event, or ignore the transported particles when
+	// library tracks are scored instead (see ReplayLibraryTrack())
+	if (fTrackLibraryMode == fTrackLibraryRecord) {
+		return RecordLibraryStep(aStep);
+	}
+	if (fTrackLibraryMode == fTrackLibraryReplay) {
 		return false;
 	}
 
-	// G4Touchable provides access to parent volumes, etc.
-	G4TouchableHistory* touchable;
-	if (isPreStepDNAMaterial || isPreStepHistoneMaterial) {
-		touchable = (G4TouchableHistory*)(aStep->GetPreStepPoint()->GetTouchable());
+	// Molecules scavenged by the cellular environment during the step take no part in it
+	if (fIncludeScavenging && aStep->GetTrack()->GetTrackID() < 0 && ScavengeMolecule(aStep)) {
+		return false;
 	}
-	else if (isPostStepDNAMaterial) {
-		touchable = (G4TouchableHistory*)(aStep->GetPostStepPoint()->GetTouchable());
+
+	// Nucleus of the step, used in the voxel IDs. Steps in the water between nuclei are not scored.
+	if (fNumNuclei > 1) {
+		if (!fNucleusLayout) {
+			fNucleusLayout = NucleusLayout::Find(fComponentName);
+			if (!fNucleusLayout) {
+				G4cerr << "Error: No nucleus layout found for component " << fComponentName
+					   << ". Sc/" << GetName() << "/BuildNucleus must match the geometry component." << G4endl;
+				exit(0);
+			}
+		}
+		fNucleusID = fNucleusLayout->Locate(aStep->GetPreStepPoint()->GetTouchable());
+		if (fNucleusID < 0) {
+			return false;
+		}
+		fNucleusEdep[fNucleusID] += edep;
 	}
-	else {
-		G4cerr << "Error: Material check failed. PreStep: " << materialPreStep << " PostStep: " << materialPostStep << G4endl;
-		exit(0);
+
+	// Molecules present in the nucleus during the step, for the time-resolved yields
+	if (fChemistryYieldTally && aStep->GetTrack()->GetTrackID() < 0) {
+		TallyChemistryStep(aStep);
 	}
 
-	// Determine unique voxel ID number using replica ID of parent volumes
-	if (fBuildNucleus) {
-		G4int voxIDZ = touchable->GetReplicaNumber(fParentIndexVoxelZ);
-		G4int voxIDX = touchable->GetReplicaNumber(fParentIndexVoxelX);
-		G4int voxIDY = touchable->GetReplicaNumber(fParentIndexVoxelY);
-		fVoxelID = voxIDZ + (fNumVoxelsPerSide*voxIDX) + (fNumVoxelsPerSide*fNumVoxelsPerSide*voxIDY);
+	// Energy depositions in proxy fibers are attributed to residues separately
+	if (fUseFiberProxy && aStep->GetPreStepPoint()->GetMaterial() == fFiberProxyMaterial) {
+		return ProcessHitsInFiberProxy(aStep);
 	}
-	// Determine unique fiber ID number using copy ID of parent
-	if (fNumFibers > 1) {
-		fFiberID = touchable->GetCopyNumber(fParentIndexFiber);
+
+	// Variant of the step handler specialised for this scorer's configuration
+	return (this->*fConfigurationHandler)(aStep);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Select the variant of ProcessHitsForConfiguration() matching the configuration flags. Each flag
+// is appended in turn to the template arguments, so the flags must be passed in the order of the
+// template parameters of ProcessHitsForConfiguration().
+//--------------------------------------------------------------------------------------------------
+template<G4bool... kFlags>
+ScoreClusteredDNADamage::StepHandler ScoreClusteredDNADamage::SelectStepHandler()
+{
+	return &ScoreClusteredDNADamage::ProcessHitsForConfiguration<kFlags...>;
+}
+
+template<G4bool... kFlags, typename... Args>
+ScoreClusteredDNADamage::StepHandler ScoreClusteredDNADamage::SelectStepHandler(G4bool flag, Args... flags)
+{
+	if (flag)
+		return SelectStepHandler<kFlags..., true>(flags...);
+	else
+		return SelectStepHandler<kFlags..., false>(flags...);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Step handler for one configuration of the scorer. The configuration flags are template
+// parameters, so the tests on disabled features are removed at compile time. When only direct
+// damage is scored, steps are rejected as soon as they cannot deposit energy in a residue.
+//--------------------------------------------------------------------------------------------------
+template<G4bool kIncludeDirect, G4bool kIncludeIndirect, G4bool kBuildNucleus, G4bool kMultipleFibers,
+		 G4bool kHistonesAsScavenger>
+G4bool ScoreClusteredDNADamage::ProcessHitsForConfiguration(G4Step* aStep)
+{
+	fTotalEdep += aStep->GetTotalEnergyDeposit(); // running sum of energy deposition in entire volume
+
+	G4Material* materialPreStep = aStep->GetPreStepPoint()->GetMaterial();
+	G4bool isPreStepDNAMaterial = (materialPreStep == fDNAMaterial);
+	G4int trackID = aStep->GetTrack()->GetTrackID(); // Determines whether track is physical or chemical
+
+	//----------------------------------------------------------------------------------------------
+	// Direct damage only: the energy must be deposited in a DNA volume by a physical track
+	//----------------------------------------------------------------------------------------------
+	if (!kIncludeIndirect) {
+		if (!kIncludeDirect || !isPreStepDNAMaterial || trackID < 0 || aStep->GetTotalEnergyDeposit() <= 0) {
+			return false;
+		}
+		G4TouchableHistory* touchable = (G4TouchableHistory*)(aStep->GetPreStepPoint()->GetTouchable());
+		SetVoxelAndFiberID<kBuildNucleus, kMultipleFibers>(touchable, 0);
+
+		G4int volID = touchable->GetVolume()->GetCopyNo();
+		G4int strandID = volID / 1000000;
+		G4int residueID = (volID - (strandID*1000000)) / 100000;
+		G4int bpID = volID - (strandID*1000000) - (residueID*100000);
+		AddDirectEnergyDeposit(strandID, residueID, bpID, aStep->GetTotalEnergyDeposit(), aStep->GetTrack());
+		return true;
+	}
+
+	// Material filtering of pre-step and post-step (only proceed if a sensitive volume is involved)
+	G4bool isPreStepHistoneMaterial = (materialPreStep == fHistoneMaterial);
+	G4Material* materialPostStep = aStep->GetPostStepPoint()->GetMaterial();
+	G4bool isPostStepDNAMaterial = (materialPostStep == fDNAMaterial);
+	if (!isPreStepDNAMaterial && !isPostStepDNAMaterial && !isPreStepHistoneMaterial) {
+		return false;
+	}
+
+	// G4Touchable provides access to parent volumes, etc.
+	G4TouchableHistory* touchable;
+	if (isPreStepDNAMaterial || isPreStepHistoneMaterial) {
+		touchable = (G4TouchableHistory*)(aStep->GetPreStepPoint()->GetTouchable());
+	}
+	else {
+		touchable = (G4TouchableHistory*)(aStep->GetPostStepPoint()->GetTouchable());
 	}
+	SetVoxelAndFiberID<kBuildNucleus, kMultipleFibers>(touchable, 0);
+
 	// Determine the indices defining the volume in which hit occured by parsing the copy number of the Physical Volume.
 	G4int volID = touchable->GetVolume()->GetCopyNo();
 	G4int strandID = volID / 1000000;
 	G4int residueID = (volID - (strandID*1000000)) / 100000;
 	G4int bpID = volID - (strandID*1000000) - (residueID*100000);
 
-	// Determines whether track is physical or chemical
-	G4int trackID = aStep->GetTrack()->GetTrackID();
-
 	//----------------------------------------------------------------------------------------------
 	// If this hit deposits energy (in sensitive DNA volume), update the appropriate energy deposition
 	// map
 	//----------------------------------------------------------------------------------------------
-	if (fIncludeDirectDamage && edep > 0 && trackID >= 0 && isPreStepDNAMaterial) { // energy deposition should be from physical tracks
-		//------------------------------------------------------------------------------------------
-		// Use the DNA strand ID, residue ID, and nucleotide ID to increment the energy deposited
-		// in the appropriate energy deposition map. Maps are indexed as follows:
-		// First index specifies the voxel
-		// Second index specifies DNA fibre
-		// Third index specifies the bp index
-		//------------------------------------------------------------------------------------------
-		if ( strandID == 0 ){ // first strand
-			if (residueID == fVolIdPhosphate || residueID == fVolIdDeoxyribose) {
-				fMapEdepStrand1Backbone[fVoxelID][fFiberID][bpID] += edep;
-			}
-			else if (residueID == fVolIdBase) {
-				fMapEdepStrand1Base[fVoxelID][fFiberID][bpID] += edep;
-			}
-		}
-		else if ( strandID == 1 ) { // second strand
-			if (residueID == fVolIdPhosphate || residueID == fVolIdDeoxyribose) {
-				fMapEdepStrand2Backbone[fVoxelID][fFiberID][bpID] += edep;
-			}
-			else if (residueID == fVolIdBase) {
-				fMapEdepStrand2Base[fVoxelID][fFiberID][bpID] += edep;
-			}
-		}
-		else {
-			G4cerr << "Error: (While scoring direct damage) The following strandID is unrecognized: " << strandID << G4endl;
-			exit(0);
-		}
+	G4double edep = aStep->GetTotalEnergyDeposit();
+	if (kIncludeDirect && edep > 0 && trackID >= 0 && isPreStepDNAMaterial) { // energy deposition should be from physical tracks
+		AddDirectEnergyDeposit(strandID, residueID, bpID, edep, aStep->GetTrack());
 		return true;
 	}
 
 	// Indirect damage
-	else if (fIncludeIndirectDamage && trackID < 0) { // chemical tracks
-		// Get molecule info
-		G4int moleculeID = GetMolecule(aStep->GetTrack())->GetMoleculeID();
+	else if (trackID < 0) { // chemical tracks
+		// Molecule info, constant over the lifetime of the track
+		const ChemicalTrackRecord& record = GetChemicalTrackRecord(aStep->GetTrack());
 
-		// Kill species generated inside DNA volumes and histones by not letting them exit
-		G4Material* materialTrackVertex = aStep->GetTrack()->GetLogicalVolumeAtVertex()->GetMaterial();
-		G4bool isPreStepInTrackVertexVolume = (materialPreStep == materialTrackVertex);
+		// Kill species generated inside DNA volumes and histones by not letting them exit. Not needed
+		// if they are killed at birth by fTrackClassifier.
 		G4bool isPostStepInNewVolume	= (aStep->GetPostStepPoint()->GetStepStatus() == fGeomBoundary);
-		if ( isPostStepInNewVolume && isPreStepInTrackVertexVolume && (isPreStepDNAMaterial || isPreStepHistoneMaterial) ) {
+		if ( isPostStepInNewVolume && ((isPreStepDNAMaterial && (record.flags & fChemFlagBornInDNA))
+									   || (isPreStepHistoneMaterial && (record.flags & fChemFlagBornInHistone))) ) {
 			aStep->GetTrack()->SetTrackStatus(fStopAndKill);
 			return false;
 		}
 
-		// Determine if damage is inflicted
-		G4bool isDamaged = IsDamageInflicted(moleculeID, residueID);
-		if (isDamaged && isPostStepDNAMaterial && isPostStepInNewVolume && !isPreStepDNAMaterial && !isPreStepHistoneMaterial) {
-			// Check which damage map to update
-			if ( strandID == 0 ) { // first strand
-				if (residueID == fVolIdPhosphate || residueID == fVolIdDeoxyribose) { // backbone damage
-					fIndices = &fMapIndDamageStrand1Backbone[fVoxelID][fFiberID];
-				}
-				else if (residueID == fVolIdBase){ // base damage
-					fIndices = &fMapIndDamageStrand1Base[fVoxelID][fFiberID];
-				}
-			}
-			else if ( strandID == 1 ) { // second strand
-				if (residueID == fVolIdPhosphate || residueID == fVolIdDeoxyribose) { // backbone damage
-					fIndices = &fMapIndDamageStrand2Backbone[fVoxelID][fFiberID];
-				}
-				else if (residueID == fVolIdBase){ // base damage
-					fIndices = &fMapIndDamageStrand2Base[fVoxelID][fFiberID];
-				}
-			}
-			else {
-				G4cerr << "Error: (While scoring indirect damage) The following strandID is unrecognized: " << strandID << G4endl;
-				exit(0);
-			}
-
-			// Check if backbone or base has already been damaged previously via indirect action
-			if (IsElementInVector(bpID, *fIndices)) {
-				fDoubleCountsII++;
-				return false;
-			}
-			else { // Record damaged nucleotide
-				fIndices->push_back(bpID);
+		// Molecule entering a DNA volume from outside the DNA & histones
+		if (isPostStepDNAMaterial && isPostStepInNewVolume && !isPreStepDNAMaterial && !isPreStepHistoneMaterial) {
+			G4int reaction = ReactWithResidue(volID, record.moleculeID, aStep->GetPostStepPoint()->GetGlobalTime(),
+											  record.probDamageBase, record.probDamageBackbone,
+											  record.flags & fChemFlagKilledByDNA);
+			if (reaction != fResidueReactionNone) {
 				aStep->GetTrack()->SetTrackStatus(fStopAndKill);
-				return true;
 			}
-		}
-
-		// Kill certain species interacting with DNA volumes
-		G4bool isSpeciesToKillByDNA = IsElementInVector(moleculeID, fSpeciesToKillByDNAVolumes);
-		if (isPostStepDNAMaterial && isPostStepInNewVolume && isSpeciesToKillByDNA && !isPreStepDNAMaterial && !isPreStepHistoneMaterial) {
-			aStep->GetTrack()->SetTrackStatus(fStopAndKill);
-			return false;
+			return (reaction == fResidueReactionDamage);
 		}
 
 		// Kill certain species diffusing in histone volumes
-		if (fHistonesAsScavenger && isPreStepHistoneMaterial) {
-			G4bool isSpeciesToKillByHistone = IsElementInVector(moleculeID, fspeciesToKillByHistones);
+		if (kHistonesAsScavenger && isPreStepHistoneMaterial && (record.flags & fChemFlagKilledByHistone)) {
 			G4bool isPreStepInNewVolume	= (aStep->GetPreStepPoint()->GetStepStatus() == fGeomBoundary);
-			if (isSpeciesToKillByHistone && isPreStepInNewVolume) {
+			if (isPreStepInNewVolume) {
 				aStep->GetTrack()->SetTrackStatus(fStopAndKill);
+				TallyChemistryOutcome(record.moleculeID, ChemistryYieldTally::kOutcomeKilledByHistone,
+									  aStep->GetPreStepPoint()->GetGlobalTime());
 				return false;
 			}
 		}
@@ -686,6 +1524,845 @@ G4bool ScoreClusteredDNADamage::ProcessHits(G4Step* aStep,G4TouchableHistory*)
 }
 
 
+//--------------------------------------------------------------------------------------------------
+// Determine the unique voxel ID number using the replica IDs of the parent volumes, and the fiber ID
+// number using the copy number of the fiber. depthOffset is added to the touchable depths of the
+// parents of a residue volume (e.g. -1 if the touchable is a fiber).
+//--------------------------------------------------------------------------------------------------
+template<G4bool kBuildNucleus, G4bool kMultipleFibers>
+void ScoreClusteredDNADamage::SetVoxelAndFiberID(G4TouchableHistory* touchable, G4int depthOffset)
+{
+	if (kBuildNucleus) {
+		G4int voxIDZ = touchable->GetReplicaNumber(fParentIndexVoxelZ+depthOffset);
+		G4int voxIDX = touchable->GetReplicaNumber(fParentIndexVoxelX+depthOffset);
+		G4int voxIDY = touchable->GetReplicaNumber(fParentIndexVoxelY+depthOffset);
+		fVoxelID = voxIDZ + (fNumVoxelsPerSide*voxIDX) + (fNumVoxelsPerSide*fNumVoxelsPerSide*voxIDY)
+				   + fNucleusID*fNumVoxelsPerNucleus;
+	}
+	if (kMultipleFibers) {
+		fFiberID = touchable->GetCopyNumber(fParentIndexFiber+depthOffset);
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Apply the indirect damage rules to a molecule reaching a residue, whether it enters a residue
+// volume, crosses a residue of a proxy fiber or encounters a residue in IRT chemistry. A molecule
+// damaging a residue already damaged by indirect action is counted as a double count & survives.
+//--------------------------------------------------------------------------------------------------
+G4int ScoreClusteredDNADamage::ReactWithResidue(G4int volID, G4int moleculeID, G4double time, G4float probDamageBase,
+												G4float probDamageBackbone, G4bool isKilledByDNA)
+{
+	G4int strandID = volID / 1000000;
+	G4int residueID = (volID - (strandID*1000000)) / 100000;
+	G4int bpID = volID - (strandID*1000000) - (residueID*100000);
+
+	// Determine if damage is inflicted
+	G4float probDamage = (residueID == fVolIdBase) ? probDamageBase : probDamageBackbone;
+	if (probDamage > 0. && G4UniformRand() <= probDamage) {
+		// Damage map of the strand & residue type
+		fIndices = &(*fMapIndDamageByChannel[GetDamageChannel(strandID, residueID)])[fVoxelID][fFiberID];
+
+		// Check if backbone or base has already been damaged previously via indirect action
+		if (IsElementInVector(bpID, *fIndices)) {
+			fDoubleCountsII++;
+			return fResidueReactionNone;
+		}
+		fIndices->push_back(bpID); // Record damaged nucleotide
+		TallyChemistryOutcome(moleculeID, ChemistryYieldTally::kOutcomeDamage, time);
+		return fResidueReactionDamage;
+	}
+
+	// Kill certain species interacting with DNA volumes
+	if (!isKilledByDNA) {
+		return fResidueReactionNone;
+	}
+	TallyChemistryOutcome(moleculeID, ChemistryYieldTally::kOutcomeKilledByDNA, time);
+	return fResidueReactionScavenged;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Handle a step in a proxy fiber (a homogeneous DNA-equivalent cylinder, see the VoxelizedNuclearDNA
+// parameter UseFiberProxy). The energy deposited by the step is attributed to its post-step point,
+// where Geant4-DNA places the deposit of a discrete interaction. The DNAFiberTemplate of the
+// component gives the residue occupying that point in the full fiber geometry, if any. Energy deposited outside the residues is
+// not scored, like energy deposited in water or histones in the full geometry.
+//--------------------------------------------------------------------------------------------------
+G4bool ScoreClusteredDNADamage::ProcessHitsInFiberProxy(G4Step* aStep)
+{
+	fTotalEdep += aStep->GetTotalEnergyDeposit(); // running sum of energy deposition in entire volume
+
+	if (aStep->GetTrack()->GetTrackID() < 0) {
+		return fIncludeIndirectDamage ? ProcessChemicalStepInFiberProxy(aStep) : false;
+	}
+
+	G4double edep = aStep->GetTotalEnergyDeposit();
+	if (!fIncludeDirectDamage || edep <= 0) {
+		return false;
+	}
+
+	// The proxy fiber is the volume of the pre-step point, so its parents are one level higher
+	// than for a residue volume.
+	G4TouchableHistory* touchable = (G4TouchableHistory*)(aStep->GetPreStepPoint()->GetTouchable());
+	if (fBuildNucleus)
+		SetVoxelAndFiberID<true, true>(touchable, -1);
+	else if (fNumFibers > 1)
+		SetVoxelAndFiberID<false, true>(touchable, -1);
+
+	G4int volID = LocateDepositInFiberProxy(touchable, aStep->GetPostStepPoint()->GetPosition());
+	if (volID < 0) {
+		return false;
+	}
+
+	G4int strandID = volID / 1000000;
+	G4int residueID = (volID - (strandID*1000000)) / 100000;
+	G4int bpID = volID - (strandID*1000000) - (residueID*100000);
+
+	AddDirectEnergyDeposit(strandID, residueID, bpID, edep, aStep->GetTrack());
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Return the copy number of the residue of the fiber template containing an energy deposit at a
+// global point in a proxy fiber (the volume of the touchable), or -1 if none. Transported & replayed
+// tracks (ScoreLibraryDeposit()) share this lookup, so their deposits are attributed alike. Hydration
+// shells are not included, as they only apply to indirect damage.
+//--------------------------------------------------------------------------------------------------
+G4int ScoreClusteredDNADamage::LocateDepositInFiberProxy(G4TouchableHistory* touchable, const G4ThreeVector& point)
+{
+	G4ThreeVector localPoint = touchable->GetHistory()->GetTopTransform().TransformPoint(point);
+	return GetFiberTemplate()->LocateResidue(localPoint);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Handle a diffusion step of a molecule in a proxy fiber. The fiber contains no DNA volumes, so the
+// molecule is not stopped at the residues by the navigator: the step, as a straight segment in the
+// fiber frame, is tested against the residues & histones of the fiber template instead. The first
+// one entered along the step follows the rules of ProcessHitsForConfiguration() for a molecule
+// entering a residue volume or diffusing in a histone volume. A molecule created inside a residue
+// or a histone is killed at its first step, as if killed at birth. With hydration shells, residues
+// are entered at their shell, and a molecule created inside a shell reaches its residue at once.
+//--------------------------------------------------------------------------------------------------
+G4bool ScoreClusteredDNADamage::ProcessChemicalStepInFiberProxy(G4Step* aStep)
+{
+	G4Track* track = aStep->GetTrack();
+	const DNAFiberTemplate* fiberTemplate = GetFiberTemplate();
+
+	G4TouchableHistory* touchable = (G4TouchableHistory*)(aStep->GetPreStepPoint()->GetTouchable());
+	const G4AffineTransform& globalToFiber = touchable->GetHistory()->GetTopTransform();
+	G4ThreeVector start = globalToFiber.TransformPoint(aStep->GetPreStepPoint()->GetPosition());
+	G4ThreeVector end = globalToFiber.TransformPoint(aStep->GetPostStepPoint()->GetPosition());
+
+	if (track->GetCurrentStepNumber() == 1
+		&& (fiberTemplate->LocateResidue(start) >= 0 || fiberTemplate->LocateHistone(start) >= 0)) {
+		track->SetTrackStatus(fStopAndKill);
+		return false;
+	}
+
+	DNAFiberTemplate::SegmentCrossing crossing;
+	G4int shellResidue = -1;
+	if (fUseHydrationShells && track->GetCurrentStepNumber() == 1)
+		shellResidue = fiberTemplate->LocateResidue(start, true);
+	if (shellResidue >= 0) {
+		crossing.isHistone = false;
+		crossing.target = shellResidue;
+		crossing.fraction = 0.;
+	}
+	else if (!fiberTemplate->FindFirstCrossing(start, end, crossing, fUseHydrationShells)) {
+		return false;
+	}
+
+	// Molecule info, constant over the lifetime of the track
+	const ChemicalTrackRecord& record = GetChemicalTrackRecord(track);
+	G4double preStepTime = aStep->GetPreStepPoint()->GetGlobalTime();
+	G4double crossingTime = preStepTime + crossing.fraction*(aStep->GetPostStepPoint()->GetGlobalTime() - preStepTime);
+
+	// Kill certain species entering histones
+	if (crossing.isHistone) {
+		if (fHistonesAsScavenger && (record.flags & fChemFlagKilledByHistone)) {
+			track->SetTrackStatus(fStopAndKill);
+			TallyChemistryOutcome(record.moleculeID, ChemistryYieldTally::kOutcomeKilledByHistone, crossingTime);
+		}
+		return false;
+	}
+
+	// The proxy fiber is the volume of the pre-step point, so its parents are one level higher
+	// than for a residue volume.
+	if (fBuildNucleus)
+		SetVoxelAndFiberID<true, true>(touchable, -1);
+	else if (fNumFibers > 1)
+		SetVoxelAndFiberID<false, true>(touchable, -1);
+
+	G4int reaction = ReactWithResidue(crossing.target, record.moleculeID, crossingTime, record.probDamageBase,
+									  record.probDamageBackbone, record.flags & fChemFlagKilledByDNA);
+	if (reaction != fResidueReactionNone) {
+		track->SetTrackStatus(fStopAndKill);
+	}
+	return (reaction == fResidueReactionDamage);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Return the fiber template of the component. The template is built by the geometry component on
+// the master thread.
+//--------------------------------------------------------------------------------------------------
+const DNAFiberTemplate* ScoreClusteredDNADamage::GetFiberTemplate()
+{
+	if (!fFiberTemplate) {
+		fFiberTemplate = DNAFiberTemplate::Find(fComponentName);
+		if (!fFiberTemplate) {
+			G4cerr << "Error: No fiber template found for component " << fComponentName
+				   << ". Ge/" << fComponentName << "/UseFiberProxy or Ge/" << fComponentName
+				   << "/BuildFiberTemplate must be True." << G4endl;
+			exit(0);
+		}
+	}
+	return fFiberTemplate;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Record the energy deposited by a physical step at its post-step point (as for proxy fibers), and
+// the position of each chemical track at its first step, which is where the species was created.
+//--------------------------------------------------------------------------------------------------
+G4bool ScoreClusteredDNADamage::RecordLibraryStep(G4Step* aStep)
+{
+	G4Track* track = aStep->GetTrack();
+	if (track->GetTrackID() < 0) {
+		if (!fTrackLibraryRecordSpecies) {
+			return false;
+		}
+		size_t index = -track->GetTrackID();
+		if (index >= fIsSpeciesRecorded.size())
+			fIsSpeciesRecorded.resize(index+1, false);
+		if (!fIsSpeciesRecorded[index]) {
+			fIsSpeciesRecorded[index] = true;
+			fRecordedTrackLibrary->AddSpecies(GetMolecule(track)->GetMolecularConfiguration()->GetUserID(),
+											  aStep->GetPreStepPoint()->GetPosition());
+		}
+		return false;
+	}
+
+	G4double edep = aStep->GetTotalEnergyDeposit();
+	if (edep <= 0) {
+		return false;
+	}
+	fTotalEdep += edep;
+
+	fRecordedTrackLibrary->AddDeposit(aStep->GetPostStepPoint()->GetPosition(), edep);
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Close the track of the current event, relative to the vertex of its first primary.
+//--------------------------------------------------------------------------------------------------
+void ScoreClusteredDNADamage::CloseLibraryTrack()
+{
+	G4ThreeVector vertex;
+	G4double primaryEnergy = 0.;
+	const G4Event* event = G4EventManager::GetEventManager()->GetConstCurrentEvent();
+	if (event && event->GetNumberOfPrimaryVertex() > 0 && event->GetPrimaryVertex(0)->GetPrimary(0)) {
+		vertex = event->GetPrimaryVertex(0)->GetPosition();
+		primaryEnergy = event->GetPrimaryVertex(0)->GetPrimary(0)->GetKineticEnergy();
+	}
+	fRecordedTrackLibrary->EndTrack(vertex, primaryEnergy);
+	fIsSpeciesRecorded.clear();
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Score a track of the libraries in place of the transported particles of the current event. The
+// library is drawn with its weight, then the track uniformly within it. The track is given a
+// uniformly random orientation (a rotation about z, then z is turned to a random direction) and its
+// vertex is placed uniformly in a nucleus (drawn uniformly if there are several), widened by the
+// translation margin so tracks starting outside the nucleus are included.
+//--------------------------------------------------------------------------------------------------
+void ScoreClusteredDNADamage::ReplayLibraryTrack()
+{
+	// Copy of the component placed at the origin, so points are located in the component frame. It
+	// shares the logical volumes of the component, built on the master thread.
+	if (!fReplayNavigator) {
+		const NucleusLayout* layout = NucleusLayout::Find(fComponentName);
+		if (!layout) {
+			G4cerr << "Error: No layout found for component " << fComponentName
+				   << ". TrackLibraryMode Replay requires a VoxelizedNuclearDNA component." << G4endl;
+			exit(0);
+		}
+		{
+			G4AutoLock lock(&replayWorldMutex);
+			fReplayWorld = new G4PVPlacement(NULL, G4ThreeVector(), layout->GetComponentVolume(),
+											 fComponentName + "_TrackLibraryReplay", NULL, false, 0);
+			G4PhysicalVolumeStore::DeRegister(fReplayWorld); // owned by this scorer
+		}
+		fReplayNavigator = new G4Navigator();
+		fReplayNavigator->SetWorldVolume(fReplayWorld);
+		fReplayTouchable = new G4TouchableHistory();
+		if (fNumNuclei > 1)
+			fNucleusLayout = layout;
+	}
+
+	G4double u = G4UniformRand()*fReplayCumulativeWeights.back();
+	size_t libraryIndex = std::upper_bound(fReplayCumulativeWeights.begin(), fReplayCumulativeWeights.end(), u)
+						  - fReplayCumulativeWeights.begin();
+	const TrackLibrary* library = fReplayLibraries[std::min(libraryIndex, fReplayLibraries.size()-1)];
+	G4int track = std::min((G4int)(G4UniformRand()*library->GetNumberOfTracks()), library->GetNumberOfTracks()-1);
+	fReplayPrimaryEnergy = library->GetPrimaryEnergy(track)*MeV;
+
+	G4double angle = CLHEP::twopi*G4UniformRand();
+	G4ThreeVector direction = G4RandomDirection();
+
+	G4ThreeVector vertex;
+	if (fNumNuclei > 1)
+		vertex = fNucleusLayout->GetCentre(std::min((G4int)(G4UniformRand()*fNumNuclei), fNumNuclei-1));
+	G4double halfLength = fNumVoxelsPerSide*fVoxelSideLength + fTrackLibraryTranslationMargin;
+	vertex += G4ThreeVector((2*G4UniformRand()-1)*halfLength, (2*G4UniformRand()-1)*halfLength,
+							(2*G4UniformRand()-1)*halfLength);
+
+	for (std::int64_t i = library->GetFirstDeposit(track); i < library->GetFirstDeposit(track+1); i++) {
+		const TrackLibrary::Deposit& deposit = library->GetDeposit(i);
+		G4ThreeVector position(deposit.x*nm, deposit.y*nm, deposit.z*nm);
+		position.rotateZ(angle);
+		position.rotateUz(direction);
+		ScoreLibraryDeposit(vertex + position, deposit.edep*eV);
+	}
+	fNucleusID = 0;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Score an energy deposit of a replayed track, at a point in the component frame. As for transported
+// particles, the deposit counts towards the dose if it is in the component (in a nucleus, if there
+// are several), and towards direct damage if it is in a residue volume or in a residue of a proxy
+// fiber.
+//--------------------------------------------------------------------------------------------------
+void ScoreClusteredDNADamage::ScoreLibraryDeposit(const G4ThreeVector& position, G4double edep)
+{
+	if (fReplayWorld->GetLogicalVolume()->GetSolid()->Inside(position) == kOutside) {
+		return;
+	}
+	fReplayNavigator->LocateGlobalPointAndUpdateTouchable(position, fReplayTouchable, true);
+
+	if (fNumNuclei > 1) {
+		fNucleusID = fNucleusLayout->Locate(fReplayTouchable);
+		if (fNucleusID < 0) {
+			return;
+		}
+		fNucleusEdep[fNucleusID] += edep;
+	}
+	fTotalEdep += edep;
+	if (!fIncludeDirectDamage) {
+		return;
+	}
+
+	G4VPhysicalVolume* volume = fReplayTouchable->GetVolume();
+	G4Material* material = volume->GetLogicalVolume()->GetMaterial();
+	G4int volID = -1;
+	if (material == fDNAMaterial) {
+		if (fBuildNucleus)
+			SetVoxelAndFiberID<true, true>(fReplayTouchable, 0);
+		else if (fNumFibers > 1)
+			SetVoxelAndFiberID<false, true>(fReplayTouchable, 0);
+		volID = volume->GetCopyNo();
+	}
+	else if (fUseFiberProxy && material == fFiberProxyMaterial) {
+		if (fBuildNucleus)
+			SetVoxelAndFiberID<true, true>(fReplayTouchable, -1);
+		else if (fNumFibers > 1)
+			SetVoxelAndFiberID<false, true>(fReplayTouchable, -1);
+		volID = LocateDepositInFiberProxy(fReplayTouchable, position);
+	}
+	if (volID < 0) {
+		return;
+	}
+
+	G4int strandID = volID / 1000000;
+	G4int residueID = (volID - (strandID*1000000)) / 100000;
+	G4int bpID = volID - (strandID*1000000) - (residueID*100000);
+	AddDirectEnergyDeposit(strandID, residueID, bpID, edep, NULL);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Run the chemical stage of the current event by independent reaction times (see IRTChemistry).
+// The molecules collected at their creation are located in the geometry: a molecule created in the
+// water of a fiber has the residues & histones of that fiber as targets. An encounter with a residue
+// follows the rules applied to a molecule entering a residue volume in ProcessHitsForConfiguration(),
+// and an encounter with a histone kills the molecule (only species scavenged by histones have them
+// as targets).
+//--------------------------------------------------------------------------------------------------
+void ScoreClusteredDNADamage::RunIRTChemistry()
+{
+	const std::vector<ChemicalTrackClassifier::CollectedMolecule>& molecules = fTrackClassifier->GetCollectedMolecules();
+	if (molecules.empty()) {
+		return;
+	}
+
+	// Navigator separate from the one used for tracking, created once the world exists
+	if (!fIRTNavigator) {
+		fIRTNavigator = new G4Navigator();
+		fIRTNavigator->SetWorldVolume(G4TransportationManager::GetTransportationManager()
+										  ->GetNavigatorForTracking()->GetWorldVolume());
+		fIRTTouchable = new G4TouchableHistory();
+		fIRTChemistry->SetFiberTemplate(GetFiberTemplate());
+		fIRTChemistry->SetEndTime(G4Scheduler::Instance()->GetEndTime());
+		if (fNumNuclei > 1) {
+			fNucleusLayout = NucleusLayout::Find(fComponentName);
+			if (!fNucleusLayout) {
+				G4cerr << "Error: No nucleus layout found for component " << fComponentName
+					   << ". Sc/" << GetName() << "/BuildNucleus must match the geometry component." << G4endl;
+				exit(0);
+			}
+		}
+	}
+	G4LogicalVolume* fiberVolume = GetFiberTemplate()->GetFiberVolume();
+
+	fIRTChemistry->Clear();
+	for (size_t i = 0; i < molecules.size(); i++) {
+		const ChemicalTrackClassifier::CollectedMolecule& molecule = molecules[i];
+		fIRTNavigator->LocateGlobalPointAndUpdateTouchable(molecule.position, fIRTTouchable, false);
+
+		G4VPhysicalVolume* volume = fIRTTouchable->GetVolume();
+		G4bool isInFiber = volume && volume->GetLogicalVolume() == fiberVolume;
+		if (isInFiber && fNumNuclei > 1) {
+			fNucleusID = fNucleusLayout->Locate(fIRTTouchable);
+			isInFiber = (fNucleusID >= 0);
+		}
+		if (!isInFiber) {
+			fIRTChemistry->AddSpecies(molecule.configuration, molecule.position, molecule.time, NULL, 0, 0);
+			continue;
+		}
+
+		// A proxy fiber has no DNA & histone volumes, so molecules created inside a residue or a
+		// histone are not killed at birth by fTrackClassifier
+		const G4AffineTransform& globalToFiber = fIRTTouchable->GetHistory()->GetTopTransform();
+		if (fUseFiberProxy) {
+			G4ThreeVector localPoint = globalToFiber.TransformPoint(molecule.position);
+			if (GetFiberTemplate()->LocateResidue(localPoint) >= 0 || GetFiberTemplate()->LocateHistone(localPoint) >= 0)
+				continue;
+		}
+
+		// The fiber is the volume of the touchable, so its parents are one level higher than for a
+		// residue volume
+		if (fBuildNucleus)
+			SetVoxelAndFiberID<true, true>(fIRTTouchable, -1);
+		else if (fNumFibers > 1)
+			SetVoxelAndFiberID<false, true>(fIRTTouchable, -1);
+		fIRTChemistry->AddSpecies(molecule.configuration, molecule.position, molecule.time, &globalToFiber,
+								  fVoxelID, fFiberID);
+	}
+	fTrackClassifier->ClearCollectedMolecules();
+	fNucleusID = 0;
+
+	fIRTChemistry->Start();
+	IRTChemistry::Encounter encounter;
+	while (fIRTChemistry->NextEncounter(encounter)) {
+		if (encounter.target < 0) {
+			TallyChemistryOutcome(encounter.moleculeID, ChemistryYieldTally::kOutcomeScavenged, encounter.time);
+			continue;
+		}
+		if (encounter.isHistone) {
+			fIRTChemistry->RemoveSpecies(encounter.species);
+			TallyChemistryOutcome(encounter.moleculeID, ChemistryYieldTally::kOutcomeKilledByHistone, encounter.time);
+			continue;
+		}
+
+		// Only species in fIRTResidueReactivity target the residues
+		const IRTResidueReactivity& reactivity = fIRTResidueReactivity[encounter.moleculeID];
+		fVoxelID = encounter.voxelID;
+		fFiberID = encounter.fiberID;
+		G4int reaction = ReactWithResidue(encounter.target, encounter.moleculeID, encounter.time,
+										  reactivity.probDamageBase, reactivity.probDamageBackbone,
+										  reactivity.isKilledByResidues);
+		if (reaction != fResidueReactionNone) {
+			fIRTChemistry->RemoveSpecies(encounter.species);
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Use the DNA strand ID, residue ID, and nucleotide ID to increment the energy deposited in the
+// appropriate energy deposition map. Maps are indexed as follows:
+// First index specifies the voxel
+// Second index specifies DNA fibre
+// Third index specifies the bp index
+//
+// If attributing damage, the tag of the track is kept in the entry if this is the largest deposit in
+// the residue so far, & the deposit is added to the energy of the tag.
+//--------------------------------------------------------------------------------------------------
+void ScoreClusteredDNADamage::AddDirectEnergyDeposit(G4int strandID, G4int residueID, G4int bpID, G4double edep,
+													 const G4Track* track)
+{
+	G4int channel = GetDamageChannel(strandID, residueID);
+	ResidueEdep& deposit = (*fMapEdepByChannel[channel])[fVoxelID][fFiberID][bpID];
+	deposit.edep += edep;
+
+	if (fTrackTagger) {
+		TrackTagger::Tag tag = fTrackTagger->GetTag(track);
+		fAttributionTallies[tag].edep += edep;
+
+		if (edep > deposit.maxStepEdep) {
+			deposit.maxStepEdep = edep;
+			deposit.tag = tag;
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Return the energy deposited in a residue of the fiber being recorded (see RecordFiberDamage()), or
+// NULL if no energy was deposited in it.
+//--------------------------------------------------------------------------------------------------
+const ScoreClusteredDNADamage::ResidueEdep* ScoreClusteredDNADamage::FindResidueEdep(G4int channel, G4int bpID) const
+{
+	std::map<G4int, ResidueEdep>::const_iterator deposit = fFiberMapEdepByChannel[channel]->find(bpID);
+	if (deposit == fFiberMapEdepByChannel[channel]->end()) return NULL;
+	return &deposit->second;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Attribute each direct SSB (backbone channels) or BD (base channels) in a strand to the tag of the
+// largest deposit in its residue.
+//--------------------------------------------------------------------------------------------------
+void ScoreClusteredDNADamage::AttributeSimpleDamage(G4int channel, const std::vector<G4int>& indices)
+{
+	G4bool isBase = (channel == fChannelStrand1Base || channel == fChannelStrand2Base);
+	for (size_t i = 0; i < indices.size(); i++) {
+		const ResidueEdep* hit = FindResidueEdep(channel, indices[i]);
+		if (!hit) continue;
+		if (isBase)
+			fAttributionTallies[hit->tag].numBD++;
+		else
+			fAttributionTallies[hit->tag].numSSB++;
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Attribute a direct or hybrid DSB to the tag of the largest deposit among its direct sites
+// (site1 in strand 1, site2 in strand 2).
+//--------------------------------------------------------------------------------------------------
+void ScoreClusteredDNADamage::AttributeDSB(G4int site1, G4bool isSite1Direct, G4int site2, G4bool isSite2Direct,
+										   G4bool isHybrid)
+{
+	const ResidueEdep* hit1 = isSite1Direct ? FindResidueEdep(fChannelStrand1Backbone, site1) : NULL;
+	const ResidueEdep* hit2 = isSite2Direct ? FindResidueEdep(fChannelStrand2Backbone, site2) : NULL;
+	const ResidueEdep* dominant = (hit1 && (!hit2 || hit1->maxStepEdep >= hit2->maxStepEdep)) ? hit1 : hit2;
+	if (!dominant) return;
+
+	if (isHybrid)
+		fAttributionTallies[dominant->tag].numDSB_hybrid++;
+	else
+		fAttributionTallies[dominant->tag].numDSB++;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Return the damage channel (strand 1 or 2, backbone or base) of a residue, using fChannelLookup.
+//--------------------------------------------------------------------------------------------------
+G4int ScoreClusteredDNADamage::GetDamageChannel(G4int strandID, G4int residueID)
+{
+	if (strandID < 0 || strandID > 1 || residueID < 0 || residueID > 2) {
+		G4cerr << "Error: The following strandID / residueID is unrecognized: " << strandID << " / " << residueID << G4endl;
+		exit(0);
+	}
+	return fChannelLookup[strandID][residueID];
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Set fPrimaryEnergy & fEnergyGroup from the first primary particle of the current event. Events
+// outside all groups (or if there are no groups) have fEnergyGroup = -1.
+//--------------------------------------------------------------------------------------------------
+void ScoreClusteredDNADamage::SetPrimaryEnergyGroup() {
+	fPrimaryEnergy = 0.;
+	fEnergyGroup = -1;
+
+	const G4Event* event = G4EventManager::GetEventManager()->GetConstCurrentEvent();
+	if (fTrackLibraryMode == fTrackLibraryReplay)
+		fPrimaryEnergy = fReplayPrimaryEnergy; // of the library track scored in this event
+	else if (event && event->GetNumberOfPrimaryVertex() > 0 && event->GetPrimaryVertex(0)->GetPrimary(0))
+		fPrimaryEnergy = event->GetPrimaryVertex(0)->GetPrimary(0)->GetKineticEnergy();
+
+	if (fEnergyGroupEdges.empty())
+		return;
+
+	// Groups include their lower edge; the last group also includes its upper edge
+	if (fPrimaryEnergy >= fEnergyGroupEdges.front() && fPrimaryEnergy <= fEnergyGroupEdges.back()) {
+		fEnergyGroup = std::upper_bound(fEnergyGroupEdges.begin(), fEnergyGroupEdges.end(), fPrimaryEnergy)
+					   - fEnergyGroupEdges.begin() - 1;
+		fEnergyGroup = std::min(fEnergyGroup, (G4int)fEnergyGroupTallies.size()-1);
+	}
+	else {
+		fNumEventsOutsideEnergyGroups++;
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Add the current damage yields (one ntuple row) to the tally of this event & to the tally of its
+// energy group.
+//--------------------------------------------------------------------------------------------------
+void ScoreClusteredDNADamage::AddYieldsToTallies() {
+	if (fStatusPublisher) {
+		const G4int counts[StatusStreamPublisher::kNumQuantities] = {fTotalSSB, fTotalDSB, fTotalBD, fTotalComplexDSB,
+																	 fTotalNonDSBCluster};
+		fStatusPublisher->AddDamage(counts);
+	}
+
+	if (fRecordEventTallies) {
+		fCurrentEventTally.numSSB += fTotalSSB;
+		fCurrentEventTally.numSSB_direct += fTotalSSB_direct;
+		fCurrentEventTally.numSSB_indirect += fTotalSSB_indirect;
+		fCurrentEventTally.numBD += fTotalBD;
+		fCurrentEventTally.numBD_direct += fTotalBD_direct;
+		fCurrentEventTally.numBD_indirect += fTotalBD_indirect;
+		fCurrentEventTally.numDSB += fTotalDSB;
+		fCurrentEventTally.numDSB_direct += fTotalDSB_direct;
+		fCurrentEventTally.numDSB_indirect += fTotalDSB_indirect;
+		fCurrentEventTally.numDSB_hybrid += fTotalDSB_hybrid;
+		fCurrentEventTally.numComplexDSB += fTotalComplexDSB;
+		fCurrentEventTally.numNonDSBCluster += fTotalNonDSBCluster;
+	}
+
+	if (fEnergyGroup < 0 || fEnergyGroup >= (G4int)fEnergyGroupTallies.size())
+		return;
+
+	EnergyGroupTally& tally = fEnergyGroupTallies[fEnergyGroup];
+	tally.numSSB += fTotalSSB;
+	tally.numSSB_direct += fTotalSSB_direct;
+	tally.numSSB_indirect += fTotalSSB_indirect;
+	tally.numBD += fTotalBD;
+	tally.numBD_direct += fTotalBD_direct;
+	tally.numBD_indirect += fTotalBD_indirect;
+	tally.numDSB += fTotalDSB;
+	tally.numDSB_direct += fTotalDSB_direct;
+	tally.numDSB_indirect += fTotalDSB_indirect;
+	tally.numDSB_hybrid += fTotalDSB_hybrid;
+	tally.numComplexDSB += fTotalComplexDSB;
+	tally.numNonDSBCluster += fTotalNonDSBCluster;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Add the tally of another thread to this one.
+//--------------------------------------------------------------------------------------------------
+void ScoreClusteredDNADamage::EnergyGroupTally::Add(const EnergyGroupTally& other) {
+	numEvents += other.numEvents;
+	edep += other.edep;
+	numSSB += other.numSSB;
+	numSSB_direct += other.numSSB_direct;
+	numSSB_indirect += other.numSSB_indirect;
+	numBD += other.numBD;
+	numBD_direct += other.numBD_direct;
+	numBD_indirect += other.numBD_indirect;
+	numDSB += other.numDSB;
+	numDSB_direct += other.numDSB_direct;
+	numDSB_indirect += other.numDSB_indirect;
+	numDSB_hybrid += other.numDSB_hybrid;
+	numComplexDSB += other.numComplexDSB;
+	numNonDSBCluster += other.numNonDSBCluster;
+
+	std::map<G4int, G4long>::const_iterator it;
+	for (it = other.complexDSBSizeCounts.begin(); it != other.complexDSBSizeCounts.end(); ++it)
+		complexDSBSizeCounts[it->first] += it->second;
+	for (it = other.nonDSBClusterSizeCounts.begin(); it != other.nonDSBClusterSizeCounts.end(); ++it)
+		nonDSBClusterSizeCounts[it->first] += it->second;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// This method outputs the tallies of all events (one row per event) to a data file. Rows are sorted
+// by event ID then thread.
+//--------------------------------------------------------------------------------------------------
+void ScoreClusteredDNADamage::OutputEventTalliesToFile() {
+	//----------------------------------------------------------------------------------------------
+	// Header file
+	//----------------------------------------------------------------------------------------------
+	if (fOutputHeaders) {
+		std::ofstream outHeader;
+		G4String headerFileName = fFileEventTallies + fOutHeaderExtension;
+
+		outHeader.open(headerFileName, std::ofstream::trunc);
+
+		// Catch file I/O error
+		if (!outHeader.good()) {
+			G4cerr << "Topas is exiting due to a serious error in file output." << G4endl;
+			G4cerr << "Output file: " << headerFileName << " cannot be opened" << G4endl;
+			fPm->AbortSession(1);
+		}
+
+		outHeader << "Thread ID" << fDelimiter << "Event ID" << fDelimiter;
+		outHeader << "Primary energy (MeV)" << fDelimiter << "Energy (eV)" << fDelimiter;
+		outHeader << "SSBs" << fDelimiter << "SSBs direct" << fDelimiter << "SSBs indirect" << fDelimiter;
+		outHeader << "DSBs" << fDelimiter << "DSBs direct" << fDelimiter << "DSBs indirect" << fDelimiter << "DSBs hybrid" << fDelimiter;
+		outHeader << "BDs" << fDelimiter << "BDs direct" << fDelimiter << "BDs indirect" << fDelimiter;
+		outHeader << "Complex DSBs" << fDelimiter << "Non-DSB clusters" << G4endl;
+		outHeader.close();
+	}
+
+	//----------------------------------------------------------------------------------------------
+	// Data file
+	//----------------------------------------------------------------------------------------------
+	G4String outputFileName = fFileEventTallies + fOutFileExtension;
+	std::ofstream outFile(outputFileName, std::ios_base::app);
+
+	// Catch file I/O error
+	if (!outFile.good()) {
+		G4cerr << "Topas is exiting due to a serious error in file output." << G4endl;
+		G4cerr << "Output file: " << outputFileName << " cannot be opened" << G4endl;
+		fPm->AbortSession(1);
+	}
+
+	std::sort(fEventTallies.begin(), fEventTallies.end());
+	outFile.precision(9);
+	for (size_t i = 0; i < fEventTallies.size(); i++) {
+		const EventTally& tally = fEventTallies[i];
+		outFile << tally.threadID << fDelimiter << tally.eventID << fDelimiter;
+		outFile << tally.primaryEnergy/MeV << fDelimiter << tally.edep/eV << fDelimiter;
+		outFile << tally.numSSB << fDelimiter << tally.numSSB_direct << fDelimiter << tally.numSSB_indirect << fDelimiter;
+		outFile << tally.numDSB << fDelimiter << tally.numDSB_direct << fDelimiter << tally.numDSB_indirect << fDelimiter << tally.numDSB_hybrid << fDelimiter;
+		outFile << tally.numBD << fDelimiter << tally.numBD_direct << fDelimiter << tally.numBD_indirect << fDelimiter;
+		outFile << tally.numComplexDSB << fDelimiter << tally.numNonDSBCluster << G4endl;
+	}
+	outFile.close();
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// This method outputs the yields & dose of each energy group to a data file (one row per group),
+// and the cluster size histograms of each group to a second data file (one row per group, cluster
+// type & size).
+//--------------------------------------------------------------------------------------------------
+void ScoreClusteredDNADamage::OutputEnergyGroupsToFile() {
+	G4String groupsFileName = fFileEnergyGroups + fOutFileExtension;
+	G4String sizesFileName = fFileEnergyGroups + "_cluster_sizes" + fOutFileExtension;
+
+	//----------------------------------------------------------------------------------------------
+	// Header files
+	//----------------------------------------------------------------------------------------------
+	if (fOutputHeaders) {
+		std::ofstream outHeader(fFileEnergyGroups + fOutHeaderExtension, std::ofstream::trunc);
+		std::ofstream outSizesHeader(fFileEnergyGroups + "_cluster_sizes" + fOutHeaderExtension, std::ofstream::trunc);
+
+		// Catch file I/O error
+		if (!outHeader.good() || !outSizesHeader.good()) {
+			G4cerr << "Topas is exiting due to a serious error in file output." << G4endl;
+			G4cerr << "Output file: " << fFileEnergyGroups << fOutHeaderExtension << " cannot be opened" << G4endl;
+			fPm->AbortSession(1);
+		}
+
+		outHeader << "Energy group" << fDelimiter << "Lower energy (MeV)" << fDelimiter << "Upper energy (MeV)" << fDelimiter;
+		outHeader << "# events" << fDelimiter << "Dose (Gray)" << fDelimiter << "Energy (eV)" << fDelimiter;
+		outHeader << "SSBs" << fDelimiter << "SSBs direct" << fDelimiter << "SSBs indirect" << fDelimiter;
+		outHeader << "DSBs" << fDelimiter << "DSBs direct" << fDelimiter << "DSBs indirect" << fDelimiter << "DSBs hybrid" << fDelimiter;
+		outHeader << "BDs" << fDelimiter << "BDs direct" << fDelimiter << "BDs indirect" << fDelimiter;
+		outHeader << "Complex DSBs" << fDelimiter << "Non-DSB clusters" << G4endl;
+		outHeader << "# Events whose primary energy is outside all groups: " << fNumEventsOutsideEnergyGroups << G4endl;
+
+		outSizesHeader << "Energy group" << fDelimiter << "Cluster type (0 = complex DSB, 1 = non-DSB cluster)" << fDelimiter;
+		outSizesHeader << "Cluster size (bp)" << fDelimiter << "# clusters" << G4endl;
+	}
+
+	//----------------------------------------------------------------------------------------------
+	// Data files
+	//----------------------------------------------------------------------------------------------
+	std::ofstream outFile(groupsFileName, std::ios_base::app);
+	std::ofstream outSizesFile(sizesFileName, std::ios_base::app);
+
+	// Catch file I/O error
+	if (!outFile.good() || !outSizesFile.good()) {
+		G4cerr << "Topas is exiting due to a serious error in file output." << G4endl;
+		G4cerr << "Output file: " << groupsFileName << " cannot be opened" << G4endl;
+		fPm->AbortSession(1);
+	}
+
+	for (size_t g = 0; g < fEnergyGroupTallies.size(); g++) {
+		const EnergyGroupTally& tally = fEnergyGroupTallies[g];
+		G4double doseDep = tally.edep / GetMaterial("G4_WATER")->GetDensity() / fComponentVolume;
+
+		outFile << g << fDelimiter << fEnergyGroupEdges[g]/MeV << fDelimiter << fEnergyGroupEdges[g+1]/MeV << fDelimiter;
+		outFile << tally.numEvents << fDelimiter << doseDep/gray << fDelimiter << tally.edep/eV << fDelimiter;
+		outFile << tally.numSSB << fDelimiter << tally.numSSB_direct << fDelimiter << tally.numSSB_indirect << fDelimiter;
+		outFile << tally.numDSB << fDelimiter << tally.numDSB_direct << fDelimiter << tally.numDSB_indirect << fDelimiter << tally.numDSB_hybrid << fDelimiter;
+		outFile << tally.numBD << fDelimiter << tally.numBD_direct << fDelimiter << tally.numBD_indirect << fDelimiter;
+		outFile << tally.numComplexDSB << fDelimiter << tally.numNonDSBCluster << G4endl;
+
+		std::map<G4int, G4long>::const_iterator it;
+		for (it = tally.complexDSBSizeCounts.begin(); it != tally.complexDSBSizeCounts.end(); ++it)
+			outSizesFile << g << fDelimiter << 0 << fDelimiter << it->first << fDelimiter << it->second << G4endl;
+		for (it = tally.nonDSBClusterSizeCounts.begin(); it != tally.nonDSBClusterSizeCounts.end(); ++it)
+			outSizesFile << g << fDelimiter << 1 << fDelimiter << it->first << fDelimiter << it->second << G4endl;
+	}
+
+	outFile.close();
+	outSizesFile.close();
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// This method outputs the energy deposited in residues & the direct damage yields attributed to
+// each track tag (one row per tag that deposited energy). A damage is attributed to the tag of the
+// largest single deposit in its residue(s). Rows can be summed by particle, creator or generation.
+//--------------------------------------------------------------------------------------------------
+void ScoreClusteredDNADamage::OutputDamageAttributionToFile() {
+	//----------------------------------------------------------------------------------------------
+	// Header file
+	//----------------------------------------------------------------------------------------------
+	if (fOutputHeaders) {
+		std::ofstream outHeader;
+		G4String headerFileName = fFileDamageAttribution + fOutHeaderExtension;
+
+		outHeader.open(headerFileName, std::ofstream::trunc);
+
+		// Catch file I/O error
+		if (!outHeader.good()) {
+			G4cerr << "Topas is exiting due to a serious error in file output." << G4endl;
+			G4cerr << "Output file: " << headerFileName << " cannot be opened" << G4endl;
+			fPm->AbortSession(1);
+		}
+
+		outHeader << "Tag" << fDelimiter << "Particle" << fDelimiter << "Creator process" << fDelimiter;
+		outHeader << "Generation (0 = primary, 7 = 7 or more)" << fDelimiter << "Energy (eV)" << fDelimiter;
+		outHeader << "SSBs direct" << fDelimiter << "BDs direct" << fDelimiter << "DSBs direct" << fDelimiter;
+		outHeader << "DSBs hybrid" << G4endl;
+		outHeader.close();
+	}
+
+	//----------------------------------------------------------------------------------------------
+	// Data file
+	//----------------------------------------------------------------------------------------------
+	G4String outputFileName = fFileDamageAttribution + fOutFileExtension;
+	std::ofstream outFile(outputFileName, std::ios_base::app);
+
+	// Catch file I/O error
+	if (!outFile.good()) {
+		G4cerr << "Topas is exiting due to a serious error in file output." << G4endl;
+		G4cerr << "Output file: " << outputFileName << " cannot be opened" << G4endl;
+		fPm->AbortSession(1);
+	}
+
+	for (size_t i = 0; i < fAttributionTallies.size(); i++) {
+		const AttributionTally& tally = fAttributionTallies[i];
+		if (tally.edep <= 0. && tally.numSSB + tally.numBD + tally.numDSB + tally.numDSB_hybrid == 0)
+			continue;
+
+		TrackTagger::Tag tag = (TrackTagger::Tag)i;
+		outFile << i << fDelimiter << TrackTagger::GetParticleClassName(TrackTagger::GetParticleClass(tag)) << fDelimiter;
+		outFile << TrackTagger::GetCreatorClassName(TrackTagger::GetCreatorClass(tag)) << fDelimiter;
+		outFile << TrackTagger::GetGeneration(tag) << fDelimiter << tally.edep/eV << fDelimiter;
+		outFile << tally.numSSB << fDelimiter << tally.numBD << fDelimiter << tally.numDSB << fDelimiter;
+		outFile << tally.numDSB_hybrid << G4endl;
+	}
+	outFile.close();
+}
+
+
 //--------------------------------------------------------------------------------------------------
 // This helper method checks whether an element is in a vector.
 //--------------------------------------------------------------------------------------------------
@@ -711,33 +2388,97 @@ void ScoreClusteredDNADamage::RemoveElementFromVector(G4int pElement, std::vecto
 
 
 //--------------------------------------------------------------------------------------------------
-// This helper method checks whether an indirect damage has been induced given the moleculeID.
+// Return the record of a chemical track, filling it at the first step of the track seen by this
+// scorer. Records are indexed by -trackID (chemical track IDs are negative) & cleared at the end of
+// each event. The record holds everything used to score the track that does not change during its
+// lifetime, so later steps do not repeat the molecule, vertex & species lookups.
+//--------------------------------------------------------------------------------------------------
+const ScoreClusteredDNADamage::ChemicalTrackRecord& ScoreClusteredDNADamage::GetChemicalTrackRecord(G4Track* track)
+{
+	size_t index = -track->GetTrackID();
+	if (index >= fChemicalTrackRecords.size())
+		fChemicalTrackRecords.resize(std::max(index+1, 2*fChemicalTrackRecords.size()));
+
+	ChemicalTrackRecord& record = fChemicalTrackRecords[index];
+	if (record.flags & fChemFlagFilled)
+		return record;
+
+	G4int moleculeID = GetMolecule(track)->GetMoleculeID();
+	if ( fMoleculeDamageProb_SSB.find(moleculeID) == fMoleculeDamageProb_SSB.end() && fMoleculeDamageProb_BD.find(moleculeID) == fMoleculeDamageProb_BD.end()) {
+		// moleculeID not found in fMoleculeDamageProb_SSB and fMoleculeDamageProb_BD
+		G4cerr << "\tmoleculeID NOT LISTED: " << moleculeID << G4endl;
+		exit(0);
+	}
+
+	record.moleculeID = moleculeID;
+	record.probDamageBackbone = fMoleculeDamageProb_SSB[moleculeID];
+	record.probDamageBase = fMoleculeDamageProb_BD[moleculeID];
+	record.flags = fChemFlagFilled;
+	std::map<G4int, G4double>::const_iterator scavenging = fScavengingRates.find(moleculeID);
+	record.scavengingRate = (scavenging != fScavengingRates.end()) ? scavenging->second*ns : 0.;
+
+	// Molecules created in DNA & histones are killed at birth if fTrackClassifier is used
+	if (!fTrackClassifier) {
+		G4Material* materialTrackVertex = track->GetLogicalVolumeAtVertex()->GetMaterial();
+		if (materialTrackVertex == fDNAMaterial)
+			record.flags |= fChemFlagBornInDNA;
+		else if (materialTrackVertex == fHistoneMaterial)
+			record.flags |= fChemFlagBornInHistone;
+	}
+
+	if (IsElementInVector(moleculeID, fSpeciesToKillByDNAVolumes))
+		record.flags |= fChemFlagKilledByDNA;
+	if (IsElementInVector(moleculeID, fspeciesToKillByHistones))
+		record.flags |= fChemFlagKilledByHistone;
+
+	return record;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Survival of a molecule over a step, against the scavengers of the cellular environment. The
+// survival probability is multiplicative over steps, so a molecule created at t0 survives to t with
+// probability exp(-k*(t-t0)). Only the steps seen by the scorer (in the scored component &
+// materials) are tested, which covers the molecules that can reach the DNA.
+//--------------------------------------------------------------------------------------------------
+G4bool ScoreClusteredDNADamage::ScavengeMolecule(G4Step* aStep)
+{
+	const ChemicalTrackRecord& record = GetChemicalTrackRecord(aStep->GetTrack());
+	if (record.scavengingRate <= 0.) {
+		return false;
+	}
+
+	G4double stepTime = aStep->GetPostStepPoint()->GetGlobalTime() - aStep->GetPreStepPoint()->GetGlobalTime();
+	if (G4UniformRand() < std::exp(-record.scavengingRate*stepTime/ns)) {
+		return false;
+	}
+	aStep->GetTrack()->SetTrackStatus(fStopAndKill);
+	TallyChemistryOutcome(record.moleculeID, ChemistryYieldTally::kOutcomeScavenged,
+						  aStep->GetPostStepPoint()->GetGlobalTime());
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Time-resolved yields. Only the steps seen by the scorer are tallied, so populations are those of
+// the scored component (e.g. the nucleus). In IRT chemistry species are not diffused step by step,
+// so only their outcomes are tallied.
 //--------------------------------------------------------------------------------------------------
-G4bool ScoreClusteredDNADamage::IsDamageInflicted(G4int pMoleculeID, G4int pDNAVolumeID) {
-	G4float prob_damage = 0.;
-
-	if ( fMoleculeDamageProb_SSB.find(pMoleculeID) == fMoleculeDamageProb_SSB.end() && fMoleculeDamageProb_BD.find(pMoleculeID) == fMoleculeDamageProb_BD.end()) {
-  	// pMoleculeID not found in fMoleculeDamageProb_SSB and fMoleculeDamageProb_BD
-		G4cerr << "\tmoleculeID NOT LISTED: " << pMoleculeID << G4endl;
-		exit(0);
+void ScoreClusteredDNADamage::TallyChemistryStep(G4Step* aStep)
+{
+	G4int moleculeID = GetChemicalTrackRecord(aStep->GetTrack()).moleculeID;
+	if (moleculeID < (G4int)fChemistryYieldIndices.size() && fChemistryYieldIndices[moleculeID] >= 0) {
+		fChemistryYieldTally->AddStep(fChemistryYieldIndices[moleculeID], aStep->GetPreStepPoint()->GetGlobalTime(),
+									  aStep->GetPostStepPoint()->GetGlobalTime());
 	}
+}
 
-	// Check if SSB or BD
-	if (pDNAVolumeID == fVolIdPhosphate || pDNAVolumeID == fVolIdDeoxyribose)
-		prob_damage = fMoleculeDamageProb_SSB[pMoleculeID];
-	else if (pDNAVolumeID == fVolIdBase)
-		prob_damage = fMoleculeDamageProb_BD[pMoleculeID];
-
-	if (prob_damage == 0.)
-		return false;
-
-	// Generate random float between 0 and 1
-	G4float prob_random = G4UniformRand();
-
-	if (prob_random <= prob_damage)
-		return true;
-	else
-		return false;
+void ScoreClusteredDNADamage::TallyChemistryOutcome(G4int moleculeID, G4int outcome, G4double time)
+{
+	if (fChemistryYieldTally && moleculeID < (G4int)fChemistryYieldIndices.size()
+		&& fChemistryYieldIndices[moleculeID] >= 0) {
+		fChemistryYieldTally->AddOutcome(fChemistryYieldIndices[moleculeID], outcome, time);
+	}
 }
 
 
@@ -778,28 +2519,146 @@ void ScoreClusteredDNADamage::PrintStepInfo(G4Step* aStep) { // for debugging
 // worker thread if so.
 //--------------------------------------------------------------------------------------------------
 void ScoreClusteredDNADamage::UserHookForEndOfEvent() {
+	if (fRestoredFromCache) {
+		return;
+	}
+	EventTimelineTracer::Span hookSpan(fTimelineTracer, "End-of-event hook");
+
 	fEventID = GetEventID();
 	fThreadID = G4Threading::G4GetThreadId();
 
 	fNumEvents++;
 
+	// Track library: close the track of this event (no damage is scored while recording), or score a
+	// library track in place of the transported particles
+	if (fTrackLibraryMode == fTrackLibraryRecord) {
+		CloseLibraryTrack();
+		fChemicalTrackRecords.clear();
+		return;
+	}
+	if (fTrackLibraryMode == fTrackLibraryReplay) {
+		EventTimelineTracer::Span span(fTimelineTracer, "Track library replay");
+		ReplayLibraryTrack();
+	}
+
+	// Chemical stage of this event, if run by independent reaction times
+	if (fChemistryMode == fChemistryIRT) {
+		EventTimelineTracer::Span span(fTimelineTracer, "IRT chemistry");
+		RunIRTChemistry();
+	}
+
+	// Energy (& energy group) of the primary of this event
+	if (!fEnergyGroupEdges.empty() || fRecordEventTallies) {
+		SetPrimaryEnergyGroup();
+	}
+
 	// Analyze damage if doing event-by-event scoring
 	if (fRecordDamagePerEvent) {
-		RecordDamage();
+		if (fRecordEventTallies) {
+			fCurrentEventTally = EventTally();
+			fCurrentEventTally.eventID = fEventID;
+			fCurrentEventTally.threadID = fThreadID;
+			fCurrentEventTally.primaryEnergy = fPrimaryEnergy;
+			fCurrentEventTally.edep = fTotalEdep - fEdepBeforeEvent;
+		}
+
+		{
+			EventTimelineTracer::Span span(fTimelineTracer, "Damage analysis");
+			ScopedWallTimer timer(fRecordRunMetrics ? &fThreadMetrics.analysisTime : NULL);
+			RecordDamage();
+		}
 		if (fScoreClusters) {
+			EventTimelineTracer::Span span(fTimelineTracer, "Output");
+			ScopedWallTimer timer(fRecordRunMetrics ? &fThreadMetrics.outputTime : NULL);
 			OutputComplexDSBToFile();
 			OutputNonDSBClusterToFile();
 		}
+		if (fEnergyGroup >= 0) {
+			// Cluster sizes & dose of this event, before they are reset (yields are tallied in RecordDamage())
+			EnergyGroupTally& tally = fEnergyGroupTallies[fEnergyGroup];
+			tally.numEvents++;
+			tally.edep += fTotalEdep - fEdepBeforeEvent;
+			for (size_t i = 0; i < fComplexDSBSizes.size(); i++)
+				tally.complexDSBSizeCounts[fComplexDSBSizes[i]]++;
+			for (size_t i = 0; i < fNonDSBClusterSizes.size(); i++)
+				tally.nonDSBClusterSizeCounts[fNonDSBClusterSizes[i]]++;
+		}
+		if (fRecordEventTallies) {
+			fEventTallies.push_back(fCurrentEventTally);
+		}
+		fEdepBeforeEvent = fTotalEdep;
 		ResetMemberVariables(); // Necessary to reset variables before proceeding to next event
 	}
 
-	// Check if dose threshold has been met
-	if (fUseDoseThreshold && fTotalEdep > fEnergyThreshold) {
-		G4cout << "Aborting worker #" << G4Threading::G4GetThreadId() << " because dose threshold has been met" << G4endl;
-		G4RunManager::GetRunManager()->AbortRun(true);
+	// Analyze damage once the batch is complete if doing batch-by-batch scoring
+	else if (fRecordDamagePerBatch > 0) {
+		fNumEventsInBatch++;
+		if (fNumEventsInBatch == fRecordDamagePerBatch) {
+			fEventID = fBatchID; // batch ID, unique within this thread
+			fBatchDose = (fTotalEdep - fEdepBeforeBatch) / GetMaterial("G4_WATER")->GetDensity() / fComponentVolume;
+			{
+				EventTimelineTracer::Span span(fTimelineTracer, "Damage analysis");
+				ScopedWallTimer timer(fRecordRunMetrics ? &fThreadMetrics.analysisTime : NULL);
+				RecordDamage();
+			}
+			if (fScoreClusters) {
+				EventTimelineTracer::Span span(fTimelineTracer, "Output");
+				ScopedWallTimer timer(fRecordRunMetrics ? &fThreadMetrics.outputTime : NULL);
+				OutputComplexDSBToFile();
+				OutputNonDSBClusterToFile();
+			}
+			ResetMemberVariables();
+			fNumEventsInBatch = 0;
+			fEdepBeforeBatch = fTotalEdep;
+			fBatchID++;
+		}
+	}
+
+	// Provisional yields from a sample of the fibers hit so far by this thread
+	if (fYieldEstimateInterval > 0 && fThreadID <= 0 && fNumEvents % fYieldEstimateInterval == 0) {
+		EventTimelineTracer::Span span(fTimelineTracer, "Yield estimate");
+		EstimateYieldsFromSample();
+	}
+
+	// Chemical & physical track IDs are reused in the next event
+	fChemicalTrackRecords.clear();
+	if (fTrackTagger)
+		fTrackTagger->Clear();
+
+	if (fRecordRunMetrics)
+		fThreadMetrics.lastEventTime = GetWallTime();
+
+	// Live status of the run (atomic counters only, so the thread never waits)
+	if (fStatusPublisher) {
+		fStatusPublisher->AddEvent(fTotalEdep - fEdepPublished);
+		fEdepPublished = fTotalEdep;
+	}
+
+	// Check if dose threshold has been met by all threads together. Every thread stops at the end of
+	// its current event; the thread whose event crosses the threshold reports it.
+	if (fUseDoseThreshold) {
+		G4double eventEdep = fTotalEdep - fEdepAddedToRun;
+		fEdepAddedToRun = fTotalEdep;
+		G4double runEdep = AddToRunEdep(eventEdep);
+		if (runEdep > fEnergyThreshold) {
+			if (runEdep - eventEdep <= fEnergyThreshold)
+				G4cout << "Dose threshold has been met by worker #" << G4Threading::G4GetThreadId() << ". Aborting run." << G4endl;
+			G4RunManager::GetRunManager()->AbortRun(true);
+		}
 	}
 }
 
+//--------------------------------------------------------------------------------------------------
+// Add energy to the total deposited in the current run by all threads & return the new total. The
+// lock is taken once per event.
+//--------------------------------------------------------------------------------------------------
+G4double ScoreClusteredDNADamage::AddToRunEdep(G4double edep) {
+	G4AutoLock lock(&runEdepMutex);
+	G4double& runEdep = runEdepByScorer[GetName()];
+	runEdep += edep;
+	return runEdep;
+}
+
 //--------------------------------------------------------------------------------------------------
 // This method is called at the end of the run (all primary particles). Only called by the master
 // thread, not the worker threads.
@@ -808,26 +2667,113 @@ void ScoreClusteredDNADamage::UserHookForEndOfEvent() {
 // threads) to determine DNA yields and output the results.
 //--------------------------------------------------------------------------------------------------
 void ScoreClusteredDNADamage::UserHookForEndOfRun() {
+	if (fRestoredFromCache) {
+		return;
+	}
 	// fEventID = GetEventID();
 	fThreadID = G4Threading::G4GetThreadId();
+	if (fEndOfRunStartTime < 0.) fEndOfRunStartTime = GetWallTime(); // no worker was absorbed
+
+	// Track library recorded by all threads
+	if (fTrackLibraryMode == fTrackLibraryRecord) {
+		if (!fRecordedTrackLibrary->Write(fTrackLibraryFile)) {
+			G4cerr << "Topas is exiting due to a serious error in file output." << G4endl;
+			G4cerr << "Output file: " << fTrackLibraryFile << " cannot be opened" << G4endl;
+			fPm->AbortSession(1);
+		}
+		G4cout << "Track library (" << fRecordedTrackLibrary->GetNumberOfTracks() << " tracks) has been written to: "
+			   << fTrackLibraryFile << G4endl;
+	}
+
+	{
+		EventTimelineTracer::Span span(fTimelineTracer, "Output");
+		ScopedWallTimer timer(&fEndOfRunOutputTime);
+		OutputRunSummaryToFile();
+		G4cout << "Run summary has been written to: " << fFileRunSummary << G4endl;
+
+		if (fRecordEventTallies) {
+			OutputEventTalliesToFile();
+			G4cout << "Event tallies have been written to: " << fFileEventTallies << G4endl;
+		}
 
-	OutputRunSummaryToFile();
-	G4cout << "Run summary has been written to: " << fFileRunSummary << G4endl;
+		if (!fEnergyGroupEdges.empty()) {
+			OutputEnergyGroupsToFile();
+			G4cout << "Energy group yields have been written to: " << fFileEnergyGroups << G4endl;
+		}
+	}
 
-	// Analyze damage if scoring over the whole run
-	if (!fRecordDamagePerEvent) {
+	// Analyze damage if scoring over the whole run, or the events left over from the last batch of
+	// each thread if scoring batch-by-batch
+	if (!fRecordDamagePerEvent && (fRecordDamagePerBatch == 0 || fNumEventsInBatch > 0)
+		&& fTrackLibraryMode != fTrackLibraryRecord) {
 		fEventID = fAggregateValueIndicator;
-		RecordDamage();
+		if (fRecordDamagePerBatch > 0) {
+			fBatchDose = (fTotalEdep - fEdepBeforeBatch) / GetMaterial("G4_WATER")->GetDensity() / fComponentVolume;
+			fEdepBeforeBatch = fTotalEdep;
+		}
+		{
+			EventTimelineTracer::Span span(fTimelineTracer, "Damage analysis");
+			ScopedWallTimer timer(&fEndOfRunAnalysisTime);
+			RecordDamage();
+		}
 		if (fScoreClusters) {
+			EventTimelineTracer::Span span(fTimelineTracer, "Output");
+			ScopedWallTimer timer(&fEndOfRunOutputTime);
 			OutputComplexDSBToFile();
 			OutputNonDSBClusterToFile();
 		}
 	}
 
+	// Damage is attributed in RecordDamage(), so after damage is analyzed over the whole run
+	if (fRecordDamageAttribution) {
+		EventTimelineTracer::Span span(fTimelineTracer, "Output");
+		ScopedWallTimer timer(&fEndOfRunOutputTime);
+		OutputDamageAttributionToFile();
+		G4cout << "Damage attribution has been written to: " << fFileDamageAttribution << G4endl;
+	}
+
 	if (fScoreClusters) {
 		G4cout << "Complex DSB details have been written to: " << fFileComplexDSB << G4endl;
 		G4cout << "Non-DSB cluster details have been written to: " << fFileNonDSBCluster << G4endl;
 	}
+
+	if (fRecordRunMetrics) {
+		OutputRunMetricsToFile();
+		G4cout << "Run metrics have been written to: " << fFileRunMetrics << G4endl;
+	}
+
+	if (fChemistryYieldTally) {
+		OutputChemistryYieldsToFile();
+		fChemistryYieldTally->Clear();
+		G4cout << "Chemistry yields have been written to: " << fFileChemistryYields << G4endl;
+	}
+
+	if (fTimelineTracer) {
+		G4String timelineFileName = fFileEventTimeline + ".json";
+		if (!fTimelineTracer->WriteChromeTrace(timelineFileName)) {
+			G4cerr << "Topas is exiting due to a serious error in file output." << G4endl;
+			G4cerr << "Output file: " << timelineFileName << " cannot be opened" << G4endl;
+			fPm->AbortSession(1);
+		}
+		G4cout << "Event timeline has been written to: " << timelineFileName << G4endl;
+	}
+
+	// Final status of the run, with the damage recorded at the end of the run
+	if (fStatusPublisher)
+		fStatusPublisher->EndRun();
+
+	// The next run starts from zero dose
+	if (fUseDoseThreshold) {
+		G4AutoLock lock(&runEdepMutex);
+		runEdepByScorer[GetName()] = 0.;
+	}
+
+	// Outputs are complete once Topas closes its files, so they are stored at exit
+	if (fResultCache) {
+		fResultCache->ScheduleStore();
+		G4cout << "Outputs will be stored in result cache entry: " << fResultCacheDirectory << "/"
+			   << fResultCache->GetKey() << G4endl;
+	}
 }
 
 
@@ -880,6 +2826,189 @@ void ScoreClusteredDNADamage::OutputRunSummaryToFile() {
 }
 
 
+//--------------------------------------------------------------------------------------------------
+// This method outputs the run metrics to a header file and a data file (one row per run). Times are
+// wall-clock seconds:
+//   - init: from the construction of the master scorer until the first thread is ready (worker
+//     initialisation; the time before scorers are constructed is not included)
+//   - event loop: from the first thread ready until the last event of the last thread. The spread
+//     of the end times of the threads shows how evenly the work (e.g. the dose) is split.
+//   - event analysis & output: summed over threads, during the event loop
+//   - absorb, end-of-run analysis & output: serial work of the master at the end of the run
+//--------------------------------------------------------------------------------------------------
+void ScoreClusteredDNADamage::OutputRunMetricsToFile() {
+	//----------------------------------------------------------------------------------------------
+	// Gather the threads (this scorer's own thread if no worker was absorbed)
+	//----------------------------------------------------------------------------------------------
+	std::vector<ThreadMetrics> threads(fWorkerMetrics);
+	if (threads.empty()) {
+		threads.push_back(fThreadMetrics);
+		threads.back().numEvents = fNumEvents;
+	}
+
+	G4double firstReady = threads[0].readyTime;
+	G4double firstDone = -1.;
+	G4double lastDone = -1.;
+	G4long minEvents = threads[0].numEvents;
+	G4long maxEvents = threads[0].numEvents;
+	G4double analysisTime = 0.;
+	G4double outputTime = 0.;
+	for (size_t i = 0; i < threads.size(); i++) {
+		firstReady = std::min(firstReady, threads[i].readyTime);
+		if (threads[i].numEvents > 0) {
+			firstDone = firstDone < 0. ? threads[i].lastEventTime : std::min(firstDone, threads[i].lastEventTime);
+			lastDone = std::max(lastDone, threads[i].lastEventTime);
+		}
+		minEvents = std::min(minEvents, threads[i].numEvents);
+		maxEvents = std::max(maxEvents, threads[i].numEvents);
+		analysisTime += threads[i].analysisTime;
+		outputTime += threads[i].outputTime;
+	}
+	G4double eventLoopTime = lastDone > firstReady ? lastDone - firstReady : 0.;
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage); // peak resident set size, in kB on Linux
+
+	//----------------------------------------------------------------------------------------------
+	// Header file
+	//----------------------------------------------------------------------------------------------
+	if (fOutputHeaders) {
+		std::ofstream outHeader;
+		G4String headerFileName = fFileRunMetrics + fOutHeaderExtension;
+
+		outHeader.open(headerFileName, std::ofstream::trunc);
+
+		// Catch file I/O error
+		if (!outHeader.good()) {
+			G4cerr << "Topas is exiting due to a serious error in file output." << G4endl;
+			G4cerr << "Output file: " << headerFileName << " cannot be opened" << G4endl;
+			fPm->AbortSession(1);
+		}
+
+		outHeader << "# threads" << fDelimiter;
+		outHeader << "# events" << fDelimiter;
+		outHeader << "Dose (Gray)" << fDelimiter;
+		outHeader << "Init (s)" << fDelimiter;
+		outHeader << "Event loop (s)" << fDelimiter;
+		outHeader << "Events per s" << fDelimiter;
+		outHeader << "Spread of thread end times (s)" << fDelimiter;
+		outHeader << "Min events per thread" << fDelimiter;
+		outHeader << "Max events per thread" << fDelimiter;
+		outHeader << "Event analysis, summed over threads (s)" << fDelimiter;
+		outHeader << "Event output, summed over threads (s)" << fDelimiter;
+		outHeader << "Absorb (s)" << fDelimiter;
+		outHeader << "End-of-run analysis (s)" << fDelimiter;
+		outHeader << "End-of-run output (s)" << fDelimiter;
+		outHeader << "End of run (s)" << fDelimiter;
+		outHeader << "Peak RSS (MB)" << G4endl;
+		outHeader.close();
+	}
+
+	//----------------------------------------------------------------------------------------------
+	// Data file
+	//----------------------------------------------------------------------------------------------
+	G4String outputFileName = fFileRunMetrics + fOutFileExtension;
+	std::ofstream outFile(outputFileName, std::ios_base::app);
+
+	// Catch file I/O error
+	if (!outFile.good()) {
+		G4cerr << "Topas is exiting due to a serious error in file output." << G4endl;
+		G4cerr << "Output file: " << outputFileName << " cannot be opened" << G4endl;
+		fPm->AbortSession(1);
+	}
+
+	G4double doseDep = fTotalEdep / GetMaterial("G4_WATER")->GetDensity() / fComponentVolume;
+
+	outFile << threads.size() << fDelimiter;
+	outFile << fNumEvents << fDelimiter;
+	outFile << doseDep/gray << fDelimiter;
+	outFile << firstReady - fThreadMetrics.readyTime << fDelimiter;
+	outFile << eventLoopTime << fDelimiter;
+	outFile << (eventLoopTime > 0. ? fNumEvents/eventLoopTime : 0.) << fDelimiter;
+	outFile << (lastDone > 0. ? lastDone - firstDone : 0.) << fDelimiter;
+	outFile << minEvents << fDelimiter;
+	outFile << maxEvents << fDelimiter;
+	outFile << analysisTime << fDelimiter;
+	outFile << outputTime << fDelimiter;
+	outFile << fAbsorbTime << fDelimiter;
+	outFile << fEndOfRunAnalysisTime << fDelimiter;
+	outFile << fEndOfRunOutputTime << fDelimiter;
+	outFile << GetWallTime() - fEndOfRunStartTime << fDelimiter;
+	outFile << usage.ru_maxrss/1024. << G4endl;
+
+	outFile.close();
+
+	// Start the metrics of the next run afresh
+	fWorkerMetrics.clear();
+	fEndOfRunStartTime = -1.;
+	fAbsorbTime = 0.;
+	fEndOfRunAnalysisTime = 0.;
+	fEndOfRunOutputTime = 0.;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Output the time-resolved yields of the run: one row per time point & tallied species, with the
+// population & the cumulative outcomes of the species as G-values (molecules per 100 eV deposited
+// in the scored component).
+//--------------------------------------------------------------------------------------------------
+void ScoreClusteredDNADamage::OutputChemistryYieldsToFile() {
+	//----------------------------------------------------------------------------------------------
+	// Header file
+	//----------------------------------------------------------------------------------------------
+	if (fOutputHeaders) {
+		std::ofstream outHeader;
+		G4String headerFileName = fFileChemistryYields + fOutHeaderExtension;
+
+		outHeader.open(headerFileName, std::ofstream::trunc);
+
+		// Catch file I/O error
+		if (!outHeader.good()) {
+			G4cerr << "Topas is exiting due to a serious error in file output." << G4endl;
+			G4cerr << "Output file: " << headerFileName << " cannot be opened" << G4endl;
+			fPm->AbortSession(1);
+		}
+
+		outHeader << "Time (ns)" << fDelimiter;
+		outHeader << "Species" << fDelimiter;
+		outHeader << "G present (/100 eV)" << fDelimiter;
+		outHeader << "G damage (/100 eV)" << fDelimiter;
+		outHeader << "G killed by DNA (/100 eV)" << fDelimiter;
+		outHeader << "G killed by histones (/100 eV)" << fDelimiter;
+		outHeader << "G scavenged by environment (/100 eV)" << G4endl;
+		outHeader.close();
+	}
+
+	//----------------------------------------------------------------------------------------------
+	// Data file
+	//----------------------------------------------------------------------------------------------
+	G4String outputFileName = fFileChemistryYields + fOutFileExtension;
+	std::ofstream outFile(outputFileName, std::ios_base::app);
+
+	// Catch file I/O error
+	if (!outFile.good()) {
+		G4cerr << "Topas is exiting due to a serious error in file output." << G4endl;
+		G4cerr << "Output file: " << outputFileName << " cannot be opened" << G4endl;
+		fPm->AbortSession(1);
+	}
+
+	G4double numHundredEV = fTotalEdep/(100.*eV);
+	G4double scale = numHundredEV > 0. ? 1./numHundredEV : 0.;
+	for (G4int i = 0; i < fChemistryYieldTally->GetNumberOfTimes(); i++) {
+		for (size_t species = 0; species < fChemistryYieldSpecies.size(); species++) {
+			outFile << fChemistryYieldTally->GetTime(i)/ns << fDelimiter;
+			outFile << fChemistryYieldSpecies[species] << fDelimiter;
+			outFile << fChemistryYieldTally->GetPopulation(species, i)*scale;
+			for (G4int outcome = 0; outcome < ChemistryYieldTally::kNumOutcomes; outcome++)
+				outFile << fDelimiter << fChemistryYieldTally->GetCumulativeOutcomes(species, outcome, i)*scale;
+			outFile << G4endl;
+		}
+	}
+
+	outFile.close();
+}
+
+
 //--------------------------------------------------------------------------------------------------
 // This method outputs the details of scored Complex DSBs to a header file and data file. Each line
 // in the data file contains information for a single cluster.
@@ -1015,17 +3144,72 @@ void ScoreClusteredDNADamage::OutputNonDSBClusterToFile() {
 //--------------------------------------------------------------------------------------------------
 void ScoreClusteredDNADamage::AbsorbResultsFromWorkerScorer(TsVScorer* workerScorer)
 {
+	if (fRestoredFromCache) {
+		return;
+	}
+	ScoreClusteredDNADamage* myWorkerScorer = dynamic_cast<ScoreClusteredDNADamage*>(workerScorer);
+	EventTimelineTracer::Span span(fTimelineTracer, "Absorb worker");
+	if (fEndOfRunStartTime < 0.) fEndOfRunStartTime = GetWallTime();
+	ScopedWallTimer timer(&fAbsorbTime);
+
+	// Timing of the worker's part of the run
+	if (fRecordRunMetrics) {
+		myWorkerScorer->fThreadMetrics.numEvents = myWorkerScorer->fNumEvents;
+		fWorkerMetrics.push_back(myWorkerScorer->fThreadMetrics);
+		myWorkerScorer->fThreadMetrics.analysisTime = 0.;
+		myWorkerScorer->fThreadMetrics.outputTime = 0.;
+	}
+	if (fTimelineTracer && myWorkerScorer->fTimelineTracer)
+		fTimelineTracer->AbsorbSpans(myWorkerScorer->fTimelineTracer);
+
 	TsVNtupleScorer::AbsorbResultsFromWorkerScorer(workerScorer); // run the parent version
 
-	ScoreClusteredDNADamage* myWorkerScorer = dynamic_cast<ScoreClusteredDNADamage*>(workerScorer);
+	// Time-resolved yields of the chemical stage of this worker
+	if (fChemistryYieldTally)
+		fChemistryYieldTally->Absorb(*myWorkerScorer->fChemistryYieldTally);
+
+	// Tracks recorded by this worker
+	if (fRecordedTrackLibrary)
+		fRecordedTrackLibrary->Absorb(*myWorkerScorer->fRecordedTrackLibrary);
 
 	// Absorb various worker thread data
 	fTotalEdep += myWorkerScorer->fTotalEdep;
 	fNumEvents += myWorkerScorer->fNumEvents;
 	fNumProcessHitsCalls += myWorkerScorer->fNumProcessHitsCalls;
 
-  // Absorb the energy deposition maps from this worker
+	// Events of the incomplete last batch of this worker, whose maps are absorbed below. The energy
+	// they deposited is the difference between the totals & their values at the start of the batches.
+	fNumEventsInBatch += myWorkerScorer->fNumEventsInBatch;
+	myWorkerScorer->fNumEventsInBatch = 0;
+	fEdepBeforeBatch += myWorkerScorer->fEdepBeforeBatch;
+	myWorkerScorer->fEdepBeforeBatch = myWorkerScorer->fTotalEdep;
+
+	// Absorb the event tallies & energy group tallies from this worker
+	fEventTallies.insert(fEventTallies.end(), myWorkerScorer->fEventTallies.begin(), myWorkerScorer->fEventTallies.end());
+	myWorkerScorer->fEventTallies.clear();
+	fNumEventsOutsideEnergyGroups += myWorkerScorer->fNumEventsOutsideEnergyGroups;
+	for (size_t g = 0; g < fEnergyGroupTallies.size(); g++)
+		fEnergyGroupTallies[g].Add(myWorkerScorer->fEnergyGroupTallies[g]);
+
+	// Absorb the damage attribution tallies from this worker
+	for (size_t tag = 0; tag < fAttributionTallies.size(); tag++) {
+		AttributionTally& tally = fAttributionTallies[tag];
+		const AttributionTally& workerTally = myWorkerScorer->fAttributionTallies[tag];
+		tally.edep += workerTally.edep;
+		tally.numSSB += workerTally.numSSB;
+		tally.numBD += workerTally.numBD;
+		tally.numDSB += workerTally.numDSB;
+		tally.numDSB_hybrid += workerTally.numDSB_hybrid;
+	}
+	myWorkerScorer->fAttributionTallies.assign(TrackTagger::kNumTags, AttributionTally());
+
+  // Absorb the energy deposition maps (& the energy deposited in each nucleus) from this worker
   if (!fRecordDamagePerEvent) {
+    for (size_t i = 0; i < fNucleusEdep.size(); i++) {
+      fNucleusEdep[i] += myWorkerScorer->fNucleusEdep[i];
+      myWorkerScorer->fNucleusEdep[i] = 0.;
+    }
+
     AbsorbDirDmgMapFromWorkerScorer(fMapEdepStrand1Backbone,myWorkerScorer->fMapEdepStrand1Backbone);
     AbsorbDirDmgMapFromWorkerScorer(fMapEdepStrand2Backbone,myWorkerScorer->fMapEdepStrand2Backbone);
     AbsorbDirDmgMapFromWorkerScorer(fMapEdepStrand1Base,myWorkerScorer->fMapEdepStrand1Base);
@@ -1040,32 +3224,37 @@ void ScoreClusteredDNADamage::AbsorbResultsFromWorkerScorer(TsVScorer* workerSco
 
 //--------------------------------------------------------------------------------------------------
 // This method transfers the contents of a map of energy depositions from the worker thread to the
-// master thread
+// master thread. For residues hit in both, the hit tag of the larger single deposit is kept.
 //--------------------------------------------------------------------------------------------------
 void ScoreClusteredDNADamage::AbsorbDirDmgMapFromWorkerScorer(
-	std::map<G4int,std::map<G4int,std::map<G4int, G4double>>> &masterMap,
-	std::map<G4int,std::map<G4int,std::map<G4int, G4double>>> &workerMap)
+	std::map<G4int,std::map<G4int,std::map<G4int, ResidueEdep>>> &masterMap,
+	std::map<G4int,std::map<G4int,std::map<G4int, ResidueEdep>>> &workerMap)
 {
 	// Loop over all voxels in nucleus
-	std::map<G4int,std::map<G4int,std::map<G4int, G4double>>>::iterator itVoxel = workerMap.begin();
+	std::map<G4int,std::map<G4int,std::map<G4int, ResidueEdep>>>::iterator itVoxel = workerMap.begin();
 	while (itVoxel != workerMap.end()) {
 		G4int indexVoxel = itVoxel->first;
-		std::map<G4int,std::map<G4int, G4double>> workerMapVoxel = itVoxel->second;
+		std::map<G4int,std::map<G4int, ResidueEdep>> workerMapVoxel = itVoxel->second;
 
 		// Loop over all fibers in voxel
-		std::map<G4int,std::map<G4int, G4double>>::iterator itFiber = workerMapVoxel.begin();
+		std::map<G4int,std::map<G4int, ResidueEdep>>::iterator itFiber = workerMapVoxel.begin();
 		while (itFiber != workerMapVoxel.end()) {
 			G4int indexFiber = itFiber->first;
-			std::map<G4int, G4double> workerMapFiber = itFiber->second;
+			std::map<G4int, ResidueEdep> workerMapFiber = itFiber->second;
 
 			// Loop over all base pairs fiber
-			std::map<G4int, G4double>::iterator itBP = workerMapFiber.begin();
+			std::map<G4int, ResidueEdep>::iterator itBP = workerMapFiber.begin();
 			while (itBP != workerMapFiber.end()) {
 				G4int indexBP = itBP->first;
-				G4double eDep = itBP->second;
-
-				// Increment master thread energy map
-				masterMap[indexVoxel][indexFiber][indexBP] += eDep;
+				const ResidueEdep& workerDeposit = itBP->second;
+
+				// Increment master thread energy map, keeping the tag of the larger single deposit
+				ResidueEdep& masterDeposit = masterMap[indexVoxel][indexFiber][indexBP];
+				masterDeposit.edep += workerDeposit.edep;
+				if (workerDeposit.maxStepEdep > masterDeposit.maxStepEdep) {
+					masterDeposit.maxStepEdep = workerDeposit.maxStepEdep;
+					masterDeposit.tag = workerDeposit.tag;
+				}
 				itBP++;
 			}
 			itFiber++;
@@ -1127,108 +3316,240 @@ void ScoreClusteredDNADamage::RecordDamage() {
 	// Include following line if want to create a fake, predefined energy map to validate scoring
 	// CreateFakeEnergyMap();
 
-	// Iterate over all voxels
-	G4int numVoxels = pow(fNumVoxelsPerSide,3);
-	for (G4int iVoxel = 0; iVoxel < numVoxels; iVoxel++) {
-		fVoxelID = iVoxel;
-
-		// Iterate over all DNA fibres
-		for (G4int iFiber = 0; iFiber < fNumFibers; iFiber++) {
-			fFiberID = iFiber;
-
-			// As only a single fiber is processed at a time, copy the 1D maps for the current fiber
-			// from the larger 3D maps for easier processing.
-			fFiberMapEdepStrand1Backbone = fMapEdepStrand1Backbone[iVoxel][iFiber];
-			fFiberMapEdepStrand2Backbone = fMapEdepStrand2Backbone[iVoxel][iFiber];
-			fFiberMapEdepStrand1Base = fMapEdepStrand1Base[iVoxel][iFiber];
-			fFiberMapEdepStrand2Base = fMapEdepStrand2Base[iVoxel][iFiber];
-
-			// Determine yields of simple damages (SSB and BD) in both strands
-			fIndicesSSB1_direct = RecordSimpleDamage(fThresEdepForSSB,fFiberMapEdepStrand1Backbone);
-			fIndicesSSB2_direct = RecordSimpleDamage(fThresEdepForSSB,fFiberMapEdepStrand2Backbone);
-			fIndicesBD1_direct = RecordSimpleDamage(fThresEdepForBD,fFiberMapEdepStrand1Base);
-			fIndicesBD2_direct = RecordSimpleDamage(fThresEdepForBD,fFiberMapEdepStrand2Base);
-
-			fIndicesSSB1_indirect = fMapIndDamageStrand1Backbone[iVoxel][iFiber];
-			fIndicesSSB2_indirect = fMapIndDamageStrand2Backbone[iVoxel][iFiber];
-			fIndicesBD1_indirect = fMapIndDamageStrand1Base[iVoxel][iFiber];
-			fIndicesBD2_indirect = fMapIndDamageStrand2Base[iVoxel][iFiber];
-
-			// Process SSBs in both strands to determine if there are any DSB
-			// fIndicesDSB = RecordDSB();
-			G4int totalFiberSSB_direct = 0, totalFiberSSB_indirect = 0, totalFiberBD_direct = 0, totalFiberBD_indirect = 0;
-			G4int totalFiberDSB_direct = 0, totalFiberDSB_indirect = 0, totalFiberDSB_hybrid = 0;
-
-			// Hybrid DSBs
-			if (fIncludeDirectDamage && fIncludeIndirectDamage) {
-				fIndicesDSB_hybrid = RecordDSB(fIdHybrid);
-				totalFiberDSB_hybrid = fIndicesDSB_hybrid.size();
-				fTotalDSB_hybrid += totalFiberDSB_hybrid;
-				fTotalDSB += totalFiberDSB_hybrid;
-			}
-			// Direct DSBs, SSBs, and BDs
-			if (fIncludeDirectDamage) {
-				fIndicesDSB_direct = RecordDSB(fIdDirect);
-				totalFiberDSB_direct = fIndicesDSB_direct.size();
-				fTotalDSB_direct += totalFiberDSB_direct;
-				fTotalDSB += totalFiberDSB_direct;
-
-				totalFiberSSB_direct = fIndicesSSB1_direct.size() + fIndicesSSB2_direct.size();
-				fTotalSSB_direct += totalFiberSSB_direct;
-				fTotalSSB += totalFiberSSB_direct;
-
-				totalFiberBD_direct = fIndicesBD1_direct.size() + fIndicesBD2_direct.size();
-				fTotalBD_direct += totalFiberBD_direct;
-				fTotalBD += totalFiberBD_direct;
-			}
-			// Indirect DSBs, SSBs, and BDs
-			if (fIncludeIndirectDamage) {
-				fIndicesDSB_indirect = RecordDSB(fIdIndirect);
-				totalFiberDSB_indirect = fIndicesDSB_indirect.size();
-				fTotalDSB_indirect += totalFiberDSB_indirect;
-				fTotalDSB += totalFiberDSB_indirect;
-
-				totalFiberSSB_indirect = fIndicesSSB1_indirect.size() + fIndicesSSB2_indirect.size();
-				fTotalSSB_indirect += totalFiberSSB_indirect;
-				fTotalSSB += totalFiberSSB_indirect;
-
-				totalFiberBD_indirect = fIndicesBD1_indirect.size() + fIndicesBD2_indirect.size();
-				fTotalBD_indirect += totalFiberBD_indirect;
-				fTotalBD += totalFiberBD_indirect;
+	// Iterate over all nuclei. Voxel IDs are unique over all nuclei (see SetVoxelAndFiberID()).
+	for (fNucleusID = 0; fNucleusID < fNumNuclei; fNucleusID++) {
+		if (fNumNuclei > 1)
+			fNucleusDose = fNucleusEdep[fNucleusID] / GetMaterial("G4_WATER")->GetDensity() / (fComponentVolume/fNumNuclei);
+
+		// Iterate over all voxels of the nucleus
+		for (G4int iVoxel = fNucleusID*fNumVoxelsPerNucleus; iVoxel < (fNucleusID+1)*fNumVoxelsPerNucleus; iVoxel++) {
+			fVoxelID = iVoxel;
+
+			// Iterate over all DNA fibres
+			for (G4int iFiber = 0; iFiber < fNumFibers; iFiber++) {
+				RecordFiberDamage(iVoxel, iFiber);
+
+				// If recording damage on a fiber-by-fiber basis, fill the output ntuple
+				if (fRecordDamagePerFiber) {
+					fTotalDSB = fTotalDSB/2;
+					fTotalDSB_hybrid = fTotalDSB_hybrid/2;
+					fTotalDSB_direct = fTotalDSB_direct/2;
+					fTotalDSB_indirect = fTotalDSB_indirect/2;
+					AddYieldsToTallies();
+					fNtuple->Fill(); // Move this to outside loop if aggregating over all fibres
+
+					// Reset variables before next fibre (not aggregating over all fibres)
+					ResetDamageCounterVariables();
+				}
 			}
+		}
 
-			// If recording clustered damage, combine all damages into a single, sequential vector
-			// of damage that indicates the type and bp index. Then process this vector to determine
-			// clustered damage yields
-			if (fScoreClusters) {
-				fIndicesSimple = CombineSimpleDamage();
-				RecordClusteredDamage();
-			}
+		// If recording damage aggregated over all fibers, fill the output ntuple (one row per
+		// nucleus if there are several)
+		if (!fRecordDamagePerFiber && (fNumNuclei > 1 || fNucleusID == fNumNuclei-1)) {
+			fTotalDSB = fTotalDSB/2;
+			fTotalDSB_hybrid = fTotalDSB_hybrid/2;
+			fTotalDSB_direct = fTotalDSB_direct/2;
+			fTotalDSB_indirect = fTotalDSB_indirect/2;
+			fFiberID = fAggregateValueIndicator;
+			AddYieldsToTallies();
+			fNtuple->Fill(); // Move this to outside loop if aggregating over all fibres
+			if (fNumNuclei > 1)
+				ResetDamageCounterVariables();
+		}
+	}
+	// PrintDNADamageToConsole(); // debugging;
 
-			// If recording damage on a fiber-by-fiber basis, fill the output ntuple
-			if (fRecordDamagePerFiber) {
-				fTotalDSB = fTotalDSB/2;
-				fTotalDSB_hybrid = fTotalDSB_hybrid/2;
-				fTotalDSB_direct = fTotalDSB_direct/2;
-				fTotalDSB_indirect = fTotalDSB_indirect/2;
-				fNtuple->Fill(); // Move this to outside loop if aggregating over all fibres
+	// ProcessHits() only sets the voxel, fiber & nucleus IDs if there are several, so restore the
+	// defaults before the hits of the next event (or batch) are recorded
+	fVoxelID = 0;
+	fFiberID = 0;
+	fNucleusID = 0;
+}
 
-				// Reset variables before next fibre (not aggregating over all fibres)
-				ResetDamageCounterVariables();
-			}
+
+//--------------------------------------------------------------------------------------------------
+// Estimate the damage yields per Gy of this thread so far, from a random sample (without
+// replacement) of the fibers it has hit. The yields of the sampled fibers are scaled by the number
+// of fibers hit, & 95% confidence intervals use the standard error of the sample mean with the
+// finite population correction. Damage is recorded over the whole run, so the damage counters &
+// cluster details of this thread are empty before & after. Only the sampled fibers are analysed,
+// between events, so tracking is paused for a bounded time.
+//--------------------------------------------------------------------------------------------------
+void ScoreClusteredDNADamage::EstimateYieldsFromSample() {
+	//----------------------------------------------------------------------------------------------
+	// Fibers hit so far (by direct or indirect action)
+	//----------------------------------------------------------------------------------------------
+	std::vector<std::pair<G4int, G4int>> fibersHit;
+	for (G4int channel = 0; channel < 4; channel++) {
+		std::map<G4int, std::map<G4int, std::map<G4int, ResidueEdep>>>::const_iterator itVoxel;
+		for (itVoxel = fMapEdepByChannel[channel]->begin(); itVoxel != fMapEdepByChannel[channel]->end(); ++itVoxel) {
+			std::map<G4int, std::map<G4int, ResidueEdep>>::const_iterator itFiber;
+			for (itFiber = itVoxel->second.begin(); itFiber != itVoxel->second.end(); ++itFiber)
+				fibersHit.push_back(std::make_pair(itVoxel->first, itFiber->first));
+		}
+
+		std::map<G4int, std::map<G4int, std::vector<G4int>>>::const_iterator itIndVoxel;
+		for (itIndVoxel = fMapIndDamageByChannel[channel]->begin(); itIndVoxel != fMapIndDamageByChannel[channel]->end(); ++itIndVoxel) {
+			std::map<G4int, std::vector<G4int>>::const_iterator itFiber;
+			for (itFiber = itIndVoxel->second.begin(); itFiber != itIndVoxel->second.end(); ++itFiber)
+				fibersHit.push_back(std::make_pair(itIndVoxel->first, itFiber->first));
+		}
+	}
+	std::sort(fibersHit.begin(), fibersHit.end());
+	fibersHit.erase(std::unique(fibersHit.begin(), fibersHit.end()), fibersHit.end());
+
+	G4int numFibersHit = fibersHit.size();
+	G4double doseDep = fTotalEdep / GetMaterial("G4_WATER")->GetDensity() / fComponentVolume;
+	if (numFibersHit == 0 || doseDep <= 0.)
+		return;
+
+	//----------------------------------------------------------------------------------------------
+	// Analyse a random sample of the fibers (partial Fisher-Yates shuffle)
+	//----------------------------------------------------------------------------------------------
+	G4int numSampled = std::min(fYieldEstimateNumFibers, numFibersHit);
+	const G4int numQuantities = StatusStreamPublisher::kNumQuantities;
+	const char* names[numQuantities] = {"SSBs", "DSBs", "BDs", "Complex DSBs", "Non-DSB clusters"};
+	std::vector<G4double> sum(numQuantities, 0.), sumSquares(numQuantities, 0.);
+
+	// The double counts are accumulated over the whole run (indirect-indirect ones during tracking),
+	// so they are kept across the resets of the damage counters below
+	G4int doubleCountsDD = fDoubleCountsDD;
+	G4int doubleCountsDI = fDoubleCountsDI;
+	G4int doubleCountsII = fDoubleCountsII;
+
+	fIsEstimatingYields = true;
+	for (G4int i = 0; i < numSampled; i++) {
+		std::uniform_int_distribution<G4int> pick(i, numFibersHit-1);
+		std::swap(fibersHit[i], fibersHit[pick(fYieldEstimateEngine)]);
+
+		ResetDamageCounterVariables();
+		RecordFiberDamage(fibersHit[i].first, fibersHit[i].second);
+
+		G4double yields[numQuantities] = {(G4double)fTotalSSB, fTotalDSB/2., (G4double)fTotalBD,
+										  (G4double)fTotalComplexDSB, (G4double)fTotalNonDSBCluster};
+		for (G4int q = 0; q < numQuantities; q++) {
+			sum[q] += yields[q];
+			sumSquares[q] += yields[q]*yields[q];
 		}
 	}
+	fIsEstimatingYields = false;
+	ResetDamageCounterVariables();
+	ResetClusterVariables();
+	fDoubleCountsDD = doubleCountsDD;
+	fDoubleCountsDI = doubleCountsDI;
+	fDoubleCountsII = doubleCountsII;
+	fVoxelID = 0;
+	fFiberID = 0;
+
+	//----------------------------------------------------------------------------------------------
+	// Report
+	//----------------------------------------------------------------------------------------------
+	G4double finitePopulationCorrection = (numFibersHit > 1) ? (G4double)(numFibersHit-numSampled)/(numFibersHit-1) : 0.;
+
+	G4cout << "Yield estimate (thread " << fThreadID << ", " << fNumEvents << " events, " << doseDep/gray << " Gy, "
+		   << numSampled << " of " << numFibersHit << " fibers hit sampled"
+		   << (fNumNuclei > 1 ? ", yields per nucleus" : "") << "):" << G4endl;
+	G4double yieldsPerGy[numQuantities], halfWidthsPerGy[numQuantities];
+	for (G4int q = 0; q < numQuantities; q++) {
+		G4double mean = sum[q]/numSampled;
+		G4double variance = (numSampled > 1) ? std::max(0., (sumSquares[q] - numSampled*mean*mean)/(numSampled-1)) : 0.;
+		G4double total = numFibersHit*mean/fNumNuclei; // mean over the nuclei
+		G4double halfWidth = 1.96*numFibersHit*std::sqrt(variance/numSampled*finitePopulationCorrection)/fNumNuclei;
+		yieldsPerGy[q] = total/(doseDep/gray);
+		halfWidthsPerGy[q] = halfWidth/(doseDep/gray);
+		G4cout << "\t" << names[q] << " per Gy: " << yieldsPerGy[q] << " +/- " << halfWidthsPerGy[q]
+			   << " (95% CI)" << G4endl;
+	}
+	if (fStatusPublisher)
+		fStatusPublisher->SetYieldEstimate(fNumEvents, doseDep, yieldsPerGy, halfWidthsPerGy);
+}
 
-	// If recording damage aggregated over all fibers, fill the output ntuple
-	if (!fRecordDamagePerFiber) {
-		fTotalDSB = fTotalDSB/2;
-		fTotalDSB_hybrid = fTotalDSB_hybrid/2;
-		fTotalDSB_direct = fTotalDSB_direct/2;
-		fTotalDSB_indirect = fTotalDSB_indirect/2;
-		fFiberID = fAggregateValueIndicator;
-		fNtuple->Fill(); // Move this to outside loop if aggregating over all fibres
+
+//--------------------------------------------------------------------------------------------------
+// Record the DNA damage yields of a single fiber, adding them to the damage counters. The damage
+// maps are only read (fibers that were not hit are not inserted in them).
+//--------------------------------------------------------------------------------------------------
+void ScoreClusteredDNADamage::RecordFiberDamage(G4int iVoxel, G4int iFiber) {
+	fVoxelID = iVoxel;
+	fFiberID = iFiber;
+
+	// As only a single fiber is processed at a time, copy the 1D maps for the current fiber
+	// from the larger 3D maps for easier processing.
+	fFiberMapEdepStrand1Backbone = FindFiberEntry(fMapEdepStrand1Backbone, iVoxel, iFiber);
+	fFiberMapEdepStrand2Backbone = FindFiberEntry(fMapEdepStrand2Backbone, iVoxel, iFiber);
+	fFiberMapEdepStrand1Base = FindFiberEntry(fMapEdepStrand1Base, iVoxel, iFiber);
+	fFiberMapEdepStrand2Base = FindFiberEntry(fMapEdepStrand2Base, iVoxel, iFiber);
+
+	// Determine yields of simple damages (SSB and BD) in both strands
+	fIndicesSSB1_direct = RecordSimpleDamage(fThresEdepForSSB,fFiberMapEdepStrand1Backbone);
+	fIndicesSSB2_direct = RecordSimpleDamage(fThresEdepForSSB,fFiberMapEdepStrand2Backbone);
+	fIndicesBD1_direct = RecordSimpleDamage(fThresEdepForBD,fFiberMapEdepStrand1Base);
+	fIndicesBD2_direct = RecordSimpleDamage(fThresEdepForBD,fFiberMapEdepStrand2Base);
+
+	fIndicesSSB1_indirect = FindFiberEntry(fMapIndDamageStrand1Backbone, iVoxel, iFiber);
+	fIndicesSSB2_indirect = FindFiberEntry(fMapIndDamageStrand2Backbone, iVoxel, iFiber);
+	fIndicesBD1_indirect = FindFiberEntry(fMapIndDamageStrand1Base, iVoxel, iFiber);
+	fIndicesBD2_indirect = FindFiberEntry(fMapIndDamageStrand2Base, iVoxel, iFiber);
+
+	// Process SSBs in both strands to determine if there are any DSB
+	// fIndicesDSB = RecordDSB();
+	G4int totalFiberSSB_direct = 0, totalFiberSSB_indirect = 0, totalFiberBD_direct = 0, totalFiberBD_indirect = 0;
+	G4int totalFiberDSB_direct = 0, totalFiberDSB_indirect = 0, totalFiberDSB_hybrid = 0;
+
+	// Hybrid DSBs
+	if (fIncludeDirectDamage && fIncludeIndirectDamage) {
+		fIndicesDSB_hybrid = RecordDSB(fIdHybrid);
+		totalFiberDSB_hybrid = fIndicesDSB_hybrid.size();
+		fTotalDSB_hybrid += totalFiberDSB_hybrid;
+		fTotalDSB += totalFiberDSB_hybrid;
+	}
+	// Direct DSBs, SSBs, and BDs
+	if (fIncludeDirectDamage) {
+		fIndicesDSB_direct = RecordDSB(fIdDirect);
+		totalFiberDSB_direct = fIndicesDSB_direct.size();
+		fTotalDSB_direct += totalFiberDSB_direct;
+		fTotalDSB += totalFiberDSB_direct;
+
+		totalFiberSSB_direct = fIndicesSSB1_direct.size() + fIndicesSSB2_direct.size();
+		fTotalSSB_direct += totalFiberSSB_direct;
+		fTotalSSB += totalFiberSSB_direct;
+
+		totalFiberBD_direct = fIndicesBD1_direct.size() + fIndicesBD2_direct.size();
+		fTotalBD_direct += totalFiberBD_direct;
+		fTotalBD += totalFiberBD_direct;
+
+		// SSBs that are part of DSBs have been removed from the direct SSB vectors
+		if (fTrackTagger && !fIsEstimatingYields) {
+			AttributeSimpleDamage(fChannelStrand1Backbone, fIndicesSSB1_direct);
+			AttributeSimpleDamage(fChannelStrand2Backbone, fIndicesSSB2_direct);
+			AttributeSimpleDamage(fChannelStrand1Base, fIndicesBD1_direct);
+			AttributeSimpleDamage(fChannelStrand2Base, fIndicesBD2_direct);
+		}
+	}
+	// Indirect DSBs, SSBs, and BDs
+	if (fIncludeIndirectDamage) {
+		fIndicesDSB_indirect = RecordDSB(fIdIndirect);
+		totalFiberDSB_indirect = fIndicesDSB_indirect.size();
+		fTotalDSB_indirect += totalFiberDSB_indirect;
+		fTotalDSB += totalFiberDSB_indirect;
+
+		totalFiberSSB_indirect = fIndicesSSB1_indirect.size() + fIndicesSSB2_indirect.size();
+		fTotalSSB_indirect += totalFiberSSB_indirect;
+		fTotalSSB += totalFiberSSB_indirect;
+
+		totalFiberBD_indirect = fIndicesBD1_indirect.size() + fIndicesBD2_indirect.size();
+		fTotalBD_indirect += totalFiberBD_indirect;
+		fTotalBD += totalFiberBD_indirect;
+	}
+
+	// If recording clustered damage, combine all damages into a single, sequential vector
+	// of damage that indicates the type and bp index. Then process this vector to determine
+	// clustered damage yields
+	if (fScoreClusters) {
+		fIndicesSimple = CombineSimpleDamage();
+		RecordClusteredDamage();
 	}
-	// PrintDNADamageToConsole(); // debugging;
 }
 
 
@@ -1277,27 +3598,47 @@ void ScoreClusteredDNADamage::ResetMemberVariables() {
 	fFiberMapEdepStrand2Base.erase(fFiberMapEdepStrand2Base.begin(), fFiberMapEdepStrand2Base.end());
 
 	ResetDamageCounterVariables();
+	ResetClusterVariables();
+
+	fMapEdepStrand1Backbone.erase(fMapEdepStrand1Backbone.begin(), fMapEdepStrand1Backbone.end());
+	fMapEdepStrand2Backbone.erase(fMapEdepStrand2Backbone.begin(), fMapEdepStrand2Backbone.end());
+	fMapEdepStrand1Base.erase(fMapEdepStrand1Base.begin(), fMapEdepStrand1Base.end());
+	fMapEdepStrand2Base.erase(fMapEdepStrand2Base.begin(), fMapEdepStrand2Base.end());
+
+	fMapIndDamageStrand1Backbone.erase(fMapIndDamageStrand1Backbone.begin(), fMapIndDamageStrand1Backbone.end());
+	fMapIndDamageStrand2Backbone.erase(fMapIndDamageStrand2Backbone.begin(), fMapIndDamageStrand2Backbone.end());
+	fMapIndDamageStrand1Base.erase(fMapIndDamageStrand1Base.begin(), fMapIndDamageStrand1Base.end());
+	fMapIndDamageStrand2Base.erase(fMapIndDamageStrand2Base.begin(), fMapIndDamageStrand2Base.end());
 
+	fNucleusEdep.assign(fNucleusEdep.size(), 0.);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// This method erases the details of the recorded clusters.
+//--------------------------------------------------------------------------------------------------
+void ScoreClusteredDNADamage::ResetClusterVariables() {
 	fComplexDSBSizes.clear();
 	fComplexDSBNumSSB.clear();
+	fComplexDSBNumSSB_direct.clear();
+	fComplexDSBNumSSB_indirect.clear();
 	fComplexDSBNumBD.clear();
+	fComplexDSBNumBD_direct.clear();
+	fComplexDSBNumBD_indirect.clear();
 	fComplexDSBNumDSB.clear();
+	fComplexDSBNumDSB_direct.clear();
+	fComplexDSBNumDSB_indirect.clear();
+	fComplexDSBNumDSB_hybrid.clear();
 	fComplexDSBNumDamage.clear();
 
 	fNonDSBClusterSizes.clear();
 	fNonDSBClusterNumSSB.clear();
+	fNonDSBClusterNumSSB_direct.clear();
+	fNonDSBClusterNumSSB_indirect.clear();
 	fNonDSBClusterNumBD.clear();
+	fNonDSBClusterNumBD_direct.clear();
+	fNonDSBClusterNumBD_indirect.clear();
 	fNonDSBClusterNumDamage.clear();
-
-	fMapEdepStrand1Backbone.erase(fMapEdepStrand1Backbone.begin(), fMapEdepStrand1Backbone.end());
-	fMapEdepStrand2Backbone.erase(fMapEdepStrand2Backbone.begin(), fMapEdepStrand2Backbone.end());
-	fMapEdepStrand1Base.erase(fMapEdepStrand1Base.begin(), fMapEdepStrand1Base.end());
-	fMapEdepStrand2Base.erase(fMapEdepStrand2Base.begin(), fMapEdepStrand2Base.end());
-
-	fMapIndDamageStrand1Backbone.erase(fMapIndDamageStrand1Backbone.begin(), fMapIndDamageStrand1Backbone.end());
-	fMapIndDamageStrand2Backbone.erase(fMapIndDamageStrand2Backbone.begin(), fMapIndDamageStrand2Backbone.end());
-	fMapIndDamageStrand1Base.erase(fMapIndDamageStrand1Base.begin(), fMapIndDamageStrand1Base.end());
-	fMapIndDamageStrand2Base.erase(fMapIndDamageStrand2Base.begin(), fMapIndDamageStrand2Base.end());
 }
 
 
@@ -1339,7 +3680,7 @@ void ScoreClusteredDNADamage::ResetDamageCounterVariables() {
 // This method deletes the content in the provided map.
 //--------------------------------------------------------------------------------------------------
 std::vector<G4int> ScoreClusteredDNADamage::RecordSimpleDamage(G4double ThreshEDep,
-	std::map<G4int,G4double> mapEDep)
+	std::map<G4int,ResidueEdep> mapEDep)
 {
 	std::vector<G4int> indicesDamage;
 
@@ -1352,7 +3693,7 @@ std::vector<G4int> ScoreClusteredDNADamage::RecordSimpleDamage(G4double ThreshED
 	while ( !mapEDep.empty() )
 	{
 		indexBP = mapEDep.begin()->first;
-		eDep = mapEDep.begin()->second;
+		eDep = mapEDep.begin()->second.edep;
 
 		if (eDep >= ThreshEDep) {
 			indicesDamage.push_back(indexBP);
@@ -1430,6 +3771,9 @@ std::vector<G4int> ScoreClusteredDNADamage::RecordDSB(G4int pDamageCause)
 
 		// Damage in site 2 is within range of site 1 to count as DSB (either before or after)
 		if (isDSB && isDSBrecorded) {
+			if (fTrackTagger && !fIsEstimatingYields && pDamageCause != fIdIndirect)
+				AttributeDSB(*site1, isSite1Direct, *site2, isSite2Direct, isHybrid);
+
 			// Damage in site 1 is earlier or parallel to damage in site 2
 			if (*site1 <= *site2) {
 				indicesDSB1D.push_back(*site1);
@@ -1897,21 +4241,21 @@ void ScoreClusteredDNADamage::PrintDNADamageToConsole() {
 //--------------------------------------------------------------------------------------------------
 void ScoreClusteredDNADamage::CreateFakeEnergyMap() {
 	// Test cases to validate damage clustering algorithm is functioning properly
-	G4double eng = 20./eV;
+	ResidueEdep eng(20./eV);
 	fThresDistForCluster = 4;
 	fThresDistForDSB = 4;
 
 	// Test case 1
-	std::map<G4int,G4double> back1 = {{1,eng},{5,eng},{10,eng}};
-	std::map<G4int,G4double> base1 = {{10,eng},{12,eng}};
-	std::map<G4int,G4double> base2 = {{11,eng},{17,eng}};
-	std::map<G4int,G4double> back2 = {{1,eng},{3,eng}};
+	std::map<G4int,ResidueEdep> back1 = {{1,eng},{5,eng},{10,eng}};
+	std::map<G4int,ResidueEdep> base1 = {{10,eng},{12,eng}};
+	std::map<G4int,ResidueEdep> base2 = {{11,eng},{17,eng}};
+	std::map<G4int,ResidueEdep> back2 = {{1,eng},{3,eng}};
 
 	// Test case 2
-	// std::map<G4int,G4double> back1 = {{6,eng}};
-	// std::map<G4int,G4double> base1 = {{15,eng},{20,eng}};
-	// std::map<G4int,G4double> base2 = {{15,eng}};
-	// std::map<G4int,G4double> back2 = {{2,eng},{10,eng}};
+	// std::map<G4int,ResidueEdep> back1 = {{6,eng}};
+	// std::map<G4int,ResidueEdep> base1 = {{15,eng},{20,eng}};
+	// std::map<G4int,ResidueEdep> base2 = {{15,eng}};
+	// std::map<G4int,ResidueEdep> back2 = {{2,eng},{10,eng}};
 
 
 	fMapEdepStrand1Backbone[0][0] = back1;
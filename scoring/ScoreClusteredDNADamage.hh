@@ -15,11 +15,37 @@
 #include "TsVNtupleScorer.hh"
 
 #include <map>
+#include <cstdint>
+#include <random>
 
 struct DamageCluster;
 
+class DNAFiberTemplate;
+
+class NucleusLayout;
+
+class ChemicalTrackClassifier;
+
+class TrackTagger;
+
+class ResultCache;
+
+class EventTimelineTracer;
+
+class TrackLibrary;
+
+class IRTChemistry;
+
+class ChemistryYieldTally;
+
+class StatusStreamPublisher;
+
 class G4Material;
 
+class G4Navigator;
+
+class G4VPhysicalVolume;
+
 class ScoreClusteredDNADamage : public TsVNtupleScorer
 {
 public:
@@ -45,6 +71,74 @@ public:
     //--------------------------------------------------------------------------------------------------
     G4bool ProcessHits(G4Step*,G4TouchableHistory*);
 
+    //----------------------------------------------------------------------------------------------
+    // Record an energy deposition in a proxy fiber, by locating the residue at the post-step
+    // point. Diffusion steps of molecules in a proxy fiber are tested against the residues
+    // & histones of the fiber template instead.
+    //----------------------------------------------------------------------------------------------
+    G4bool ProcessHitsInFiberProxy(G4Step*);
+    G4bool ProcessChemicalStepInFiberProxy(G4Step*);
+    G4int LocateDepositInFiberProxy(G4TouchableHistory* touchable, const G4ThreeVector& point);
+
+    //----------------------------------------------------------------------------------------------
+    // Apply the indirect damage rules to a molecule reaching the residue of copy number volID, in
+    // the fiber of fVoxelID & fFiberID. Return fResidueReactionNone, fResidueReactionDamage (damage
+    // recorded) or fResidueReactionScavenged (no damage, but the molecule is removed).
+    //----------------------------------------------------------------------------------------------
+    G4int ReactWithResidue(G4int volID, G4int moleculeID, G4double time, G4float probDamageBase,
+                           G4float probDamageBackbone, G4bool isKilledByDNA);
+
+    //----------------------------------------------------------------------------------------------
+    // Time-resolved yields of the chemical stage (see ChemistryYieldTally): count a molecule as
+    // present during a step, or an outcome of a molecule (ChemistryYieldTally::kOutcome...) at the
+    // given time. Molecules of species that are not tallied are ignored.
+    //----------------------------------------------------------------------------------------------
+    void TallyChemistryStep(G4Step*);
+    void TallyChemistryOutcome(G4int moleculeID, G4int outcome, G4double time);
+    void OutputChemistryYieldsToFile();
+
+    //----------------------------------------------------------------------------------------------
+    // Track library (see TrackLibrary). In Record mode, add the energy deposit (& new species) of a
+    // step to the track of the current event, then close the track at the end of the event. In
+    // Replay mode, score a library track randomly rotated & translated into a nucleus, one deposit
+    // at a time.
+    //----------------------------------------------------------------------------------------------
+    G4bool RecordLibraryStep(G4Step*);
+    void CloseLibraryTrack();
+    void ReplayLibraryTrack();
+    void ScoreLibraryDeposit(const G4ThreeVector& position, G4double edep);
+
+    //----------------------------------------------------------------------------------------------
+    // IRT chemistry (see IRTChemistry). Run the chemical stage of the current event from the
+    // molecules collected at their creation, and score the indirect damage of their encounters with
+    // the residues.
+    //----------------------------------------------------------------------------------------------
+    void RunIRTChemistry();
+
+    //----------------------------------------------------------------------------------------------
+    // Step handler specialised for one configuration of the scorer (direct damage, indirect damage,
+    // voxelized nucleus, more than one fiber, histones as scavengers). The variant selected at
+    // construction is fConfigurationHandler.
+    //----------------------------------------------------------------------------------------------
+    template<G4bool kIncludeDirect, G4bool kIncludeIndirect, G4bool kBuildNucleus, G4bool kMultipleFibers,
+             G4bool kHistonesAsScavenger>
+    G4bool ProcessHitsForConfiguration(G4Step*);
+
+    //----------------------------------------------------------------------------------------------
+    // Add energy to the total deposited in the current run by the scorers of all threads
+    //----------------------------------------------------------------------------------------------
+    G4double AddToRunEdep(G4double edep);
+
+    //----------------------------------------------------------------------------------------------
+    // Output the timing & memory metrics of the run (see tools/scaling_harness.py)
+    //----------------------------------------------------------------------------------------------
+    void OutputRunMetricsToFile();
+
+    //----------------------------------------------------------------------------------------------
+    // Create the result cache of this scorer: key parameters & output files (see ResultCache)
+    //----------------------------------------------------------------------------------------------
+    ResultCache* CreateResultCache(const G4String& outFileName);
+
     //----------------------------------------------------------------------------------------------
     // Optionally process energy depositions to determine DNA damage yields (event-by-event)
     //----------------------------------------------------------------------------------------------
@@ -64,7 +158,94 @@ private:
 
     void RemoveElementFromVector(G4int, std::vector<G4int>&);
 
-    G4bool IsDamageInflicted(G4int, G4int);
+    //----------------------------------------------------------------------------------------------
+    // Chemistry data of a molecule that is constant over the lifetime of its track
+    //----------------------------------------------------------------------------------------------
+    struct ChemicalTrackRecord
+    {
+        G4int moleculeID;
+        G4float probDamageBackbone; // probability of inflicting an SSB when reacting with a backbone residue
+        G4float probDamageBase; // probability of inflicting a BD when reacting with a base
+        G4int flags; // combination of the fChemFlag bits
+        G4float scavengingRate; // rate of scavenging by the cellular environment (per ns), 0 if none
+
+        ChemicalTrackRecord() : moleculeID(0), probDamageBackbone(0.), probDamageBase(0.), flags(0), scavengingRate(0.) {}
+    };
+
+    //----------------------------------------------------------------------------------------------
+    // Return the record of a chemical track, filled at its first step.
+    //----------------------------------------------------------------------------------------------
+    const ChemicalTrackRecord& GetChemicalTrackRecord(G4Track*);
+
+    //----------------------------------------------------------------------------------------------
+    // Remove a molecule scavenged by the cellular environment during a step: it survives a step of
+    // duration dt with probability exp(-k*dt). Return true if the molecule was removed.
+    //----------------------------------------------------------------------------------------------
+    G4bool ScavengeMolecule(G4Step*);
+
+    //----------------------------------------------------------------------------------------------
+    // Add an energy deposition in a residue to the appropriate direct damage map
+    //----------------------------------------------------------------------------------------------
+    void AddDirectEnergyDeposit(G4int strandID, G4int residueID, G4int bpID, G4double edep, const G4Track* track);
+
+    //----------------------------------------------------------------------------------------------
+    // Energy deposited in a residue. If attributing damage, also the largest energy deposited by a
+    // single step & the tag of the track of that step (see TrackTagger).
+    //----------------------------------------------------------------------------------------------
+    struct ResidueEdep
+    {
+        G4double edep;
+        G4float maxStepEdep;
+        std::uint8_t tag;
+
+        explicit ResidueEdep(G4double energy = 0.) : edep(energy), maxStepEdep(0.), tag(0) {}
+    };
+
+    //----------------------------------------------------------------------------------------------
+    // Return the energy deposited in a residue of the fiber being recorded (NULL if not hit)
+    //----------------------------------------------------------------------------------------------
+    const ResidueEdep* FindResidueEdep(G4int channel, G4int bpID) const;
+
+    //----------------------------------------------------------------------------------------------
+    // Attribute direct damage to the tags of the dominant contributors of the damaged residues
+    //----------------------------------------------------------------------------------------------
+    void AttributeSimpleDamage(G4int channel, const std::vector<G4int>& indices);
+    void AttributeDSB(G4int site1, G4bool isSite1Direct, G4int site2, G4bool isSite2Direct, G4bool isHybrid);
+
+    //----------------------------------------------------------------------------------------------
+    // Return the damage channel of a residue (e.g. fChannelStrand1Backbone)
+    //----------------------------------------------------------------------------------------------
+    G4int GetDamageChannel(G4int strandID, G4int residueID);
+
+    //----------------------------------------------------------------------------------------------
+    // Return the fiber template of the component (see DNAFiberTemplate), found on first use
+    //----------------------------------------------------------------------------------------------
+    const DNAFiberTemplate* GetFiberTemplate();
+
+    //----------------------------------------------------------------------------------------------
+    // Set fVoxelID & fFiberID from the parents of the touchable. The voxel ID is unique over all
+    // nuclei: voxels of nucleus fNucleusID follow those of the nuclei before it.
+    //----------------------------------------------------------------------------------------------
+    template<G4bool kBuildNucleus, G4bool kMultipleFibers>
+    void SetVoxelAndFiberID(G4TouchableHistory* touchable, G4int depthOffset);
+
+    //----------------------------------------------------------------------------------------------
+    // Return the ProcessHitsForConfiguration() variant matching the given configuration flags
+    //----------------------------------------------------------------------------------------------
+    typedef G4bool (ScoreClusteredDNADamage::*StepHandler)(G4Step*);
+
+    template<G4bool... kFlags>
+    StepHandler SelectStepHandler();
+
+    template<G4bool... kFlags, typename... Args>
+    StepHandler SelectStepHandler(G4bool flag, Args... flags);
+
+    //----------------------------------------------------------------------------------------------
+    // Step handlers selected at construction instead of fConfigurationHandler (see ProcessHits()):
+    // apply the features acting on every step, or ignore the step (outputs restored from the cache)
+    //----------------------------------------------------------------------------------------------
+    G4bool ProcessHitsWithStepFeatures(G4Step*);
+    G4bool IgnoreStep(G4Step*) {return false;}
 
     void PrintStepInfo(G4Step*);
 
@@ -89,6 +270,31 @@ private:
     //----------------------------------------------------------------------------------------------
     void OutputRunSummaryToFile();
 
+    //----------------------------------------------------------------------------------------------
+    // This method outputs the yields, dose and cluster sizes of each primary energy group.
+    //----------------------------------------------------------------------------------------------
+    void OutputEnergyGroupsToFile();
+
+    //----------------------------------------------------------------------------------------------
+    // Find the energy group of the primary particle of the current event
+    //----------------------------------------------------------------------------------------------
+    void SetPrimaryEnergyGroup();
+
+    //----------------------------------------------------------------------------------------------
+    // Add the current damage yields to the tallies of the current event & of its energy group
+    //----------------------------------------------------------------------------------------------
+    void AddYieldsToTallies();
+
+    //----------------------------------------------------------------------------------------------
+    // This method outputs the primary energy, energy deposit & damage yields of every event.
+    //----------------------------------------------------------------------------------------------
+    void OutputEventTalliesToFile();
+
+    //----------------------------------------------------------------------------------------------
+    // This method outputs the energy deposit & direct damage yields attributed to each track tag.
+    //----------------------------------------------------------------------------------------------
+    void OutputDamageAttributionToFile();
+
     //----------------------------------------------------------------------------------------------
     // This method outputs the details of scored Complex DSBs to a header file and data file.
     //----------------------------------------------------------------------------------------------
@@ -109,8 +315,8 @@ private:
     // This method transfers the contents of a map of energy depositions from the worker thread to
     // the master thread
     //----------------------------------------------------------------------------------------------
-    void AbsorbDirDmgMapFromWorkerScorer(std::map<G4int,std::map<G4int,std::map<G4int, G4double>>>&,
-        std::map<G4int,std::map<G4int,std::map<G4int, G4double>>>&);
+    void AbsorbDirDmgMapFromWorkerScorer(std::map<G4int,std::map<G4int,std::map<G4int, ResidueEdep>>>&,
+        std::map<G4int,std::map<G4int,std::map<G4int, ResidueEdep>>>&);
 
     void AbsorbIndDmgMapFromWorkerScorer(std::map<G4int,std::map<G4int,std::vector<G4int>>>&,
         std::map<G4int,std::map<G4int,std::vector<G4int>>>&);
@@ -120,6 +326,16 @@ private:
     //----------------------------------------------------------------------------------------------
     void RecordDamage();
 
+    //----------------------------------------------------------------------------------------------
+    // Record the DNA damage yields of a single fiber (called by RecordDamage() for each fiber)
+    //----------------------------------------------------------------------------------------------
+    void RecordFiberDamage(G4int iVoxel, G4int iFiber);
+
+    //----------------------------------------------------------------------------------------------
+    // Print provisional yields per Gy estimated from a random sample of the fibers hit so far
+    //----------------------------------------------------------------------------------------------
+    void EstimateYieldsFromSample();
+
     //--------------------------------------------------------------------------------------------------
     // This method merges and resolves duplicates of the damage yields from direct and indirect damage.
     //--------------------------------------------------------------------------------------------------
@@ -135,10 +351,15 @@ private:
     //----------------------------------------------------------------------------------------------
     void ResetDamageCounterVariables();
 
+    //----------------------------------------------------------------------------------------------
+    // This method erases the details of the recorded clusters (sizes & contents).
+    //----------------------------------------------------------------------------------------------
+    void ResetClusterVariables();
+
     //----------------------------------------------------------------------------------------------
     // Record bp indices of one type of simple DNA damage (SSB or BD) in a single strand to a vector
     //----------------------------------------------------------------------------------------------
-    std::vector<G4int> RecordSimpleDamage(G4double,std::map<G4int, G4double>);
+    std::vector<G4int> RecordSimpleDamage(G4double,std::map<G4int, ResidueEdep>);
 
     //----------------------------------------------------------------------------------------------
     // Record indices of DSBs in a 1D vector
@@ -195,6 +416,67 @@ private:
     G4bool fBuildNucleus;
     G4int fNumVoxelsPerSide;
     G4double fVoxelSideLength;
+    G4int fNumVoxelsPerNucleus;
+
+    // Population of nuclei sharing one DNA geometry (see NucleusLayout). Damage & dose are reported
+    // per nucleus when there are several.
+    G4int fNumNuclei;
+    const NucleusLayout* fNucleusLayout;
+    std::vector<G4double> fNucleusEdep; // energy deposited in each nucleus since damage was last recorded
+
+    // Fiber proxy (fibers are homogeneous cylinders, residues are located using the template)
+    G4bool fUseFiberProxy;
+    G4Material* fFiberProxyMaterial;
+    G4String fComponentName;
+    const DNAFiberTemplate* fFiberTemplate;
+    G4bool fUseHydrationShells; // molecules reach residues at their hydration shell (template only)
+
+    // Track library (see TrackLibrary)
+    G4int fTrackLibraryMode;
+    G4String fTrackLibraryFile; // written in Record mode
+    G4bool fTrackLibraryRecordSpecies;
+    TrackLibrary* fRecordedTrackLibrary; // of this thread until absorbed by the master, null unless recording
+    std::vector<G4bool> fIsSpeciesRecorded; // chemical tracks of the current event, indexed by -trackID
+    std::vector<const TrackLibrary*> fReplayLibraries; // shared by all threads
+    std::vector<G4double> fReplayCumulativeWeights; // probability of drawing a track from each library
+    G4double fTrackLibraryTranslationMargin; // added to the half length of the nucleus when translating tracks
+    G4double fReplayPrimaryEnergy; // of the track replayed in the current event
+
+    // Copy of the component placed at the origin, in which replayed points are located (Replay mode)
+    G4VPhysicalVolume* fReplayWorld;
+    G4Navigator* fReplayNavigator;
+    G4TouchableHistory* fReplayTouchable;
+
+    static const G4int fTrackLibraryOff = 0;
+    static const G4int fTrackLibraryRecord = 1;
+    static const G4int fTrackLibraryReplay = 2;
+
+    // Chemistry mode. In IRT mode, fTrackClassifier collects the molecules of each event, whose
+    // chemical stage is then run by fIRTChemistry instead of the chemistry scheduler.
+    G4int fChemistryMode;
+    IRTChemistry* fIRTChemistry;
+    G4Navigator* fIRTNavigator; // locates the collected molecules in the world of this thread
+    G4TouchableHistory* fIRTTouchable;
+
+    // Reaction of each species with the residues in IRT mode, indexed by moleculeID. Filled at setup
+    // for every species targeting the residues, so that encounters need no map lookup.
+    struct IRTResidueReactivity
+    {
+        G4float probDamageBackbone;
+        G4float probDamageBase;
+        G4bool isKilledByResidues;
+
+        IRTResidueReactivity() : probDamageBackbone(0.), probDamageBase(0.), isKilledByResidues(false) {}
+    };
+    std::vector<IRTResidueReactivity> fIRTResidueReactivity;
+
+    static const G4int fChemistryStepByStep = 0;
+    static const G4int fChemistryIRT = 1;
+
+    // Outcomes of ReactWithResidue()
+    static const G4int fResidueReactionNone = 0;
+    static const G4int fResidueReactionDamage = 1;
+    static const G4int fResidueReactionScavenged = 2;
 
     // Thresholds for defining DNA damage
     G4double fThresEdepForSSB;
@@ -202,9 +484,15 @@ private:
     G4int fThresDistForDSB;
     G4int fThresDistForCluster;
 
+    // Step handler called by ProcessHits() & variant of ProcessHitsForConfiguration() selected for
+    // the configuration of this scorer
+    StepHandler fStepHandler;
+    StepHandler fConfigurationHandler;
+
     // Booleans
     G4bool fScoreClusters;
     G4bool fRecordDamagePerEvent;
+    G4int fRecordDamagePerBatch; // # events per batch, 0 if not scoring batch-by-batch
     G4bool fRecordDamagePerFiber;
     G4bool fOutputHeaders;
     G4bool fIncludeDirectDamage;
@@ -221,33 +509,113 @@ private:
     // Dose threshold
     G4bool fUseDoseThreshold;
     G4double fDoseThreshold;
-    G4double fEnergyThreshold;
-
-    // # of threads used
-    G4int fNumberOfThreads;
+    G4double fEnergyThreshold; // for the energy deposited in the run by all threads
+    G4double fEdepAddedToRun; // part of fTotalEdep already added to the total of the run
 
     // Output file parameters
     G4String fDelimiter;
     G4String fOutHeaderExtension;
     G4String fOutFileExtension;
     G4String fFileRunSummary;
+    G4String fFileEnergyGroups;
+
+    //----------------------------------------------------------------------------------------------
+    // Damage yields, dose & cluster size histograms of the events whose primary energy is in one
+    // energy group
+    //----------------------------------------------------------------------------------------------
+    struct EnergyGroupTally
+    {
+        G4long numEvents;
+        G4double edep;
+        G4long numSSB, numSSB_direct, numSSB_indirect;
+        G4long numBD, numBD_direct, numBD_indirect;
+        G4long numDSB, numDSB_direct, numDSB_indirect, numDSB_hybrid;
+        G4long numComplexDSB;
+        G4long numNonDSBCluster;
+        std::map<G4int, G4long> complexDSBSizeCounts; // key = cluster size (bp)
+        std::map<G4int, G4long> nonDSBClusterSizeCounts;
+
+        EnergyGroupTally() : numEvents(0), edep(0.), numSSB(0), numSSB_direct(0), numSSB_indirect(0),
+                             numBD(0), numBD_direct(0), numBD_indirect(0), numDSB(0), numDSB_direct(0),
+                             numDSB_indirect(0), numDSB_hybrid(0), numComplexDSB(0), numNonDSBCluster(0) {}
+
+        void Add(const EnergyGroupTally& other);
+    };
+
+    //----------------------------------------------------------------------------------------------
+    // Primary energy, energy deposited & damage yields of one event
+    //----------------------------------------------------------------------------------------------
+    struct EventTally
+    {
+        G4int threadID;
+        G4int eventID;
+        G4double primaryEnergy;
+        G4double edep;
+        G4int numSSB, numSSB_direct, numSSB_indirect;
+        G4int numBD, numBD_direct, numBD_indirect;
+        G4int numDSB, numDSB_direct, numDSB_indirect, numDSB_hybrid;
+        G4int numComplexDSB;
+        G4int numNonDSBCluster;
+
+        EventTally() : threadID(0), eventID(0), primaryEnergy(0.), edep(0.), numSSB(0), numSSB_direct(0),
+                       numSSB_indirect(0), numBD(0), numBD_direct(0), numBD_indirect(0), numDSB(0),
+                       numDSB_direct(0), numDSB_indirect(0), numDSB_hybrid(0), numComplexDSB(0),
+                       numNonDSBCluster(0) {}
+
+        // Event IDs are unique within a run, so the order does not depend on which thread ran
+        // each event
+        G4bool operator<(const EventTally& other) const
+        {
+            return eventID < other.eventID || (eventID == other.eventID && threadID < other.threadID);
+        }
+    };
+
+    G4bool fRecordEventTallies;
+    G4String fFileEventTallies;
+    EventTally fCurrentEventTally;
+    std::vector<EventTally> fEventTallies; // of this thread until absorbed by the master
+
+    //----------------------------------------------------------------------------------------------
+    // Energy deposited in residues & direct damage yields whose dominant contributor has one tag
+    //----------------------------------------------------------------------------------------------
+    struct AttributionTally
+    {
+        G4double edep;
+        G4long numSSB, numBD, numDSB, numDSB_hybrid; // direct damage only
+
+        AttributionTally() : edep(0.), numSSB(0), numBD(0), numDSB(0), numDSB_hybrid(0) {}
+    };
+
+    // Damage attribution by track tag (null tagger if RecordDamageAttribution is off)
+    G4bool fRecordDamageAttribution;
+    G4String fFileDamageAttribution;
+    TrackTagger* fTrackTagger;
+    std::vector<AttributionTally> fAttributionTallies; // indexed by tag
+
+    // Primary energy groups (empty if not stratifying). Group g is [edges[g], edges[g+1]).
+    std::vector<G4double> fEnergyGroupEdges;
+    std::vector<EnergyGroupTally> fEnergyGroupTallies;
+    G4long fNumEventsOutsideEnergyGroups;
+    G4double fPrimaryEnergy; // of the current event
+    G4int fEnergyGroup; // of the current event, -1 if outside all groups
+    G4double fEdepBeforeEvent; // fTotalEdep at the start of the current event
 
     // These maps record energy deposited in bp in one of the strands of the DNA double helix
-    std::map<G4int, G4double> fFiberMapEdepStrand1Backbone;
-    std::map<G4int, G4double> fFiberMapEdepStrand2Backbone;
-    std::map<G4int, G4double> fFiberMapEdepStrand1Base;
-    std::map<G4int, G4double> fFiberMapEdepStrand2Base;
+    std::map<G4int, ResidueEdep> fFiberMapEdepStrand1Backbone;
+    std::map<G4int, ResidueEdep> fFiberMapEdepStrand2Backbone;
+    std::map<G4int, ResidueEdep> fFiberMapEdepStrand1Base;
+    std::map<G4int, ResidueEdep> fFiberMapEdepStrand2Base;
 
     // These maps energy deposited in bp in one of the strands of the DNA double helix in a
     // triple-nested map structure
-    // map1 (key, map2) --> map2 (key, map3) --> map3 (key, double)
+    // map1 (key, map2) --> map2 (key, map3) --> map3 (key, ResidueEdep)
     // First index specifies the voxel
     // Second index specifies the fiber
     // Third index specifies the bp index
-    std::map<G4int, std::map<G4int, std::map<G4int, G4double>>> fMapEdepStrand1Backbone;
-    std::map<G4int, std::map<G4int, std::map<G4int, G4double>>> fMapEdepStrand2Backbone;
-    std::map<G4int, std::map<G4int, std::map<G4int, G4double>>> fMapEdepStrand1Base;
-    std::map<G4int, std::map<G4int, std::map<G4int, G4double>>> fMapEdepStrand2Base;
+    std::map<G4int, std::map<G4int, std::map<G4int, ResidueEdep>>> fMapEdepStrand1Backbone;
+    std::map<G4int, std::map<G4int, std::map<G4int, ResidueEdep>>> fMapEdepStrand2Backbone;
+    std::map<G4int, std::map<G4int, std::map<G4int, ResidueEdep>>> fMapEdepStrand1Base;
+    std::map<G4int, std::map<G4int, std::map<G4int, ResidueEdep>>> fMapEdepStrand2Base;
 
     // map1 (key, map2) --> map2 (key, vector) --> vector (int)
     std::map<G4int, std::map<G4int, std::vector<G4int>>> fMapIndDamageStrand1Backbone;
@@ -255,6 +623,13 @@ private:
     std::map<G4int, std::map<G4int, std::vector<G4int>>> fMapIndDamageStrand1Base;
     std::map<G4int, std::map<G4int, std::vector<G4int>>> fMapIndDamageStrand2Base;
 
+    // The maps above, indexed by damage channel
+    std::map<G4int, std::map<G4int, std::map<G4int, ResidueEdep>>>* fMapEdepByChannel[4];
+    std::map<G4int, std::map<G4int, std::vector<G4int>>>* fMapIndDamageByChannel[4];
+
+    // The fiber maps above, indexed by damage channel
+    std::map<G4int, ResidueEdep>* fFiberMapEdepByChannel[4];
+
     std::map<G4int, std::map<G4int, std::vector<G4int>>> fMapDamageTypeStrand1Backbone;
     std::map<G4int, std::map<G4int, std::vector<G4int>>> fMapDamageTypeStrand2Backbone;
     std::map<G4int, std::map<G4int, std::vector<G4int>>> fMapDamageTypeStrand1Base;
@@ -265,6 +640,72 @@ private:
     G4int fEventID;
     G4int fFiberID;
     G4int fVoxelID;
+    G4int fNucleusID;
+    G4double fNucleusDose; // dose to nucleus fNucleusID, reported with its yields
+
+    // In-run yield estimates
+    G4int fYieldEstimateInterval; // # events between estimates, 0 if no estimates
+    G4int fYieldEstimateNumFibers; // # fibers sampled per estimate
+    G4bool fIsEstimatingYields; // damage is not attributed while estimating
+    std::mt19937 fYieldEstimateEngine;
+
+    //----------------------------------------------------------------------------------------------
+    // Timing of one thread's part of a run (wall-clock seconds, see OutputRunMetricsToFile())
+    //----------------------------------------------------------------------------------------------
+    struct ThreadMetrics
+    {
+        G4double readyTime; // construction of the scorer of the thread
+        G4double lastEventTime; // end of the last event of the thread
+        G4long numEvents;
+        G4double analysisTime; // damage analysis during the event loop
+        G4double outputTime; // output during the event loop
+
+        ThreadMetrics() : readyTime(0.), lastEventTime(0.), numEvents(0), analysisTime(0.), outputTime(0.) {}
+    };
+
+    // Run metrics
+    G4bool fRecordRunMetrics;
+    G4String fFileRunMetrics;
+
+    // Time-resolved yields of the chemical stage, for the species of fChemistryYieldSpecies
+    ChemistryYieldTally* fChemistryYieldTally; // NULL if not recorded
+    G4String fFileChemistryYields;
+    std::vector<G4String> fChemistryYieldSpecies;
+    std::vector<G4double> fChemistryYieldTimes;
+    std::vector<G4int> fChemistryYieldIndices; // index in fChemistryYieldSpecies by molecule ID, -1 if not tallied
+    ThreadMetrics fThreadMetrics; // of this thread
+    std::vector<ThreadMetrics> fWorkerMetrics; // of the absorbed workers, on the master
+    G4double fEndOfRunStartTime; // first absorb on the master, -1 before the end of the run
+    G4double fAbsorbTime;
+    G4double fEndOfRunAnalysisTime;
+    G4double fEndOfRunOutputTime;
+
+    // Live status stream (null publisher if PublishStatusStream is off)
+    G4bool fPublishStatusStream;
+    G4String fStatusStreamSocket;
+    G4double fStatusStreamInterval;
+    StatusStreamPublisher* fStatusPublisher; // shared by all threads
+    G4double fEdepPublished; // part of fTotalEdep already added to the status stream
+
+    // Event timeline (null tracer if RecordEventTimeline is off)
+    G4bool fRecordEventTimeline;
+    G4int fEventTimelineSampleInterval; // one event in K is traced
+    G4int fEventTimelineBufferSize; // # spans kept per thread
+    G4String fFileEventTimeline;
+    EventTimelineTracer* fTimelineTracer;
+
+    // Result cache (null except on the master thread if UseResultCache is on)
+    G4bool fUseResultCache;
+    G4bool fReuseCachedResults;
+    G4String fResultCacheDirectory;
+    ResultCache* fResultCache;
+    G4bool fRestoredFromCache; // outputs restored at exit, nothing is scored
+
+    // Batch-by-batch scoring
+    G4int fNumEventsInBatch; // # events in the current batch
+    G4int fBatchID; // of the current batch, within this thread
+    G4double fEdepBeforeBatch; // fTotalEdep at the start of the current batch
+    G4double fBatchDose; // dose to the component in the batch written
 
     // Molecule IDs
     G4int fMoleculeID_OH;
@@ -280,6 +721,19 @@ private:
     G4int fMoleculeID_O2;
     G4int fMoleculeID_O2m;
 
+    // Records of the chemical tracks of the current event, indexed by -trackID
+    std::vector<ChemicalTrackRecord> fChemicalTrackRecords;
+
+    static const G4int fChemFlagFilled = 1;
+    static const G4int fChemFlagBornInDNA = 2; // only set if molecules are not killed at birth
+    static const G4int fChemFlagBornInHistone = 4; // only set if molecules are not killed at birth
+    static const G4int fChemFlagKilledByDNA = 8; // in SpeciesToKillByDNAVolumes
+    static const G4int fChemFlagKilledByHistone = 16; // in SpeciesToKillByHistones
+
+    // Kills molecules created in DNA & histone volumes at birth (null if KillSpeciesAtBirth is off)
+    G4bool fKillSpeciesAtBirth;
+    ChemicalTrackClassifier* fTrackClassifier;
+
     std::vector<G4int> fSpeciesToKillByDNAVolumes;
     std::vector<G4int> fspeciesToKillByHistones;
     G4bool fHistonesAsScavenger;
@@ -327,6 +781,15 @@ private:
     static const G4int fVolIdDeoxyribose = 1;
     static const G4int fVolIdBase = 2;
 
+    // Damage channels (strand & backbone or base), and the channel of each (strand, residue) pair
+    static const G4int fChannelStrand1Backbone = 0;
+    static const G4int fChannelStrand1Base = 1;
+    static const G4int fChannelStrand2Backbone = 2;
+    static const G4int fChannelStrand2Base = 3;
+    static constexpr G4int fChannelLookup[2][3] = {
+        {fChannelStrand1Backbone, fChannelStrand1Backbone, fChannelStrand1Base},
+        {fChannelStrand2Backbone, fChannelStrand2Backbone, fChannelStrand2Base}};
+
     static const G4int fParentIndexFiber = 1; // Touchable history index for accessing DNA fiber
     static const G4int fParentIndexVoxelZ = 2; // Touchable history index for accessing Z voxels
     static const G4int fParentIndexVoxelX = 3; // Touchable history index for accessing X voxels
@@ -341,6 +804,11 @@ private:
     std::map<G4int, G4float> fMoleculeDamageProb_SSB; // backbone damage
     std::map<G4int, G4float> fMoleculeDamageProb_BD; // base damage
 
+    // Scavenging by the cellular environment: map of moleculeID to the inverse of the mean lifetime
+    // of the species (species absent from the map are not scavenged)
+    G4bool fIncludeScavenging;
+    std::map<G4int, G4double> fScavengingRates;
+
     // Vectors to hold indices of simple damages
     std::vector<G4int>* fIndices;
     std::vector<G4int>* fIndicesSSB1;
@@ -0,0 +1,328 @@
+// Extra Class for ClusteredDNADamage
+//
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class publishes the live status of a run as JSON lines on a local Unix-domain socket, from an
+// aggregation thread of the master.
+//**************************************************************************************************
+
+#include "StatusStreamPublisher.hh"
+
+#include "G4AutoLock.hh"
+#include "G4ios.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // SO_NOSIGPIPE is set on the client sockets instead
+#endif
+
+static const char* kQuantityNames[StatusStreamPublisher::kNumQuantities] = {"SSB", "DSB", "BD", "ComplexDSB",
+                                                                            "NonDSBCluster"};
+
+//--------------------------------------------------------------------------------------------------
+// Registry of publishers, indexed by scorer name. The scorers of all threads are constructed
+// concurrently, so the registry is locked. The publishers are deleted with the registry at exit,
+// after the scorers of all threads that point to them.
+//--------------------------------------------------------------------------------------------------
+static G4Mutex registryMutex = G4MUTEX_INITIALIZER;
+
+std::map<G4String, std::unique_ptr<StatusStreamPublisher>>& StatusStreamPublisher::GetRegistry()
+{
+    static std::map<G4String, std::unique_ptr<StatusStreamPublisher>> registry;
+    return registry;
+}
+
+StatusStreamPublisher* StatusStreamPublisher::GetInstance(const G4String& scorerName)
+{
+    G4AutoLock lock(&registryMutex);
+    std::unique_ptr<StatusStreamPublisher>& publisher = GetRegistry()[scorerName];
+    if (!publisher)
+        publisher.reset(new StatusStreamPublisher(scorerName));
+    return publisher.get();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Wall-clock time (s) on a monotonic clock
+//--------------------------------------------------------------------------------------------------
+static G4double GetWallTime()
+{
+    return std::chrono::duration<G4double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Constructor
+//--------------------------------------------------------------------------------------------------
+StatusStreamPublisher::StatusStreamPublisher(const G4String& scorerName)
+    : fScorerName(scorerName), fInterval(1.), fEnergyToDose(0.), fDoseThreshold(0.), fNumNuclei(1), fNumEvents(0),
+      fEdep(0.), fHasEstimate(false), fEstimateNumEvents(0), fEstimateDose(0.), fListenDescriptor(-1), fRunID(0),
+      fRunStartTime(GetWallTime()), fLastPublishTime(fRunStartTime), fLastNumEvents(0), fStopRequested(false)
+{
+    for (G4int q=0; q<kNumQuantities; ++q) {
+        fDamage[q] = 0;
+        fEstimateYields[q] = 0.;
+        fEstimateHalfWidths[q] = 0.;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Destructor
+//--------------------------------------------------------------------------------------------------
+StatusStreamPublisher::~StatusStreamPublisher()
+{
+    Close();
+}
+
+//--------------------------------------------------------------------------------------------------
+// The socket is non-blocking, so the aggregation thread accepts the pending clients at each record
+// without waiting for new ones. A socket file left by an earlier session is replaced, but any other
+// file at socketPath is kept & reported.
+//--------------------------------------------------------------------------------------------------
+G4bool StatusStreamPublisher::Open(const G4String& socketPath, G4double interval, G4double energyToDose,
+                                   G4double doseThreshold, G4int numNuclei)
+{
+    if (fListenDescriptor >= 0) return true;
+
+    fSocketPath = socketPath;
+    fInterval = interval;
+    fEnergyToDose = energyToDose;
+    fDoseThreshold = doseThreshold;
+    fNumNuclei = numNuclei;
+
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        G4cerr << "Status stream: socket path " << socketPath << " is longer than "
+               << sizeof(address.sun_path)-1 << " characters." << G4endl;
+        return false;
+    }
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path)-1);
+
+    struct stat status;
+    if (lstat(socketPath.c_str(), &status) == 0) {
+        if (!S_ISSOCK(status.st_mode)) {
+            G4cerr << "Status stream: " << socketPath << " exists & is not a socket." << G4endl;
+            return false;
+        }
+        unlink(socketPath.c_str());
+    }
+
+    fListenDescriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fListenDescriptor < 0
+        || bind(fListenDescriptor, (sockaddr*)&address, sizeof(address)) != 0
+        || listen(fListenDescriptor, 16) != 0
+        || fcntl(fListenDescriptor, F_SETFL, fcntl(fListenDescriptor, F_GETFL) | O_NONBLOCK) != 0) {
+        G4cerr << "Status stream: cannot create socket " << socketPath << " (" << std::strerror(errno) << ")."
+               << G4endl;
+        if (fListenDescriptor >= 0) close(fListenDescriptor);
+        fListenDescriptor = -1;
+        return false;
+    }
+
+    fRunStartTime = GetWallTime();
+    fLastPublishTime = fRunStartTime;
+    fStopRequested = false;
+    fThread = std::thread(&StatusStreamPublisher::Run, this);
+    return true;
+}
+
+void StatusStreamPublisher::Close()
+{
+    if (fThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(fStopMutex);
+            fStopRequested = true;
+        }
+        fStopCondition.notify_all();
+        fThread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(fPublishMutex);
+    for (size_t c=0; c<fClients.size(); ++c)
+        close(fClients[c].descriptor);
+    fClients.clear();
+    if (fListenDescriptor >= 0) {
+        close(fListenDescriptor);
+        unlink(fSocketPath.c_str());
+        fListenDescriptor = -1;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Counters. There is no atomic addition of doubles in C++11, so the energy is added by
+// compare-and-swap; contention is limited to one addition per event & thread.
+//--------------------------------------------------------------------------------------------------
+void StatusStreamPublisher::AddEvent(G4double edep)
+{
+    fNumEvents.fetch_add(1, std::memory_order_relaxed);
+    G4double total = fEdep.load(std::memory_order_relaxed);
+    while (!fEdep.compare_exchange_weak(total, total + edep, std::memory_order_relaxed)) {}
+}
+
+void StatusStreamPublisher::AddDamage(const G4int counts[kNumQuantities])
+{
+    for (G4int q=0; q<kNumQuantities; ++q)
+        fDamage[q].fetch_add(counts[q], std::memory_order_relaxed);
+}
+
+void StatusStreamPublisher::SetYieldEstimate(G4int numEvents, G4double dose, const G4double yields[kNumQuantities],
+                                             const G4double halfWidths[kNumQuantities])
+{
+    std::unique_lock<std::mutex> lock(fEstimateMutex, std::try_to_lock);
+    if (!lock.owns_lock()) return;
+
+    fHasEstimate = true;
+    fEstimateNumEvents = numEvents;
+    fEstimateDose = dose;
+    for (G4int q=0; q<kNumQuantities; ++q) {
+        fEstimateYields[q] = yields[q];
+        fEstimateHalfWidths[q] = halfWidths[q];
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// The workers are idle at the end of the run, so the counters can be reset
+//--------------------------------------------------------------------------------------------------
+void StatusStreamPublisher::EndRun()
+{
+    if (fListenDescriptor < 0) return;
+
+    std::lock_guard<std::mutex> lock(fPublishMutex);
+    AcceptClients();
+    Publish("end_of_run");
+
+    fNumEvents = 0;
+    fEdep = 0.;
+    for (G4int q=0; q<kNumQuantities; ++q)
+        fDamage[q] = 0;
+    {
+        std::lock_guard<std::mutex> estimateLock(fEstimateMutex);
+        fHasEstimate = false;
+    }
+    fRunID++;
+    fRunStartTime = GetWallTime();
+    fLastPublishTime = fRunStartTime;
+    fLastNumEvents = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Aggregation thread: one record per interval until Close()
+//--------------------------------------------------------------------------------------------------
+void StatusStreamPublisher::Run()
+{
+    std::unique_lock<std::mutex> stopLock(fStopMutex);
+    while (!fStopCondition.wait_for(stopLock, std::chrono::duration<G4double>(fInterval),
+                                    [this] {return fStopRequested;})) {
+        std::lock_guard<std::mutex> lock(fPublishMutex);
+        AcceptClients();
+        if (!fClients.empty())
+            Publish("running");
+    }
+}
+
+void StatusStreamPublisher::AcceptClients()
+{
+    G4int client;
+    while ((client = accept(fListenDescriptor, NULL, NULL)) >= 0) {
+#ifdef SO_NOSIGPIPE
+        G4int noSigPipe = 1;
+        setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+        fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+        Client newClient;
+        newClient.descriptor = client;
+        fClients.push_back(newClient);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Format one record & send it to every client. The part of the previous record that did not fit in
+// the socket buffer of a client is sent first; a client that has not read it since the previous
+// record (or that has disconnected) is dropped, so records are never interleaved or truncated.
+//--------------------------------------------------------------------------------------------------
+void StatusStreamPublisher::Publish(const char* state)
+{
+    G4double now = GetWallTime();
+    std::int64_t numEvents = fNumEvents.load(std::memory_order_relaxed);
+    G4double dose = fEdep.load(std::memory_order_relaxed)*fEnergyToDose;
+    G4double eventRate = (now > fLastPublishTime) ? (numEvents - fLastNumEvents)/(now - fLastPublishTime) : 0.;
+    fLastPublishTime = now;
+    fLastNumEvents = numEvents;
+
+    std::ostringstream record;
+    record.precision(6);
+    record << "{\"scorer\":\"" << fScorerName << "\",\"run\":" << fRunID << ",\"state\":\"" << state << "\""
+           << ",\"elapsed_s\":" << now - fRunStartTime << ",\"events\":" << numEvents
+           << ",\"events_per_s\":" << eventRate << ",\"dose_Gy\":" << dose/gray
+           << ",\"dose_threshold_Gy\":" << fDoseThreshold/gray;
+    for (G4int q=0; q<kNumQuantities; ++q) {
+        std::int64_t count = fDamage[q].load(std::memory_order_relaxed);
+        record << ",\"" << kQuantityNames[q] << "\":" << count
+               << ",\"" << kQuantityNames[q] << "_per_Gy\":" << (dose > 0. ? count/(dose/gray)/fNumNuclei : 0.);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(fEstimateMutex);
+        if (fHasEstimate) {
+            record << ",\"estimate\":{\"events\":" << fEstimateNumEvents << ",\"dose_Gy\":" << fEstimateDose/gray;
+            for (G4int q=0; q<kNumQuantities; ++q)
+                record << ",\"" << kQuantityNames[q] << "_per_Gy\":[" << fEstimateYields[q] << ","
+                       << fEstimateHalfWidths[q] << "]";
+            record << "}";
+        }
+    }
+    record << "}\n";
+
+    const std::string line = record.str();
+    for (size_t c=0; c<fClients.size();) {
+        Client& client = fClients[c];
+        G4bool isConnected = true;
+        if (!client.pending.empty()) {
+            std::string pending;
+            pending.swap(client.pending);
+            isConnected = Send(client, pending) && client.pending.empty();
+        }
+        if (isConnected && Send(client, line)) {
+            ++c;
+            continue;
+        }
+        close(client.descriptor);
+        fClients.erase(fClients.begin() + c);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Send data to a client without blocking, keeping in client.pending what does not fit in its socket
+// buffer. Return false if the client has disconnected.
+//--------------------------------------------------------------------------------------------------
+G4bool StatusStreamPublisher::Send(Client& client, const std::string& data)
+{
+    size_t offset = 0;
+    while (offset < data.size()) {
+        ssize_t sent = send(client.descriptor, data.c_str() + offset, data.size() - offset, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent > 0) {
+            offset += sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            client.pending.assign(data, offset, std::string::npos);
+            return true;
+        }
+        return false;
+    }
+    return true;
+}
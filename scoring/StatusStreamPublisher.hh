@@ -0,0 +1,145 @@
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class publishes the live status of a run (events, delivered dose, event rate & provisional
+// damage yields) as JSON lines on a local Unix-domain socket, for dashboards monitoring long runs.
+// Any number of clients may connect to the socket (e.g. tools/status_client.py); each receives one
+// record per interval from the time it connects, and a final record at the end of each run.
+//
+// One publisher is kept per scorer name, shared by the scorers of all threads. Worker threads only
+// add to atomic counters at the end of their events, so they never wait for the publisher. The
+// records are formatted & sent by an aggregation thread owned by the master, with non-blocking
+// sends: the part of a record that does not fit in the socket buffer of a client is sent before the
+// next record, & a client that has still not read it by then is disconnected.
+//
+// Record fields: scorer, run, state ("running" or "end_of_run"), elapsed_s (since the start of the
+// run), events, events_per_s (over the last interval), dose_Gy, dose_threshold_Gy (0 if none), the
+// damage recorded so far (SSB, DSB, BD, ComplexDSB, NonDSBCluster) & per Gy & nucleus, and, if the
+// scorer estimates yields during the run, the latest estimate (yield per Gy & 95% half-width of each
+// quantity).
+//**************************************************************************************************
+
+#ifndef StatusStreamPublisher_hh
+#define StatusStreamPublisher_hh
+
+#include "G4String.hh"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class StatusStreamPublisher
+{
+public:
+    // Damage quantities of the records
+    static const G4int kSSB = 0;
+    static const G4int kDSB = 1;
+    static const G4int kBD = 2;
+    static const G4int kComplexDSB = 3;
+    static const G4int kNonDSBCluster = 4;
+    static const G4int kNumQuantities = 5;
+
+    //----------------------------------------------------------------------------------------------
+    // Return the publisher of the given scorer, creating it if needed. The registry owns the
+    // publishers, which are destroyed at exit, so the returned pointer remains valid for the whole
+    // session.
+    //----------------------------------------------------------------------------------------------
+    static StatusStreamPublisher* GetInstance(const G4String& scorerName);
+
+    //----------------------------------------------------------------------------------------------
+    // Create the socket at socketPath (replacing a stale socket) & start the aggregation thread,
+    // which publishes a record every interval (s). energyToDose converts the energy deposited in the
+    // scored component to dose; yields are per Gy & per nucleus. Return false if the socket cannot be
+    // created. Called by the master.
+    //----------------------------------------------------------------------------------------------
+    G4bool Open(const G4String& socketPath, G4double interval, G4double energyToDose, G4double doseThreshold,
+                G4int numNuclei);
+
+    //----------------------------------------------------------------------------------------------
+    // Stop the aggregation thread, disconnect the clients & remove the socket
+    //----------------------------------------------------------------------------------------------
+    void Close();
+
+    //----------------------------------------------------------------------------------------------
+    // Counters, updated by any thread without locking
+    //----------------------------------------------------------------------------------------------
+    void AddEvent(G4double edep);
+    void AddDamage(const G4int counts[kNumQuantities]);
+
+    //----------------------------------------------------------------------------------------------
+    // Latest provisional yields per Gy & their 95% half-widths, estimated after the given number of
+    // events & dose. Dropped if a record is being formatted at the same time (the next estimate
+    // replaces it anyway).
+    //----------------------------------------------------------------------------------------------
+    void SetYieldEstimate(G4int numEvents, G4double dose, const G4double yields[kNumQuantities],
+                          const G4double halfWidths[kNumQuantities]);
+
+    //----------------------------------------------------------------------------------------------
+    // Publish the final record of the run & reset the counters for the next run. Called by the
+    // master once the damage of the run has been recorded.
+    //----------------------------------------------------------------------------------------------
+    void EndRun();
+
+private:
+    explicit StatusStreamPublisher(const G4String& scorerName);
+
+    ~StatusStreamPublisher();
+    friend struct std::default_delete<StatusStreamPublisher>;
+
+    static std::map<G4String, std::unique_ptr<StatusStreamPublisher>>& GetRegistry();
+
+    // A connected client & the end of the last record, if it did not fit in its socket buffer
+    struct Client
+    {
+        G4int descriptor;
+        std::string pending;
+    };
+
+    void Run();
+    void AcceptClients();
+    void Publish(const char* state);
+    static G4bool Send(Client& client, const std::string& data);
+
+    G4String fScorerName;
+    G4String fSocketPath;
+    G4double fInterval; // s
+    G4double fEnergyToDose;
+    G4double fDoseThreshold;
+    G4int fNumNuclei;
+
+    // Counters of the current run
+    std::atomic<std::int64_t> fNumEvents;
+    std::atomic<G4double> fEdep;
+    std::atomic<std::int64_t> fDamage[kNumQuantities];
+
+    // Latest yield estimate, guarded by fEstimateMutex
+    std::mutex fEstimateMutex;
+    G4bool fHasEstimate;
+    G4int fEstimateNumEvents;
+    G4double fEstimateDose;
+    G4double fEstimateYields[kNumQuantities];
+    G4double fEstimateHalfWidths[kNumQuantities];
+
+    // Socket & clients, guarded by fPublishMutex (aggregation thread & EndRun() only)
+    std::mutex fPublishMutex;
+    G4int fListenDescriptor;
+    std::vector<Client> fClients;
+    G4int fRunID;
+    G4double fRunStartTime;
+    G4double fLastPublishTime;
+    std::int64_t fLastNumEvents;
+
+    // Aggregation thread
+    std::thread fThread;
+    std::mutex fStopMutex;
+    std::condition_variable fStopCondition;
+    G4bool fStopRequested;
+};
+
+#endif
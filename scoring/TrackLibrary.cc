@@ -0,0 +1,258 @@
+// Extra Class for ClusteredDNADamage
+//
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class holds a library of precomputed track structures (energy deposits & initial species
+// relative to the vertex of the primary), recorded in homogeneous water & reused by the scorer.
+//**************************************************************************************************
+
+#include "TrackLibrary.hh"
+
+#include "G4AutoLock.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char kFileMagic[8] = {'D','N','A','T','R','L','I','B'};
+static const std::int32_t kFileVersion = 1;
+
+//--------------------------------------------------------------------------------------------------
+// Libraries loaded so far, by file name. Scorers of all threads load their libraries when they are
+// constructed, so loading is serialized.
+//--------------------------------------------------------------------------------------------------
+static G4Mutex libraryMutex = G4MUTEX_INITIALIZER;
+static std::map<G4String, TrackLibrary*> loadedLibraries;
+
+//--------------------------------------------------------------------------------------------------
+// Total size in bytes of the arrays following the species names
+//--------------------------------------------------------------------------------------------------
+static size_t GetArraysSize(std::int64_t numTracks, std::int64_t numDeposits, std::int64_t numSpecies)
+{
+    return numTracks*sizeof(G4double) + 2*(numTracks+1)*sizeof(std::int64_t)
+           + numDeposits*sizeof(TrackLibrary::Deposit) + numSpecies*sizeof(TrackLibrary::Species);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Constructor
+//--------------------------------------------------------------------------------------------------
+TrackLibrary::TrackLibrary()
+    : fNumTracks(0), fData(NULL), fSize(0), fPrimaryEnergies(NULL), fDepositStart(NULL),
+      fSpeciesStart(NULL), fDeposits(NULL), fSpecies(NULL)
+{
+    fRecordedDepositStart.push_back(0);
+    fRecordedSpeciesStart.push_back(0);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Destructor
+//--------------------------------------------------------------------------------------------------
+TrackLibrary::~TrackLibrary()
+{
+    if (fData) munmap((void*)fData, fSize);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Return the library of a file, mapping it on first use
+//--------------------------------------------------------------------------------------------------
+const TrackLibrary* TrackLibrary::Load(const G4String& fileName)
+{
+    G4AutoLock lock(&libraryMutex);
+    std::map<G4String, TrackLibrary*>::iterator it = loadedLibraries.find(fileName);
+    if (it != loadedLibraries.end()) return it->second;
+
+    TrackLibrary* library = new TrackLibrary();
+    if (!library->Open(fileName)) {
+        delete library;
+        return NULL;
+    }
+    loadedLibraries[fileName] = library;
+    return library;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Map the file read-only & set the views on its arrays
+//--------------------------------------------------------------------------------------------------
+G4bool TrackLibrary::Open(const G4String& fileName)
+{
+    G4int descriptor = open(fileName.c_str(), O_RDONLY);
+    if (descriptor < 0) return false;
+
+    struct stat fileStatus;
+    if (fstat(descriptor, &fileStatus) != 0 || (size_t)fileStatus.st_size < sizeof(Header)) {
+        close(descriptor);
+        return false;
+    }
+
+    void* data = mmap(NULL, fileStatus.st_size, PROT_READ, MAP_SHARED, descriptor, 0);
+    close(descriptor); // the mapping remains valid
+    if (data == MAP_FAILED) return false;
+
+    fData = (const char*)data;
+    fSize = fileStatus.st_size;
+
+    const Header* header = (const Header*)fData;
+    if (std::memcmp(header->magic, kFileMagic, sizeof(kFileMagic)) != 0
+        || header->version != kFileVersion
+        || header->namesLength < 0 || header->namesLength % 8 != 0
+        || header->numTracks < 0 || header->numDeposits < 0 || header->numSpecies < 0
+        || fSize != sizeof(Header) + header->namesLength
+                    + GetArraysSize(header->numTracks, header->numDeposits, header->numSpecies)) {
+        munmap((void*)fData, fSize);
+        fData = NULL;
+        fSize = 0;
+        return false;
+    }
+
+    // Species names, null-terminated
+    const char* names = fData + sizeof(Header);
+    const char* namesEnd = names + header->namesLength;
+    while (names < namesEnd && *names != '\0') {
+        fSpeciesNames.push_back(G4String(names));
+        names += std::strlen(names) + 1;
+    }
+
+    fNumTracks = (G4int)header->numTracks;
+    fPrimaryEnergies = (const G4double*)namesEnd;
+    fDepositStart = (const std::int64_t*)(fPrimaryEnergies + fNumTracks);
+    fSpeciesStart = fDepositStart + fNumTracks + 1;
+    fDeposits = (const Deposit*)(fSpeciesStart + fNumTracks + 1);
+    fSpecies = (const Species*)(fDeposits + header->numDeposits);
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Recording of the open track
+//--------------------------------------------------------------------------------------------------
+void TrackLibrary::AddDeposit(const G4ThreeVector& position, G4double edep)
+{
+    fOpenDepositPositions.push_back(position);
+    fOpenDepositEdeps.push_back(edep);
+}
+
+void TrackLibrary::AddSpecies(const G4String& name, const G4ThreeVector& position)
+{
+    fOpenSpeciesPositions.push_back(position);
+    fOpenSpeciesNames.push_back(GetSpeciesNameIndex(name));
+}
+
+G4int TrackLibrary::GetSpeciesNameIndex(const G4String& name)
+{
+    std::map<G4String, G4int>::iterator it = fSpeciesNameIndices.find(name);
+    if (it != fSpeciesNameIndices.end()) return it->second;
+
+    G4int nameIndex = (G4int)fSpeciesNames.size();
+    fSpeciesNames.push_back(name);
+    fSpeciesNameIndices[name] = nameIndex;
+    return nameIndex;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Close the open track: positions are made relative to the vertex of the primary & converted to nm
+//--------------------------------------------------------------------------------------------------
+void TrackLibrary::EndTrack(const G4ThreeVector& vertex, G4double primaryEnergy)
+{
+    for (size_t i=0; i<fOpenDepositPositions.size(); ++i) {
+        G4ThreeVector position = (fOpenDepositPositions[i] - vertex)/nm;
+        Deposit deposit = {(float)position.x(), (float)position.y(), (float)position.z(),
+                           (float)(fOpenDepositEdeps[i]/eV)};
+        fRecordedDeposits.push_back(deposit);
+    }
+    for (size_t i=0; i<fOpenSpeciesPositions.size(); ++i) {
+        G4ThreeVector position = (fOpenSpeciesPositions[i] - vertex)/nm;
+        Species species = {fOpenSpeciesNames[i], (float)position.x(), (float)position.y(), (float)position.z()};
+        fRecordedSpecies.push_back(species);
+    }
+
+    fRecordedPrimaryEnergies.push_back(primaryEnergy/MeV);
+    fNumTracks++;
+    fRecordedDepositStart.push_back((std::int64_t)fRecordedDeposits.size());
+    fRecordedSpeciesStart.push_back((std::int64_t)fRecordedSpecies.size());
+
+    fOpenDepositPositions.clear();
+    fOpenDepositEdeps.clear();
+    fOpenSpeciesPositions.clear();
+    fOpenSpeciesNames.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Append the closed tracks of another recorded library. Species names are re-indexed, since each
+// library numbers them in the order they were first recorded.
+//--------------------------------------------------------------------------------------------------
+void TrackLibrary::Absorb(TrackLibrary& other)
+{
+    std::int64_t depositOffset = (std::int64_t)fRecordedDeposits.size();
+    std::int64_t speciesOffset = (std::int64_t)fRecordedSpecies.size();
+
+    fRecordedPrimaryEnergies.insert(fRecordedPrimaryEnergies.end(), other.fRecordedPrimaryEnergies.begin(),
+                                    other.fRecordedPrimaryEnergies.end());
+    for (size_t i=1; i<other.fRecordedDepositStart.size(); ++i) {
+        fRecordedDepositStart.push_back(other.fRecordedDepositStart[i] + depositOffset);
+        fRecordedSpeciesStart.push_back(other.fRecordedSpeciesStart[i] + speciesOffset);
+    }
+    fRecordedDeposits.insert(fRecordedDeposits.end(), other.fRecordedDeposits.begin(), other.fRecordedDeposits.end());
+    for (size_t i=0; i<other.fRecordedSpecies.size(); ++i) {
+        Species species = other.fRecordedSpecies[i];
+        species.nameIndex = GetSpeciesNameIndex(other.fSpeciesNames[species.nameIndex]);
+        fRecordedSpecies.push_back(species);
+    }
+
+    fNumTracks += other.fNumTracks;
+
+    // The open track of the other library (if any) is kept
+    other.fNumTracks = 0;
+    other.fRecordedPrimaryEnergies.clear();
+    other.fRecordedDepositStart.assign(1, 0);
+    other.fRecordedSpeciesStart.assign(1, 0);
+    other.fRecordedDeposits.clear();
+    other.fRecordedSpecies.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Write the closed tracks. The data is written to a temporary file in the same directory, which is
+// then renamed, so processes that have mapped an older version of the file keep a valid mapping.
+//--------------------------------------------------------------------------------------------------
+G4bool TrackLibrary::Write(const G4String& fileName) const
+{
+    std::vector<char> names;
+    for (size_t i=0; i<fSpeciesNames.size(); ++i)
+        names.insert(names.end(), fSpeciesNames[i].c_str(), fSpeciesNames[i].c_str() + fSpeciesNames[i].size() + 1);
+    names.resize((names.size() + 7)/8*8, '\0');
+
+    Header header;
+    std::memcpy(header.magic, kFileMagic, sizeof(kFileMagic));
+    header.version = kFileVersion;
+    header.namesLength = (std::int32_t)names.size();
+    header.numTracks = (std::int64_t)fRecordedPrimaryEnergies.size();
+    header.numDeposits = (std::int64_t)fRecordedDeposits.size();
+    header.numSpecies = (std::int64_t)fRecordedSpecies.size();
+
+    std::ostringstream tempName;
+    tempName << fileName << ".tmp." << getpid();
+
+    std::ofstream file(tempName.str().c_str(), std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+
+    file.write((const char*)&header, sizeof(Header));
+    file.write(names.data(), names.size());
+    file.write((const char*)fRecordedPrimaryEnergies.data(), fRecordedPrimaryEnergies.size()*sizeof(G4double));
+    file.write((const char*)fRecordedDepositStart.data(), fRecordedDepositStart.size()*sizeof(std::int64_t));
+    file.write((const char*)fRecordedSpeciesStart.data(), fRecordedSpeciesStart.size()*sizeof(std::int64_t));
+    file.write((const char*)fRecordedDeposits.data(), fRecordedDeposits.size()*sizeof(Deposit));
+    file.write((const char*)fRecordedSpecies.data(), fRecordedSpecies.size()*sizeof(Species));
+    file.close();
+
+    if (!file || std::rename(tempName.str().c_str(), fileName.c_str()) != 0) {
+        std::remove(tempName.str().c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,142 @@
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class holds a library of precomputed track structures: for each primary particle, the points
+// where energy was deposited (and optionally the initial positions of the radiolytic species),
+// relative to the vertex of the primary. A library is recorded once in homogeneous water, then
+// reused by ScoreClusteredDNADamage, which scores randomly rotated & translated copies of its tracks
+// against the DNA geometry instead of transporting new particles (one library per energy bin of a
+// spectrum).
+//
+// Points are stored in single precision (nm & eV), which is exact to well below the size of a
+// residue over the range of a low-energy electron. Layout of a file: a header, the names of the
+// species (null-terminated, padded to a multiple of 8 bytes), the primary energy of each track, the
+// index of the first deposit & first species of each track, then all deposits & all species.
+//
+// Libraries are memory-mapped read-only and shared by the scorers of all threads, so many TOPAS
+// processes running on one node also share the pages of a single copy.
+//**************************************************************************************************
+
+#ifndef TrackLibrary_hh
+#define TrackLibrary_hh
+
+#include "G4ThreeVector.hh"
+#include "G4String.hh"
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+class TrackLibrary
+{
+public:
+    //----------------------------------------------------------------------------------------------
+    // Energy deposit (position in nm, energy in eV) & initial species (index of its name, position
+    // in nm), relative to the vertex of the primary
+    //----------------------------------------------------------------------------------------------
+    struct Deposit
+    {
+        float x, y, z;
+        float edep;
+    };
+
+    struct Species
+    {
+        std::int32_t nameIndex;
+        float x, y, z;
+    };
+
+    //----------------------------------------------------------------------------------------------
+    // Constructor of an empty library, to be recorded
+    //----------------------------------------------------------------------------------------------
+    TrackLibrary();
+
+    ~TrackLibrary();
+
+    //----------------------------------------------------------------------------------------------
+    // Return the library stored in a file, mapping it on first use. Libraries are kept for the
+    // whole session & may be used by all threads. Return NULL if the file does not exist or is not a
+    // valid library.
+    //----------------------------------------------------------------------------------------------
+    static const TrackLibrary* Load(const G4String& fileName);
+
+    //----------------------------------------------------------------------------------------------
+    // Recording. Deposits & species (absolute positions) are added to the current track, which is
+    // closed by EndTrack() once the vertex & energy of its primary are known.
+    //----------------------------------------------------------------------------------------------
+    void AddDeposit(const G4ThreeVector& position, G4double edep);
+    void AddSpecies(const G4String& name, const G4ThreeVector& position);
+    void EndTrack(const G4ThreeVector& vertex, G4double primaryEnergy);
+
+    //----------------------------------------------------------------------------------------------
+    // Append the closed tracks of another recorded library & clear them from it
+    //----------------------------------------------------------------------------------------------
+    void Absorb(TrackLibrary& other);
+
+    //----------------------------------------------------------------------------------------------
+    // Write the closed tracks of a recorded library. Return false if the file could not be written.
+    //----------------------------------------------------------------------------------------------
+    G4bool Write(const G4String& fileName) const;
+
+    //----------------------------------------------------------------------------------------------
+    // Number of tracks (closed tracks, if recording)
+    //----------------------------------------------------------------------------------------------
+    G4int GetNumberOfTracks() const {return fNumTracks;}
+
+    //----------------------------------------------------------------------------------------------
+    // Getters of a loaded library. Deposits of track i are [GetFirstDeposit(i), GetFirstDeposit(i+1)),
+    // and likewise for species.
+    //----------------------------------------------------------------------------------------------
+    G4double GetPrimaryEnergy(G4int track) const {return fPrimaryEnergies[track];}
+    std::int64_t GetFirstDeposit(G4int track) const {return fDepositStart[track];}
+    std::int64_t GetFirstSpecies(G4int track) const {return fSpeciesStart[track];}
+    const Deposit& GetDeposit(std::int64_t i) const {return fDeposits[i];}
+    const Species& GetSpecies(std::int64_t i) const {return fSpecies[i];}
+    const G4String& GetSpeciesName(G4int nameIndex) const {return fSpeciesNames[nameIndex];}
+
+private:
+    struct Header
+    {
+        char magic[8];
+        std::int32_t version;
+        std::int32_t namesLength; // bytes, padded to a multiple of 8
+        std::int64_t numTracks;
+        std::int64_t numDeposits;
+        std::int64_t numSpecies;
+    };
+
+    //----------------------------------------------------------------------------------------------
+    // Map a file read-only. Return false (and leave nothing mapped) if it is not a valid library.
+    //----------------------------------------------------------------------------------------------
+    G4bool Open(const G4String& fileName);
+
+    G4int fNumTracks;
+
+    // Mapped file & views on its arrays (loaded library)
+    const char* fData;
+    size_t fSize;
+    const G4double* fPrimaryEnergies; // MeV
+    const std::int64_t* fDepositStart;
+    const std::int64_t* fSpeciesStart;
+    const Deposit* fDeposits;
+    const Species* fSpecies;
+    std::vector<G4String> fSpeciesNames;
+
+    // Closed tracks (recorded library)
+    std::vector<G4double> fRecordedPrimaryEnergies;
+    std::vector<std::int64_t> fRecordedDepositStart;
+    std::vector<std::int64_t> fRecordedSpeciesStart;
+    std::vector<Deposit> fRecordedDeposits;
+    std::vector<Species> fRecordedSpecies;
+    std::map<G4String, G4int> fSpeciesNameIndices;
+
+    // Absolute positions of the open track, made relative to the vertex by EndTrack()
+    std::vector<G4ThreeVector> fOpenDepositPositions;
+    std::vector<G4double> fOpenDepositEdeps;
+    std::vector<G4ThreeVector> fOpenSpeciesPositions;
+    std::vector<G4int> fOpenSpeciesNames;
+
+    G4int GetSpeciesNameIndex(const G4String& name);
+};
+
+#endif
@@ -0,0 +1,160 @@
+// Extra Class for ClusteredDNADamage
+//
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class gives every physical track of an event a one-byte tag (particle class, creator process
+// class & generation), computed when the track starts from its own properties & the tag of its
+// parent.
+//**************************************************************************************************
+
+#include "TrackTagger.hh"
+
+#include "G4EventManager.hh"
+#include "G4Track.hh"
+#include "G4ParticleDefinition.hh"
+#include "G4VProcess.hh"
+
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------------------
+// Constructor
+//--------------------------------------------------------------------------------------------------
+TrackTagger::TrackTagger()
+    : fWrappedAction(NULL), fIsInstalled(false)
+{}
+
+//--------------------------------------------------------------------------------------------------
+// Destructor. Restore the wrapped tracking action if this tagger is still installed.
+//--------------------------------------------------------------------------------------------------
+TrackTagger::~TrackTagger()
+{
+    G4EventManager* eventManager = G4EventManager::GetEventManager();
+    if (fIsInstalled && eventManager && eventManager->GetUserTrackingAction() == this)
+        eventManager->SetUserAction(fWrappedAction);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Install in the event manager of the current thread.
+//--------------------------------------------------------------------------------------------------
+void TrackTagger::Install()
+{
+    G4EventManager* eventManager = G4EventManager::GetEventManager();
+    if (!eventManager || eventManager->GetUserTrackingAction() == this) return;
+
+    fWrappedAction = eventManager->GetUserTrackingAction();
+    eventManager->SetUserAction(this);
+    fIsInstalled = true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Tag the track. Its parent has already started, so its tag is in the table (unless the parent
+// started before the tagger was installed).
+//--------------------------------------------------------------------------------------------------
+void TrackTagger::PreUserTrackingAction(const G4Track* track)
+{
+    G4int trackID = track->GetTrackID();
+    if (trackID > 0) {
+        if (trackID >= (G4int)fTags.size()) {
+            fTags.resize(std::max((size_t)trackID+1, 2*fTags.size()), 0);
+            fIsTagged.resize(fTags.size(), false);
+        }
+
+        G4int parentID = track->GetParentID();
+        Tag parentTag = 0;
+        if (parentID > 0 && parentID < (G4int)fTags.size() && fIsTagged[parentID])
+            parentTag = fTags[parentID];
+
+        fTags[trackID] = ComputeTag(track, parentTag);
+        fIsTagged[trackID] = true;
+    }
+
+    if (fWrappedAction) fWrappedAction->PreUserTrackingAction(track);
+}
+
+void TrackTagger::PostUserTrackingAction(const G4Track* track)
+{
+    if (fWrappedAction) fWrappedAction->PostUserTrackingAction(track);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Tag of a physical track of the current event
+//--------------------------------------------------------------------------------------------------
+TrackTagger::Tag TrackTagger::GetTag(const G4Track* track) const
+{
+    G4int trackID = track->GetTrackID();
+    if (trackID > 0 && trackID < (G4int)fTags.size() && fIsTagged[trackID])
+        return fTags[trackID];
+    return ComputeTag(track, 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Forget the tags of the current event. The table keeps its capacity.
+//--------------------------------------------------------------------------------------------------
+void TrackTagger::Clear()
+{
+    fIsTagged.assign(fIsTagged.size(), false);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Compose the tag of a track. Auger electrons are recognised by the name of the model that created
+// them, which Geant4 sets for the products of atomic de-excitation when Auger emission (&
+// AugerCascade) is enabled; otherwise they are counted as ionisation products.
+//--------------------------------------------------------------------------------------------------
+TrackTagger::Tag TrackTagger::ComputeTag(const G4Track* track, Tag parentTag)
+{
+    //----------------------------------------------------------------------------------------------
+    // Particle class
+    //----------------------------------------------------------------------------------------------
+    const G4ParticleDefinition* particle = track->GetParticleDefinition();
+    const G4String& particleName = particle->GetParticleName();
+    G4int pdgCode = particle->GetPDGEncoding();
+
+    G4int particleClass = kParticleOther;
+    if (pdgCode == 11)
+        particleClass = kParticleElectron;
+    else if (pdgCode == 22)
+        particleClass = kParticlePhoton;
+    else if (pdgCode == 2212 || particleName == "hydrogen")
+        particleClass = kParticleProton;
+    else if (particleName == "alpha" || particleName == "alpha+" || particleName == "helium")
+        particleClass = kParticleAlpha;
+    else if (particle->GetParticleType() == "nucleus")
+        particleClass = kParticleIon;
+
+    //----------------------------------------------------------------------------------------------
+    // Creator class & generation
+    //----------------------------------------------------------------------------------------------
+    G4int creatorClass = kCreatorPrimary;
+    G4int generation = 0;
+    if (track->GetParentID() > 0) {
+        generation = std::min(GetGeneration(parentTag)+1, kMaxGeneration);
+
+        const G4VProcess* creator = track->GetCreatorProcess();
+        if (track->GetCreatorModelName().contains("Auger"))
+            creatorClass = kCreatorAuger;
+        else if (creator && creator->GetProcessName().contains("Ioni")) // e.g. e-_G4DNAIonisation, hIoni
+            creatorClass = kCreatorIonisation;
+        else
+            creatorClass = kCreatorOther;
+    }
+
+    return (Tag)(particleClass | (creatorClass << 3) | (generation << 5));
+}
+
+//--------------------------------------------------------------------------------------------------
+// Names of the particle & creator classes, as written to the output files
+//--------------------------------------------------------------------------------------------------
+const char* TrackTagger::GetParticleClassName(G4int particleClass)
+{
+    static const char* names[kNumParticleClasses] = {"other", "electron", "proton", "alpha", "ion", "photon"};
+    if (particleClass < 0 || particleClass >= kNumParticleClasses) return "other";
+    return names[particleClass];
+}
+
+const char* TrackTagger::GetCreatorClassName(G4int creatorClass)
+{
+    static const char* names[4] = {"primary", "ionisation", "Auger", "other"};
+    if (creatorClass < 0 || creatorClass > kCreatorOther) return "other";
+    return names[creatorClass];
+}
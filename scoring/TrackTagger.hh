@@ -0,0 +1,105 @@
+//**************************************************************************************************
+// Author: Logan Montgomery
+//
+// This class gives every physical track of an event a one-byte tag describing where it comes from:
+// the class of particle, the class of process that created it (primary, ionisation, Auger cascade,
+// other) and its generation (0 for primaries, saturating at 7). ScoreClusteredDNADamage stores the
+// tag of the largest energy deposit in each damaged residue, so direct damage yields can be broken
+// down by dominant contributor (e.g. primary protons vs. delta electrons vs. Auger electrons).
+//
+// Tags are computed when a track starts, from its own particle & creator process and from the tag
+// of its parent, which always starts before it. They are kept in a table indexed by track ID rather
+// than in the track information, which Topas uses for its own purposes.
+//
+// The tagger is installed as the user tracking action of the event manager of the current thread.
+// Any tracking action installed before it is kept & receives all calls.
+//**************************************************************************************************
+
+#ifndef TrackTagger_hh
+#define TrackTagger_hh
+
+#include "G4UserTrackingAction.hh"
+
+#include <cstdint>
+#include <vector>
+
+class G4Track;
+
+class TrackTagger : public G4UserTrackingAction
+{
+public:
+    typedef std::uint8_t Tag;
+
+    // Particle classes (bits 0-2 of a tag)
+    static const G4int kParticleOther = 0;
+    static const G4int kParticleElectron = 1;
+    static const G4int kParticleProton = 2; // including neutral hydrogen of the Geant4-DNA models
+    static const G4int kParticleAlpha = 3; // including alpha+ & neutral helium
+    static const G4int kParticleIon = 4;
+    static const G4int kParticlePhoton = 5;
+    static const G4int kNumParticleClasses = 6;
+
+    // Creator classes (bits 3-4 of a tag)
+    static const G4int kCreatorPrimary = 0;
+    static const G4int kCreatorIonisation = 1; // delta rays & other ionisation products
+    static const G4int kCreatorAuger = 2; // atomic de-excitation (Auger cascade)
+    static const G4int kCreatorOther = 3;
+
+    // Generation (bits 5-7 of a tag)
+    static const G4int kMaxGeneration = 7;
+
+    static const G4int kNumTags = 256;
+
+    TrackTagger();
+    virtual ~TrackTagger();
+
+    //----------------------------------------------------------------------------------------------
+    // Install this tagger in the event manager of the current thread, wrapping the tracking action
+    // already installed (if any). Has no effect if already installed.
+    //----------------------------------------------------------------------------------------------
+    void Install();
+
+    //----------------------------------------------------------------------------------------------
+    // G4UserTrackingAction interface. PreUserTrackingAction() tags the track; all calls are
+    // forwarded to the wrapped tracking action.
+    //----------------------------------------------------------------------------------------------
+    virtual void PreUserTrackingAction(const G4Track* track);
+    virtual void PostUserTrackingAction(const G4Track* track);
+
+    //----------------------------------------------------------------------------------------------
+    // Tag of a physical track of the current event. Tracks that started before the tagger was
+    // installed are tagged from their own particle & creator process, as if their parent were a
+    // primary.
+    //----------------------------------------------------------------------------------------------
+    Tag GetTag(const G4Track* track) const;
+
+    //----------------------------------------------------------------------------------------------
+    // Forget the tags of the current event (track IDs are reused in the next event)
+    //----------------------------------------------------------------------------------------------
+    void Clear();
+
+    //----------------------------------------------------------------------------------------------
+    // Decode a tag
+    //----------------------------------------------------------------------------------------------
+    static G4int GetParticleClass(Tag tag) {return tag & 7;}
+    static G4int GetCreatorClass(Tag tag) {return (tag >> 3) & 3;}
+    static G4int GetGeneration(Tag tag) {return tag >> 5;}
+
+    static const char* GetParticleClassName(G4int particleClass);
+    static const char* GetCreatorClassName(G4int creatorClass);
+
+private:
+    //----------------------------------------------------------------------------------------------
+    // Tag of a track whose parent has the given tag
+    //----------------------------------------------------------------------------------------------
+    static Tag ComputeTag(const G4Track* track, Tag parentTag);
+
+    G4UserTrackingAction* fWrappedAction;
+    G4bool fIsInstalled;
+
+    // Tags of the tracks of the current event, indexed by track ID
+    std::vector<Tag> fTags;
+    std::vector<G4bool> fIsTagged;
+};
+
+#endif
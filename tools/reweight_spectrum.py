@@ -0,0 +1,205 @@
+#!/usr/bin/env python3
+"""
+Reweight the per-event tallies of one simulation to other primary energy spectra.
+
+All spectrum files (spectra/spectrum_*.txt) share the same energy grid (spectra/energy_bins.txt or
+spectra/xray_bins.txt) and differ only in their weights. A run made with a broad sampling spectrum
+and Sc/ClusterScorer/RecordEventTallies = "True" records the primary energy, energy deposited and
+damage yields of every event. The yields per Gy for any target spectrum q are then estimated by
+importance sampling, weighting each event by w = q(E)/p(E), where p is the sampling spectrum:
+
+    Y/D = sum(w * Y_i) / sum(w * D_i)
+
+The effective sample size, ESS = sum(w)^2 / sum(w^2), measures how many unweighted events the
+estimate is worth. Targets with a low ESS, or with weight in bins the sampling spectrum never
+populated, should be simulated directly.
+
+Example:
+    python3 tools/reweight_spectrum.py --tallies data_event_tallies.csv \\
+        --run-summary data_run_summary.csv --bins spectra/energy_bins.txt \\
+        --sampling spectra/spectrum_n10MeV_inner_proton.txt spectra/spectrum_n*_proton.txt
+"""
+
+import argparse
+import bisect
+import csv
+import math
+import os
+import sys
+
+EV_TO_JOULE = 1.602176634e-19
+UNITS_IN_MEV = {"eV": 1e-6, "keV": 1e-3, "MeV": 1.0, "GeV": 1e3}
+
+# Columns of the event tallies file (see ScoreClusteredDNADamage::OutputEventTalliesToFile)
+TALLY_COLUMNS = ["thread", "event", "primary_energy_MeV", "edep_eV",
+                 "SSB", "SSB_direct", "SSB_indirect",
+                 "DSB", "DSB_direct", "DSB_indirect", "DSB_hybrid",
+                 "BD", "BD_direct", "BD_indirect",
+                 "ComplexDSB", "NonDSBCluster"]
+YIELD_COLUMNS = TALLY_COLUMNS[4:]
+
+
+def read_topas_vector(file_name, parameter_suffix):
+    """Return the values of the TOPAS vector parameter ending in parameter_suffix, and its unit."""
+    with open(file_name) as f:
+        for line in f:
+            line = line.split("#")[0].strip()
+            if "=" not in line:
+                continue
+            name, value = line.split("=", 1)
+            if not name.strip().endswith(parameter_suffix):
+                continue
+            tokens = value.split()
+            count = int(tokens[0])
+            values = [float(v) for v in tokens[1:count + 1]]
+            unit = tokens[count + 1] if len(tokens) > count + 1 else None
+            if len(values) != count:
+                sys.exit("Error: %s in %s has %d values, expected %d" % (parameter_suffix, file_name, len(values), count))
+            return values, unit
+    sys.exit("Error: no parameter ending in %s found in %s" % (parameter_suffix, file_name))
+
+
+def read_energy_grid(file_name):
+    values, unit = read_topas_vector(file_name, "BeamEnergySpectrumValues")
+    if unit not in UNITS_IN_MEV:
+        sys.exit("Error: unknown energy unit %s in %s" % (unit, file_name))
+    return [v * UNITS_IN_MEV[unit] for v in values]
+
+
+def read_spectrum(file_name, num_bins):
+    """Return the normalised weights of a spectrum file, or of a flat spectrum if file_name is 'flat'."""
+    if file_name == "flat":
+        weights = [1.0] * num_bins
+    else:
+        weights, _ = read_topas_vector(file_name, "BeamEnergySpectrumWeights")
+        if len(weights) != num_bins:
+            sys.exit("Error: %s has %d weights but the energy grid has %d bins" % (file_name, len(weights), num_bins))
+    total = sum(weights)
+    if total <= 0:
+        sys.exit("Error: weights of %s sum to zero" % file_name)
+    return [w / total for w in weights]
+
+
+def read_tallies(file_name):
+    events = []
+    with open(file_name) as f:
+        for row in csv.reader(f):
+            if not row or row[0].startswith("#"):
+                continue
+            values = [float(v) for v in row]
+            events.append(dict(zip(TALLY_COLUMNS, values)))
+    if not events:
+        sys.exit("Error: no events in %s" % file_name)
+    return events
+
+
+def read_mass_kg(run_summary_file):
+    """Mass of the scored component, from the total dose & energy of the run summary file(s)."""
+    dose_gy = 0.0
+    energy_ev = 0.0
+    with open(run_summary_file) as f:
+        for row in csv.reader(f):
+            if not row or row[0].startswith("#"):
+                continue
+            dose_gy += float(row[1])
+            energy_ev += float(row[2])
+    if dose_gy <= 0:
+        sys.exit("Error: no dose recorded in %s" % run_summary_file)
+    return energy_ev * EV_TO_JOULE / dose_gy
+
+
+def assign_bins(events, grid):
+    """Index of the grid energy closest to the primary energy of each event."""
+    max_mismatch = 0.0
+    for event in events:
+        energy = event["primary_energy_MeV"]
+        i = bisect.bisect_left(grid, energy)
+        candidates = [j for j in (i - 1, i) if 0 <= j < len(grid)]
+        best = min(candidates, key=lambda j: abs(grid[j] - energy))
+        event["bin"] = best
+        max_mismatch = max(max_mismatch, abs(grid[best] - energy) / grid[best])
+    return max_mismatch
+
+
+def reweight(events, sampling, target, mass_kg):
+    """Return (results, ess, uncovered_fraction) for one target spectrum."""
+    uncovered = sum(q for p, q in zip(sampling, target) if p == 0.0)
+
+    weights = []
+    for event in events:
+        p = sampling[event["bin"]]
+        weights.append(target[event["bin"]] / p if p > 0.0 else 0.0)
+
+    sum_w = sum(weights)
+    sum_w2 = sum(w * w for w in weights)
+    ess = sum_w * sum_w / sum_w2 if sum_w2 > 0 else 0.0
+
+    doses = [event["edep_eV"] * EV_TO_JOULE / mass_kg for event in events]
+    sum_wd = sum(w * d for w, d in zip(weights, doses))
+
+    results = {"dose_per_event_Gy": sum_wd / sum_w if sum_w > 0 else float("nan")}
+    for column in YIELD_COLUMNS:
+        if sum_wd <= 0:
+            results[column] = (float("nan"), float("nan"))
+            continue
+        ratio = sum(w * event[column] for w, event in zip(weights, events)) / sum_wd
+        # Standard error of the ratio estimator (delta method)
+        residuals = sum((w * (event[column] - ratio * d)) ** 2 for w, event, d in zip(weights, events, doses))
+        results[column] = (ratio, math.sqrt(residuals) / sum_wd)
+    return results, ess, uncovered
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Reweight per-event damage tallies to other primary spectra.")
+    parser.add_argument("targets", nargs="+", help="target spectrum files (spectrum_*.txt)")
+    parser.add_argument("--tallies", required=True, help="event tallies file written by the scorer (FileEventTallies)")
+    parser.add_argument("--bins", required=True, help="energy grid file (energy_bins.txt or xray_bins.txt)")
+    parser.add_argument("--sampling", required=True, help="spectrum file used in the simulation, or 'flat'")
+    mass = parser.add_mutually_exclusive_group(required=True)
+    mass.add_argument("--run-summary", help="run summary file written by the scorer (FileRunSummary), to obtain the mass")
+    mass.add_argument("--mass-kg", type=float, help="mass of the scored component (kg)")
+    parser.add_argument("--min-ess", type=float, default=100.0, help="warn if the effective sample size is below this")
+    parser.add_argument("--output", help="output CSV file (default: standard output)")
+    args = parser.parse_args()
+
+    grid = read_energy_grid(args.bins)
+    sampling = read_spectrum(args.sampling, len(grid))
+    events = read_tallies(args.tallies)
+    mass_kg = args.mass_kg if args.mass_kg else read_mass_kg(args.run_summary)
+
+    max_mismatch = assign_bins(events, grid)
+    if max_mismatch > 1e-4:
+        print("Warning: some primary energies are not on the energy grid (max relative mismatch %.2g). "
+              "Were the events sampled from a discrete spectrum on this grid?" % max_mismatch, file=sys.stderr)
+
+    out = open(args.output, "w", newline="") if args.output else sys.stdout
+    writer = csv.writer(out)
+    header = ["spectrum", "events", "ESS", "uncovered_fraction", "dose_per_event_Gy"]
+    for column in YIELD_COLUMNS:
+        header += [column + "_per_Gy", column + "_per_Gy_stderr"]
+    writer.writerow(header)
+
+    for target_file in args.targets:
+        target = read_spectrum(target_file, len(grid))
+        results, ess, uncovered = reweight(events, sampling, target, mass_kg)
+
+        name = os.path.basename(target_file)
+        if ess < args.min_ess:
+            print("Warning: %s has an effective sample size of %.1f (< %g). Simulate it directly or use a "
+                  "broader sampling spectrum." % (name, ess, args.min_ess), file=sys.stderr)
+        if uncovered > 0:
+            print("Warning: %.3g of the weight of %s is in bins the sampling spectrum does not populate. "
+                  "Its yields are biased." % (uncovered, name), file=sys.stderr)
+
+        row = [name, len(events), "%.1f" % ess, "%.6g" % uncovered, "%.6g" % results["dose_per_event_Gy"]]
+        for column in YIELD_COLUMNS:
+            value, stderr = results[column]
+            row += ["%.6g" % value, "%.3g" % stderr]
+        writer.writerow(row)
+
+    if args.output:
+        out.close()
+
+
+if __name__ == "__main__":
+    main()
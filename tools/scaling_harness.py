@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+"""
+Measure how a benchmark simulation with the clustered DNA damage scorer scales with the number of
+threads, to find where it stops scaling: the split of the dose between threads, the master's
+absorption of the worker scorers, the serial damage analysis at the end of the run, or contention
+when writing output.
+
+The benchmark parameter file is run with Ts/NumberOfThreads = 1, 2, 4, ... N, ending each run with
+a dose threshold:
+    strong scaling: the same dose at every thread count
+    weak scaling:   a dose proportional to the number of threads
+Each run records the scorer's run metrics (Sc/<scorer>/RecordRunMetrics, see
+ScoreClusteredDNADamage::OutputRunMetricsToFile). The benchmark must set NumberOfHistoriesInRun
+high enough that every run ends on the dose threshold.
+
+The table has one row per run, with the time of each phase and its parallel efficiency relative to
+the single-thread run of the same mode:
+    strong scaling: E = T(1) / (n * T(n))   for phases that should shrink with more threads
+                    E = S(1) / S(n)         for work summed over threads (event analysis & output)
+    weak scaling:   E = T(1) / T(n)
+                    E = n * S(1) / S(n)
+The serial end-of-run phases cannot shrink, so their strong-scaling efficiency falls as 1/n; it is
+reported to show how much they weigh on the total. Startup is the wall time not covered by the
+scorer's phases (process start, geometry, physics tables & teardown).
+
+Example:
+    python3 tools/scaling_harness.py supportFiles/benchmark.txt --max-threads 64 --dose 0.1 \\
+        --output scaling.csv
+"""
+
+import argparse
+import csv
+import os
+import subprocess
+import sys
+import time
+
+# Columns of the run metrics file (see ScoreClusteredDNADamage::OutputRunMetricsToFile)
+METRICS_COLUMNS = ["threads", "events", "dose_Gy", "init_s", "event_loop_s", "events_per_s",
+                   "thread_end_spread_s", "min_events_per_thread", "max_events_per_thread",
+                   "event_analysis_s", "event_output_s", "absorb_s", "end_of_run_analysis_s",
+                   "end_of_run_output_s", "end_of_run_s", "peak_rss_MB"]
+
+# Phases whose efficiency is reported: (column, summed over threads)
+PHASES = [("wall_s", False), ("startup_s", False), ("init_s", False), ("event_loop_s", False),
+          ("event_analysis_s", True), ("event_output_s", True), ("absorb_s", False),
+          ("end_of_run_analysis_s", False), ("end_of_run_output_s", False), ("end_of_run_s", False)]
+
+
+def thread_counts(max_threads):
+    counts = []
+    n = 1
+    while n < max_threads:
+        counts.append(n)
+        n *= 2
+    counts.append(max_threads)
+    return counts
+
+
+def write_run_file(run_file, base_file, scorer, threads, dose_gy, metrics_file):
+    """Parameter file including the benchmark, with the overrides of one run."""
+    with open(run_file, "w") as f:
+        f.write("includeFile = %s\n" % os.path.abspath(base_file))
+        f.write("i:Ts/NumberOfThreads = %d\n" % threads)
+        f.write("b:Sc/%s/UseDoseThreshold = \"True\"\n" % scorer)
+        f.write("d:Sc/%s/DoseThreshold = %.9g Gy\n" % (scorer, dose_gy))
+        f.write("b:Sc/%s/RecordRunMetrics = \"True\"\n" % scorer)
+        f.write("s:Sc/%s/FileRunMetrics = \"%s\"\n" % (scorer, metrics_file))
+        f.write("b:Sc/%s/UseResultCache = \"False\"\n" % scorer)
+        f.write("b:Sc/%s/ReuseCachedResults = \"False\"\n" % scorer)
+
+
+def read_metrics(metrics_csv):
+    """Metrics of the last run in the file."""
+    rows = []
+    with open(metrics_csv) as f:
+        for row in csv.reader(f):
+            if row and not row[0].startswith("#"):
+                rows.append(row)
+    if not rows:
+        return None
+    return dict(zip(METRICS_COLUMNS, [float(v) for v in rows[-1]]))
+
+
+def run(args, mode, threads):
+    dose_gy = args.dose * (threads if mode == "weak" else 1)
+    name = "%s_%03d" % (mode, threads)
+    run_file = os.path.abspath(os.path.join(args.workdir, name + ".txt"))
+    metrics_file = os.path.abspath(os.path.join(args.workdir, name + "_run_metrics"))
+    log_file = os.path.join(args.workdir, name + ".log")
+    if os.path.exists(metrics_file + ".csv"):
+        os.remove(metrics_file + ".csv")
+    write_run_file(run_file, args.parameter_file, args.scorer, threads, dose_gy, metrics_file)
+
+    # Run from the directory of the benchmark, so its relative includeFiles resolve
+    print("Running %s scaling with %d thread(s), %.4g Gy..." % (mode, threads, dose_gy), file=sys.stderr)
+    start = time.monotonic()
+    with open(log_file, "w") as log:
+        status = subprocess.call([args.topas, run_file], stdout=log, stderr=subprocess.STDOUT,
+                                 cwd=os.path.dirname(os.path.abspath(args.parameter_file)))
+    wall = time.monotonic() - start
+
+    metrics = read_metrics(metrics_file + ".csv") if os.path.exists(metrics_file + ".csv") else None
+    if status != 0 or metrics is None:
+        print("Warning: run %s failed (exit status %d), see %s" % (name, status, log_file), file=sys.stderr)
+        return None
+
+    metrics["mode"] = mode
+    metrics["requested_threads"] = threads
+    metrics["wall_s"] = wall
+    metrics["startup_s"] = max(0.0, wall - metrics["init_s"] - metrics["event_loop_s"] - metrics["end_of_run_s"])
+    return metrics
+
+
+def efficiency(mode, threads, reference, value, is_summed):
+    if value <= 0 or reference <= 0:
+        return float("nan")
+    if mode == "strong":
+        return reference / value if is_summed else reference / (threads * value)
+    return threads * reference / value if is_summed else reference / value
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Strong & weak thread scaling of the clustered DNA damage scorer.")
+    parser.add_argument("parameter_file", help="benchmark TOPAS parameter file")
+    parser.add_argument("--max-threads", type=int, required=True, help="largest thread count (runs 1, 2, 4, ... N)")
+    parser.add_argument("--dose", type=float, required=True, help="dose (Gy) of the strong runs & of the 1-thread weak run")
+    parser.add_argument("--mode", choices=["strong", "weak", "both"], default="both")
+    parser.add_argument("--scorer", default="ClusterScorer", help="name of the scorer in the parameter file")
+    parser.add_argument("--topas", default="topas", help="TOPAS executable")
+    parser.add_argument("--workdir", default="scaling_runs", help="directory for run files, logs & metrics")
+    parser.add_argument("--output", help="output CSV file (default: standard output)")
+    args = parser.parse_args()
+
+    if args.max_threads < 1:
+        sys.exit("Error: --max-threads must be at least 1")
+    os.makedirs(args.workdir, exist_ok=True)
+
+    modes = ["strong", "weak"] if args.mode == "both" else [args.mode]
+    results = []
+    for mode in modes:
+        reference = None
+        for threads in thread_counts(args.max_threads):
+            metrics = run(args, mode, threads)
+            if metrics is None:
+                continue
+            if threads == 1:
+                reference = metrics
+            metrics["reference"] = reference
+            results.append(metrics)
+
+    out = open(args.output, "w", newline="") if args.output else sys.stdout
+    writer = csv.writer(out)
+    header = ["mode", "threads", "dose_Gy", "events", "events_per_s", "throughput_efficiency",
+              "thread_end_spread_s", "min_events_per_thread", "max_events_per_thread", "peak_rss_MB"]
+    for phase, _ in PHASES:
+        header += [phase, phase[:-2] + "_efficiency"]
+    writer.writerow(header)
+
+    for metrics in results:
+        mode = metrics["mode"]
+        threads = metrics["requested_threads"]
+        reference = metrics["reference"]
+        throughput = float("nan")
+        if reference and reference["events_per_s"] > 0:
+            throughput = metrics["events_per_s"] / (threads * reference["events_per_s"])
+
+        row = [mode, threads, "%.6g" % metrics["dose_Gy"], int(metrics["events"]), "%.6g" % metrics["events_per_s"],
+               "%.3f" % throughput, "%.4g" % metrics["thread_end_spread_s"], int(metrics["min_events_per_thread"]),
+               int(metrics["max_events_per_thread"]), "%.1f" % metrics["peak_rss_MB"]]
+        for phase, is_summed in PHASES:
+            value = metrics[phase]
+            eff = efficiency(mode, threads, reference[phase], value, is_summed) if reference else float("nan")
+            row += ["%.4g" % value, "%.3f" % eff]
+        writer.writerow(row)
+
+    if args.output:
+        out.close()
+
+    # Share of the wall time of each phase at the largest thread count
+    for mode in modes:
+        runs = [m for m in results if m["mode"] == mode]
+        if not runs:
+            continue
+        last = runs[-1]
+        shares = ", ".join("%s %.0f%%" % (phase[:-2], 100.0 * last[phase] / last["wall_s"])
+                           for phase in ("startup_s", "init_s", "event_loop_s", "absorb_s",
+                                         "end_of_run_analysis_s", "end_of_run_output_s"))
+        print("%s scaling, %d threads: %s of the wall time" % (mode, last["requested_threads"], shares), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,213 @@
+#!/usr/bin/env python3
+"""
+Validate a shortened chemical stage with continuous scavenging against the 1 ns baseline.
+
+The chemical stage usually runs to Ch/<chemistry>/ChemicalStageTimeEnd = 1 ns, the cut-off standing
+in for scavenging by the cellular environment. With Sc/<scorer>/ScavengingLifetime/<species>, each
+species is instead removed with survival probability exp(-t/tau), so the explicit stage can end
+earlier: a species surviving a cut-off T has probability exp(-T/tau) of still being free, and the
+damage it would have caused after T is lost. A cut-off of a few lifetimes loses little damage while
+saving most of the diffusion steps, which dominate the CPU time of indirect damage scoring.
+
+The benchmark parameter file is run once as the baseline (1 ns, no scavenging), then once for each
+requested cut-off with the given lifetimes. Every run delivers the same dose (Sc/<scorer>/DoseThreshold),
+with the same seed, and records its per-event yields (RecordEventTallies) & run metrics
+(RecordRunMetrics). The benchmark must set NumberOfHistoriesInRun high enough that every run ends on
+the dose threshold.
+
+For each run, the table gives the indirect yields per Gy with their standard error (from the spread
+of the per-event yields), their ratio to the baseline & the deviation in standard errors, and the CPU
+time of the TOPAS process & of the event loop with their speed-up over the baseline.
+
+Example:
+    python3 tools/scavenging_benchmark.py supportFiles/benchmark.txt --dose 1 \\
+        --lifetime OH=2.5 --lifetime e_aq=5 --lifetime H=5 --end-times 0.1 0.3 0.5 \\
+        --output scavenging.csv
+"""
+
+import argparse
+import csv
+import math
+import os
+import resource
+import subprocess
+import sys
+import time
+
+# Columns of the event tallies file (see ScoreClusteredDNADamage::OutputEventTalliesToFile)
+TALLY_COLUMNS = ["thread", "event", "primary_energy_MeV", "edep_eV",
+                 "SSB", "SSB_direct", "SSB_indirect",
+                 "DSB", "DSB_direct", "DSB_indirect", "DSB_hybrid",
+                 "BD", "BD_direct", "BD_indirect",
+                 "ComplexDSB", "NonDSBCluster"]
+YIELD_COLUMNS = ["SSB_indirect", "DSB_indirect", "BD_indirect", "DSB_hybrid", "SSB", "DSB", "BD"]
+
+# Columns of the run metrics file (see ScoreClusteredDNADamage::OutputRunMetricsToFile)
+METRICS_COLUMNS = ["threads", "events", "dose_Gy", "init_s", "event_loop_s", "events_per_s",
+                   "thread_end_spread_s", "min_events_per_thread", "max_events_per_thread",
+                   "event_analysis_s", "event_output_s", "absorb_s", "end_of_run_analysis_s",
+                   "end_of_run_output_s", "end_of_run_s", "peak_rss_MB"]
+
+
+def parse_lifetimes(values):
+    lifetimes = {}
+    for value in values:
+        if "=" not in value:
+            sys.exit("Error: --lifetime must be SPECIES=NS, got %s" % value)
+        species, lifetime = value.split("=", 1)
+        lifetimes[species] = float(lifetime)
+        if lifetimes[species] <= 0:
+            sys.exit("Error: the lifetime of %s must be positive" % species)
+    return lifetimes
+
+
+def write_run_file(run_file, args, end_time_ns, lifetimes, tallies_file, metrics_file):
+    """Parameter file including the benchmark, with the overrides of one run."""
+    scorer = args.scorer
+    with open(run_file, "w") as f:
+        f.write("includeFile = %s\n" % os.path.abspath(args.parameter_file))
+        f.write("i:Ts/NumberOfThreads = %d\n" % args.threads)
+        f.write("i:Ts/Seed = %d\n" % args.seed)
+        f.write("d:Ch/%s/ChemicalStageTimeEnd = %.9g ns\n" % (args.chemistry, end_time_ns))
+        f.write("b:Sc/%s/IncludeIndirectDamage = \"True\"\n" % scorer)
+        f.write("b:Sc/%s/UseDoseThreshold = \"True\"\n" % scorer)
+        f.write("d:Sc/%s/DoseThreshold = %.9g Gy\n" % (scorer, args.dose))
+        f.write("b:Sc/%s/RecordDamagePerEvent = \"True\"\n" % scorer)
+        f.write("b:Sc/%s/RecordEventTallies = \"True\"\n" % scorer)
+        f.write("s:Sc/%s/FileEventTallies = \"%s\"\n" % (scorer, tallies_file))
+        f.write("b:Sc/%s/RecordRunMetrics = \"True\"\n" % scorer)
+        f.write("s:Sc/%s/FileRunMetrics = \"%s\"\n" % (scorer, metrics_file))
+        f.write("b:Sc/%s/UseResultCache = \"False\"\n" % scorer)
+        f.write("b:Sc/%s/ReuseCachedResults = \"False\"\n" % scorer)
+        for species, lifetime in sorted(lifetimes.items()):
+            f.write("d:Sc/%s/ScavengingLifetime/%s = %.9g ns\n" % (scorer, species, lifetime))
+
+
+def read_rows(file_name):
+    rows = []
+    with open(file_name) as f:
+        for row in csv.reader(f):
+            if row and not row[0].startswith("#"):
+                rows.append([float(v) for v in row])
+    return rows
+
+
+def yields_per_gy(tallies, dose_gy):
+    """Yield per Gy of each column & its standard error, treating the events as independent."""
+    n = len(tallies)
+    result = {}
+    for column in YIELD_COLUMNS:
+        values = [event[column] for event in tallies]
+        total = sum(values)
+        mean = total / n
+        variance = sum((v - mean) ** 2 for v in values) / (n - 1) if n > 1 else 0.0
+        result[column] = (total / dose_gy, math.sqrt(n * variance) / dose_gy)
+    return result
+
+
+def run(args, name, end_time_ns, lifetimes):
+    run_file = os.path.abspath(os.path.join(args.workdir, name + ".txt"))
+    tallies_file = os.path.abspath(os.path.join(args.workdir, name + "_event_tallies"))
+    metrics_file = os.path.abspath(os.path.join(args.workdir, name + "_run_metrics"))
+    log_file = os.path.join(args.workdir, name + ".log")
+    for output in (tallies_file + ".csv", metrics_file + ".csv"):
+        if os.path.exists(output):
+            os.remove(output)
+    write_run_file(run_file, args, end_time_ns, lifetimes, tallies_file, metrics_file)
+
+    # Run from the directory of the benchmark, so its relative includeFiles resolve
+    print("Running %s (chemical stage %.4g ns)..." % (name, end_time_ns), file=sys.stderr)
+    usage_before = resource.getrusage(resource.RUSAGE_CHILDREN)
+    start = time.monotonic()
+    with open(log_file, "w") as log:
+        status = subprocess.call([args.topas, run_file], stdout=log, stderr=subprocess.STDOUT,
+                                 cwd=os.path.dirname(os.path.abspath(args.parameter_file)))
+    wall = time.monotonic() - start
+    usage_after = resource.getrusage(resource.RUSAGE_CHILDREN)
+
+    if status != 0 or not os.path.exists(tallies_file + ".csv") or not os.path.exists(metrics_file + ".csv"):
+        print("Warning: run %s failed (exit status %d), see %s" % (name, status, log_file), file=sys.stderr)
+        return None
+
+    metrics_rows = read_rows(metrics_file + ".csv")
+    tallies = [dict(zip(TALLY_COLUMNS, row)) for row in read_rows(tallies_file + ".csv")]
+    if not metrics_rows or not tallies:
+        print("Warning: run %s recorded no events, see %s" % (name, log_file), file=sys.stderr)
+        return None
+    metrics = dict(zip(METRICS_COLUMNS, metrics_rows[-1]))
+
+    return {"name": name, "end_time_ns": end_time_ns, "events": len(tallies), "dose_Gy": metrics["dose_Gy"],
+            "wall_s": wall, "event_loop_s": metrics["event_loop_s"],
+            "cpu_s": (usage_after.ru_utime - usage_before.ru_utime) + (usage_after.ru_stime - usage_before.ru_stime),
+            "yields": yields_per_gy(tallies, metrics["dose_Gy"])}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Indirect yields & CPU time of shortened chemical stages with "
+                                                 "continuous scavenging, against the 1 ns baseline.")
+    parser.add_argument("parameter_file", help="benchmark TOPAS parameter file, with indirect damage scoring")
+    parser.add_argument("--dose", type=float, required=True, help="dose (Gy) delivered by every run")
+    parser.add_argument("--lifetime", action="append", default=[], metavar="SPECIES=NS",
+                        help="scavenging lifetime (ns) of a species, e.g. OH=2.5 (repeat for each species)")
+    parser.add_argument("--end-times", type=float, nargs="+", required=True, metavar="NS",
+                        help="chemical stage cut-offs (ns) to compare with the baseline")
+    parser.add_argument("--baseline-end-time", type=float, default=1.0, metavar="NS",
+                        help="chemical stage cut-off (ns) of the baseline, run without scavenging")
+    parser.add_argument("--chemistry", default="TOPASChemistry", help="name of the chemistry (Ch/ChemistryName)")
+    parser.add_argument("--scorer", default="ClusterScorer", help="name of the scorer in the parameter file")
+    parser.add_argument("--threads", type=int, default=1, help="Ts/NumberOfThreads of every run")
+    parser.add_argument("--seed", type=int, default=1, help="Ts/Seed of every run")
+    parser.add_argument("--topas", default="topas", help="TOPAS executable")
+    parser.add_argument("--workdir", default="scavenging_runs", help="directory for run files, logs & outputs")
+    parser.add_argument("--output", help="output CSV file (default: standard output)")
+    args = parser.parse_args()
+
+    lifetimes = parse_lifetimes(args.lifetime)
+    if not lifetimes:
+        sys.exit("Error: at least one --lifetime is needed")
+    os.makedirs(args.workdir, exist_ok=True)
+
+    baseline = run(args, "baseline", args.baseline_end_time, {})
+    if baseline is None:
+        sys.exit("Error: the baseline run failed")
+    results = [baseline]
+    for end_time in args.end_times:
+        result = run(args, "scavenging_%gns" % end_time, end_time, lifetimes)
+        if result is not None:
+            results.append(result)
+
+    out = open(args.output, "w", newline="") if args.output else sys.stdout
+    writer = csv.writer(out)
+    header = ["run", "chemical_stage_ns", "events", "dose_Gy", "cpu_s", "cpu_speedup", "event_loop_s",
+              "event_loop_speedup"]
+    for column in YIELD_COLUMNS:
+        header += [column + "_per_Gy", column + "_per_Gy_stderr", column + "_ratio", column + "_deviation_sigma"]
+    writer.writerow(header)
+
+    for result in results:
+        row = [result["name"], "%.4g" % result["end_time_ns"], result["events"], "%.6g" % result["dose_Gy"],
+               "%.4g" % result["cpu_s"], "%.3f" % (baseline["cpu_s"] / result["cpu_s"] if result["cpu_s"] > 0 else float("nan")),
+               "%.4g" % result["event_loop_s"],
+               "%.3f" % (baseline["event_loop_s"] / result["event_loop_s"] if result["event_loop_s"] > 0 else float("nan"))]
+        for column in YIELD_COLUMNS:
+            value, error = result["yields"][column]
+            reference, reference_error = baseline["yields"][column]
+            ratio = value / reference if reference > 0 else float("nan")
+            combined = math.sqrt(error ** 2 + reference_error ** 2)
+            deviation = (value - reference) / combined if combined > 0 else float("nan")
+            row += ["%.6g" % value, "%.3g" % error, "%.4f" % ratio, "%.2f" % deviation]
+        writer.writerow(row)
+
+    if args.output:
+        out.close()
+
+    # Surviving fraction at each cut-off, i.e. the share of each species still free when the
+    # explicit stage ends
+    for end_time in args.end_times:
+        survival = ", ".join("%s %.1f%%" % (species, 100.0 * math.exp(-end_time / lifetime))
+                             for species, lifetime in sorted(lifetimes.items()))
+        print("Cut-off %.4g ns: species still free %s" % (end_time, survival), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""
+Print the live status stream of a ClusteredDNADamage scorer.
+
+With Sc/<scorer>/PublishStatusStream = "True", the scorer publishes one JSON record per
+Sc/<scorer>/StatusStreamInterval on the Unix-domain socket Sc/<scorer>/StatusStreamSocket (see
+scoring/StatusStreamPublisher.hh for the fields), and a final record at the end of each run. This
+client connects to the socket (waiting for it to appear if the simulation has not started yet) and
+prints one line per record, or the records themselves with --raw (e.g. to pipe them into jq or a
+dashboard). It exits when the simulation closes the socket.
+
+Example:
+    python3 tools/status_client.py dna_damage_status.sock
+"""
+
+import argparse
+import json
+import socket
+import sys
+import time
+
+QUANTITIES = ["SSB", "DSB", "BD", "ComplexDSB", "NonDSBCluster"]
+
+
+def connect(path, wait):
+    """Connect to the socket, retrying for up to wait seconds."""
+    deadline = time.monotonic() + wait
+    while True:
+        client = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        try:
+            client.connect(path)
+            return client
+        except (FileNotFoundError, ConnectionRefusedError):
+            client.close()
+            if time.monotonic() >= deadline:
+                sys.exit("Error: no status stream at %s" % path)
+            time.sleep(0.5)
+
+
+def format_record(record):
+    """One line summarising a record: progress, then recorded yields or the latest estimate."""
+    line = "[%s run %d %s] %8.1f s  %d events  %.1f events/s  %.4g Gy" % (
+        record["scorer"], record["run"], record["state"], record["elapsed_s"], record["events"],
+        record["events_per_s"], record["dose_Gy"])
+    if record["dose_threshold_Gy"] > 0:
+        line += " (%.0f%% of %.4g Gy)" % (100.0 * record["dose_Gy"] / record["dose_threshold_Gy"],
+                                           record["dose_threshold_Gy"])
+
+    if any(record[quantity] for quantity in QUANTITIES):
+        line += "  per Gy: " + ", ".join("%s %.4g" % (quantity, record[quantity + "_per_Gy"])
+                                         for quantity in QUANTITIES)
+    elif "estimate" in record:
+        estimate = record["estimate"]
+        line += "  estimate per Gy: " + ", ".join("%s %.4g+/-%.2g" % ((quantity,) + tuple(estimate[quantity + "_per_Gy"]))
+                                                  for quantity in QUANTITIES)
+    return line
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Print the live status stream of a ClusteredDNADamage scorer.")
+    parser.add_argument("socket", help="socket path (Sc/<scorer>/StatusStreamSocket)")
+    parser.add_argument("--raw", action="store_true", help="print the JSON records as received")
+    parser.add_argument("--wait", type=float, default=60.0, metavar="S",
+                        help="seconds to wait for the socket to appear (default: 60)")
+    args = parser.parse_args()
+
+    client = connect(args.socket, args.wait)
+    with client, client.makefile("r") as stream:
+        for line in stream:
+            if args.raw:
+                sys.stdout.write(line)
+            else:
+                print(format_record(json.loads(line)))
+            sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except KeyboardInterrupt:
+        pass